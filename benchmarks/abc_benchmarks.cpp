@@ -3,13 +3,18 @@
 #include <absim.hpp>
 #include <abc_assembler.hpp>
 #include <abc_compiler.hpp>
+#include <abc_interp.h>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cinttypes>
 #include <cstdio>
 #include <cstdarg>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <string>
 #include <strstream>
@@ -182,6 +187,241 @@ static void bench(char const* name)
         double(cycles_abc) / cycles_native);
 }
 
+// time assembling a compiled program through asm text versus reading
+// the compiler output directly
+static bool bench_assemble(char const* name)
+{
+    abc::compiler_t c{};
+    c.suppress_githash();
+    c.compile(std::string(PLATFORMER_DIR "/../") + name, "main");
+    if(!c.errors().empty())
+        return false;
+
+    using clock = std::chrono::steady_clock;
+    int const N = 8;
+    auto t0 = clock::now();
+    for(int i = 0; i < N; ++i)
+    {
+        std::stringstream fasm;
+        c.write(fasm);
+        abc::assembler_t a{};
+        if(!a.assemble(fasm).msg.empty() || !a.link().msg.empty())
+            return false;
+    }
+    auto t1 = clock::now();
+    for(int i = 0; i < N; ++i)
+    {
+        abc::assembler_t a{};
+        if(!a.assemble(c).msg.empty() || !a.link().msg.empty())
+            return false;
+    }
+    auto t2 = clock::now();
+
+    double text = std::chrono::duration<double, std::milli>(t1 - t0).count() / N;
+    double direct = std::chrono::duration<double, std::milli>(t2 - t1).count() / N;
+    printf("%-20s%9.1f ms%9.1f ms%11.2fx\n", name, text, direct, text / direct);
+    return true;
+}
+
+// synthetic program of short and long jumps, calls between distant
+// functions, and global reads above and below the 256-byte boundary
+static std::string relax_program(size_t num_instrs)
+{
+    size_t const per_func = 100;
+    size_t num_funcs = num_instrs / per_func;
+    std::ostringstream f;
+    f << ".shades 2\n.saved 0\n.global small 16\n.global large 512\n\n";
+    f << "$globinit:\n  ret\n\nmain:\n  call  f0\n  ret\n\n";
+    for(size_t fi = 0; fi < num_funcs; ++fi)
+    {
+        f << "f" << fi << ":\n";
+        for(size_t i = 0; i < per_func; i += 5)
+        {
+            f << "$L_" << fi << "_" << i << ":\n";
+            f << "  getg  small " << i % 16 << "\n";
+            f << "  getg  large " << 300 + i << "\n";
+            f << "  bz    $L_" << fi << "_" << (i + 5) % per_func << "\n";
+            f << "  jmp   $L_" << fi << "_0\n";
+            f << "  call  f" << (fi * 7919 + i) % num_funcs << "\n";
+        }
+        f << "  ret\n\n";
+    }
+    return f.str();
+}
+
+// time linking with and without jump relaxation
+static bool bench_relax(size_t num_instrs)
+{
+    auto text = relax_program(num_instrs);
+    double ms[2];
+    for(int relax = 0; relax < 2; ++relax)
+    {
+        abc::assembler_t a{};
+        a.enable_relaxing = relax != 0;
+        std::istringstream fi(text);
+        if(!a.assemble(fi).msg.empty())
+            return false;
+        auto t0 = std::chrono::steady_clock::now();
+        if(!a.link().msg.empty())
+            return false;
+        auto t1 = std::chrono::steady_clock::now();
+        ms[relax] = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    }
+    printf("%-20zu%9.1f ms%9.1f ms\n", num_instrs, ms[0], ms[1]);
+    return true;
+}
+
+static uint8_t generic_prog(void* user, uint32_t addr)
+{
+    auto const& d = *(std::vector<uint8_t> const*)user;
+    return addr < d.size() ? d[addr] : 0;
+}
+
+static bool generic_run_to_break(abc_interp_t& interp, abc_host_t const& host)
+{
+    for(;;)
+    {
+        auto r = abc_run(&interp, &host);
+        if(r == ABC_RESULT_BREAK)
+            return true;
+        if(r == ABC_RESULT_ERROR)
+            return false;
+    }
+}
+
+// Rerun the stretch from one debug break to the next n times from the
+// saved state and return the elapsed host time in picoseconds.
+static int64_t generic_batch(
+    abc_interp_t& interp, abc_host_t const& host,
+    abc_interp_t const& start, int n)
+{
+    using clock = std::chrono::steady_clock;
+    using ps = std::chrono::duration<int64_t, std::pico>;
+    auto t0 = clock::now();
+    for(int i = 0; i < n; ++i)
+    {
+        interp.pc = start.pc;
+        interp.sp = start.sp;
+        interp.csp = start.csp;
+        memcpy(interp.stack, start.stack, sizeof(interp.stack));
+        memcpy(interp.call_stack, start.call_stack, sizeof(interp.call_stack));
+        if(!generic_run_to_break(interp, host))
+            return -1;
+    }
+    auto t1 = clock::now();
+    return std::chrono::duration_cast<ps>(t1 - t0).count();
+}
+
+// measure() for the generic interpreter: host picoseconds from one debug
+// break to the next, less the same for the empty stretch at base. A single
+// run is too short for the clock, so batches of runs from the same state
+// alternate with batches of the empty stretch, and the median difference
+// is kept; restoring the state costs the same in both and cancels out.
+static uint64_t measure_generic(
+    abc_interp_t& interp, abc_host_t const& host, abc_interp_t& base)
+{
+    int const N = 5000;
+    if(!generic_run_to_break(interp, host))
+        return 0;
+    auto start = std::make_unique<abc_interp_t>(interp);
+    auto scratch = std::make_unique<abc_interp_t>(base);
+    std::vector<int64_t> diffs;
+    for(int batch = 0; batch < 31; ++batch)
+    {
+        int64_t t = generic_batch(interp, host, *start, N);
+        int64_t tb = generic_batch(*scratch, host, base, N);
+        if(t < 0 || tb < 0)
+            return 0;
+        diffs.push_back(t - tb);
+    }
+    std::nth_element(diffs.begin(), diffs.begin() + diffs.size() / 2, diffs.end());
+    int64_t d = diffs[diffs.size() / 2];
+    return d > 0 ? uint64_t(d / N) : 0;
+}
+
+// The argument of a row in the cost table: the shift count, the byte count
+// of GETLN and the like, the quotient bit width of a division, or whether
+// a branch is taken. Other variants are averaged into a row with -1.
+static int cost_arg(std::string const& mnem, std::string const& variant)
+{
+    if(variant.empty() || variant == "N")
+        return -1;
+    if(variant == "(taken)")
+        return 1;
+    if(variant == "(not taken)")
+        return 0;
+    if(variant[0] != '(')
+        return std::stoi(variant);
+    if(auto i = variant.find(" / "); i != std::string::npos)
+    {
+        uint64_t q = std::stoull(variant.substr(1)) / std::stoull(variant.substr(i + 3));
+        int n = 0;
+        for(; q != 0; q >>= 1)
+            ++n;
+        return n;
+    }
+    if(mnem.compare(0, 3, "lsl") == 0 ||
+        mnem.compare(0, 3, "lsr") == 0 ||
+        mnem.compare(0, 3, "asr") == 0)
+        return std::stoi(variant.substr(1));
+    return -1;
+}
+
+// Write the cost table that drives the compiler's cost model from the
+// per-instruction timings on both VMs.
+static bool write_cost_table(
+    char const* const* names, size_t num,
+    uint64_t const* cycles, uint64_t const* generic_ps)
+{
+    struct row_t { std::string instr; uint64_t sum[2]; uint64_t n; };
+    std::vector<std::pair<std::string, int>> order;
+    std::map<std::pair<std::string, int>, row_t> rows;
+    for(size_t i = 0; i < num; ++i)
+    {
+        std::string name = names[i];
+        if(name[0] == '$')
+            continue;
+        auto sp = name.find(' ');
+        std::string mnem = name.substr(0, sp);
+        std::string variant = sp == std::string::npos ? "" : name.substr(sp + 1);
+        std::pair<std::string, int> key{ mnem, cost_arg(mnem, variant) };
+        auto& r = rows[key];
+        if(r.n == 0)
+        {
+            order.push_back(key);
+            r.instr = "I_" + mnem;
+            for(auto& c : r.instr)
+                c = (char)toupper(c);
+        }
+        r.sum[0] += cycles[i];
+        r.sum[1] += generic_ps[i];
+        r.n += 1;
+    }
+
+    FILE* f = fopen(SRC_DIR "/abc_instr_costs.hpp", "w");
+    if(!f) return false;
+    fprintf(f, "#pragma once\n\n");
+    fprintf(f, "// Generated by abc_integration from benchmarks/instructions.asm.\n");
+    fprintf(f, "// Do not edit: rerun the benchmarks after changing either VM.\n");
+    fprintf(f, "//\n");
+    fprintf(f, "// Cost of each instruction on the Arduboy VM in cycles and on the\n");
+    fprintf(f, "// generic interpreter in host picoseconds. The argument is the shift\n");
+    fprintf(f, "// count, byte count, quotient bit width or whether a branch is taken,\n");
+    fprintf(f, "// and -1 where the measured variants were averaged.\n\n");
+    fprintf(f, "static instr_cost_t const INSTR_COSTS[] =\n{\n");
+    fprintf(f, "    //  instr        arg   arduboy  generic\n");
+    for(auto const& key : order)
+    {
+        auto const& r = rows[key];
+        fprintf(f, "    { %-10s %4d, { %7" PRIu64 ", %7" PRIu64 " } },\n",
+            (r.instr + ",").c_str(), key.second,
+            (r.sum[0] + r.n / 2) / r.n, (r.sum[1] + r.n / 2) / r.n);
+    }
+    fprintf(f, "};\n");
+    fclose(f);
+    return true;
+}
+
 int abc_benchmarks()
 {
     arduboy = std::make_unique<absim::arduboy_t>();
@@ -229,6 +469,21 @@ int abc_benchmarks()
     if(compile(PLATFORMER_DIR "/../tilemap/main.abc").empty()) return 1;
 #endif
 
+#if 1
+    printf("\nAssembly benchmark...\n\n");
+    printf("%-20s%12s%12s%12s\n", "", "Text", "Direct", "Speedup");
+    if(!bench_assemble("lasertank")) return 1;
+    if(!bench_assemble("platformer")) return 1;
+    if(!bench_assemble("tilemap")) return 1;
+#endif
+
+#if 1
+    printf("\nJump relaxation benchmark...\n\n");
+    printf("%-20s%12s%12s\n", "Instructions", "No relax", "Relax");
+    if(!bench_relax(10000)) return 1;
+    if(!bench_relax(100000)) return 1;
+#endif
+
 #if 1
     fout = fopen(PLATFORMER_DIR "/benchmark.txt", "w");
     if(!fout) return 1;
@@ -255,6 +510,7 @@ int abc_benchmarks()
 
     fout = fopen(BENCHMARKS_DIR "/cycles_instruction.txt", "w");
     if(!fout) return 1;
+    std::vector<uint8_t> instrs_binary;
     {
         abc::assembler_t a{};
         a.enable_relaxing = false;
@@ -277,8 +533,9 @@ int abc_benchmarks()
             auto t = arduboy->load_file("vm.hex", vmhex);
             assert(t.empty());
         }
+        instrs_binary = a.data();
         {
-            std::vector<uint8_t> binary = a.data();
+            std::vector<uint8_t> const& binary = instrs_binary;
             std::istrstream ss((char const*)binary.data(), (int)binary.size());
             auto t = arduboy->load_file("fxdata.bin", ss);
             assert(t.empty());
@@ -310,8 +567,8 @@ int abc_benchmarks()
         "refl", "refgb",
         "getr", "getr2", "getrn 3", "getrn 4", "getrn 8", "getrn 16", "getrn 32",
         "setr", "setr2", "setrn 3", "setrn 4", "setrn 8", "setrn 16", "setrn 32",
-        "aixb1", "aidxb", "aidx",
-        "pidxb", "pidx",
+        "aixb1", "aidxb", "aidx", "aixb",
+        "pixb", "pidxb", "pidx",
         "uaidx", "upidx",
         "aslc", "pslc",
         "inc", "dec", "linc N",
@@ -323,21 +580,21 @@ int abc_benchmarks()
         "sub", "sub2", "sub3", "sub4",
         "add2b", "sub2b", "mul2b", "add3b",
         "mul", "mul2", "mul3", "mul4",
-        "udiv2 (30000 / 7)", "udiv2 (30000 / 7000)",
-        "udiv4 (300000000 / 7)", "udiv4 (300000000 / 70000000)",
-        "div2 (30000 / 7)", "div2 (30000 / 7000)",
-        "div4 (300000000 / 7)", "div4 (300000000 / 70000000)",
-        "umod2 (30000 / 7)", "umod2 (30000 / 7000)",
-        "umod4 (300000000 / 7)", "umod4 (300000000 / 70000000)",
-        "mod2 (30000 / 7)", "mod2 (30000 / 7000)",
-        "mod4 (300000000 / 7)", "mod4 (300000000 / 70000000)",
+        "udiv2 (30000 / 7)", "udiv2 (30000 / 7000)", "udiv2 (30000 / 100)",
+        "udiv4 (300000000 / 7)", "udiv4 (300000000 / 70000000)", "udiv4 (300000000 / 3000)",
+        "div2 (30000 / 7)", "div2 (30000 / 7000)", "div2 (30000 / 100)",
+        "div4 (300000000 / 7)", "div4 (300000000 / 70000000)", "div4 (300000000 / 3000)",
+        "umod2 (30000 / 7)", "umod2 (30000 / 7000)", "umod2 (30000 / 100)",
+        "umod4 (300000000 / 7)", "umod4 (300000000 / 70000000)", "umod4 (300000000 / 3000)",
+        "mod2 (30000 / 7)", "mod2 (30000 / 7000)", "mod2 (30000 / 100)",
+        "mod4 (300000000 / 7)", "mod4 (300000000 / 70000000)", "mod4 (300000000 / 3000)",
         "lsl (0)", "lsl (1)", "lsl (4)", "lsl (7)", "lsl (8)", "lsl (64)",
-        "lsl2 (0)", "lsl2 (1)", "lsl2 (4)", "lsl2 (8)", "lsl2 (15)", "lsl2 (16)", "lsl2 (64)",
-        "lsl4 (0)", "lsl4 (1)", "lsl4 (4)", "lsl4 (8)", "lsl4 (16)", "lsl4 (24)", "lsl4 (31)", "lsl4 (32)", "lsl4 (64)",
+        "lsl2 (0)", "lsl2 (1)", "lsl2 (4)", "lsl2 (7)", "lsl2 (8)", "lsl2 (15)", "lsl2 (16)", "lsl2 (64)",
+        "lsl4 (0)", "lsl4 (1)", "lsl4 (4)", "lsl4 (8)", "lsl4 (15)", "lsl4 (16)", "lsl4 (24)", "lsl4 (31)", "lsl4 (32)", "lsl4 (64)",
         "lsr (0)", "lsr (1)", "lsr (4)", "lsr (7)", "lsr (8)", "lsr (64)",
-        "lsr2 (0)", "lsr2 (1)", "lsr2 (4)", "lsr2 (8)", "lsr2 (15)", "lsr2 (16)", "lsr2 (64)",
-        "lsr4 (0)", "lsr4 (1)", "lsr4 (4)", "lsr4 (8)", "lsr4 (16)", "lsr4 (24)", "lsr4 (31)", "lsr4 (32)", "lsr4 (64)",
-        "asr (0)", "asr (1)", "asr (4)", "asr (7)", "asr (8)", "asr (64)",
+        "lsr2 (0)", "lsr2 (1)", "lsr2 (4)", "lsr2 (7)", "lsr2 (8)", "lsr2 (15)", "lsr2 (16)", "lsr2 (64)",
+        "lsr4 (0)", "lsr4 (1)", "lsr4 (4)", "lsr4 (8)", "lsr4 (15)", "lsr4 (16)", "lsr4 (24)", "lsr4 (31)", "lsr4 (32)", "lsr4 (64)",
+        "asr (0)", "asr (1)", "asr (4)", "asr (6)", "asr (7)", "asr (8)", "asr (64)",
         "asr2 (0)", "asr2 (1)", "asr2 (4)", "asr2 (8)", "asr2 (15)", "asr2 (16)", "asr2 (64)",
         "asr4 (0)", "asr4 (1)", "asr4 (4)", "asr4 (8)", "asr4 (16)", "asr4 (24)", "asr4 (31)", "asr4 (32)", "asr4 (64)",
         "and", "and2", "and4",
@@ -422,18 +679,57 @@ int abc_benchmarks()
         "$draw_circle (64, 32, 32)",
         "$draw_circle (64, 32, 64)",
     };
+    size_t const NUM_INSTRS = sizeof(INSTRS) / sizeof(INSTRS[0]);
     (void)measure();
     uint64_t bn = measure();
+    std::vector<uint64_t> cycles;
     {
         std::vector<std::tuple<char const*, uint64_t>> timings;
         for(auto const* i : INSTRS)
             timings.push_back({ i, uint64_t(measure() - bn) });
         for(auto const& t : timings)
+        {
             fprintf(fout, "%5" PRIu64 "   %s\n", std::get<1>(t), std::get<0>(t));
+            cycles.push_back(std::get<1>(t));
+        }
     }
 
     fclose(fout);
 
+    // the same instructions on the generic interpreter, up to the
+    // system calls, which the cost table leaves out. Host timings are
+    // noisy, so each is the median of several passes.
+    {
+        int const PASSES = 7;
+        std::vector<std::vector<uint64_t>> passes(NUM_INSTRS);
+        auto interp = std::make_unique<abc_interp_t>();
+        abc_host_t host{};
+        host.prog = generic_prog;
+        host.user = &instrs_binary;
+        for(int pass = 0; pass < PASSES; ++pass)
+        {
+            memset(interp.get(), 0, sizeof(*interp));
+            // the stretch between the second pair of breaks is empty
+            for(int i = 0; i < 3; ++i)
+                (void)generic_run_to_break(*interp, host);
+            auto base = std::make_unique<abc_interp_t>(*interp);
+            (void)generic_run_to_break(*interp, host);
+            for(size_t i = 0; i < NUM_INSTRS && INSTRS[i][0] != '$'; ++i)
+                passes[i].push_back(measure_generic(*interp, host, *base));
+        }
+        std::vector<uint64_t> generic_ps(NUM_INSTRS);
+        for(size_t i = 0; i < NUM_INSTRS; ++i)
+        {
+            auto& p = passes[i];
+            if(p.empty())
+                continue;
+            std::nth_element(p.begin(), p.begin() + p.size() / 2, p.end());
+            generic_ps[i] = p[p.size() / 2];
+        }
+        if(!write_cost_table(INSTRS, NUM_INSTRS, cycles.data(), generic_ps.data()))
+            return 1;
+    }
+
     fout = fopen(BENCHMARKS_DIR "/cycles_code.txt", "w");
     if(!fout) return 1;
     {
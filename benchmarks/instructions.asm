@@ -927,6 +927,20 @@ $L_main_start:
     sys debug_break
     pop2
 
+    pushg g 0
+    push 42
+    sys debug_break
+    aixb 1
+    sys debug_break
+    pop2
+
+    pushl p 0
+    push 14
+    sys debug_break
+    pixb 1
+    sys debug_break
+    pop3
+
     pushl p 0
     push 14
     sys debug_break
@@ -1241,6 +1255,15 @@ $L_main_start:
     sys debug_break
     pop2
     
+    push 48
+    push 117
+    push 100
+    push 0
+    sys debug_break
+    udiv2
+    sys debug_break
+    pop2
+    
     push 0
     push 163
     push 225
@@ -1267,6 +1290,19 @@ $L_main_start:
     sys debug_break
     pop2
     
+    push 0
+    push 163
+    push 225
+    push 17
+    push 184
+    push 11
+    push 0
+    push 0
+    sys debug_break
+    udiv4
+    sys debug_break
+    pop2
+    
     push 48
     push 117
     push 7
@@ -1285,6 +1321,15 @@ $L_main_start:
     sys debug_break
     pop2
     
+    push 48
+    push 117
+    push 100
+    push 0
+    sys debug_break
+    div2
+    sys debug_break
+    pop2
+    
     push 0
     push 163
     push 225
@@ -1311,6 +1356,19 @@ $L_main_start:
     sys debug_break
     pop2
     
+    push 0
+    push 163
+    push 225
+    push 17
+    push 184
+    push 11
+    push 0
+    push 0
+    sys debug_break
+    div4
+    sys debug_break
+    pop2
+    
     push 48
     push 117
     push 7
@@ -1329,6 +1387,15 @@ $L_main_start:
     sys debug_break
     pop2
     
+    push 48
+    push 117
+    push 100
+    push 0
+    sys debug_break
+    umod2
+    sys debug_break
+    pop2
+    
     push 0
     push 163
     push 225
@@ -1355,6 +1422,19 @@ $L_main_start:
     sys debug_break
     pop2
     
+    push 0
+    push 163
+    push 225
+    push 17
+    push 184
+    push 11
+    push 0
+    push 0
+    sys debug_break
+    umod4
+    sys debug_break
+    pop2
+    
     push 48
     push 117
     push 7
@@ -1373,6 +1453,15 @@ $L_main_start:
     sys debug_break
     pop2
     
+    push 48
+    push 117
+    push 100
+    push 0
+    sys debug_break
+    mod2
+    sys debug_break
+    pop2
+    
     push 0
     push 163
     push 225
@@ -1399,6 +1488,19 @@ $L_main_start:
     sys debug_break
     pop2
     
+    push 0
+    push 163
+    push 225
+    push 17
+    push 184
+    push 11
+    push 0
+    push 0
+    sys debug_break
+    mod4
+    sys debug_break
+    pop2
+    
     push 0
     push 0
     sys debug_break
@@ -1462,6 +1564,13 @@ $L_main_start:
     sys debug_break
     pop2
     
+    p00
+    push 7
+    sys debug_break
+    lsl2
+    sys debug_break
+    pop2
+    
     p00
     push 8
     sys debug_break
@@ -1518,6 +1627,13 @@ $L_main_start:
     sys debug_break
     pop4
     
+    p0000
+    push 15
+    sys debug_break
+    lsl4
+    sys debug_break
+    pop4
+    
     p0000
     push 16
     sys debug_break
@@ -1616,6 +1732,13 @@ $L_main_start:
     sys debug_break
     pop2
     
+    p00
+    push 7
+    sys debug_break
+    lsr2
+    sys debug_break
+    pop2
+    
     p00
     push 8
     sys debug_break
@@ -1672,6 +1795,13 @@ $L_main_start:
     sys debug_break
     pop4
     
+    p0000
+    push 15
+    sys debug_break
+    lsr4
+    sys debug_break
+    pop4
+    
     p0000
     push 16
     sys debug_break
@@ -1728,6 +1858,13 @@ $L_main_start:
     sys debug_break
     pop
     
+    push 0
+    push 6
+    sys debug_break
+    asr
+    sys debug_break
+    pop
+    
     push 0
     push 7
     sys debug_break
@@ -0,0 +1,93 @@
+#include "abc_display_pipe.h"
+
+#include <stddef.h>
+
+static void convert_half(
+    abc_display_pipe_t const* pipe, uint8_t const* display, uint16_t* dst)
+{
+    uint16_t const* palette = pipe->palette;
+    uint32_t i, j;
+    for(j = 0; j < ABC_DISPLAY_PIPE_HALF_ROWS; ++j)
+    {
+        uint16_t* d0 = dst;
+        uint16_t* d1 = dst + ABC_DISPLAY_PIPE_WIDTH;
+        if(palette)
+        {
+            for(i = 0; i < ABC_DISPLAY_PIPE_WIDTH; ++i)
+                d0[i] = d1[i] = palette[display[i]];
+        }
+        else
+        {
+            for(i = 0; i < ABC_DISPLAY_PIPE_WIDTH; ++i)
+                d0[i] = d1[i] = display[i];
+        }
+        display += ABC_DISPLAY_PIPE_WIDTH;
+        dst += ABC_DISPLAY_PIPE_WIDTH * 2;
+    }
+}
+
+void abc_display_pipe_init(
+    abc_display_pipe_t* pipe,
+    uint16_t* buffer0,
+    uint16_t* buffer1)
+{
+    pipe->buffers[0] = buffer0;
+    pipe->buffers[1] = buffer1;
+    pipe->state[0] = ABC_DISPLAY_PIPE_FREE;
+    pipe->state[1] = ABC_DISPLAY_PIPE_FREE;
+    pipe->next_fill = 0;
+    pipe->next_send = 0;
+    pipe->frames = 0;
+    pipe->waits = 0;
+}
+
+void abc_display_pipe_poll(abc_display_pipe_t* pipe)
+{
+    uint8_t* state = pipe->state;
+    uint8_t n = pipe->next_send;
+    uint8_t prev = n ^ 1;
+    if(state[prev] == ABC_DISPLAY_PIPE_SENDING)
+    {
+        if(pipe->busy(pipe->user))
+            return;
+        state[prev] = ABC_DISPLAY_PIPE_FREE;
+    }
+    if(state[n] == ABC_DISPLAY_PIPE_QUEUED)
+    {
+        state[n] = ABC_DISPLAY_PIPE_SENDING;
+        pipe->next_send = prev;
+        pipe->write(pipe->user,
+            (uint8_t const*)pipe->buffers[n], ABC_DISPLAY_PIPE_HALF_BYTES);
+    }
+}
+
+void abc_display_pipe_frame(
+    abc_display_pipe_t* pipe,
+    uint8_t const* display)
+{
+    uint32_t half;
+    for(half = 0; half < 2; ++half)
+    {
+        uint8_t n = pipe->next_fill;
+        if(pipe->state[n] != ABC_DISPLAY_PIPE_FREE)
+        {
+            ++pipe->waits;
+            do abc_display_pipe_poll(pipe);
+            while(pipe->state[n] != ABC_DISPLAY_PIPE_FREE);
+        }
+        convert_half(pipe, display, pipe->buffers[n]);
+        pipe->state[n] = ABC_DISPLAY_PIPE_QUEUED;
+        pipe->next_fill = n ^ 1;
+        display += ABC_DISPLAY_PIPE_WIDTH * ABC_DISPLAY_PIPE_HALF_ROWS;
+        abc_display_pipe_poll(pipe);
+    }
+    ++pipe->frames;
+}
+
+uint8_t abc_display_pipe_idle(abc_display_pipe_t* pipe)
+{
+    abc_display_pipe_poll(pipe);
+    return
+        pipe->state[0] == ABC_DISPLAY_PIPE_FREE &&
+        pipe->state[1] == ABC_DISPLAY_PIPE_FREE;
+}
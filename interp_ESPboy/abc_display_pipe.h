@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* output frame: each 128x64 display row is sent twice (128x128 16-bit pixels) */
+#define ABC_DISPLAY_PIPE_WIDTH        128
+#define ABC_DISPLAY_PIPE_HEIGHT       64
+#define ABC_DISPLAY_PIPE_HALF_ROWS    (ABC_DISPLAY_PIPE_HEIGHT / 2)
+#define ABC_DISPLAY_PIPE_HALF_PIXELS  (ABC_DISPLAY_PIPE_WIDTH * ABC_DISPLAY_PIPE_HALF_ROWS * 2)
+#define ABC_DISPLAY_PIPE_HALF_BYTES   (ABC_DISPLAY_PIPE_HALF_PIXELS * 2)
+
+/********************************************************************
+* Double-buffered display transfer. A frame is converted and sent   *
+* in two halves: while one half-size line buffer is being sent by   *
+* a non-blocking transfer (e.g., interrupt-driven SPI), the other   *
+* can be filled. abc_display_pipe_frame only waits when the buffer  *
+* it needs is still in flight; the host should call                 *
+* abc_display_pipe_poll between abc_run calls to start queued       *
+* transfers as soon as the previous one has completed.              *
+********************************************************************/
+typedef struct abc_display_pipe_t
+{
+    /****************************************************************
+    * The following must not be NULL.                               *
+    ****************************************************************/
+
+    /* Whether a previously started transfer is still in progress. */
+    uint8_t (*busy)         (void* user);
+
+    /* Start a non-blocking transfer; data remains valid until done. */
+    void    (*write)        (void* user, uint8_t const* data, uint32_t size);
+
+    /****************************************************************
+    * The following may be NULL.                                    *
+    ****************************************************************/
+
+    /* Maps display pixel values to output pixels (identity if NULL). */
+    uint16_t const* palette;
+
+    void* user;
+
+    /* Two buffers of ABC_DISPLAY_PIPE_HALF_PIXELS pixels each. */
+    uint16_t* buffers[2];
+
+    /* Buffer states (ABC_DISPLAY_PIPE_*) and transfer order. */
+    uint8_t  state[2];
+    uint8_t  next_fill;
+    uint8_t  next_send;
+
+    /* Statistics */
+    uint32_t frames;
+    uint32_t waits;     /* number of times a frame had to wait for a buffer */
+
+} abc_display_pipe_t;
+
+enum
+{
+    ABC_DISPLAY_PIPE_FREE,
+    ABC_DISPLAY_PIPE_QUEUED,
+    ABC_DISPLAY_PIPE_SENDING,
+};
+
+/*
+Attach the two half-size buffers and mark them free.
+The transfer callbacks, palette and user pointer should be set separately.
+*/
+void abc_display_pipe_init(
+    abc_display_pipe_t* pipe,
+    uint16_t* buffer0,
+    uint16_t* buffer1
+);
+
+/*
+Convert a 128x64 display into the pipe buffers and queue both halves.
+The display may be modified again as soon as this returns.
+*/
+void abc_display_pipe_frame(
+    abc_display_pipe_t* pipe,
+    uint8_t const* display
+);
+
+/*
+Retire a completed transfer and start the next queued one, if any.
+Never blocks.
+*/
+void abc_display_pipe_poll(abc_display_pipe_t* pipe);
+
+/* Whether all queued halves have been sent. */
+uint8_t abc_display_pipe_idle(abc_display_pipe_t* pipe);
+
+#ifdef __cplusplus
+}
+#endif
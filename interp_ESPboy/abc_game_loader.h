@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef ABC_GAME_LIST_MAX_GAMES
+#define ABC_GAME_LIST_MAX_GAMES 32
+#endif
+
+#ifndef ABC_GAME_LIST_MAX_NAME
+#define ABC_GAME_LIST_MAX_NAME 32
+#endif
+
+#define ABC_GAME_HEADER_SIZE 256
+
+typedef enum
+{
+    ABC_GAME_OK,
+    ABC_GAME_ERROR_OPEN,       /* file could not be opened */
+    ABC_GAME_ERROR_FORMAT,     /* file is not a compiled ABC binary */
+} abc_game_result_t;
+
+/********************************************************************
+* Filesystem interface for loading compiled games at runtime, e.g., *
+* from a LittleFS/SPIFFS partition or a directory on a desktop.     *
+********************************************************************/
+typedef struct abc_game_fs_t
+{
+    /****************************************************************
+    * The following must not be NULL.                               *
+    ****************************************************************/
+
+    /* Get name and size of the index'th file. Returns 0 past the end. */
+    uint8_t (*entry)        (void* user, uint32_t index,
+                             char* name, uint32_t name_size, uint32_t* size);
+
+    /* Open a file for reading and get its size. Returns NULL on failure. */
+    void*   (*open)         (void* user, char const* name, uint32_t* size);
+
+    /* Read up to n bytes at offset. Returns the number of bytes read. */
+    uint32_t(*read)         (void* user, void* file,
+                             uint32_t offset, uint8_t* dst, uint32_t n);
+
+    /* Close a file returned by open. */
+    void    (*close)        (void* user, void* file);
+
+    void* user;
+
+} abc_game_fs_t;
+
+/********************************************************************
+* List of games (*.bin files) with menu selection state.            *
+********************************************************************/
+typedef struct abc_game_list_t
+{
+    char     names[ABC_GAME_LIST_MAX_GAMES][ABC_GAME_LIST_MAX_NAME];
+    uint32_t sizes[ABC_GAME_LIST_MAX_GAMES];
+    uint8_t  count;
+
+    /* Menu state */
+    uint8_t  selected;
+    uint8_t  scroll;
+    uint8_t  buttons_prev;
+
+} abc_game_list_t;
+
+/********************************************************************
+* An open game. Pass abc_game_fill_line as abc_prog_cache_t's       *
+* fill_line with the game as user to stream bytecode from the file. *
+********************************************************************/
+typedef struct abc_game_t
+{
+    abc_game_fs_t const* fs;
+    void*    file;
+    uint32_t size;
+
+    /* From the binary header */
+    uint16_t save_size;
+    uint8_t  shades;
+
+} abc_game_t;
+
+/*
+Fill the list with all *.bin files (sorted by name) and reset the menu.
+Files whose names do not fit ABC_GAME_LIST_MAX_NAME are skipped.
+*/
+void abc_game_list_scan(abc_game_list_t* list, abc_game_fs_t const* fs);
+
+/*
+Update menu selection from the current button state (ABC_BUTTON_*).
+Returns 1 when the selected game has been chosen with A.
+*/
+uint8_t abc_game_list_update(
+    abc_game_list_t* list,
+    uint8_t buttons,
+    uint8_t visible_rows  /* Number of rows the host can show at once */
+);
+
+/* Open a game and check its header. */
+abc_game_result_t abc_game_open(
+    abc_game_t* game,
+    abc_game_fs_t const* fs,
+    char const* name
+);
+
+void abc_game_close(abc_game_t* game);
+
+/* Read n bytes at addr; bytes past the end of the file read as zero. */
+void abc_game_fill_line(void* game, uint32_t addr, uint8_t* dst, uint32_t n);
+
+/* 16-bit identifier derived from the file name, e.g., for save slots. */
+uint16_t abc_game_id(char const* name);
+
+#ifdef __cplusplus
+}
+#endif
@@ -298,6 +298,8 @@ enum
     I_ICALL,
     I_RET,
     I_SYS,
+    I_AIXB,
+    I_PIXB,
 };
 
 #define st_inc(p__, x__) (*(p__)++ = (x__))
@@ -1263,6 +1265,22 @@ static abc_result_t aidx(abc_interp_t* interp, abc_host_t const* h)
     return push16(interp, p + i * b);
 }
 
+static abc_result_t aixb(abc_interp_t* interp, abc_host_t const* h)
+{
+    uint8_t b = imm8(interp, h);
+    uint8_t i = pop8(interp);
+    uint16_t p = pop16(interp);
+    return push16(interp, p + i * b);
+}
+
+static abc_result_t pixb(abc_interp_t* interp, abc_host_t const* h)
+{
+    uint8_t b = imm8(interp, h);
+    uint8_t i = pop8(interp);
+    uint32_t p = pop24(interp);
+    return push24(interp, p + i * b);
+}
+
 static abc_result_t pidxb(abc_interp_t* interp, abc_host_t const* h)
 {
     uint8_t b = imm8(interp, h);
@@ -3635,6 +3653,8 @@ abc_result_t abc_run(abc_interp_t* interp, abc_host_t const* h)
     case I_AIXB1: return aixb1(interp, h);
     case I_AIDXB: return aidxb(interp, h);
     case I_AIDX:  return aidx(interp, h);
+    case I_AIXB:  return aixb(interp, h);
+    case I_PIXB:  return pixb(interp, h);
     case I_PIDXB: return pidxb(interp, h);
     case I_PIDX:  return pidx(interp, h);
     case I_UAIDX: return uaidx(interp, h);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* log2 of the cache line size in bytes (5 = 32 bytes, 6 = 64 bytes) */
+#ifndef ABC_PROG_CACHE_LINE_BITS
+#define ABC_PROG_CACHE_LINE_BITS 5
+#endif
+
+#define ABC_PROG_CACHE_LINE_SIZE (1u << ABC_PROG_CACHE_LINE_BITS)
+
+typedef struct abc_prog_cache_line_t
+{
+    uint32_t tag;
+    uint8_t  data[ABC_PROG_CACHE_LINE_SIZE];
+} abc_prog_cache_line_t;
+
+/********************************************************************
+* Direct-mapped read-through cache for program data. Hosts whose    *
+* bytecode lives in slow memory (e.g., memory-mapped flash) can put *
+* this in front of their byte source: set abc_host_t::prog to       *
+* abc_prog_cache_prog and abc_host_t::user to the cache.            *
+********************************************************************/
+typedef struct abc_prog_cache_t
+{
+    /****************************************************************
+    * At least one of the following must not be NULL. If both are   *
+    * set, fill_line is used.                                       *
+    ****************************************************************/
+
+    /* Access a single byte in the slow byte source. */
+    uint8_t (*source)       (void* user, uint32_t addr);
+
+    /* Copy n bytes starting at addr from the slow byte source. */
+    void    (*fill_line)    (void* user, uint32_t addr, uint8_t* dst, uint32_t n);
+
+    void* user;
+
+    /* Line storage provided by the host: num_lines must be a power of two. */
+    abc_prog_cache_line_t* lines;
+    uint32_t num_lines;
+
+    /* Statistics */
+    uint32_t hits;
+    uint32_t misses;
+
+} abc_prog_cache_t;
+
+/*
+Attach line storage and invalidate all lines.
+The source callbacks and user pointer should be set separately.
+*/
+void abc_prog_cache_init(
+    abc_prog_cache_t* cache,
+    abc_prog_cache_line_t* lines,
+    uint32_t num_lines    /* Number of lines (must be a power of two) */
+);
+
+/* Invalidate all lines, e.g., after the underlying program has changed. */
+void abc_prog_cache_invalidate(abc_prog_cache_t* cache);
+
+/* Clear hit and miss counters. */
+void abc_prog_cache_reset_stats(abc_prog_cache_t* cache);
+
+/* Read a single byte through the cache. */
+uint8_t abc_prog_cache_read(abc_prog_cache_t* cache, uint32_t addr);
+
+/* Same as abc_prog_cache_read, with the signature of abc_host_t::prog. */
+uint8_t abc_prog_cache_prog(void* cache, uint32_t addr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,10 +2,15 @@
 ESPboy ABC interp port
 for www.ESPboy.com project by RomanS
 
-to changed APP - change following, then compile
- 1. #include "compiled_h/APP.h" - lines 16-25
- 2. APP_ID - line 37
- 3. myESPboy.begin("App name"); - line 162
+By default games (*.bin from compiled_bin) are loaded at runtime from
+the LittleFS partition: upload them with the LittleFS data upload tool
+and pick one from the menu shown at startup.
+
+to compile an APP into the firmware instead
+ 1. comment out #define LOAD_FROM_FS
+ 2. #include "compiled_h/APP.h" below
+ 3. APP_ID
+ 4. myESPboy.begin("App name");
 */
 
 #include "Arduino.h"
@@ -13,6 +18,11 @@ to changed APP - change following, then compile
 #include <mmu_iram.h>
 #include <ESP_EEPROM.h>
 
+#define LOAD_FROM_FS
+
+#ifdef LOAD_FROM_FS
+#include <LittleFS.h>
+#else
 //#include "compiled_h/basic.h"
 //#include "compiled_h/circle.h"
 //#include "compiled_h/font.h"
@@ -23,6 +33,7 @@ to changed APP - change following, then compile
 //#include "compiled_h/pong.h"
 //#include "compiled_h/snake.h"
 //#include "compiled_h/tilemap.h"
+#endif
 
 #include "lib/ESPboyInit.h"
 #include "lib/ESPboyInit.cpp"
@@ -32,7 +43,10 @@ to changed APP - change following, then compile
 //#include "lib/ESPboyOTA2.cpp"
 
 #include "nbSPI.h"
+#include "abc_display_pipe.h"
+#include "abc_game_loader.h"
 #include "abc_interp.h"
+#include "abc_prog_cache.h"
 
 #define APP_ID        0xFFFF
 #define WIDTH         128
@@ -40,8 +54,10 @@ to changed APP - change following, then compile
 #define SAMPLING_RATE 22000
 #define SOUND_PIN     D3
 #define SOUND_LEN     SAMPLING_RATE/20
+#define PROG_CACHE_LINES 64
+#define MENU_ROWS     14
 
-static uint16_t         *doblebuffer = NULL;
+static uint16_t         *displaybuffers[2] = {NULL, NULL};
 static int16_t          *samples = NULL;
 static volatile uint8_t endofSample = 1;
 static volatile int16_t samplePointer = 0;
@@ -53,12 +69,72 @@ ESPboyInit myESPboy;
 static abc_interp_t interp;
 static abc_host_t host;
 
+/* the game sits in flash: keep recently used lines of it in RAM */
+static abc_prog_cache_line_t prog_cache_lines[PROG_CACHE_LINES];
+static abc_prog_cache_t prog_cache;
+static uint16_t appId = APP_ID;
+
+/* display halves are converted while the previous one is sent over SPI */
+static abc_display_pipe_t display_pipe;
+
+
+#ifdef LOAD_FROM_FS
+static abc_game_fs_t game_fs;
+static abc_game_list_t game_list;
+static abc_game_t game;
+static File game_file;
+
+/* the scan asks for entries in order: keep walking one directory listing
+   and only start it over when the index goes back */
+static Dir game_dir;
+static uint32_t game_dir_pos = 0; /* entries read from game_dir */
+
+
+static uint8_t fs_entry(void* user, uint32_t index, char* name, uint32_t name_size, uint32_t* size){
+    if(index == 0 || index + 1 < game_dir_pos){
+      game_dir = LittleFS.openDir("/");
+      game_dir_pos = 0;
+    }
+    while(game_dir_pos <= index){
+      if(!game_dir.next()) return 0;
+      game_dir_pos++;
+    }
+    snprintf(name, name_size, "%s", game_dir.fileName().c_str());
+    *size = game_dir.fileSize();
+    return 1;
+}
+
 
-static inline __attribute__((always_inline)) uint8_t host_prog(void* user, uint32_t addr){
-    return mmu_get_uint8((const void *)(&abcData[addr]));
+static void* fs_open(void* user, char const* name, uint32_t* size){
+    game_file = LittleFS.open(String("/") + name, "r");
+    if(!game_file) return NULL;
+    *size = game_file.size();
+    return &game_file;
 }
 
 
+static uint32_t fs_read(void* user, void* file, uint32_t offset, uint8_t* dst, uint32_t n){
+    File* f = (File*)file;
+    if(!f->seek(offset, SeekSet)) return 0;
+    return f->read(dst, n);
+}
+
+
+static void fs_close(void* user, void* file){
+    ((File*)file)->close();
+}
+#else
+static void host_prog_fill(void* user, uint32_t addr, uint8_t* dst, uint32_t n){
+    uint32_t avail = addr < sizeof(abcData) ? sizeof(abcData) - addr : 0;
+    if(n > avail){
+      memset(dst + avail, 0, n - avail);
+      n = avail;
+    }
+    if(n) memcpy_P(dst, &abcData[addr], n);
+}
+#endif
+
+
 static inline __attribute__((always_inline)) uint32_t host_millis(void* user){
     return millis();
 }
@@ -83,22 +159,19 @@ static uint32_t __attribute__((always_inline)) host_rand_seed(void* user){
 }
 
 
+static uint8_t host_spi_busy(void* user){
+    return nbSPI_isBusy() ? 1 : 0;
+}
+
+
+static void host_spi_write(void* user, uint8_t const* data, uint32_t size){
+    nbSPI_writeBytes((uint8_t*)data, (uint16_t)size);
+}
+
+
 void __attribute__((always_inline)) doDisplayCPP(){   
     ESP.wdtFeed();
-    
-    uint16_t addr1=0, addr2=WIDTH, addr3=0;
-    for(uint8_t j=0; j<HEIGHT; j++){
-      for(uint8_t i=0; i<WIDTH; i++){
-        uint8_t bte = interp.display[addr3++];    
-        doblebuffer[addr1++] = bte;
-        doblebuffer[addr2++] = bte;
-      }
-      addr1+=WIDTH;
-      addr2+=WIDTH;
-    }
-     
-     while(nbSPI_isBusy()); 
-     nbSPI_writeBytes((uint8_t*)doblebuffer, 128*128*2);
+    abc_display_pipe_frame(&display_pipe, interp.display);
 }
 
 
@@ -154,6 +227,52 @@ void fillSoundBuf(){
 }
 
 
+#ifdef LOAD_FROM_FS
+void drawMenu(){
+    myESPboy.tft.fillScreen(TFT_BLACK);
+    myESPboy.tft.setTextColor(TFT_YELLOW, TFT_BLACK);
+    myESPboy.tft.drawString("Select game:", 4, 2);
+    for(uint8_t i=0; i<MENU_ROWS && game_list.scroll+i<game_list.count; i++){
+      uint8_t n = game_list.scroll+i;
+      myESPboy.tft.setTextColor(n == game_list.selected ? TFT_WHITE : TFT_DARKGREY, TFT_BLACK);
+      myESPboy.tft.drawString(game_list.names[n], 4, 14+i*8);
+    }
+}
+
+
+void selectGame(){
+    game_fs.entry = fs_entry;
+    game_fs.open = fs_open;
+    game_fs.read = fs_read;
+    game_fs.close = fs_close;
+    LittleFS.begin();
+    abc_game_list_scan(&game_list, &game_fs);
+
+    if(!game_list.count){
+      myESPboy.tft.fillScreen(TFT_BLACK);
+      myESPboy.tft.setTextColor(TFT_RED, TFT_BLACK);
+      myESPboy.tft.drawString("No games found", 4, 2);
+      for(;;) {delay(100); ESP.wdtFeed();}
+    }
+
+    uint8_t lastSelected = 0xff;
+    for(;;){
+      uint8_t chosen = abc_game_list_update(&game_list, host_buttons(NULL), MENU_ROWS);
+      if(game_list.selected != lastSelected){
+        lastSelected = game_list.selected;
+        drawMenu();
+      }
+      if(chosen && abc_game_open(&game, &game_fs, game_list.names[game_list.selected]) == ABC_GAME_OK)
+        break;
+      delay(20);
+      ESP.wdtFeed();
+    }
+
+    appId = abc_game_id(game_list.names[game_list.selected]);
+}
+#endif
+
+
 void setup() {
   //Serial.begin(115200);
   EEPROM.begin(1028);
@@ -170,11 +289,12 @@ void setup() {
 //  }
 
 /* alloc mem */
-  //Serial.println((int32_t)doblebuffer);
+  //Serial.println((int32_t)displaybuffers[0]);
   //Serial.println((int32_t)samples);
-  doblebuffer = (uint16_t *) malloc (128*128*2);
+  displaybuffers[0] = (uint16_t *) malloc (ABC_DISPLAY_PIPE_HALF_BYTES);
+  displaybuffers[1] = (uint16_t *) malloc (ABC_DISPLAY_PIPE_HALF_BYTES);
   samples = (int16_t *) malloc ((SOUND_LEN+1)*2);
-  //Serial.println((int32_t)doblebuffer);
+  //Serial.println((int32_t)displaybuffers[0]);
   //Serial.println((int32_t)samples);
   
   /* Init sound */
@@ -191,7 +311,17 @@ void setup() {
   /* Init ABC */
   memset(&interp, 0, sizeof(interp));
   memset(&host, 0, sizeof(host));
-  host.prog = host_prog;
+  memset(&prog_cache, 0, sizeof(prog_cache));
+#ifdef LOAD_FROM_FS
+  selectGame();
+  prog_cache.fill_line = abc_game_fill_line;
+  prog_cache.user = &game;
+#else
+  prog_cache.fill_line = host_prog_fill;
+#endif
+  abc_prog_cache_init(&prog_cache, prog_cache_lines, PROG_CACHE_LINES);
+  host.prog = abc_prog_cache_prog;
+  host.user = &prog_cache;
   host.millis = host_millis;
   host.buttons = host_buttons;
   host.rand_seed = host_rand_seed;
@@ -199,9 +329,9 @@ void setup() {
   
 
   /* Init savings */
-  uint16_t appId;
-  EEPROM.get(0, appId);
-  if (appId == APP_ID){
+  uint16_t savedId;
+  EEPROM.get(0, savedId);
+  if (savedId == appId){
     //Serial.println("Loading done!");
     for(uint16_t i=0; i<1024; i++){
       interp.saved[i] = EEPROM.read(i+2);
@@ -211,7 +341,6 @@ void setup() {
     interp.has_save = 1;}
   else{
     //Serial.println("Init loading done!");
-    appId = APP_ID;
     EEPROM.put(0, appId);
     interp.audio_disabled = 0;
     for(uint16_t i=0; i<1024; i++){
@@ -224,6 +353,10 @@ void setup() {
   /* Init display */
   myESPboy.tft.fillScreen(TFT_BLACK);
   myESPboy.tft.setAddrWindow(0, 0, WIDTH, HEIGHT*2);
+  memset(&display_pipe, 0, sizeof(display_pipe));
+  display_pipe.busy = host_spi_busy;
+  display_pipe.write = host_spi_write;
+  abc_display_pipe_init(&display_pipe, displaybuffers[0], displaybuffers[1]);
 
 }
 
@@ -235,8 +368,11 @@ void loop(){
 
   /* do interp */
   for(uint16_t i = 0; i < 200; i++){     
+    /* queue the frame once, when it starts waiting for frame timing;
+       later idle polls leave the pipe to drain */
+    uint8_t waiting = interp.waiting_for_frame;
     t = abc_run(&interp, &host);
-    if (t == ABC_RESULT_IDLE)  {
+    if (t == ABC_RESULT_IDLE && !waiting && interp.waiting_for_frame)  {
       doDisplayCPP(); 
       // Serial.println("Idle");
       // for FPS display
@@ -252,6 +388,9 @@ void loop(){
     if (t == ABC_RESULT_BREAK) {/*Serial.println("Break");*/ delay(500);}
     if (t == ABC_RESULT_ERROR) {/*Serial.println("Error");*/ delay(5000); ESP.reset();}
 
+    /* start sending the second display half once the first is out */
+    abc_display_pipe_poll(&display_pipe);
+
     /* prefill sound buffer if get command form sound ISR */
     fillSoundBuf();
   }
@@ -337,6 +337,12 @@ enum instr_t : uint8_t
 
     I_SYS,   // call sysfunc (imm8)
 
+    // new instructions go here, so that existing binaries keep their
+    // encoding
+
+    I_AIXB,  // ref i | (ref+i*imm) without bounds checking (8-bit)
+    I_PIXB,  // pref i | (pref+i*imm) without bounds checking (8-bit)
+
     NUM_INSTRS,
 
     //
@@ -4219,10 +4219,6 @@ sys_mod:
 
     .align 6
 
-    ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
-    ; NOTE! I_SYS impl is too long, but it's the last one so it's OK
-    ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
-
 I_SYS:
     ldi  r30, lo8(%[sys_funcs])
     ldi  r31, hi8(%[sys_funcs])
@@ -4255,22 +4251,64 @@ I_SYS:
     clr  r1
 
     icall
+    rjmp sys_part2
+    .align 6
 
-    ; restore stack setup
-    lds  r28, %[vm_sp]
+I_AIXB:
+    mov  r20, r9
+    add  r6, r4
+    adc  r7, r2
+    adc  r8, r2
+    rjmp .+0
+    cli
+    out  %[spdr], r2
+    in   r0, %[spdr]
+    sei
+    ; r0:  elem size
+    ; r20: index
+    mul  r0, r20
     ld   r9, -Y
+    ld   r22, -Y
+    add  r22, r0
+    adc  r9, r1
+    st   Y+, r22
+    nop
+    dispatch_reverse
 
-    dispatch_noalign
-
-    ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
-    ; NOTE! I_SYS impl is too long, but it's the last one so it's OK
-    ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
+I_PIXB:
+    mov  r20, r9
+    add  r6, r4
+    adc  r7, r2
+    adc  r8, r2
+    rjmp .+0
+    cli
+    out  %[spdr], r2
+    in   r0, %[spdr]
+    sei
+    ; r0:  elem size
+    ; r20: index
+    mul  r0, r20
+    ld   r9, -Y
+    ld   r23, -Y
+    ld   r22, -Y
+    add  r22, r0
+    adc  r23, r1
+    adc  r9, r2
+    st   Y+, r22
+    st   Y+, r23
+    dispatch_reverse
 
 
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 ; helper methods
 ;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;
 
+sys_part2:
+    ; restore stack setup
+    lds  r28, %[vm_sp]
+    ld   r9, -Y
+    dispatch_noalign
+
 pidx_part2:
     
     ; compute prog ref + index * elem_size
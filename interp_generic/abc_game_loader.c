@@ -0,0 +1,143 @@
+#include "abc_game_loader.h"
+
+#include "abc_interp.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static uint8_t has_bin_extension(char const* name)
+{
+    size_t n = strlen(name);
+    if(n < 5)
+        return 0;
+    name += n - 4;
+    return
+        name[0] == '.' &&
+        (name[1] == 'b' || name[1] == 'B') &&
+        (name[2] == 'i' || name[2] == 'I') &&
+        (name[3] == 'n' || name[3] == 'N');
+}
+
+void abc_game_list_scan(abc_game_list_t* list, abc_game_fs_t const* fs)
+{
+    char name[ABC_GAME_LIST_MAX_NAME + 1];
+    uint32_t index;
+    uint32_t size;
+
+    memset(list, 0, sizeof(*list));
+
+    for(index = 0; list->count < ABC_GAME_LIST_MAX_GAMES; ++index)
+    {
+        uint8_t i;
+        memset(name, 0, sizeof(name));
+        size = 0;
+        if(!fs->entry(fs->user, index, name, sizeof(name), &size))
+            break;
+        if(name[ABC_GAME_LIST_MAX_NAME - 1] != '\0')
+            continue;
+        if(!has_bin_extension(name))
+            continue;
+        if(size < ABC_GAME_HEADER_SIZE)
+            continue;
+
+        /* insertion sort by name */
+        i = list->count++;
+        for(; i > 0 && strcmp(list->names[i - 1], name) > 0; --i)
+        {
+            memcpy(list->names[i], list->names[i - 1], ABC_GAME_LIST_MAX_NAME);
+            list->sizes[i] = list->sizes[i - 1];
+        }
+        memcpy(list->names[i], name, ABC_GAME_LIST_MAX_NAME);
+        list->sizes[i] = size;
+    }
+}
+
+uint8_t abc_game_list_update(
+    abc_game_list_t* list,
+    uint8_t buttons,
+    uint8_t visible_rows)
+{
+    uint8_t pressed = buttons & ~list->buttons_prev;
+    list->buttons_prev = buttons;
+
+    if(list->count == 0)
+        return 0;
+
+    if(pressed & ABC_BUTTON_U)
+        list->selected = list->selected == 0 ? list->count - 1 : list->selected - 1;
+    if(pressed & ABC_BUTTON_D)
+        list->selected = list->selected + 1 >= list->count ? 0 : list->selected + 1;
+
+    if(visible_rows == 0)
+        visible_rows = 1;
+    if(list->selected < list->scroll)
+        list->scroll = list->selected;
+    if(list->selected >= list->scroll + visible_rows)
+        list->scroll = list->selected - visible_rows + 1;
+
+    return (pressed & ABC_BUTTON_A) ? 1 : 0;
+}
+
+abc_game_result_t abc_game_open(
+    abc_game_t* game,
+    abc_game_fs_t const* fs,
+    char const* name)
+{
+    static uint8_t const SIGNATURE[4] = { 0xab, 0xc0, 0x0a, 0xbc };
+    uint8_t header[ABC_GAME_HEADER_SIZE];
+    uint32_t n;
+
+    memset(game, 0, sizeof(*game));
+    game->file = fs->open(fs->user, name, &game->size);
+    if(!game->file)
+        return ABC_GAME_ERROR_OPEN;
+    game->fs = fs;
+
+    n = fs->read(fs->user, game->file, 0, header, sizeof(header));
+    if(n != sizeof(header) || memcmp(header, SIGNATURE, sizeof(SIGNATURE)) != 0)
+    {
+        abc_game_close(game);
+        return ABC_GAME_ERROR_FORMAT;
+    }
+
+    game->save_size = (uint16_t)(header[0x0a] | (header[0x0b] << 8));
+    game->shades = header[0x13];
+
+    return ABC_GAME_OK;
+}
+
+void abc_game_close(abc_game_t* game)
+{
+    if(game->file)
+        game->fs->close(game->fs->user, game->file);
+    game->file = NULL;
+    game->size = 0;
+}
+
+void abc_game_fill_line(void* user, uint32_t addr, uint8_t* dst, uint32_t n)
+{
+    abc_game_t* game = (abc_game_t*)user;
+    uint32_t r = 0;
+    if(game->file && addr < game->size)
+    {
+        if(n > game->size - addr)
+            r = game->size - addr;
+        else
+            r = n;
+        r = game->fs->read(game->fs->user, game->file, addr, dst, r);
+    }
+    if(r < n)
+        memset(dst + r, 0, n - r);
+}
+
+uint16_t abc_game_id(char const* name)
+{
+    /* FNV-1a folded to 16 bits */
+    uint32_t h = 2166136261u;
+    while(*name)
+    {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return (uint16_t)((h >> 16) ^ h);
+}
@@ -0,0 +1,383 @@
+#include "abc_input_log.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define TAG_REPEAT_MAX  0x7f
+#define TAG_BUTTONS     0x80
+#define TAG_RAND_SEED   0x81
+#define TAG_MILLIS      0x82
+#define TAG_END         0xff
+
+static uint8_t const MAGIC[4] = { 'A', 'B', 'C', 'I' };
+
+uint32_t abc_input_prog_hash(uint8_t const* prog, uint32_t size)
+{
+    uint32_t h = 2166136261u;
+    uint32_t i;
+    for(i = 0; i < size; ++i)
+    {
+        h ^= prog[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void put_u32(uint8_t* p, uint32_t x)
+{
+    p[0] = (uint8_t)(x >> 0);
+    p[1] = (uint8_t)(x >> 8);
+    p[2] = (uint8_t)(x >> 16);
+    p[3] = (uint8_t)(x >> 24);
+}
+
+static uint32_t get_u32(uint8_t const* p)
+{
+    return
+        ((uint32_t)p[0] << 0) |
+        ((uint32_t)p[1] << 8) |
+        ((uint32_t)p[2] << 16) |
+        ((uint32_t)p[3] << 24);
+}
+
+/********************************************************************
+* Recording                                                         *
+********************************************************************/
+
+static void rec_flush(abc_input_recorder_t* rec)
+{
+    uint8_t t;
+    if(rec->repeat == 0)
+        return;
+    t = (uint8_t)(rec->repeat - 1);
+    rec->write(rec->user, &t, 1);
+    rec->repeat = 0;
+}
+
+static uint8_t rec_prog(void* user, uint32_t addr)
+{
+    abc_host_t const* h = ((abc_input_recorder_t*)user)->host;
+    return h->prog(h->user, addr);
+}
+
+static uint8_t rec_buttons(void* user)
+{
+    abc_input_recorder_t* rec = (abc_input_recorder_t*)user;
+    uint8_t b = rec->host->buttons(rec->host->user);
+    if(b == rec->buttons)
+    {
+        if(rec->repeat > TAG_REPEAT_MAX)
+            rec_flush(rec);
+        ++rec->repeat;
+    }
+    else
+    {
+        uint8_t t[2];
+        rec_flush(rec);
+        t[0] = TAG_BUTTONS;
+        t[1] = b;
+        rec->write(rec->user, t, 2);
+        rec->buttons = b;
+    }
+    return b;
+}
+
+static uint32_t rec_millis(void* user)
+{
+    abc_input_recorder_t* rec = (abc_input_recorder_t*)user;
+    uint32_t m = rec->host->millis(rec->host->user);
+    uint32_t d;
+    uint8_t t[6];
+    uint8_t n = 0;
+    if(rec->polling)
+    {
+        /* frame pacing only */
+        rec->polling = 0;
+        return m;
+    }
+    rec_flush(rec);
+    d = m - rec->millis;
+    rec->millis = m;
+    t[n++] = TAG_MILLIS;
+    while(d >= 0x80)
+    {
+        t[n++] = (uint8_t)(d | 0x80);
+        d >>= 7;
+    }
+    t[n++] = (uint8_t)d;
+    rec->write(rec->user, t, n);
+    return m;
+}
+
+static void rec_debug_putc(void* user, char c)
+{
+    abc_host_t const* h = ((abc_input_recorder_t*)user)->host;
+    h->debug_putc(h->user, c);
+}
+
+static uint32_t rec_rand_seed(void* user)
+{
+    abc_input_recorder_t* rec = (abc_input_recorder_t*)user;
+    uint32_t s = rec->host->rand_seed(rec->host->user);
+    uint8_t t[5];
+    rec_flush(rec);
+    t[0] = TAG_RAND_SEED;
+    put_u32(&t[1], s);
+    rec->write(rec->user, t, 5);
+    return s;
+}
+
+static void rec_save(void* user, abc_interp_t const* interp)
+{
+    abc_host_t const* h = ((abc_input_recorder_t*)user)->host;
+    h->save(h->user, interp);
+}
+
+void abc_input_record_begin(
+    abc_input_recorder_t* rec,
+    abc_interp_t const* interp,
+    uint32_t prog_hash)
+{
+    abc_host_t const* h = rec->host;
+    uint8_t header[ABC_INPUT_HEADER_SIZE];
+    uint8_t flags = 0;
+
+    memset(&rec->wrapped, 0, sizeof(rec->wrapped));
+    rec->wrapped.prog = rec_prog;
+    if(h->buttons)
+    {
+        rec->wrapped.buttons = rec_buttons;
+        flags |= ABC_INPUT_FLAG_BUTTONS;
+    }
+    if(h->millis)
+    {
+        rec->wrapped.millis = rec_millis;
+        flags |= ABC_INPUT_FLAG_MILLIS;
+    }
+    if(h->debug_putc)
+        rec->wrapped.debug_putc = rec_debug_putc;
+    if(h->rand_seed)
+    {
+        rec->wrapped.rand_seed = rec_rand_seed;
+        flags |= ABC_INPUT_FLAG_RAND_SEED;
+    }
+    if(h->save)
+        rec->wrapped.save = rec_save;
+    rec->wrapped.user = rec;
+    if(interp->has_save)
+        flags |= ABC_INPUT_FLAG_SAVE;
+
+    rec->millis = 0;
+    rec->buttons = 0;
+    rec->repeat = 0;
+    rec->polling = 0;
+
+    memcpy(header, MAGIC, 4);
+    header[4] = ABC_INPUT_VERSION;
+    header[5] = flags;
+    put_u32(&header[6], prog_hash);
+    rec->write(rec->user, header, sizeof(header));
+    if(interp->has_save)
+        rec->write(rec->user, interp->saved, sizeof(interp->saved));
+}
+
+abc_result_t abc_input_record_run(abc_input_recorder_t* rec, abc_interp_t* interp)
+{
+    rec->polling = interp->waiting_for_frame;
+    return abc_run(interp, &rec->wrapped);
+}
+
+void abc_input_record_end(abc_input_recorder_t* rec)
+{
+    uint8_t t = TAG_END;
+    rec_flush(rec);
+    rec->write(rec->user, &t, 1);
+}
+
+/********************************************************************
+* Replay                                                            *
+********************************************************************/
+
+/* Consume the next event if it has the given tag. */
+static uint8_t play_expect(abc_input_player_t* p, uint8_t tag, uint32_t size)
+{
+    uint8_t t;
+    if(p->state != ABC_INPUT_PLAYING)
+        return 0;
+    if(p->pos >= p->size)
+    {
+        p->state = ABC_INPUT_DESYNC;
+        return 0;
+    }
+    t = p->data[p->pos];
+    if(t == TAG_END)
+    {
+        p->state = ABC_INPUT_DONE;
+        return 0;
+    }
+    if(t != tag || p->size - p->pos - 1 < size)
+    {
+        p->state = ABC_INPUT_DESYNC;
+        return 0;
+    }
+    ++p->pos;
+    return 1;
+}
+
+static uint8_t play_prog(void* user, uint32_t addr)
+{
+    abc_host_t const* h = ((abc_input_player_t*)user)->host;
+    return h->prog(h->user, addr);
+}
+
+static uint8_t play_buttons(void* user)
+{
+    abc_input_player_t* p = (abc_input_player_t*)user;
+    uint8_t t;
+    if(p->repeat != 0)
+    {
+        --p->repeat;
+        return p->buttons;
+    }
+    if(p->state != ABC_INPUT_PLAYING || p->pos >= p->size)
+        return p->buttons;
+    t = p->data[p->pos];
+    if(t <= TAG_REPEAT_MAX)
+    {
+        ++p->pos;
+        p->repeat = t;
+        return p->buttons;
+    }
+    if(play_expect(p, TAG_BUTTONS, 1))
+        p->buttons = p->data[p->pos++];
+    return p->buttons;
+}
+
+static uint32_t play_millis(void* user)
+{
+    abc_input_player_t* p = (abc_input_player_t*)user;
+    uint32_t d = 0;
+    uint8_t shift = 0;
+    if(p->polling)
+    {
+        abc_host_t const* h = p->host;
+        abc_interp_t const* interp = p->interp;
+        p->polling = 0;
+        if(p->state != ABC_INPUT_PLAYING)
+            return interp->frame_start;
+        if(!h->millis)
+            return interp->frame_start + interp->frame_dur;
+        /* real-time pacing relative to the first recorded time */
+        return p->pace_base + (h->millis(h->user) - p->pace_start);
+    }
+    if(!play_expect(p, TAG_MILLIS, 1))
+        return p->millis;
+    while(p->pos < p->size && shift < 32)
+    {
+        uint8_t b = p->data[p->pos++];
+        d |= (uint32_t)(b & 0x7f) << shift;
+        shift += 7;
+        if(!(b & 0x80))
+            break;
+    }
+    p->millis += d;
+    if(!p->started)
+    {
+        p->started = 1;
+        p->pace_base = p->millis;
+        if(p->host->millis)
+            p->pace_start = p->host->millis(p->host->user);
+    }
+    return p->millis;
+}
+
+static void play_debug_putc(void* user, char c)
+{
+    abc_host_t const* h = ((abc_input_player_t*)user)->host;
+    if(h->debug_putc)
+        h->debug_putc(h->user, c);
+}
+
+static uint32_t play_rand_seed(void* user)
+{
+    abc_input_player_t* p = (abc_input_player_t*)user;
+    uint32_t s;
+    if(!play_expect(p, TAG_RAND_SEED, 4))
+        return 0;
+    s = get_u32(&p->data[p->pos]);
+    p->pos += 4;
+    return s;
+}
+
+static void play_save(void* user, abc_interp_t const* interp)
+{
+    abc_host_t const* h = ((abc_input_player_t*)user)->host;
+    if(h->save)
+        h->save(h->user, interp);
+}
+
+abc_input_result_t abc_input_replay_begin(
+    abc_input_player_t* player,
+    abc_interp_t* interp,
+    uint32_t prog_hash)
+{
+    uint8_t const* d = player->data;
+    uint8_t flags;
+
+    player->state = ABC_INPUT_DESYNC;
+    if(!d || player->size < ABC_INPUT_HEADER_SIZE)
+        return ABC_INPUT_ERROR_FORMAT;
+    if(memcmp(d, MAGIC, 4) != 0 || d[4] != ABC_INPUT_VERSION)
+        return ABC_INPUT_ERROR_FORMAT;
+    flags = d[5];
+    player->pos = ABC_INPUT_HEADER_SIZE;
+    if(flags & ABC_INPUT_FLAG_SAVE)
+    {
+        if(player->size - player->pos < sizeof(interp->saved))
+            return ABC_INPUT_ERROR_FORMAT;
+        memcpy(interp->saved, d + player->pos, sizeof(interp->saved));
+        interp->has_save = 1;
+        player->pos += sizeof(interp->saved);
+    }
+    if(get_u32(&d[6]) != prog_hash)
+        return ABC_INPUT_ERROR_PROGRAM;
+
+    /* present exactly the callbacks the recorded host had */
+    memset(&player->wrapped, 0, sizeof(player->wrapped));
+    player->wrapped.prog = play_prog;
+    if(flags & ABC_INPUT_FLAG_BUTTONS)
+        player->wrapped.buttons = play_buttons;
+    if(flags & ABC_INPUT_FLAG_MILLIS)
+        player->wrapped.millis = play_millis;
+    player->wrapped.debug_putc = play_debug_putc;
+    if(flags & ABC_INPUT_FLAG_RAND_SEED)
+        player->wrapped.rand_seed = play_rand_seed;
+    player->wrapped.save = play_save;
+    player->wrapped.user = player;
+
+    player->interp = interp;
+    player->state = ABC_INPUT_PLAYING;
+    player->millis = 0;
+    player->pace_base = 0;
+    player->pace_start = 0;
+    player->buttons = 0;
+    player->repeat = 0;
+    player->polling = 0;
+    player->started = 0;
+
+    return ABC_INPUT_OK;
+}
+
+abc_result_t abc_input_replay_run(abc_input_player_t* player, abc_interp_t* interp)
+{
+    /* stop at the frame boundary where recording ended */
+    if(interp->waiting_for_frame && player->repeat == 0 &&
+        player->pos < player->size && player->data[player->pos] == TAG_END)
+    {
+        player->state = ABC_INPUT_DONE;
+        return ABC_RESULT_IDLE;
+    }
+    player->interp = interp;
+    player->polling = interp->waiting_for_frame;
+    return abc_run(interp, &player->wrapped);
+}
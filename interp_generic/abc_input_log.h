@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "abc_interp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+Input log format (all multi-byte values little-endian):
+
+    header:
+        "ABCI"
+        uint8_t  version (1)
+        uint8_t  flags (ABC_INPUT_FLAG_*)
+        uint32_t program hash (abc_input_prog_hash)
+        uint8_t  saved[1024] (only if ABC_INPUT_FLAG_SAVE)
+
+    events, in the order the interpreter requested them:
+        0x00-0x7f   buttons unchanged for the next (n + 1) requests
+        0x80 b      buttons changed to b
+        0x81 s      rand_seed returned s (uint32_t)
+        0x82 d      millis advanced by d (unsigned LEB128, modulo 2^32)
+        0xff        end of log
+
+The millis requests an idle interpreter makes while waiting for the
+next frame are not recorded: they only pace execution and do not
+affect interpreter state. Audio playback is driven by the host's audio
+callback and is not part of the log, so games that poll the playing
+state of music or tones may diverge on replay.
+*/
+
+#define ABC_INPUT_VERSION 1
+
+#define ABC_INPUT_FLAG_BUTTONS   0x01
+#define ABC_INPUT_FLAG_MILLIS    0x02
+#define ABC_INPUT_FLAG_RAND_SEED 0x04
+#define ABC_INPUT_FLAG_SAVE      0x08
+
+#define ABC_INPUT_HEADER_SIZE 10
+
+typedef enum
+{
+    ABC_INPUT_OK,
+    ABC_INPUT_ERROR_FORMAT,    /* data is not an input log */
+    ABC_INPUT_ERROR_PROGRAM,   /* log was recorded with a different program */
+} abc_input_result_t;
+
+typedef enum
+{
+    ABC_INPUT_PLAYING,
+    ABC_INPUT_DONE,            /* all recorded input has been consumed */
+    ABC_INPUT_DESYNC,          /* interpreter requested unrecorded input */
+} abc_input_state_t;
+
+/********************************************************************
+* Records the values a host supplies to an interpreter. Set the     *
+* fields below, call abc_input_record_begin, then step with         *
+* abc_input_record_run instead of abc_run.                          *
+********************************************************************/
+typedef struct abc_input_recorder_t
+{
+    /****************************************************************
+    * The following must be set.                                    *
+    ****************************************************************/
+
+    /* Host whose input is recorded. */
+    abc_host_t const* host;
+
+    /* Append n bytes to the log. */
+    void    (*write)        (void* user, uint8_t const* data, uint32_t n);
+
+    void* user;
+
+    /****************************************************************
+    * Internal state.                                               *
+    ****************************************************************/
+
+    abc_host_t wrapped;
+    uint32_t millis;
+    uint8_t  buttons;
+    uint8_t  repeat;
+    uint8_t  polling;
+
+} abc_input_recorder_t;
+
+/********************************************************************
+* Replays an input log. Set the fields below, call                  *
+* abc_input_replay_begin, then step with abc_input_replay_run       *
+* instead of abc_run until state is no longer ABC_INPUT_PLAYING.    *
+********************************************************************/
+typedef struct abc_input_player_t
+{
+    /****************************************************************
+    * The following must be set.                                    *
+    ****************************************************************/
+
+    /*
+    Host providing prog (and optionally debug_putc and save). If it
+    provides millis, replay is paced in real time; otherwise frames
+    run back to back.
+    */
+    abc_host_t const* host;
+
+    /* The log; must stay valid while replaying. */
+    uint8_t const* data;
+    uint32_t size;
+
+    /****************************************************************
+    * Internal state.                                               *
+    ****************************************************************/
+
+    abc_host_t wrapped;
+    abc_interp_t const* interp;
+    abc_input_state_t state;
+    uint32_t pos;
+    uint32_t millis;
+    uint32_t pace_base;
+    uint32_t pace_start;
+    uint8_t  buttons;
+    uint8_t  repeat;
+    uint8_t  polling;
+    uint8_t  started;
+
+} abc_input_player_t;
+
+/* FNV-1a hash identifying the program an input log belongs to. */
+uint32_t abc_input_prog_hash(uint8_t const* prog, uint32_t size);
+
+/*
+Write the log header. The interpreter must be freshly cleared, with
+any save data already loaded into it.
+*/
+void abc_input_record_begin(
+    abc_input_recorder_t* rec,
+    abc_interp_t const* interp,
+    uint32_t prog_hash
+);
+
+/* Same as abc_run, recording all input requested by the interpreter. */
+abc_result_t abc_input_record_run(abc_input_recorder_t* rec, abc_interp_t* interp);
+
+/* Terminate the log. */
+void abc_input_record_end(abc_input_recorder_t* rec);
+
+/*
+Check the log header and load recorded save data into the interpreter,
+which must be freshly cleared.
+*/
+abc_input_result_t abc_input_replay_begin(
+    abc_input_player_t* player,
+    abc_interp_t* interp,
+    uint32_t prog_hash
+);
+
+/* Same as abc_run, supplying input from the log. */
+abc_result_t abc_input_replay_run(abc_input_player_t* player, abc_interp_t* interp);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,259 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <abc_input_log.h>
+#include <abc_pool.h>
+
+static uint8_t host_buttons(void* user, uint32_t instance, uint32_t frame)
+{
+    (void)user;
+    /* random bot input, held for 8 frames at a time */
+    uint32_t h = (instance * 0x9e3779b9u) ^ ((frame >> 3) * 0x85ebca6bu);
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return (uint8_t)h;
+}
+
+static void* read_file(char const* fname, uint32_t* size)
+{
+    FILE* f = fopen(fname, "rb");
+    if(!f)
+    {
+        fprintf(stderr, "Unable to open \"%s\"\n", fname);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    *size = (uint32_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    void* buf = malloc(*size);
+    if(!buf)
+    {
+        fprintf(stderr, "Unable to allocate buffer for \"%s\"\n", fname);
+        fclose(f);
+        return NULL;
+    }
+
+    size_t r = fread(buf, 1, *size, f);
+    if(r != *size)
+    {
+        fprintf(stderr, "Unable to read \"%s\"\n", fname);
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+
+    fclose(f);
+    return buf;
+}
+
+static double seconds(void)
+{
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+static uint8_t const* replay_prog_data;
+static uint32_t replay_prog_size;
+
+static uint8_t replay_prog(void* user, uint32_t addr)
+{
+    (void)user;
+    return addr < replay_prog_size ? replay_prog_data[addr] : 0;
+}
+
+/* Write PC hits as "<hex pc> <count>" lines, the profile format of abcc --profile-use. */
+static int write_profile(char const* fname, uint64_t const* hits, uint32_t size)
+{
+    FILE* f = fopen(fname, "w");
+    if(!f)
+    {
+        fprintf(stderr, "Unable to open \"%s\"\n", fname);
+        return 1;
+    }
+    for(uint32_t pc = 0; pc < size; ++pc)
+        if(hits[pc] != 0)
+            fprintf(f, "%x %llu\n", pc, (unsigned long long)hits[pc]);
+    fclose(f);
+    return 0;
+}
+
+/* Replay a recorded session as fast as possible, several times over,
+   optionally counting how often each PC executes. */
+static int replay(void const* data, uint32_t data_size, char const* log_name, uint32_t repeats,
+    char const* profile_name)
+{
+    uint32_t log_size;
+    void* log = read_file(log_name, &log_size);
+    if(!log)
+        return 1;
+
+    abc_interp_t* interp = (abc_interp_t*)malloc(sizeof(abc_interp_t));
+    if(!interp)
+    {
+        free(log);
+        return 1;
+    }
+
+    uint64_t* hits = NULL;
+    if(profile_name)
+    {
+        hits = (uint64_t*)calloc(data_size, sizeof(uint64_t));
+        if(!hits)
+        {
+            free(interp);
+            free(log);
+            return 1;
+        }
+    }
+
+    replay_prog_data = (uint8_t const*)data;
+    replay_prog_size = data_size;
+    abc_host_t host;
+    memset(&host, 0, sizeof(host));
+    host.prog = replay_prog;
+
+    uint32_t prog_hash = abc_input_prog_hash(replay_prog_data, data_size);
+    uint64_t frames = 0;
+    uint64_t instrs = 0;
+    int r = 0;
+    double t0 = seconds();
+    for(uint32_t n = 0; r == 0 && n < repeats; ++n)
+    {
+        abc_input_player_t player;
+        memset(&player, 0, sizeof(player));
+        memset(interp, 0, sizeof(*interp));
+        player.host = &host;
+        player.data = (uint8_t const*)log;
+        player.size = log_size;
+        if(abc_input_replay_begin(&player, interp, prog_hash) != ABC_INPUT_OK)
+        {
+            fprintf(stderr, "\"%s\" is not an input log for this program\n", log_name);
+            r = 1;
+            break;
+        }
+        while(player.state == ABC_INPUT_PLAYING)
+        {
+            uint8_t waiting = interp->waiting_for_frame;
+            if(hits && interp->pc < data_size)
+                ++hits[interp->pc];
+            abc_result_t t = abc_input_replay_run(&player, interp);
+            ++instrs;
+            if(t == ABC_RESULT_ERROR)
+            {
+                fprintf(stderr, "Runtime error during replay\n");
+                r = 1;
+                break;
+            }
+            if(!waiting && interp->waiting_for_frame)
+                ++frames;
+        }
+        if(player.state == ABC_INPUT_DESYNC)
+        {
+            fprintf(stderr, "Replay out of sync\n");
+            r = 1;
+        }
+    }
+    double secs = seconds() - t0;
+
+    printf("repeats:   %u\n", repeats);
+    printf("frames:    %llu\n", (unsigned long long)frames);
+    printf("instrs:    %llu\n", (unsigned long long)instrs);
+    printf("time:      %.3f s\n", secs);
+    if(secs > 0)
+        printf("frames/s:  %.0f\n", (double)frames / secs);
+
+    if(hits && r == 0)
+        r = write_profile(profile_name, hits, data_size);
+
+    free(hits);
+    free(interp);
+    free(log);
+    return r;
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <data.bin> [instances] [threads] [frames]\n", argv[0]);
+        fprintf(stderr, "       %s <data.bin> --replay <input.log> [repeats] [profile.txt]\n", argv[0]);
+        return 1;
+    }
+
+    uint32_t data_size;
+    void* data = read_file(argv[1], &data_size);
+    if(!data)
+        return 1;
+
+    if(argc > 2 && !strcmp(argv[2], "--replay"))
+    {
+        if(argc < 4)
+        {
+            fprintf(stderr, "Usage: %s <data.bin> --replay <input.log> [repeats] [profile.txt]\n", argv[0]);
+            free(data);
+            return 1;
+        }
+        uint32_t repeats = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : 1;
+        int r = replay(data, data_size, argv[3], repeats, argc > 5 ? argv[5] : NULL);
+        free(data);
+        return r;
+    }
+
+    abc_pool_config_t config;
+    memset(&config, 0, sizeof(config));
+    config.prog = (uint8_t const*)data;
+    config.prog_size = data_size;
+    config.num_instances = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 64;
+    config.num_threads = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 0) : 0;
+    config.buttons = host_buttons;
+    uint32_t frames = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 0) : 1000;
+
+    abc_pool_t* pool = abc_pool_create(&config);
+    if(!pool)
+    {
+        fprintf(stderr, "Unable to create pool\n");
+        free(data);
+        return 1;
+    }
+
+    double t0 = seconds();
+    uint32_t running = abc_pool_step(pool, frames);
+    double secs = seconds() - t0;
+
+    uint64_t total_frames = 0;
+    uint64_t total_instrs = 0;
+    uint32_t errors = 0;
+    uint32_t stalls = 0;
+    for(uint32_t i = 0; i < config.num_instances; ++i)
+    {
+        total_frames += abc_pool_frames(pool, i);
+        total_instrs += abc_pool_instrs(pool, i);
+        switch(abc_pool_status(pool, i))
+        {
+        case ABC_POOL_ERROR:   ++errors; break;
+        case ABC_POOL_STALLED: ++stalls; break;
+        default: break;
+        }
+    }
+
+    printf("instances: %u (%u running, %u errors, %u stalled)\n",
+        config.num_instances, running, errors, stalls);
+    printf("threads:   %u\n", abc_pool_num_threads(pool));
+    printf("frames:    %llu\n", (unsigned long long)total_frames);
+    printf("instrs:    %llu\n", (unsigned long long)total_instrs);
+    printf("time:      %.3f s\n", secs);
+    if(secs > 0)
+        printf("frames/s:  %.0f\n", (double)total_frames / secs);
+
+    abc_pool_destroy(pool);
+    free(data);
+
+    return errors + stalls != 0 ? 1 : 0;
+}
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 
+#include <abc_input_log.h>
 #include <abc_interp.h>
 
 #include <SDL2/SDL.h>
@@ -17,6 +18,11 @@ static void* data;
 static size_t data_size;
 static uint64_t start_ticks;
 
+static abc_input_recorder_t recorder;
+static abc_input_player_t player;
+static FILE* record_file;
+static void* replay_data;
+
 static uint32_t display[128 * 64];
 
 static SDL_AudioSpec audio_desired;
@@ -69,46 +75,85 @@ static uint32_t host_rand_seed(void* user)
     return (uint32_t)time(0);
 }
 
-int main(int argc, char** argv)
+static void* read_file(char const* fname, size_t* size)
 {
-    if(argc < 2)
+    FILE* f = fopen(fname, "rb");
+    if(!f)
     {
-        fprintf(stderr, "Usage: %s <data.bin>\n", argv[0]);
-        return 1;
+        fprintf(stderr, "Unable to open \"%s\"\n", fname);
+        return NULL;
     }
 
+    fseek(f, 0, SEEK_END);
+    *size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    void* buf = malloc(*size);
+    if(!buf)
     {
-        FILE* f = fopen(argv[1], "rb");
-        if(!f)
-        {
-            fprintf(stderr, "Unable to open \"%s\"\n", argv[1]);
-            return 1;
-        }
+        fprintf(stderr, "Unable to allocate buffer for \"%s\"\n", fname);
+        fclose(f);
+        return NULL;
+    }
 
-        fseek(f, 0, SEEK_END);
-        data_size = (size_t)ftell(f);
-        fseek(f, 0, SEEK_SET);
+    size_t r = fread(buf, 1, *size, f);
+    if(r != *size)
+    {
+        fprintf(stderr, "Unable to read \"%s\"\n", fname);
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
 
-        data = malloc(data_size);
-        if(!data)
-        {
-            fprintf(stderr, "Unable to allocate buffer for \"%s\"\n", argv[1]);
-            fclose(f);
-            return 1;
-        }
+    fclose(f);
+    return buf;
+}
+
+static void record_write(void* user, uint8_t const* data, uint32_t n)
+{
+    fwrite(data, 1, n, (FILE*)user);
+}
+
+static abc_result_t step(void)
+{
+    if(record_file)
+        return abc_input_record_run(&recorder, &interp);
+    if(replay_data)
+    {
+        if(player.state != ABC_INPUT_PLAYING)
+            return ABC_RESULT_IDLE;
+        return abc_input_replay_run(&player, &interp);
+    }
+    return abc_run(&interp, &host);
+}
+
+int main(int argc, char** argv)
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <data.bin> [--record <input.log>] [--replay <input.log>]\n", argv[0]);
+        return 1;
+    }
 
-        size_t r = fread(data, 1, data_size, f);
-        if(r != data_size)
+    char const* record_name = NULL;
+    char const* replay_name = NULL;
+    for(int i = 2; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--record") && i + 1 < argc)
+            record_name = argv[++i];
+        else if(!strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay_name = argv[++i];
+        else
         {
-            fprintf(stderr, "Unable to read \"%s\"\n", argv[1]);
-            free(data);
-            fclose(f);
+            fprintf(stderr, "Usage: %s <data.bin> [--record <input.log>] [--replay <input.log>]\n", argv[0]);
             return 1;
         }
-
-        fclose(f);
     }
 
+    data = read_file(argv[1], &data_size);
+    if(!data)
+        return 1;
+
     int r = 0;
 
     memset(&interp, 0, sizeof(interp));
@@ -119,6 +164,43 @@ int main(int argc, char** argv)
     host.buttons = host_buttons;
     host.rand_seed = host_rand_seed;
 
+    uint32_t prog_hash = abc_input_prog_hash((uint8_t const*)data, (uint32_t)data_size);
+    if(replay_name)
+    {
+        size_t replay_size = 0;
+        replay_data = read_file(replay_name, &replay_size);
+        if(!replay_data)
+        {
+            free(data);
+            return 1;
+        }
+        player.host = &host;
+        player.data = (uint8_t const*)replay_data;
+        player.size = (uint32_t)replay_size;
+        abc_input_result_t t = abc_input_replay_begin(&player, &interp, prog_hash);
+        if(t != ABC_INPUT_OK)
+        {
+            fprintf(stderr, "\"%s\" is not an input log for \"%s\"\n", replay_name, argv[1]);
+            free(replay_data);
+            free(data);
+            return 1;
+        }
+    }
+    else if(record_name)
+    {
+        record_file = fopen(record_name, "wb");
+        if(!record_file)
+        {
+            fprintf(stderr, "Unable to open \"%s\"\n", record_name);
+            free(data);
+            return 1;
+        }
+        recorder.host = &host;
+        recorder.write = record_write;
+        recorder.user = record_file;
+        abc_input_record_begin(&recorder, &interp, prog_hash);
+    }
+
     if(0 != SDL_Init(SDL_INIT_EVERYTHING))
     {
         fprintf(stderr, "Unable to initialize SDL\n");
@@ -194,7 +276,7 @@ int main(int argc, char** argv)
             SDL_LockAudioDevice(audio_device);
             for(unsigned j = 0; !idle && j < 1000; ++j)
             {
-                abc_result_t t = abc_run(&interp, &host);
+                abc_result_t t = step();
 #ifdef _MSC_VER
                 if(t == ABC_RESULT_ERROR)
                     __debugbreak();
@@ -224,6 +306,13 @@ int main(int argc, char** argv)
         SDL_RenderCopy(renderer, texture, NULL, NULL);
 
         SDL_RenderPresent(renderer);
+
+        if(replay_data && player.state != ABC_INPUT_PLAYING && !quit)
+        {
+            printf(player.state == ABC_INPUT_DONE ?
+                "Replay finished\n" : "Replay out of sync\n");
+            quit = true;
+        }
     }
 
     SDL_DestroyTexture(texture);
@@ -234,6 +323,12 @@ sdl_destroy_window:
     SDL_CloseAudioDevice(audio_device);
 sdl_quit:
     SDL_Quit();
+    if(record_file)
+    {
+        abc_input_record_end(&recorder);
+        fclose(record_file);
+    }
+    free(replay_data);
     free(data);
 
     return r;
@@ -1,3 +1,4 @@
+#include <abc_input_log.h>
 #include <abc_interp.h>
 
 #if defined(_WIN32)
@@ -29,6 +30,14 @@ static void* data = NULL;
 static uint32_t data_size = 0;
 static uint64_t start_tick;
 
+static abc_input_recorder_t recorder;
+static abc_input_player_t player;
+static char const* record_name = NULL;
+static char const* replay_name = NULL;
+static FILE* record_file = NULL;
+static void* replay_data = NULL;
+static uint32_t replay_size = 0;
+
 static uint32_t display[128 * 64];
 static sg_image display_image;
 static uint8_t buttons = 0;
@@ -57,6 +66,58 @@ static uint32_t host_rand_seed(void* user)
     return (uint32_t)stm_now();
 }
 
+static void record_write(void* user, uint8_t const* data, uint32_t n)
+{
+    fwrite(data, 1, n, (FILE*)user);
+}
+
+static abc_result_t step(void)
+{
+    if(record_file)
+        return abc_input_record_run(&recorder, &interp);
+    if(replay_data)
+    {
+        if(player.state != ABC_INPUT_PLAYING)
+            return ABC_RESULT_IDLE;
+        return abc_input_replay_run(&player, &interp);
+    }
+    return abc_run(&interp, &host);
+}
+
+static void* read_file(char const* fname, uint32_t* size)
+{
+    FILE* f = fopen(fname, "rb");
+    if(!f)
+    {
+        fprintf(stderr, "Unable to open \"%s\"\n", fname);
+        return NULL;
+    }
+
+    fseek(f, 0, SEEK_END);
+    *size = (uint32_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    void* buf = malloc(*size);
+    if(!buf)
+    {
+        fprintf(stderr, "Unable to allocate buffer for \"%s\"\n", fname);
+        fclose(f);
+        return NULL;
+    }
+
+    size_t r = fread(buf, 1, *size, f);
+    if(r != *size)
+    {
+        fprintf(stderr, "Unable to read \"%s\"\n", fname);
+        free(buf);
+        fclose(f);
+        return NULL;
+    }
+
+    fclose(f);
+    return buf;
+}
+
 static void cb_stream(float* buffer, int num_frames, int num_channels)
 {
     if(audio_buffer_size < num_frames)
@@ -92,6 +153,36 @@ static void cb_init(void)
 
     memset(&interp, 0, sizeof(interp));
 
+    if(data != NULL)
+    {
+        uint32_t prog_hash = abc_input_prog_hash((uint8_t const*)data, data_size);
+        if(replay_name)
+        {
+            replay_data = read_file(replay_name, &replay_size);
+            player.host = &host;
+            player.data = (uint8_t const*)replay_data;
+            player.size = replay_size;
+            if(abc_input_replay_begin(&player, &interp, prog_hash) != ABC_INPUT_OK)
+            {
+                fprintf(stderr, "\"%s\" is not an input log for this program\n", replay_name);
+                sapp_request_quit();
+            }
+        }
+        else if(record_name)
+        {
+            record_file = fopen(record_name, "wb");
+            if(!record_file)
+                fprintf(stderr, "Unable to open \"%s\"\n", record_name);
+            else
+            {
+                recorder.host = &host;
+                recorder.write = record_write;
+                recorder.user = record_file;
+                abc_input_record_begin(&recorder, &interp, prog_hash);
+            }
+        }
+    }
+
     saudio_setup(&(saudio_desc) {
         .buffer_frames = 512,
         .stream_cb = cb_stream,
@@ -126,12 +217,21 @@ static void cb_frame(void)
         {
             for(unsigned j = 0; !idle && j < 1000; ++j)
             {
-                abc_result_t r = abc_run(&interp, &host);
+                abc_result_t r = step();
                 if(r == ABC_RESULT_IDLE)
                     idle = 1;
             }
         }
 
+        if(replay_data && player.state != ABC_INPUT_PLAYING)
+        {
+            printf(player.state == ABC_INPUT_DONE ?
+                "Replay finished\n" : "Replay out of sync\n");
+            free(replay_data);
+            replay_data = NULL;
+            sapp_request_quit();
+        }
+
         for(unsigned y = 0; y < 64; ++y)
         {
             for(unsigned x = 0; x < 128; ++x)
@@ -177,6 +277,12 @@ static void cb_frame(void)
 
 static void cb_cleanup(void)
 {
+    if(record_file)
+    {
+        abc_input_record_end(&recorder);
+        fclose(record_file);
+    }
+    free(replay_data);
     sgp_shutdown();
     sg_destroy_image(display_image);
     sg_shutdown();
@@ -252,10 +358,22 @@ sapp_desc sokol_main(int argc, char* argv[])
 #ifndef OVERRIDE
     if(argc < 2)
     {
-        fprintf(stderr, "Usage: %s <data.bin>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <data.bin> [--record <input.log>] [--replay <input.log>]\n", argv[0]);
         goto error;
     }
     char const* fname = argv[1];
+    for(int i = 2; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "--record") && i + 1 < argc)
+            record_name = argv[++i];
+        else if(!strcmp(argv[i], "--replay") && i + 1 < argc)
+            replay_name = argv[++i];
+        else
+        {
+            fprintf(stderr, "Usage: %s <data.bin> [--record <input.log>] [--replay <input.log>]\n", argv[0]);
+            goto error;
+        }
+    }
 #else
     (void)argc;
     (void)argv;
@@ -263,37 +381,7 @@ sapp_desc sokol_main(int argc, char* argv[])
 #endif
 
 
-    {
-        FILE* f = fopen(fname, "rb");
-        if(!f)
-        {
-            fprintf(stderr, "Unable to open \"%s\"\n", fname);
-            goto error;
-        }
-
-        fseek(f, 0, SEEK_END);
-        data_size = (size_t)ftell(f);
-        fseek(f, 0, SEEK_SET);
-
-        data = malloc(data_size);
-        if(!data)
-        {
-            fprintf(stderr, "Unable to allocate buffer for \"%s\"\n", fname);
-            fclose(f);
-            goto error;
-        }
-
-        size_t r = fread(data, 1, data_size, f);
-        if(r != data_size)
-        {
-            fprintf(stderr, "Unable to read \"%s\"\n", fname);
-            free(data);
-            fclose(f);
-            goto error;
-        }
-
-        fclose(f);
-    }
+    data = read_file(fname, &data_size);
 
 error:
     return (sapp_desc) {
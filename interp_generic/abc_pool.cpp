@@ -0,0 +1,349 @@
+#include "abc_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+#include <string.h>
+
+namespace
+{
+
+uint32_t const DEFAULT_MAX_INSTRS_PER_FRAME = 10000000;
+
+struct instance_t
+{
+    abc_interp_t interp;
+    abc_host_t host;
+    abc_pool_t* pool;
+    uint32_t index;
+    uint32_t millis;
+    uint32_t frames;
+    uint64_t instrs;
+    abc_pool_status_t status;
+};
+
+// Range of indices into abc_pool_t::live owned by one worker: the owner
+// takes from the head, other workers steal from the tail. Both ends are
+// packed into one word so that either side can claim an item with a
+// single compare-exchange.
+struct alignas(64) work_queue_t
+{
+    std::atomic<uint64_t> range;
+
+    void set(uint32_t head, uint32_t tail)
+    {
+        range.store((uint64_t(head) << 32) | tail, std::memory_order_relaxed);
+    }
+
+    bool pop(uint32_t& i)
+    {
+        uint64_t r = range.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            uint32_t head = uint32_t(r >> 32);
+            uint32_t tail = uint32_t(r);
+            if(head >= tail)
+                return false;
+            uint64_t n = (uint64_t(head + 1) << 32) | tail;
+            if(range.compare_exchange_weak(r, n, std::memory_order_relaxed))
+            {
+                i = head;
+                return true;
+            }
+        }
+    }
+
+    bool steal(uint32_t& i)
+    {
+        uint64_t r = range.load(std::memory_order_relaxed);
+        for(;;)
+        {
+            uint32_t head = uint32_t(r >> 32);
+            uint32_t tail = uint32_t(r);
+            if(head >= tail)
+                return false;
+            uint64_t n = (uint64_t(head) << 32) | (tail - 1);
+            if(range.compare_exchange_weak(r, n, std::memory_order_relaxed))
+            {
+                i = tail - 1;
+                return true;
+            }
+        }
+    }
+};
+
+}
+
+struct abc_pool_t
+{
+    abc_pool_config_t config;
+    std::unique_ptr<instance_t[]> instances;
+
+    // running instances for the current batch
+    std::vector<uint32_t> live;
+    std::unique_ptr<work_queue_t[]> queues;
+    uint32_t num_threads;
+
+    // worker threads (the calling thread acts as worker 0)
+    std::vector<std::thread> threads;
+    std::mutex mutex;
+    std::condition_variable cv_start;
+    std::condition_variable cv_done;
+    uint64_t generation;
+    uint32_t busy;
+    bool quit;
+};
+
+static uint8_t instance_prog(void* user, uint32_t addr)
+{
+    auto const& inst = *(instance_t const*)user;
+    auto const& config = inst.pool->config;
+    if(addr < config.prog_size)
+        return config.prog[addr];
+    return 0;
+}
+
+static uint32_t instance_millis(void* user)
+{
+    return ((instance_t const*)user)->millis;
+}
+
+static uint8_t instance_buttons(void* user)
+{
+    auto const& inst = *(instance_t const*)user;
+    auto const& config = inst.pool->config;
+    if(!config.buttons)
+        return 0;
+    return config.buttons(config.user, inst.index, inst.frames);
+}
+
+static uint32_t instance_rand_seed(void* user)
+{
+    auto const& inst = *(instance_t const*)user;
+    auto const& config = inst.pool->config;
+    if(!config.rand_seed)
+        return inst.index + 1;
+    return config.rand_seed(config.user, inst.index);
+}
+
+static void step_frame(abc_pool_t* pool, instance_t& inst)
+{
+    uint32_t max_instrs = pool->config.max_instrs_per_frame;
+    if(max_instrs == 0)
+        max_instrs = DEFAULT_MAX_INSTRS_PER_FRAME;
+    for(uint32_t n = 0; n < max_instrs; ++n)
+    {
+        abc_result_t r = abc_run(&inst.interp, &inst.host);
+        ++inst.instrs;
+        if(r == ABC_RESULT_ERROR)
+        {
+            inst.status = ABC_POOL_ERROR;
+            return;
+        }
+        if(r == ABC_RESULT_IDLE && inst.interp.waiting_for_frame)
+        {
+            // jump the virtual clock to the start of the next frame
+            inst.millis = inst.interp.frame_start + inst.interp.frame_dur;
+            ++inst.frames;
+            if(pool->config.frame_done)
+                pool->config.frame_done(pool->config.user, inst.index, &inst.interp);
+            return;
+        }
+    }
+    inst.status = ABC_POOL_STALLED;
+}
+
+static void run_batch(abc_pool_t* pool, uint32_t w)
+{
+    uint32_t i;
+    while(pool->queues[w].pop(i))
+        step_frame(pool, pool->instances[pool->live[i]]);
+    for(uint32_t k = 1; k < pool->num_threads; ++k)
+    {
+        auto& q = pool->queues[(w + k) % pool->num_threads];
+        while(q.steal(i))
+            step_frame(pool, pool->instances[pool->live[i]]);
+    }
+}
+
+static void worker_main(abc_pool_t* pool, uint32_t w)
+{
+    uint64_t seen = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->cv_start.wait(lock, [&] {
+                return pool->quit || pool->generation != seen; });
+            if(pool->quit)
+                return;
+            seen = pool->generation;
+        }
+        run_batch(pool, w);
+        {
+            std::lock_guard<std::mutex> lock(pool->mutex);
+            if(--pool->busy == 0)
+                pool->cv_done.notify_one();
+        }
+    }
+}
+
+static void stop_workers(abc_pool_t* pool)
+{
+    {
+        std::lock_guard<std::mutex> lock(pool->mutex);
+        pool->quit = true;
+    }
+    pool->cv_start.notify_all();
+    for(auto& t : pool->threads)
+        t.join();
+}
+
+abc_pool_t* abc_pool_create(abc_pool_config_t const* config)
+{
+    if(!config || !config->prog || config->num_instances == 0)
+        return nullptr;
+
+    std::unique_ptr<abc_pool_t> pool(new(std::nothrow) abc_pool_t{});
+    if(!pool)
+        return nullptr;
+    pool->config = *config;
+    pool->instances.reset(new(std::nothrow) instance_t[config->num_instances]);
+    if(!pool->instances)
+        return nullptr;
+
+    for(uint32_t i = 0; i < config->num_instances; ++i)
+    {
+        auto& inst = pool->instances[i];
+        inst.pool = pool.get();
+        inst.index = i;
+        memset(&inst.host, 0, sizeof(inst.host));
+        inst.host.prog = instance_prog;
+        inst.host.millis = instance_millis;
+        inst.host.buttons = instance_buttons;
+        inst.host.rand_seed = instance_rand_seed;
+        inst.host.user = &inst;
+        abc_pool_reset(pool.get(), i);
+    }
+
+    uint32_t num_threads = config->num_threads;
+    if(num_threads == 0)
+        num_threads = std::thread::hardware_concurrency();
+    if(num_threads == 0)
+        num_threads = 1;
+    if(num_threads > config->num_instances)
+        num_threads = config->num_instances;
+    pool->num_threads = num_threads;
+    pool->queues.reset(new(std::nothrow) work_queue_t[num_threads]);
+    if(!pool->queues)
+        return nullptr;
+    for(uint32_t w = 0; w < num_threads; ++w)
+        pool->queues[w].set(0, 0);
+    try
+    {
+        pool->live.reserve(config->num_instances);
+        pool->threads.reserve(num_threads - 1);
+        for(uint32_t w = 1; w < num_threads; ++w)
+            pool->threads.emplace_back(worker_main, pool.get(), w);
+    }
+    catch(...)
+    {
+        // workers that did start must be joined before the pool goes
+        stop_workers(pool.get());
+        return nullptr;
+    }
+
+    return pool.release();
+}
+
+void abc_pool_destroy(abc_pool_t* pool)
+{
+    if(!pool)
+        return;
+    stop_workers(pool);
+    delete pool;
+}
+
+uint32_t abc_pool_step(abc_pool_t* pool, uint32_t frames)
+{
+    uint32_t n = pool->config.num_instances;
+    uint32_t const T = pool->num_threads;
+    for(uint32_t f = 0; f < frames; ++f)
+    {
+        pool->live.clear();
+        for(uint32_t i = 0; i < n; ++i)
+            if(pool->instances[i].status == ABC_POOL_RUNNING)
+                pool->live.push_back(i);
+        uint32_t num_live = (uint32_t)pool->live.size();
+        if(num_live == 0)
+            break;
+
+        // contiguous shares keep neighboring instances on one thread
+        for(uint32_t w = 0; w < T; ++w)
+            pool->queues[w].set(
+                uint32_t(uint64_t(num_live) * w / T),
+                uint32_t(uint64_t(num_live) * (w + 1) / T));
+
+        if(T > 1)
+        {
+            {
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                pool->busy = T - 1;
+                ++pool->generation;
+            }
+            pool->cv_start.notify_all();
+        }
+        run_batch(pool, 0);
+        if(T > 1)
+        {
+            std::unique_lock<std::mutex> lock(pool->mutex);
+            pool->cv_done.wait(lock, [&] { return pool->busy == 0; });
+        }
+    }
+
+    uint32_t running = 0;
+    for(uint32_t i = 0; i < n; ++i)
+        if(pool->instances[i].status == ABC_POOL_RUNNING)
+            ++running;
+    return running;
+}
+
+void abc_pool_reset(abc_pool_t* pool, uint32_t instance)
+{
+    auto& inst = pool->instances[instance];
+    memset(&inst.interp, 0, sizeof(inst.interp));
+    inst.millis = 0;
+    inst.frames = 0;
+    inst.instrs = 0;
+    inst.status = ABC_POOL_RUNNING;
+}
+
+uint32_t abc_pool_num_threads(abc_pool_t const* pool)
+{
+    return pool->num_threads;
+}
+
+abc_pool_status_t abc_pool_status(abc_pool_t const* pool, uint32_t instance)
+{
+    return pool->instances[instance].status;
+}
+
+uint32_t abc_pool_frames(abc_pool_t const* pool, uint32_t instance)
+{
+    return pool->instances[instance].frames;
+}
+
+uint64_t abc_pool_instrs(abc_pool_t const* pool, uint32_t instance)
+{
+    return pool->instances[instance].instrs;
+}
+
+abc_interp_t const* abc_pool_interp(abc_pool_t const* pool, uint32_t instance)
+{
+    return &pool->instances[instance].interp;
+}
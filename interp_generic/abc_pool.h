@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "abc_interp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum
+{
+    ABC_POOL_RUNNING,      /* instance is still executing */
+    ABC_POOL_ERROR,        /* halt: a runtime error occurred */
+    ABC_POOL_STALLED,      /* halt: a frame exceeded max_instrs_per_frame */
+} abc_pool_status_t;
+
+/********************************************************************
+* Configuration for a pool of interpreter instances sharing one     *
+* read-only program image, e.g., for parameter sweeps, bot          *
+* playtesting or fuzzing. Instances see a virtual clock that        *
+* advances one frame duration per frame, so runs are deterministic  *
+* and independent of the number of worker threads.                  *
+********************************************************************/
+typedef struct abc_pool_config_t
+{
+    /****************************************************************
+    * The following must be set.                                    *
+    ****************************************************************/
+
+    /* Compiled program; must stay valid for the lifetime of the pool. */
+    uint8_t const* prog;
+    uint32_t prog_size;
+
+    /* Number of interpreter instances. */
+    uint32_t num_instances;
+
+    /****************************************************************
+    * The following may be zero or NULL.                            *
+    ****************************************************************/
+
+    /* Number of threads stepping instances (0: one per hardware thread). */
+    uint32_t num_threads;
+
+    /* Instructions after which a frame counts as stalled (0: 10 million). */
+    uint32_t max_instrs_per_frame;
+
+    /* Get button state for an instance at a frame (ABC_BUTTON_*). */
+    uint8_t (*buttons)      (void* user, uint32_t instance, uint32_t frame);
+
+    /* Get the PRNG seed for an instance (default: instance index + 1). */
+    uint32_t(*rand_seed)    (void* user, uint32_t instance);
+
+    /* Called once per instance after each completed frame. */
+    void    (*frame_done)   (void* user, uint32_t instance,
+                             abc_interp_t const* interp);
+
+    void* user;
+
+} abc_pool_config_t;
+
+typedef struct abc_pool_t abc_pool_t;
+
+/* Returns NULL if the configuration is invalid or allocation failed. */
+abc_pool_t* abc_pool_create(abc_pool_config_t const* config);
+
+void abc_pool_destroy(abc_pool_t* pool);
+
+/*
+Advance all running instances by the given number of frames, one frame
+per batch across the worker threads. Returns the number of instances
+still running. Callbacks may be called concurrently from several
+threads, but never concurrently for the same instance.
+*/
+uint32_t abc_pool_step(abc_pool_t* pool, uint32_t frames);
+
+/* Restart an instance from the beginning of the program. */
+void abc_pool_reset(abc_pool_t* pool, uint32_t instance);
+
+uint32_t abc_pool_num_threads(abc_pool_t const* pool);
+abc_pool_status_t abc_pool_status(abc_pool_t const* pool, uint32_t instance);
+uint32_t abc_pool_frames(abc_pool_t const* pool, uint32_t instance);
+uint64_t abc_pool_instrs(abc_pool_t const* pool, uint32_t instance);
+abc_interp_t const* abc_pool_interp(abc_pool_t const* pool, uint32_t instance);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#include "abc_prog_cache.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+#define INVALID_TAG UINT32_MAX
+
+static void fill(abc_prog_cache_t* cache, abc_prog_cache_line_t* line, uint32_t tag)
+{
+    uint32_t addr = tag << ABC_PROG_CACHE_LINE_BITS;
+    if(cache->fill_line)
+        cache->fill_line(cache->user, addr, line->data, ABC_PROG_CACHE_LINE_SIZE);
+    else
+    {
+        uint32_t i;
+        for(i = 0; i < ABC_PROG_CACHE_LINE_SIZE; ++i)
+            line->data[i] = cache->source(cache->user, addr + i);
+    }
+    line->tag = tag;
+}
+
+void abc_prog_cache_init(
+    abc_prog_cache_t* cache,
+    abc_prog_cache_line_t* lines,
+    uint32_t num_lines)
+{
+    assert(num_lines != 0 && (num_lines & (num_lines - 1)) == 0);
+    cache->lines = lines;
+    cache->num_lines = num_lines;
+    abc_prog_cache_invalidate(cache);
+    abc_prog_cache_reset_stats(cache);
+}
+
+void abc_prog_cache_invalidate(abc_prog_cache_t* cache)
+{
+    uint32_t i;
+    for(i = 0; i < cache->num_lines; ++i)
+        cache->lines[i].tag = INVALID_TAG;
+}
+
+void abc_prog_cache_reset_stats(abc_prog_cache_t* cache)
+{
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+uint8_t abc_prog_cache_read(abc_prog_cache_t* cache, uint32_t addr)
+{
+    uint32_t tag = addr >> ABC_PROG_CACHE_LINE_BITS;
+    abc_prog_cache_line_t* line = &cache->lines[tag & (cache->num_lines - 1)];
+    if(line->tag == tag)
+        ++cache->hits;
+    else
+    {
+        ++cache->misses;
+        fill(cache, line, tag);
+    }
+    return line->data[addr & (ABC_PROG_CACHE_LINE_SIZE - 1)];
+}
+
+uint8_t abc_prog_cache_prog(void* cache, uint32_t addr)
+{
+    return abc_prog_cache_read((abc_prog_cache_t*)cache, addr);
+}
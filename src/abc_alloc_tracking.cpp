@@ -0,0 +1,67 @@
+// Replaces the global allocation functions to count the bytes in use for
+// time reports. Linked into the compiler executables only: the compiler
+// library works without it, reporting no allocation figures.
+
+#include "abc_time_report.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+// the size of each block is kept in front of it, padded to keep the
+// block aligned for any fundamental type
+constexpr size_t HEADER = alignof(std::max_align_t) < sizeof(size_t) ?
+    sizeof(size_t) : alignof(std::max_align_t);
+
+void* tracked_alloc(size_t n) noexcept
+{
+    void* p = std::malloc(n + HEADER);
+    if(!p)
+        return nullptr;
+    *static_cast<size_t*>(p) = n;
+    abc::track_alloc(n);
+    return static_cast<char*>(p) + HEADER;
+}
+
+void tracked_free(void* p) noexcept
+{
+    if(!p)
+        return;
+    char* b = static_cast<char*>(p) - HEADER;
+    abc::track_free(*reinterpret_cast<size_t*>(b));
+    std::free(b);
+}
+
+struct enable_t
+{
+    enable_t() { abc::alloc_tracking_enabled = true; }
+} const enable;
+
+}
+
+void* operator new(size_t n)
+{
+    if(void* p = tracked_alloc(n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t n)
+{
+    if(void* p = tracked_alloc(n))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(size_t n, std::nothrow_t const&) noexcept { return tracked_alloc(n); }
+void* operator new[](size_t n, std::nothrow_t const&) noexcept { return tracked_alloc(n); }
+
+void operator delete(void* p) noexcept { tracked_free(p); }
+void operator delete[](void* p) noexcept { tracked_free(p); }
+void operator delete(void* p, size_t) noexcept { tracked_free(p); }
+void operator delete[](void* p, size_t) noexcept { tracked_free(p); }
+void operator delete(void* p, std::nothrow_t const&) noexcept { tracked_free(p); }
+void operator delete[](void* p, std::nothrow_t const&) noexcept { tracked_free(p); }
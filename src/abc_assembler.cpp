@@ -109,7 +109,7 @@ void assembler_t::push_label(std::istream& f, bool has_offset, uint16_t size)
     byte_count += size;
 }
 
-void assembler_t::push_label(std::string const& label, uint32_t offset, uint16_t size)
+void assembler_t::push_label(symbol_t label, uint32_t offset, uint16_t size)
 {
     nodes.push_back({ byte_count, LABEL, I_NOP, size, offset, label });
     byte_count += size;
@@ -126,7 +126,7 @@ void assembler_t::push_global(std::istream& f, bool has_offset, uint16_t size)
     byte_count += size;
 }
 
-void assembler_t::push_global(std::string const& label, uint32_t offset, uint16_t size)
+void assembler_t::push_global(symbol_t label, uint32_t offset, uint16_t size)
 {
     if(!error.msg.empty()) return;
     nodes.push_back({ byte_count, GLOBAL, I_NOP, size, offset, label });
@@ -285,7 +285,7 @@ void assembler_t::add_global(compiler_global_t const& global)
     globals_bytes += ti;
 }
 
-void assembler_t::add_label(std::string const& label)
+void assembler_t::add_label(symbol_t label)
 {
     if(labels.count(label) != 0)
         error.msg = "Duplicate label: \"" + label + "\"";
@@ -295,7 +295,8 @@ void assembler_t::add_label(std::string const& label)
 
 error_t assembler_t::assemble(compiler_t const& c)
 {
-    githash = c.githash;
+    phase_timer_t timer(time_rep, "assemble");
+    githash = c.do_suppress_githash ? std::string() : c.githash;
     shades = c.shades;
     saved_bytes = 0;
 
@@ -423,7 +424,7 @@ void assembler_t::add_instr(compiler_instr_t const& instr, uint16_t& line,
     if(file != instr.file && instr.file != 0)
     {
         file = instr.file;
-        add_file(filenames[file - 1]);
+        add_file(filenames[file - 1] + ".abc");
     }
     if(instr.is_label)
     {
@@ -629,6 +630,8 @@ void assembler_t::add_instr(compiler_instr_t const& instr, uint16_t& line,
         case I_POPN:
         case I_ALLOC:
         case I_AIXB1:
+        case I_AIXB:
+        case I_PIXB:
         case I_REFL:
         case I_LINC:
             push_instr(instr.instr);
@@ -701,6 +704,7 @@ void assembler_t::add_file(std::string const& filename)
 
 error_t assembler_t::assemble(std::istream& f)
 {
+    phase_timer_t timer(time_rep, "assemble");
     std::string t;
     githash.clear();
     shades = 2;
@@ -926,12 +930,22 @@ error_t assembler_t::assemble(std::istream& f)
             push_instr(I_AIXB1);
             push_imm(read_imm(f, error), 1);
         }
+        else if(t == "aixb")
+        {
+            push_instr(I_AIXB);
+            push_imm(read_imm(f, error), 1);
+        }
         else if(t == "aidx")
         {
             push_instr(I_AIDX);
             push_imm(read_imm(f, error), 2);
             push_imm(read_imm(f, error), 2);
         }
+        else if(t == "pixb")
+        {
+            push_instr(I_PIXB);
+            push_imm(read_imm(f, error), 1);
+        }
         else if(t == "pidxb")
         {
             push_instr(I_PIDXB);
@@ -1141,11 +1155,34 @@ error_t assembler_t::assemble(std::istream& f)
     return error;
 }
 
+// Instructions are shrunk in a single pass from the start of the program.
+// Each shrink moves every later node back; rather than updating them all
+// at once, the amount is recorded at the first node it applies to and
+// nodes are moved as the pass reaches them. Nodes the pass has not reached
+// yet are behind their recorded offset by every shrink so far.
 void assembler_t::relax_jumps()
 {
+    std::vector<size_t> shifts(nodes.size() + 2);
+    size_t applied = 0; // shrinks applied to the current node
+    size_t total = 0;   // all shrinks so far
+
+    auto shrink = [&](size_t first, size_t bytes) {
+        shifts[first] += bytes;
+        total += bytes;
+    };
+    auto finish = [&](size_t first) {
+        for(size_t j = first; j < nodes.size(); ++j)
+        {
+            applied += shifts[j];
+            nodes[j].offset -= applied;
+        }
+    };
+
     for(size_t i = 0; i + 1 < nodes.size(); ++i)
     {
         auto& n = nodes[i];
+        applied += shifts[i];
+        n.offset -= applied;
 
         if(n.instr == I_GETG || n.instr == I_GETG2 || n.instr == I_GETG4)
         {
@@ -1160,8 +1197,7 @@ void assembler_t::relax_jumps()
             if(n.instr == I_GETG2) n.instr = I_GTGB2;
             if(n.instr == I_GETG4) n.instr = I_GTGB4;
             nodes[i + 1].size = 1;
-            for(size_t j = i + 2; j < nodes.size(); ++j)
-                nodes[j].offset -= 1;
+            shrink(i + 2, 1);
             continue;
         }
 
@@ -1176,11 +1212,15 @@ void assembler_t::relax_jumps()
         assert(label.type == LABEL);
 
         auto it = labels.find(label.label);
-        if(it == labels.end())
-            return;
-        if(it->second >= nodes.size())
+        if(it == labels.end() || it->second >= nodes.size())
+        {
+            finish(i + 1);
             return;
-        size_t addr = nodes[it->second].offset;
+        }
+        size_t target = it->second;
+        size_t addr = nodes[target].offset;
+        if(target > i)
+            addr -= total;
 
         int32_t offset = int32_t(addr) - int32_t(n.offset);
         int32_t abs_offset = offset < 0 ? -offset : offset;
@@ -1200,19 +1240,21 @@ void assembler_t::relax_jumps()
 
         int bytes_shortened = 3 - label.size;
         if(bytes_shortened > 0)
-        {
-            for(size_t j = i + 1; j < nodes.size(); ++j)
-                nodes[j].offset -= bytes_shortened;
-        }
+            shrink(i + 1, bytes_shortened);
     }
+    finish(nodes.empty() ? 0 : nodes.size() - 1);
 }
 
 error_t assembler_t::link()
 {
+    phase_timer_t timer(time_rep, "link");
     linked_data.clear();
 
     if(enable_relaxing)
+    {
+        phase_timer_t t(time_rep, "relax jumps");
         relax_jumps();
+    }
 
     if(globals_bytes > max_globals_bytes())
     {
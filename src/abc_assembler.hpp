@@ -8,6 +8,8 @@
 #include <limits.h>
 
 #include "abc_error.hpp"
+#include "abc_symbol.hpp"
+#include "abc_time_report.hpp"
 #include <abc_instr.hpp>
 
 namespace abc
@@ -54,12 +56,16 @@ struct assembler_t
 
     int num_shades() const { return shades; }
 
+    // phases of assembling and linking
+    time_report_t const& time_report() const { return time_rep; }
+
     std::vector<uint8_t> const& data() { return linked_data; }
 
     bool enable_relaxing = true;
 
 private:
     std::vector<uint8_t> linked_data;
+    time_report_t time_rep;
 
     /*
     Line Table Command Encoding
@@ -76,20 +82,20 @@ private:
 
     void advance_pc_offset();
 
-    std::unordered_map<std::string, std::vector<uint8_t>> custom_labels;
+    std::unordered_map<symbol_t, std::vector<uint8_t>> custom_labels;
     
     // convert label name to node index
-    std::unordered_map<std::string, size_t> labels;
+    std::unordered_map<symbol_t, size_t> labels;
 
     // convert label name to global data offset
-    std::unordered_map<std::string, size_t> globals;
+    std::unordered_map<symbol_t, size_t> globals;
 
     std::string githash;
     int shades;
     size_t max_globals_bytes() const { return shades == 2 ? 1024 : 256; }
 
     void add_global(compiler_global_t const& global);
-    void add_label(std::string const& label);
+    void add_label(symbol_t label);
     void add_instr(compiler_instr_t const& instr, uint16_t& line,
         uint16_t& file, std::vector<std::string> const& filenames);
     void add_file(std::string const& filename);
@@ -122,7 +128,7 @@ private:
         instr_t instr;
         uint32_t size; // size of object in bytes
         uint32_t imm;  // also used for label offset
-        std::string label;
+        symbol_t label;
     };
     
     std::vector<node_t> nodes;
@@ -150,10 +156,10 @@ private:
     }
 
     void push_label(std::istream& f, bool has_offset = false, uint16_t size = 3);
-    void push_label(std::string const& label, uint32_t offset = 0, uint16_t size = 3);
+    void push_label(symbol_t label, uint32_t offset = 0, uint16_t size = 3);
 
     void push_global(std::istream& f, bool has_offset = false, uint16_t size = 2);
-    void push_global(std::string const& label, uint32_t offset = 0, uint16_t size = 2);
+    void push_global(symbol_t label, uint32_t offset = 0, uint16_t size = 2);
 
 };
     
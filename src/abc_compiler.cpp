@@ -218,9 +218,10 @@ compiler_type_t compiler_t::resolve_type(ast_node_t const& n)
         }
         compiler_type_t t{};
         t.type = compiler_type_t::ARRAY_REF;
-        t.children.push_back(resolve_type(n.children[0]));
+        auto elem = resolve_type(n.children[0]);
         if(n.type == AST::TYPE_AREF_PROG)
-            t.children[0].make_prog();
+            elem.make_prog();
+        t.children = { elem };
         t.prim_size = t.children[0].is_prog ? 6 : 4;
         return t;
     }
@@ -256,7 +257,7 @@ compiler_type_t compiler_t::resolve_type(ast_node_t const& n)
                 n.line_info });
             return TYPE_NONE;
         }
-        t.children.emplace_back(std::move(type));
+        t.children = { type };
         t.prim_size = size_t(value) * t.children[0].prim_size;
         t.is_prog = t.children[0].is_prog;
         return t;
@@ -266,6 +267,8 @@ compiler_type_t compiler_t::resolve_type(ast_node_t const& n)
         compiler_type_t t{};
         t.type = compiler_type_t::STRUCT;
         t.struct_name = n.children[0].data;
+        std::vector<compiler_type_t> children;
+        std::vector<std::pair<std::string, size_t>> members;
         size_t size = 0;
         for(size_t i = 1; i < n.children.size(); ++i)
         {
@@ -280,11 +283,13 @@ compiler_type_t compiler_t::resolve_type(ast_node_t const& n)
                         decl.children[0].line_info });
                     return {};
                 }
-                t.children.emplace_back(std::move(type));
-                t.members.push_back({ std::string(decl.children[j].data), size });
-                size += t.children.back().prim_size;
+                children.push_back(type);
+                members.push_back({ std::string(decl.children[j].data), size });
+                size += type.prim_size;
             }
         }
+        t.children = children;
+        t.members = members;
         t.prim_size = size;
         return t;
     }
@@ -352,8 +357,10 @@ compiler_type_t compiler_t::resolve_type(ast_node_t const& n)
         compiler_type_t t{};
         t.type = compiler_type_t::FUNC_REF;
         t.prim_size = 3;
+        std::vector<compiler_type_t> children;
         for(auto const& child : n.children)
-            t.children.emplace_back(std::move(resolve_type(child)));
+            children.push_back(resolve_type(child));
+        t.children = children;
         return t;
     }
 
@@ -474,6 +481,8 @@ std::string compiler_t::resolve_label_ref(
         else
         {
             label = font_label_cache[key] = progdata_label();
+            if(codegen_worker)
+                codegen_events.back() = { codegen_event_t::FONT, label, key };
             add_progdata(label, TYPE_FONT, n);
         }
         return label;
@@ -533,6 +542,8 @@ void compiler_t::create_builtin_font(compiler_global_t& g)
         if(!g.constexpr_ref.empty()) return;
         g.constexpr_ref = progdata_label();
         g.var.label_ref = g.constexpr_ref;
+        if(codegen_worker)
+            codegen_events.back() = { codegen_event_t::BUILTIN_FONT, g.constexpr_ref, {}, g.name };
         std::vector<uint8_t> data;
         data.resize(f.size);
         memcpy(data.data(), f.data, data.size());
@@ -541,11 +552,6 @@ void compiler_t::create_builtin_font(compiler_global_t& g)
     }
 }
 
-static auto tie_var(compiler_global_t const* v)
-{
-    return std::tie(v->var.type.prim_size, v->name);
-}
-
 void compiler_t::compile(
     std::string const& fpath,
     std::string const& fname,
@@ -560,6 +566,7 @@ void compiler_t::compile(
     funcs.clear();
     globals.clear();
     structs.clear();
+    enums.clear();
 
     errs.clear();
     warns.clear();
@@ -567,14 +574,14 @@ void compiler_t::compile(
     compiled_files.clear();
     import_set.clear();
     progdata.clear();
+    progdata_label_index = 0;
     input_data.clear();
 
     arduboy_file_directives.clear();
     arduboy_file_directives["title"] = "Untitled Arduboy Game";
     arduboy_file_directives["author"] = "Unknown Author";
     arduboy_file_directives["version"] = "1.0";
-    arduboy_file_directives["date"] =
-        fmt::format("{:%Y-%m-%d}", fmt::localtime(std::time(nullptr)));
+    arduboy_file_directives["date"] = today();
     shades = 2;
     non_directive_found = false;
 
@@ -614,7 +621,27 @@ void compiler_t::compile(
     current_path = fpath;
     current_file = fname;
 
+    time_rep.clear();
+    type_annotate_seconds = 0;
+    type_annotate_runs = 0;
+    phase_timer_t timer(time_rep, "compile", [this] { return instr_count(); });
+
+    cache_stat = {};
+    cache_inputs.clear();
+    cache_strings.clear();
+    if(cache_enabled())
+    {
+        if(cache_load_build(fpath, fname))
+        {
+            find_githash();
+            return;
+        }
+        cache_record_inputs();
+    }
+
+    parse_modules(fpath, fname);
     compile_recurse(fpath, fname);
+    parsed_modules.clear();
 
     // add final ret to global constructor
     {
@@ -626,31 +653,40 @@ void compiler_t::compile(
     }
 
     // generate code for all functions
-    for(auto& [n, f] : funcs)
     {
-        if(!errs.empty()) return;
-        current_file = f.filename;
-        if(f.block.type == AST::NONE) continue;
-        codegen_function(f);
+        phase_timer_t t(time_rep, "codegen", [this] { return instr_count(); });
+        codegen_functions();
+        // includes the annotation of global initializers while parsing
+        time_rep.add_seconds("type annotate", type_annotate_seconds, type_annotate_runs);
     }
 
-    // merge labels of the same address
-    for(auto& [n, f] : funcs)
+    // merge labels of the same address: each run of labels is replaced
+    // by its last label
     {
         if(!errs.empty()) return;
-        for(size_t i = 0; i + 1 < f.instrs.size(); ++i)
+        std::unordered_map<symbol_t, symbol_t> merged;
+        for(auto& [n, f] : funcs)
+        {
+            for(size_t i = f.instrs.size(); i-- > 1;)
+            {
+                auto& i0 = f.instrs[i - 1];
+                auto const& i1 = f.instrs[i];
+                if(!(i0.is_label && i1.is_label))
+                    continue;
+                i0.instr = I_REMOVE;
+                auto it = merged.find(i1.label);
+                merged[i0.label] = it != merged.end() ? it->second : i1.label;
+            }
+            clear_removed_instrs(f.instrs);
+        }
+        if(!merged.empty())
         {
-            auto& i0 = f.instrs[i];
-            auto const& i1 = f.instrs[i + 1];
-            if(!(i0.is_label && i1.is_label))
-                continue;
-            i0.instr = I_REMOVE;
-            for(auto& [tn, tf] : funcs)
-                for(auto& ti : tf.instrs)
-                    if(!ti.is_label && ti.label == i0.label)
-                        ti.label = i1.label;
+            for(auto& [n, f] : funcs)
+                for(auto& i : f.instrs)
+                    if(!i.is_label)
+                        if(auto it = merged.find(i.label); it != merged.end())
+                            i.label = it->second;
         }
-        clear_removed_instrs(f.instrs);
     }
 
     // annotate instructions with file info to preserve over inlining
@@ -719,49 +755,61 @@ void compiler_t::compile(
         }
     }
 
-    optimize();
+    {
+        phase_timer_t t(time_rep, "merge progdata");
+        merge_progdata();
+    }
 
-    // attempt to find githash
     {
-        std::filesystem::path p(base_path);
-        std::string h;
-        for(int i = 0; h.empty() && i < 64; ++i)
+        phase_timer_t t(time_rep, "optimize", [this] { return instr_count(); });
+        optimize();
+    }
+
+    find_githash();
+
+    {
+        phase_timer_t t(time_rep, "place globals");
+        place_globals();
+    }
+
+    if(cache_enabled() && errs.empty())
+        cache_store_build(fpath, fname);
+}
+
+std::string compiler_t::today()
+{
+    return fmt::format("{:%Y-%m-%d}", fmt::localtime(std::time(nullptr)));
+}
+
+void compiler_t::find_githash()
+{
+    std::filesystem::path p(base_path);
+    std::string h;
+    for(int i = 0; h.empty() && i < 64; ++i)
+    {
+        auto head = p / ".git" / "HEAD";
+        if(std::filesystem::is_regular_file(head))
         {
-            auto head = p / ".git" / "HEAD";
-            if(std::filesystem::is_regular_file(head))
+            std::ifstream fhead(head);
+            if(fhead.good())
             {
-                std::ifstream fhead(head);
-                if(fhead.good())
+                std::string t;
+                std::getline(fhead, t);
+                t = t.substr(5);
+                std::filesystem::path ref = p / ".git" / t;
+                if(std::filesystem::is_regular_file(ref))
                 {
-                    std::string t;
-                    std::getline(fhead, t);
-                    t = t.substr(5);
-                    std::filesystem::path ref = p / ".git" / t;
-                    if(std::filesystem::is_regular_file(ref))
-                    {
-                        std::ifstream fref(ref);
-                        if(fref.good())
-                            fref >> h;
-                    }
+                    std::ifstream fref(ref);
+                    if(fref.good())
+                        fref >> h;
                 }
             }
-            if(p.has_parent_path())
-                p = p.parent_path();
         }
-        if(!h.empty())
-            githash = h;
+        if(p.has_parent_path())
+            p = p.parent_path();
     }
-
-    // sort globals by ascending size for optimizing access
-
-    sorted_globals.clear();
-    for(auto const& [name, global] : globals)
-        sorted_globals.push_back(&global);
-
-    std::sort(sorted_globals.begin(), sorted_globals.end(),
-        [](compiler_global_t const* a, compiler_global_t const* b) {
-            return tie_var(a) < tie_var(b);
-    });
+    if(!h.empty())
+        githash = h;
 }
 
 void compiler_t::compile(
@@ -774,11 +822,33 @@ void compiler_t::compile(
     write(fo);
 }
 
-void compiler_t::compile_recurse(std::string const& fpath, std::string const& fname)
+std::string compiler_t::module_filename(std::string const& fpath, std::string const& fname)
 {
-    std::vector<char> input;
     std::string pathbase = fpath.empty() ? "" : fpath + "/";
-    std::string filename = pathbase + fname + ".abc";
+    return pathbase + fname + ".abc";
+}
+
+// directory and module name of an import statement in a module in fpath
+void compiler_t::import_module(ast_node_t const& n, std::string const& fpath,
+    std::string& path, std::string& file)
+{
+    auto trim = [](std::string_view s) {
+        while(!s.empty() && isspace(s.front())) s.remove_prefix(1);
+        while(!s.empty() && isspace(s.back())) s.remove_suffix(1);
+        return s;
+    };
+    path = fpath;
+    for(size_t i = 0; i + 1 < n.children.size(); ++i)
+    {
+        path += "/";
+        path += trim(n.children[i].data);
+    }
+    file = std::string(trim(n.children.back().data));
+}
+
+void compiler_t::compile_recurse(std::string const& fpath, std::string const& fname)
+{
+    std::string filename = module_filename(fpath, fname);
 
     if(import_set.count(filename) != 0)
     {
@@ -791,14 +861,41 @@ void compiler_t::compile_recurse(std::string const& fpath, std::string const& fn
 
     auto& compile_data = compiled_files[filename];
     ast_node_t& ast = compile_data.second;
-    if(!file_loader || !file_loader(filename, compile_data.first))
+    if(auto it = parsed_modules.find(filename); it != parsed_modules.end())
     {
-        errs.push_back({ "Unable to open module \"" + fname + "\"" });
-        return;
+        auto& m = it->second;
+        if(!m.loaded)
+        {
+            errs.push_back({ "Unable to open module \"" + fname + "\"" });
+            return;
+        }
+        // the syntax tree views the source, which keeps its buffer
+        compile_data.first = std::move(m.source);
+        ast = std::move(m.ast);
+        errs.insert(errs.end(), m.errs.begin(), m.errs.end());
+        parsed_modules.erase(it);
+        if(!errs.empty()) return;
     }
+    else
+    {
+        if(!file_loader || !file_loader(filename, compile_data.first))
+        {
+            errs.push_back({ "Unable to open module \"" + fname + "\"" });
+            return;
+        }
 
-    parse(compile_data.first, ast);
-    if(!errs.empty()) return;
+        if(!cache_load_ast(filename, compile_data.first, ast))
+        {
+            {
+                phase_timer_t t(time_rep, "parse");
+                parse(compile_data.first, ast, errs);
+            }
+            if(!errs.empty()) return;
+            cache_store_ast(filename, compile_data.first, ast);
+        }
+    }
+
+    phase_timer_t transform_timer(time_rep, "transform");
 
     // trim all token whitespace
     ast.recurse([](ast_node_t& n) {
@@ -888,6 +985,7 @@ void compiler_t::compile_recurse(std::string const& fpath, std::string const& fn
         for(auto& child : a.children)
             child.parent = &a;
     });
+    transform_timer.stop();
 
     // gather all functions and globals and check for duplicates
     assert(ast.type == AST::PROGRAM);
@@ -1008,13 +1106,9 @@ void compiler_t::compile_recurse(std::string const& fpath, std::string const& fn
         }
         else if(n.type == AST::IMPORT_STMT)
         {
-            std::string new_path = fpath;
-            for(size_t i = 0; i + 1 < n.children.size(); ++i)
-            {
-                new_path += "/";
-                new_path += n.children[i].data;
-            }
-            std::string new_file = std::string(n.children.back().data);
+            std::string new_path;
+            std::string new_file;
+            import_module(n, fpath, new_path, new_file);
             import_set.insert(filename);
             std::string old_path = std::move(current_path);
             std::string old_file = std::move(current_file);
@@ -1167,12 +1261,12 @@ compiler_type_t compiler_t::strlit_type(size_t len)
     compiler_type_t type{};
     type.type = compiler_type_t::REF;
     type.prim_size = 3;
-    type.children.resize(1);
-    auto& t = type.children[0];
+    compiler_type_t t{};
     t.type = compiler_type_t::ARRAY;
     t.prim_size = len;
     t.children.push_back(TYPE_CHAR);
     t.make_prog();
+    type.children = { t };
     return type;
 }
 
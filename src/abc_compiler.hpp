@@ -4,6 +4,8 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
@@ -12,6 +14,14 @@
 
 #include "abc_assembler.hpp"
 #include "abc_error.hpp"
+#include "abc_interned_vector.hpp"
+#include "abc_symbol.hpp"
+#include "abc_time_report.hpp"
+
+namespace peg
+{
+class parser;
+}
 
 namespace abc
 {
@@ -132,6 +142,30 @@ enum class AST
     TYPE_FUNC_REF, // children are return type and arg types
 };
 
+struct compiler_type_t;
+struct compiler_type_hash_t
+{
+    size_t operator()(compiler_type_t const& t) const;
+};
+struct compiler_type_same_t
+{
+    bool operator()(compiler_type_t const& a, compiler_type_t const& b) const;
+};
+struct compiler_member_hash_t
+{
+    size_t operator()(std::pair<std::string, size_t> const& m) const
+    {
+        return std::hash<std::string>{}(m.first) ^ m.second;
+    }
+};
+using compiler_type_list_t = interned_vector_t<
+    compiler_type_t, compiler_type_hash_t, compiler_type_same_t>;
+using compiler_member_list_t = interned_vector_t<
+    std::pair<std::string, size_t>, compiler_member_hash_t,
+    std::equal_to<std::pair<std::string, size_t>>>;
+
+// Types are small and trivially copied: their child types and struct
+// members are interned lists, and the struct name is a symbol.
 struct compiler_type_t
 {
     // size of type in bytes (0 means void)
@@ -189,12 +223,12 @@ struct compiler_type_t
     // empty for primitives
     // element type for arrays
     // members for structs
-    std::vector<compiler_type_t> children;
+    compiler_type_list_t children;
 
     // only nonempty for structs
     // data is name, offset
-    std::vector<std::pair<std::string, size_t>> members;
-    std::string struct_name;
+    compiler_member_list_t members;
+    symbol_t struct_name;
 
     type_t ref_type() const
     {
@@ -229,8 +263,12 @@ struct compiler_type_t
         compiler_type_t t = *this;
         t.is_prog = false;
         if(is_array() || is_struct())
-            for(auto& child : t.children)
+        {
+            auto c = children.vec();
+            for(auto& child : c)
                 child = child.without_prog();
+            t.children = c;
+        }
         return t;
     }
 
@@ -295,13 +333,27 @@ struct compiler_type_t
     bool operator==(compiler_type_t const& t) const { return tie() == t.tie(); }
     bool operator!=(compiler_type_t const& t) const { return !operator==(t); }
 
+    // exact equality, including the flags operator== ignores
+    bool same(compiler_type_t const& t) const
+    {
+        return
+            std::tie(prim_size, type, is_signed, is_bool, is_char, is_float,
+                is_byte, is_constexpr, is_saved, is_prog, struct_name) ==
+            std::tie(t.prim_size, t.type, t.is_signed, t.is_bool, t.is_char, t.is_float,
+                t.is_byte, t.is_constexpr, t.is_saved, t.is_prog, t.struct_name) &&
+            children.same(t.children) &&
+            members.same(t.members);
+    }
+
     void make_prog()
     {
         is_prog = true;
-        if(is_any_ref())
+        if(is_any_ref() || children.empty())
             return;
-        for(auto& child : children)
+        auto c = children.vec();
+        for(auto& child : c)
             child.make_prog();
+        children = c;
     }
 
     compiler_type_t with_prog() const
@@ -315,7 +367,7 @@ struct compiler_type_t
     {
         compiler_type_t r{};
         r.type = REF;
-        r.children.push_back(*this);
+        r.children = { *this };
         r.prim_size = is_prog ? 3 : 2;
         return r;
     }
@@ -325,7 +377,7 @@ struct compiler_type_t
         assert(!is_array_ref());
         compiler_type_t r{};
         r.type = ARRAY_REF;
-        r.children.push_back(*this);
+        r.children = { *this };
         r.prim_size = is_prog ? 6 : 4;
         return r;
     }
@@ -336,7 +388,7 @@ struct compiler_type_t
         r.type = ARRAY;
         r.prim_size = n * prim_size;
         r.is_prog = is_prog;
-        r.children.push_back(*this);
+        r.children = { *this };
         return r;
     }
 
@@ -368,6 +420,25 @@ struct compiler_type_t
     }
 };
 
+inline size_t compiler_type_hash_t::operator()(compiler_type_t const& t) const
+{
+    size_t h = t.prim_size;
+    h = h * 31 + t.type;
+    h = h * 31 + (
+        t.is_signed << 0 | t.is_bool << 1 | t.is_char << 2 | t.is_float << 3 |
+        t.is_byte << 4 | t.is_constexpr << 5 | t.is_saved << 6 | t.is_prog << 7);
+    h = h * 31 + t.children.hash();
+    h = h * 31 + t.members.hash();
+    h = h * 31 + t.struct_name.index();
+    return h;
+}
+
+inline bool compiler_type_same_t::operator()(
+    compiler_type_t const& a, compiler_type_t const& b) const
+{
+    return a.same(b);
+}
+
 const compiler_type_t TYPE_NONE = { 0, compiler_type_t::PRIM, true };
 
 const compiler_type_t TYPE_VOID = { 0, compiler_type_t::PRIM, false };
@@ -422,9 +493,13 @@ struct compiler_instr_t
     uint16_t line;
     uint32_t imm;
     uint32_t imm2;
-    std::string label; // can also be label arg of instr
+    symbol_t label; // can also be label arg of instr
     bool is_label;
     uint16_t file;
+
+    auto tie() const { return std::tie(instr, line, imm, imm2, label, is_label, file); }
+    bool operator==(compiler_instr_t const& i) const { return tie() == i.tie(); }
+    bool operator!=(compiler_instr_t const& i) const { return !operator==(i); }
 };
 
 struct compiler_func_decl_t
@@ -536,6 +611,24 @@ struct ast_node_t
     }
 };
 
+// closed interval of integer values; empty when lo > hi
+struct compiler_range_t
+{
+    int64_t lo, hi;
+    bool empty() const { return lo > hi; }
+};
+
+// within the guarded code, local is at most (upper) or at least (!upper)
+// the value of bound plus offset
+struct compiler_range_fact_t
+{
+    int local;
+    bool upper;
+    bool annotated; // the comparison's operand conversions are explicit
+    int64_t offset;
+    ast_node_t const* bound;
+};
+
 struct compiler_lvalue_t
 {
     compiler_type_t type;
@@ -546,6 +639,120 @@ struct compiler_lvalue_t
     ast_node_t const* ref_ast;
 };
 
+// optimizer passes, in the order they are reported
+enum opt_pass_t
+{
+    OPT_INLINE,
+    OPT_REDUCE,
+    OPT_IR,
+    OPT_PEEPHOLE,
+    OPT_REMOVE_LABELS,
+    OPT_MERGE_LABELS,
+    OPT_STACK,
+    NUM_OPT_PASSES
+};
+
+// what the optimizer's cost model minimizes
+enum opt_goal_t
+{
+    OPT_GOAL_SPEED,
+    OPT_GOAL_SIZE
+};
+
+// the VM whose measured instruction costs the cost model uses
+// (abc_instr_costs.hpp)
+enum cost_vm_t
+{
+    COST_VM_ARDUBOY,
+    COST_VM_GENERIC,
+    NUM_COST_VMS
+};
+
+// how often code ran in a profile, relative to the hottest line
+// (warm when there is no profile)
+enum profile_temp_t
+{
+    TEMP_WARM,
+    TEMP_COLD,
+    TEMP_HOT
+};
+
+// hits per source line of each file in the line table, from a PC-hit
+// profile (abc_compiler_profile.cpp); -1 for lines that had no code in
+// the profiled build, e.g. because it was folded away
+struct compiler_profile_t
+{
+    std::map<std::string, std::vector<int64_t>> lines;
+    int64_t max_hits;
+};
+
+// estimated cost of a code sequence, in the cost VM's time units and
+// in encoded bytes
+struct compiler_cost_t
+{
+    uint64_t time;
+    uint64_t bytes;
+};
+
+// tunables that affect the generated code: copied to parallel codegen
+// workers and part of the cache key of a build
+struct compiler_options_t
+{
+    bool enable_merging_progdata = true;
+    bool enable_sized_unrolling = true;
+    bool enable_unsized_unrolling = true;
+    bool enable_inlining = true;
+    bool enable_jmp_to_ret = true;
+    bool enable_bake_pushl = true;
+    size_t memcpy_min_bytes = 16;
+    size_t max_jump_to_ret_instrs = 8;
+    size_t inlining_max_add_instrs = 256;
+    size_t switch_min_ranges_for_jump_table = 16;
+    size_t unroll_sized_max_instrs = 1024; // max total instrs in unrolled loop
+    size_t unroll_sized_max_iters = 64;
+    size_t unroll_unsized_max_add_instrs = 256;
+    size_t unroll_unsized_max_iters = 8;
+    bool enable_loop_motion = true;
+    size_t loop_motion_max_bytes = 8; // max stack bytes hoisted per loop
+    size_t max_getpn_bake = 16; // max bytes to bake a GETPN into PUSHs
+    bool enable_global_placement = true; // most accessed globals first
+    opt_goal_t opt_goal = OPT_GOAL_SPEED;
+    cost_vm_t cost_vm = COST_VM_ARDUBOY;
+    size_t profile_hot_ratio = 16;    // hot: run at least 1/N as often as the hottest line
+    size_t profile_cold_ratio = 4096; // cold: run less than 1/N as often, or never
+    size_t profile_hot_scale = 2;     // inlining and unrolling limits in hot code
+    size_t profile_branch_ratio = 16; // out of line: if branch taken less than 1/N of the time
+
+    // calls f on every option above; keep in sync when adding one
+    template<class F> void for_each_option(F&& f) const
+    {
+        f(enable_merging_progdata);
+        f(enable_sized_unrolling);
+        f(enable_unsized_unrolling);
+        f(enable_inlining);
+        f(enable_jmp_to_ret);
+        f(enable_bake_pushl);
+        f(memcpy_min_bytes);
+        f(max_jump_to_ret_instrs);
+        f(inlining_max_add_instrs);
+        f(switch_min_ranges_for_jump_table);
+        f(unroll_sized_max_instrs);
+        f(unroll_sized_max_iters);
+        f(unroll_unsized_max_add_instrs);
+        f(unroll_unsized_max_iters);
+        f(enable_loop_motion);
+        f(loop_motion_max_bytes);
+        f(max_getpn_bake);
+        f(enable_global_placement);
+        f(opt_goal);
+        f(cost_vm);
+        f(profile_hot_ratio);
+        f(profile_cold_ratio);
+        f(profile_hot_scale);
+        f(profile_branch_ratio);
+    }
+};
+
 struct compiler_func_t
 {
     ast_node_t block;
@@ -559,6 +766,13 @@ struct compiler_func_t
     size_t label_count;
     sysfunc_t sys;
     bool is_sys;
+
+    // optimizer bookkeeping: the version is bumped on every change, and
+    // per-function passes skip versions they already left unchanged
+    uint32_t version;
+    uint32_t clean_version[NUM_OPT_PASSES];
+
+    profile_temp_t temp;
 };
 
 struct compiler_progdata_t
@@ -603,7 +817,7 @@ struct builtin_constexpr_t
 
 extern std::vector<builtin_constexpr_t> const builtin_constexprs;
 
-struct compiler_t
+struct compiler_t : compiler_options_t
 {
     compiler_t()
         : progdata_label_index(0)
@@ -665,25 +879,57 @@ struct compiler_t
         return arduboy_file_directives;
     }
 
+    // Enable the incremental compilation cache in the given directory
+    // (empty to disable). Entries are only reused by compilers with the
+    // same version string, which should identify the compiler build.
+    void set_cache_dir(std::string const& dir, std::string const& version = {});
+
+    // Guide hot/cold optimization decisions by a PC-hit profile of a
+    // previous build, given as lines of "<hex pc> <count>", and the binary
+    // of that build, whose line table maps PCs to source lines.
+    error_t load_profile(std::vector<uint8_t> const& binary, std::istream& profile);
+    void clear_profile() { profile.reset(); }
+    compiler_profile_t const* loaded_profile() const { return profile.get(); }
+
+    // Also keep cache entries in memory, with or without a cache directory,
+    // so that a compiler reused for many compiles (e.g. abcc --watch) only
+    // parses the modules that changed since the last one.
+    void set_memory_cache(bool enable);
+
+    struct cache_stats_t
+    {
+        bool build_hit;       // outputs restored without compiling
+        size_t module_hits;   // modules whose syntax tree was reused
+        size_t module_misses; // modules that had to be parsed
+        size_t asset_hits;    // sprites, fonts, MIDI and TMX files reused
+        size_t asset_misses;  // assets that had to be encoded
+    };
+    cache_stats_t const& cache_stats() const { return cache_stat; }
+
+    struct opt_pass_stats_t
+    {
+        char const* name;
+        size_t runs;    // times the pass was run
+        size_t visited; // functions processed
+        size_t skipped; // functions skipped as unchanged since the last run
+        size_t changed; // functions changed (or removed) by the pass
+        double seconds;
+    };
+    struct opt_stats_t
+    {
+        size_t rounds[2]; // iterations of the two fixpoint loops
+        opt_pass_stats_t passes[NUM_OPT_PASSES];
+    };
+    opt_stats_t const& opt_stats() const { return opt_stat; }
+
+    // phases of the last compile, and of writes since
+    time_report_t const& time_report() const { return time_rep; }
+
     //
     // "Private but technically public" API
     //
 
-    bool enable_merging_progdata = true;
-    bool enable_sized_unrolling = true;
-    bool enable_unsized_unrolling = true;
-    bool enable_inlining = true;
-    bool enable_jmp_to_ret = true;
-    bool enable_bake_pushl = true;
-    size_t memcpy_min_bytes = 16;
-    size_t max_jump_to_ret_instrs = 8;
-    size_t inlining_max_add_instrs = 256;
-    size_t switch_min_ranges_for_jump_table = 16;
-    size_t unroll_sized_max_instrs = 1024; // max total instrs in unrolled loop
-    size_t unroll_sized_max_iters = 64;
-    size_t unroll_unsized_max_add_instrs = 256;
-    size_t unroll_unsized_max_iters = 8;
-    size_t max_getpn_bake = 16; // max bytes to bake a GETPN into PUSHs
+    size_t num_threads = 0; // codegen and peephole threads (0: one per core)
 
     void add_custom_label_ref(std::string const& name, compiler_type_t const& t);
 
@@ -695,10 +941,38 @@ private:
 
     friend struct assembler_t;
 
-    void init_parser();
-    void parse(std::vector<char> const& fi, ast_node_t& ast);
+    static void init_parser(peg::parser& p, std::vector<error_t>& errs);
+    static void parse(
+        std::vector<char> const& fi, ast_node_t& ast, std::vector<error_t>& errs);
+
+    static std::string module_filename(std::string const& fpath, std::string const& fname);
+    static void import_module(ast_node_t const& n, std::string const& fpath,
+        std::string& path, std::string& file);
 
     void create_builtin_font(compiler_global_t& g);
+
+    static std::string today();
+    void find_githash();
+
+    // global placement (abc_compiler_globals.cpp)
+    void place_globals();
+
+    // incremental compilation cache (abc_compiler_cache.cpp)
+    std::string cache_file(char const* kind, std::string const& id) const;
+    void cache_record_inputs();
+    bool cache_load_ast(
+        std::string const& filename, std::vector<char> const& input, ast_node_t& ast);
+    void cache_store_ast(
+        std::string const& filename, std::vector<char> const& input, ast_node_t const& ast);
+    bool cache_load_build(std::string const& path, std::string const& name);
+    void cache_store_build(std::string const& path, std::string const& name);
+    // encoded assets, keyed by the encoder and its parameters and by
+    // the contents of the asset file
+    bool cache_load_asset(
+        std::string const& key, std::vector<char> const& input, std::vector<uint8_t>& data);
+    void cache_store_asset(
+        std::string const& key, std::vector<char> const& input,
+        std::vector<uint8_t> const& data, size_t start);
     
     void compile_recurse(std::string const& path, std::string const& name);
 
@@ -706,6 +980,8 @@ private:
 
     bool is_simple_lvalue(ast_node_t const& n, compiler_frame_t const& frame);
 
+    // encoded size of an instruction before branch relaxation
+    static uint32_t instr_bytes(compiler_instr_t const& i);
     // how the stack size is affected by an instruction
     int instr_stack_mod(compiler_instr_t const& i);
     // how much of the stack is used by the instruction (relative to pre-execution)
@@ -749,6 +1025,7 @@ private:
     void codegen_function(compiler_func_t& f);
     void codegen(compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a);
     void codegen_switch(compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a);
+    bool switch_jump_table_cheaper(size_t items, size_t ranges, opt_goal_t goal) const;
     void codegen_expr(compiler_func_t& f, compiler_frame_t& frame, ast_node_t const& a, bool ref);
     void codegen_expr_array_index(
         compiler_func_t& f, compiler_frame_t& frame, ast_node_t const& a, size_t& offset);
@@ -760,6 +1037,8 @@ private:
     void codegen_expr_logical(
         compiler_func_t& f, compiler_frame_t& frame,
         ast_node_t const& a, std::string const& sc_label);
+    bool codegen_const_multiplicative(
+        compiler_func_t& f, compiler_frame_t& frame, ast_node_t const& a);
     void codegen_store(
         compiler_func_t& f, compiler_frame_t& frame, ast_node_t const& a);
     void codegen_convert(
@@ -793,11 +1072,98 @@ private:
         ast_node_t const& n, unroll_info_t const& u,
         compiler_func_t& f, compiler_frame_t& frame);
 
+    // value ranges of integer locals, for eliding array bounds checks
+    struct range_local_t
+    {
+        compiler_type_t type;
+        bool tracked; // integer local whose address is never taken
+        bool addressed; // may be bound to a reference
+        bool ref; // a reference, so its value can change through other names
+        compiler_range_t range;
+    };
+    struct range_assign_t
+    {
+        int local;
+        ast_node_t const* expr; // null for an unknown value
+        int64_t delta;
+        std::vector<compiler_range_fact_t> facts;
+    };
+    void analyze_ranges(compiler_func_t const& f);
+    void range_scan_stmt(compiler_func_t const& f, ast_node_t const& a);
+    void range_scan_expr(ast_node_t const& a, bool ref);
+    void range_collect(ast_node_t const& a);
+    // range_ident of a global, or of a name the scan did not reach
+    static constexpr int RANGE_GLOBAL = -1;
+    static constexpr int RANGE_UNSEEN = -2;
+    int range_ident(ast_node_t const& a) const;
+    bool range_writes(ast_node_t const& a, int local) const;
+    size_t push_range_facts(
+        ast_node_t const& cond, ast_node_t const& body, ast_node_t const* iter);
+    void pop_range_facts(size_t n);
+    compiler_range_t eval_range(
+        ast_node_t const& a, compiler_range_fact_t const* facts,
+        size_t num_facts, int depth) const;
+    bool index_in_bounds(ast_node_t const& index, size_t num_elems) const;
+    static bool sys_arg_is_ref(std::string const& name, size_t i);
+    std::map<std::pair<std::pair<size_t, size_t>, std::string_view>, int> range_idents;
+    std::vector<std::unordered_map<std::string_view, int>> range_scopes;
+    std::vector<range_local_t> range_locals;
+    std::vector<range_assign_t> range_assigns;
+    std::vector<compiler_range_fact_t> range_facts;
+
+    // loop-invariant code motion and induction variable strength reduction
+    struct loop_value_t
+    {
+        ast_node_t expr; // copy, generated before the loop
+        bool index; // address of an array element
+        uint8_t size;
+        int64_t delta; // added after every iteration; 0 if invariant
+        bool globals; // reads globals
+        size_t order;
+        int64_t saved; // instructions saved per iteration
+        size_t frame_offset;
+    };
+    struct loop_motion_t
+    {
+        std::unordered_set<int> written; // locals assigned or declared in the loop
+        std::unordered_set<int> declared;
+        std::unordered_set<std::string> written_globals;
+        int iv; // induction variable, or -1
+        int64_t step;
+        bool active; // the loop is generated with this context
+        bool discover; // the first copy of the loop is being generated
+        size_t max_frame;
+        std::unordered_map<std::string, loop_value_t> candidates;
+        std::vector<loop_value_t> values;
+        std::unordered_map<std::string, size_t> value_index;
+    };
+    void codegen_loop(
+        compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a,
+        size_t prev_instrs, size_t lm);
+    bool unrolled_smaller(
+        compiler_func_t const& f, size_t prev_instrs, size_t body_start, size_t num) const;
+    void codegen_loop_motion(
+        compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a, size_t prev_instrs);
+    void codegen_loop_iter(
+        compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a, size_t lm);
+    bool codegen_loop_value(
+        compiler_func_t& f, compiler_frame_t& frame, ast_node_t const& a, size_t* offset);
+    void loop_scan(loop_motion_t& lm, ast_node_t const& a) const;
+    void loop_induction(loop_motion_t& lm, ast_node_t const& a);
+    bool loop_opaque(ast_node_t const& a) const;
+    bool loop_is_iv(loop_motion_t const& lm, ast_node_t const& a);
+    bool loop_affine(
+        loop_motion_t const& lm, ast_node_t const& a, int64_t& coef, bool& reads_globals);
+    void loop_key(
+        std::string& key, compiler_frame_t const& frame, ast_node_t const& a);
+    std::vector<loop_motion_t> loop_motion;
+    ast_node_t const* loop_value_skip = nullptr;
+    int loop_value_depth = 0;
+
     std::string progdata_label();
     void add_progdata(std::string const& label, compiler_type_t const& t, ast_node_t const& n);
     void add_custom_progdata(std::string const& label, std::vector<uint8_t>& data);
-    void try_merge_progdata(
-        std::string const& label, compiler_progdata_t& pdata);
+    void merge_progdata();
     bool progdata_encode_prim(
         ast_node_t const& n, compiler_type_t const& t, std::vector<uint8_t>& data);
     bool progdata_expr_valid_memcpy(
@@ -832,14 +1198,37 @@ private:
     bool remove_unreferenced_labels();
     bool merge_adjacent_labels();
 
-    bool is_inlinable(std::string const& func, std::unordered_set<std::string>& refs);
-    bool is_inlinable(std::string const& func);
-    bool should_inline(std::string const& func, int ref_count);
-    bool inline_function(std::string const& func);
+    bool should_inline(std::string const& func, size_t ref_count);
+    bool inline_function(symbol_t func);
     bool inline_or_remove_functions();
 
+    // call graph for inlining and dead function removal
+    // (abc_compiler_call_graph.cpp)
+    struct call_edge_t
+    {
+        symbol_t func;
+        bool call; // I_CALL, as opposed to any other reference
+    };
+    struct call_graph_node_t
+    {
+        uint32_t version; // function version the edges were read from
+        std::vector<call_edge_t> callees; // one edge per reference
+        std::unordered_map<symbol_t, size_t> callers; // references per caller
+        size_t num_refs;
+        size_t num_calls;
+    };
+    std::unordered_map<symbol_t, call_graph_node_t> call_graph;
+    void update_call_graph();
+    void index_callees(symbol_t name, compiler_func_t const& f);
+    void unlink_callees(symbol_t name);
+    std::vector<symbol_t> call_graph_order(std::unordered_set<symbol_t>& recursive);
+    void remove_function(symbol_t func);
+
     // perform a series of peephole optimizations on a function
     void optimize();
+    bool optimize_global(opt_pass_t pass, std::function<bool()> const& fn);
+    bool optimize_funcs(opt_pass_t pass, std::function<bool(compiler_func_t&)> const& fn);
+    void func_changed(compiler_func_t& f);
     bool peephole(compiler_func_t& f);
     bool peephole_reduce(compiler_func_t& f);
     bool peephole_reduce_bake_pushl(compiler_func_t& f);
@@ -858,13 +1247,44 @@ private:
     bool optimize_stack();
     bool optimize_stack_func(std::vector<compiler_instr_t>& instrs);
 
+    // function-level IR: constant and copy propagation, CSE and DCE
+    bool optimize_ir(compiler_func_t& f);
+
     bool peephole_compress_push_sequence(compiler_func_t& f);
     static void push_compression(
         std::vector< compiler_instr_t>& pi,
         compiler_instr_t const* b,
         compiler_instr_t const* d, size_t n);
 
-    void tail_call_optimization();
+    // cost model (abc_compiler_cost.cpp)
+    // arg is the shift count, byte count, quotient bit width or whether a
+    // branch is taken, or -1 for an average over the measured variants
+    uint32_t instr_time(instr_t instr, int arg = -1) const;
+    uint32_t div_time(instr_t instr, int nbits, int dbits) const;
+    compiler_cost_t instrs_cost(
+        compiler_instr_t const* b, compiler_instr_t const* e) const;
+    compiler_cost_t instrs_cost(std::vector<compiler_instr_t> const& instrs) const
+    {
+        return instrs_cost(instrs.data(), instrs.data() + instrs.size());
+    }
+    bool cheaper(compiler_cost_t const& a, compiler_cost_t const& b, opt_goal_t goal) const;
+
+    // profile queries (abc_compiler_profile.cpp)
+    // hits of a's line, or the most of any line in its subtree; -1 where
+    // the profile has no code for them
+    std::shared_ptr<compiler_profile_t const> profile;
+    std::vector<int64_t> const* profile_lines(std::string const& filename) const;
+    int64_t profile_hits(
+        compiler_func_t const& f, ast_node_t const& a, bool subtree) const;
+    profile_temp_t temperature(int64_t hits) const;
+    opt_goal_t goal(profile_temp_t temp) const;
+    opt_goal_t goal_at(compiler_func_t const& f, ast_node_t const& a) const
+    {
+        return goal(temperature(profile_hits(f, a, false)));
+    }
+    size_t out_of_line_branch(compiler_func_t const& f, ast_node_t const& a) const;
+
+    bool tail_call_optimization(compiler_func_t& f);
 
     static void clear_removed_instrs(std::vector<compiler_instr_t>& instrs);
 
@@ -901,6 +1321,44 @@ private:
     size_t progdata_label_index;
     std::map<std::string, compiler_progdata_t> progdata;
 
+    // parallel code generation (abc_compiler_parallel.cpp)
+    struct codegen_event_t
+    {
+        enum { LABEL, FONT, BUILTIN_FONT } type;
+        std::string label;
+        font_key_t font;    // FONT: key of the cached font
+        std::string global; // BUILTIN_FONT: name of the font global
+    };
+    struct codegen_result_t
+    {
+        std::vector<error_t> errs;
+        std::vector<error_t> warns;
+        std::vector<codegen_event_t> events;
+        std::map<std::string, compiler_progdata_t> progdata;
+    };
+    size_t thread_count(size_t items) const;
+    void for_each_func(std::function<void(compiler_func_t&)> const& fn);
+    void for_each_func(
+        std::vector<compiler_func_t*> const& work,
+        std::function<void(compiler_func_t&)> const& fn);
+    void codegen_functions();
+    void codegen_worker_function(
+        compiler_func_t& f, compiler_t const& main, codegen_result_t& r);
+    bool merge_codegen_result(compiler_func_t& f, codegen_result_t& r);
+    bool codegen_worker = false;
+    std::vector<codegen_event_t> codegen_events;
+
+    // modules loaded and parsed ahead of compile_recurse
+    struct parsed_module_t
+    {
+        bool loaded;
+        std::vector<char> source;
+        ast_node_t ast;
+        std::vector<error_t> errs;
+    };
+    std::unordered_map<std::string, parsed_module_t> parsed_modules;
+    void parse_modules(std::string const& fpath, std::string const& fname);
+
     std::vector<error_t> errs;
     std::vector<error_t> warns;
 
@@ -908,6 +1366,9 @@ private:
     std::vector<std::pair<std::string, size_t>> break_stack;
     std::vector<std::pair<std::string, size_t>> continue_stack;
 
+    // rarely run blocks moved out of line, appended to the function
+    std::vector<compiler_instr_t> cold_instrs;
+
     // track files already parsed
     std::map<std::string, std::pair<std::vector<char>, ast_node_t>> compiled_files;
     std::vector<std::string> debug_filenames;
@@ -918,9 +1379,34 @@ private:
     std::string githash;
     std::vector<compiler_global_t const*> sorted_globals;
 
+    std::string cache_dir;
+    std::string cache_version;
+    cache_stats_t cache_stat;
+    // in-memory entries, shared with codegen workers
+    struct cache_memory_t
+    {
+        std::mutex mutex;
+        std::unordered_map<std::string, std::vector<char>> entries;
+    };
+    std::shared_ptr<cache_memory_t> cache_memory;
+    bool cache_enabled() const { return !cache_dir.empty() || cache_memory; }
+    bool cache_read(std::string const& file, std::vector<char>& d);
+    void cache_write(std::string const& file, std::vector<char>&& d);
+
+    opt_stats_t opt_stat{};
+    size_t opt_changes = 0; // functions changed by the running whole-program pass
+    time_report_t time_rep;
+    double type_annotate_seconds = 0;
+    size_t type_annotate_runs = 0;
+    size_t instr_count() const;
+    // filename, (size, hash) of every input read by the current build
+    std::vector<std::pair<std::string, std::pair<uint64_t, uint64_t>>> cache_inputs;
+    // node text of cached syntax trees that does not view module source
+    std::unordered_set<std::string> cache_strings;
+
     int shades;
     bool non_directive_found;
-    bool do_suppress_githash;
+    bool do_suppress_githash = false;
 };
 
 }
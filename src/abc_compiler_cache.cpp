@@ -0,0 +1,738 @@
+#include "abc_compiler.hpp"
+
+#include <chrono>
+#include <filesystem>
+
+#include <string.h>
+
+#include <fmt/format.h>
+
+namespace abc
+{
+
+// bump whenever the layout of cache files or of the cached data changes
+static constexpr uint32_t CACHE_FORMAT = 2;
+
+static char const CACHE_MAGIC_AST[4] = { 'A', 'B', 'C', 'P' };
+static char const CACHE_MAGIC_BUILD[4] = { 'A', 'B', 'C', 'B' };
+static char const CACHE_MAGIC_ASSET[4] = { 'A', 'B', 'C', 'A' };
+
+static uint64_t cache_hash(
+    void const* data, size_t size, uint64_t h = 14695981039346656037ull)
+{
+    auto const* p = (uint8_t const*)data;
+    for(size_t i = 0; i < size; ++i)
+    {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static uint64_t cache_hash(std::vector<char> const& d)
+{
+    return cache_hash(d.data(), d.size());
+}
+
+namespace
+{
+
+struct cache_writer_t
+{
+    std::vector<char> d;
+
+    void bytes(void const* p, size_t n)
+    {
+        auto const* c = (char const*)p;
+        d.insert(d.end(), c, c + n);
+    }
+    void u8(uint8_t x) { d.push_back((char)x); }
+    // unsigned LEB128: most values in syntax trees fit in one byte
+    void u32(uint32_t x)
+    {
+        while(x >= 0x80)
+        {
+            u8(uint8_t(x | 0x80));
+            x >>= 7;
+        }
+        u8(uint8_t(x));
+    }
+    void u64(uint64_t x)
+    {
+        for(int i = 0; i < 8; ++i)
+            u8(uint8_t(x >> (i * 8)));
+    }
+    void str(std::string_view s)
+    {
+        u32((uint32_t)s.size());
+        bytes(s.data(), s.size());
+    }
+};
+
+// Any read past the end clears ok; callers check it once at the end.
+struct cache_reader_t
+{
+    char const* p;
+    char const* end;
+    bool ok;
+
+    cache_reader_t(std::vector<char> const& d)
+        : p(d.data()), end(d.data() + d.size()), ok(true)
+    {}
+
+    bool need(size_t n)
+    {
+        if(size_t(end - p) < n)
+            ok = false;
+        return ok;
+    }
+    uint8_t u8()
+    {
+        if(!need(1)) return 0;
+        return (uint8_t)*p++;
+    }
+    uint32_t u32()
+    {
+        uint32_t x = 0;
+        for(int shift = 0; shift < 35; shift += 7)
+        {
+            uint8_t b = u8();
+            x |= uint32_t(b & 0x7f) << shift;
+            if(!(b & 0x80))
+                return x;
+        }
+        ok = false;
+        return 0;
+    }
+    uint64_t u64()
+    {
+        uint64_t x = 0;
+        for(int i = 0; i < 8; ++i)
+            x |= uint64_t(u8()) << (i * 8);
+        return x;
+    }
+    std::string_view view(size_t n)
+    {
+        if(!need(n)) return {};
+        std::string_view s(p, n);
+        p += n;
+        return s;
+    }
+    std::string str() { return std::string(view(u32())); }
+    bool magic(char const* m) { return view(4) == std::string_view(m, 4); }
+
+    // element count, bounded by the remaining size to reject corrupt data
+    size_t count()
+    {
+        uint32_t n = u32();
+        if(n > size_t(end - p))
+            ok = false;
+        return ok ? n : 0;
+    }
+
+    bool done() const { return ok && p == end; }
+};
+
+}
+
+static bool read_cache_file(std::filesystem::path const& path, std::vector<char>& d)
+{
+    std::ifstream f(path, std::ios::in | std::ios::binary);
+    if(f.fail()) return false;
+    d = std::vector<char>(
+        (std::istreambuf_iterator<char>(f)),
+        (std::istreambuf_iterator<char>()));
+    return !f.bad();
+}
+
+static void write_cache_file(std::filesystem::path const& path, std::vector<char> const& d)
+{
+    // write to a temporary file and rename it into place so that
+    // concurrent compiles never observe a partially written entry
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    uintptr_t addr = (uintptr_t)&d;
+    uint64_t unique = cache_hash(&addr, sizeof(addr),
+        (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count());
+    auto tmp = path;
+    tmp += fmt::format(".{:016x}.tmp", unique);
+    {
+        std::ofstream f(tmp, std::ios::out | std::ios::binary);
+        if(f.fail()) return;
+        f.write(d.data(), (std::streamsize)d.size());
+        if(f.fail())
+        {
+            f.close();
+            std::filesystem::remove(tmp, ec);
+            return;
+        }
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if(ec)
+        std::filesystem::remove(tmp, ec);
+}
+
+static void write_type(cache_writer_t& w, compiler_type_t const& t)
+{
+    w.u32((uint32_t)t.prim_size);
+    w.u8(t.type);
+    w.u8(uint8_t(
+        (t.is_signed    << 0) |
+        (t.is_bool      << 1) |
+        (t.is_char      << 2) |
+        (t.is_float     << 3) |
+        (t.is_byte      << 4) |
+        (t.is_constexpr << 5) |
+        (t.is_saved     << 6) |
+        (t.is_prog      << 7)));
+    w.u32((uint32_t)t.children.size());
+    for(auto const& child : t.children)
+        write_type(w, child);
+    w.u32((uint32_t)t.members.size());
+    for(auto const& [name, offset] : t.members)
+    {
+        w.str(name);
+        w.u32((uint32_t)offset);
+    }
+    w.str(t.struct_name.str());
+}
+
+static void read_type(cache_reader_t& r, compiler_type_t& t)
+{
+    t.prim_size = r.u32();
+    t.type = compiler_type_t::type_t(r.u8());
+    uint8_t flags = r.u8();
+    t.is_signed    = (flags & (1 << 0)) != 0;
+    t.is_bool      = (flags & (1 << 1)) != 0;
+    t.is_char      = (flags & (1 << 2)) != 0;
+    t.is_float     = (flags & (1 << 3)) != 0;
+    t.is_byte      = (flags & (1 << 4)) != 0;
+    t.is_constexpr = (flags & (1 << 5)) != 0;
+    t.is_saved     = (flags & (1 << 6)) != 0;
+    t.is_prog      = (flags & (1 << 7)) != 0;
+    std::vector<compiler_type_t> children(r.count());
+    for(auto& child : children)
+        read_type(r, child);
+    t.children = children;
+    std::vector<std::pair<std::string, size_t>> members(r.count());
+    for(auto& [name, offset] : members)
+    {
+        name = r.str();
+        offset = r.u32();
+    }
+    t.members = members;
+    t.struct_name = r.str();
+}
+
+// Node text normally views the module source, which is identical whenever
+// the cached tree is used, so it is stored as an offset into the source.
+static void write_ast(
+    cache_writer_t& w, ast_node_t const& n, std::vector<char> const& src)
+{
+    w.u32((uint32_t)n.line_info.first);
+    w.u32((uint32_t)n.line_info.second);
+    w.u32((uint32_t)n.type);
+    uintptr_t b = (uintptr_t)src.data();
+    uintptr_t p = (uintptr_t)n.data.data();
+    if(!n.data.empty() && p >= b && p + n.data.size() <= b + src.size())
+    {
+        w.u8(0);
+        w.u32(uint32_t(p - b));
+        w.u32((uint32_t)n.data.size());
+    }
+    else
+    {
+        w.u8(1);
+        w.str(n.data);
+    }
+    uint64_t value;
+    memcpy(&value, &n.value, sizeof(value));
+    w.u32(uint32_t(value));
+    w.u32(uint32_t(value >> 32));
+    write_type(w, n.comp_type);
+    w.u32((uint32_t)n.children.size());
+    for(auto const& child : n.children)
+        write_ast(w, child, src);
+}
+
+static void read_ast(
+    cache_reader_t& r, ast_node_t& n, std::vector<char> const& src,
+    std::unordered_set<std::string>& strings)
+{
+    n.line_info.first = r.u32();
+    n.line_info.second = r.u32();
+    n.type = AST(r.u32());
+    if(r.u8() == 0)
+    {
+        size_t offset = r.u32();
+        size_t size = r.u32();
+        if(offset > src.size() || size > src.size() - offset)
+            r.ok = false;
+        else
+            n.data = std::string_view(src.data() + offset, size);
+    }
+    else
+        n.data = *strings.insert(r.str()).first;
+    uint64_t value = r.u32();
+    value |= uint64_t(r.u32()) << 32;
+    memcpy(&n.value, &value, sizeof(value));
+    read_type(r, n.comp_type);
+    n.children.resize(r.count());
+    for(auto& child : n.children)
+    {
+        if(!r.ok) return;
+        read_ast(r, child, src, strings);
+    }
+}
+
+void compiler_t::set_cache_dir(std::string const& dir, std::string const& version)
+{
+    cache_dir = dir;
+    cache_version = version;
+}
+
+void compiler_t::set_memory_cache(bool enable)
+{
+    if(!enable)
+        cache_memory.reset();
+    else if(!cache_memory)
+        cache_memory = std::make_shared<cache_memory_t>();
+}
+
+bool compiler_t::cache_read(std::string const& file, std::vector<char>& d)
+{
+    if(cache_memory)
+    {
+        std::lock_guard<std::mutex> lock(cache_memory->mutex);
+        if(auto it = cache_memory->entries.find(file); it != cache_memory->entries.end())
+        {
+            d = it->second;
+            return true;
+        }
+    }
+    if(cache_dir.empty() || !read_cache_file(file, d))
+        return false;
+    if(cache_memory)
+    {
+        std::lock_guard<std::mutex> lock(cache_memory->mutex);
+        cache_memory->entries[file] = d;
+    }
+    return true;
+}
+
+void compiler_t::cache_write(std::string const& file, std::vector<char>&& d)
+{
+    if(!cache_dir.empty())
+        write_cache_file(file, d);
+    if(cache_memory)
+    {
+        std::lock_guard<std::mutex> lock(cache_memory->mutex);
+        cache_memory->entries[file] = std::move(d);
+    }
+}
+
+void compiler_t::cache_record_inputs()
+{
+    // record every input read so that a stored build can be validated
+    file_loader = [this, loader = file_loader](
+        std::string const& filename, std::vector<char>& t) -> bool
+    {
+        if(!loader || !loader(filename, t))
+            return false;
+        cache_inputs.push_back({ filename, { t.size(), cache_hash(t) } });
+        return true;
+    };
+}
+
+std::string compiler_t::cache_file(char const* kind, std::string const& id) const
+{
+    uint64_t h = cache_hash(cache_version.data(), cache_version.size());
+    h = cache_hash(id.data(), id.size(), h);
+    return (std::filesystem::path(cache_dir) / fmt::format("{}-{:016x}.bin", kind, h)).string();
+}
+
+bool compiler_t::cache_load_ast(
+    std::string const& filename, std::vector<char> const& input, ast_node_t& ast)
+{
+    if(!cache_enabled())
+        return false;
+
+    std::vector<char> d;
+    if(!cache_read(cache_file("ast", filename), d))
+    {
+        ++cache_stat.module_misses;
+        return false;
+    }
+
+    cache_reader_t r(d);
+    bool valid =
+        r.magic(CACHE_MAGIC_AST) &&
+        r.u32() == CACHE_FORMAT &&
+        r.str() == cache_version &&
+        r.u64() == input.size() &&
+        r.u64() == cache_hash(input) &&
+        r.ok;
+    if(valid)
+    {
+        ast = {};
+        read_ast(r, ast, input, cache_strings);
+        valid = r.done();
+    }
+    if(!valid)
+    {
+        ast = {};
+        ++cache_stat.module_misses;
+        return false;
+    }
+
+    ++cache_stat.module_hits;
+    return true;
+}
+
+void compiler_t::cache_store_ast(
+    std::string const& filename, std::vector<char> const& input, ast_node_t const& ast)
+{
+    if(!cache_enabled())
+        return;
+
+    cache_writer_t w;
+    w.bytes(CACHE_MAGIC_AST, 4);
+    w.u32(CACHE_FORMAT);
+    w.str(cache_version);
+    w.u64(input.size());
+    w.u64(cache_hash(input));
+    write_ast(w, ast, input);
+    cache_write(cache_file("ast", filename), std::move(w.d));
+}
+
+// Asset entries are named by the hash of their key and input, so that
+// an asset used in several places or projects is encoded once.
+static std::string asset_id(std::string const& key, std::vector<char> const& input)
+{
+    uint64_t h = cache_hash(key.data(), key.size());
+    h = cache_hash(input.data(), input.size(), h);
+    return fmt::format("{:016x}-{:x}", h, input.size());
+}
+
+bool compiler_t::cache_load_asset(
+    std::string const& key, std::vector<char> const& input, std::vector<uint8_t>& data)
+{
+    if(!cache_enabled())
+        return false;
+
+    std::vector<char> d;
+    if(!cache_read(cache_file("asset", asset_id(key, input)), d))
+    {
+        ++cache_stat.asset_misses;
+        return false;
+    }
+
+    cache_reader_t r(d);
+    bool valid =
+        r.magic(CACHE_MAGIC_ASSET) &&
+        r.u32() == CACHE_FORMAT &&
+        r.str() == cache_version &&
+        r.str() == key &&
+        r.u64() == input.size() &&
+        r.u64() == cache_hash(input) &&
+        r.ok;
+    std::string_view encoded;
+    if(valid)
+    {
+        encoded = r.view(r.count());
+        valid = r.done();
+    }
+    if(!valid)
+    {
+        ++cache_stat.asset_misses;
+        return false;
+    }
+
+    data.insert(data.end(), encoded.begin(), encoded.end());
+    ++cache_stat.asset_hits;
+    return true;
+}
+
+void compiler_t::cache_store_asset(
+    std::string const& key, std::vector<char> const& input,
+    std::vector<uint8_t> const& data, size_t start)
+{
+    if(!cache_enabled())
+        return;
+
+    cache_writer_t w;
+    w.bytes(CACHE_MAGIC_ASSET, 4);
+    w.u32(CACHE_FORMAT);
+    w.str(cache_version);
+    w.str(key);
+    w.u64(input.size());
+    w.u64(cache_hash(input));
+    w.u32(uint32_t(data.size() - start));
+    w.bytes(data.data() + start, data.size() - start);
+    cache_write(cache_file("asset", asset_id(key, input)), std::move(w.d));
+}
+
+// Everything besides the inputs that affects the output of a build.
+static void write_options(cache_writer_t& w, compiler_t const& c)
+{
+    c.for_each_option([&](auto v) { w.u64(uint64_t(v)); });
+    auto const* p = c.loaded_profile();
+    w.u32(p ? (uint32_t)p->lines.size() : 0);
+    if(p)
+    {
+        for(auto const& [file, lines] : p->lines)
+        {
+            w.str(file);
+            w.u32((uint32_t)lines.size());
+            for(auto n : lines)
+                w.u64(uint64_t(n));
+        }
+    }
+}
+
+static void write_build_header(
+    cache_writer_t& w, compiler_t const& c,
+    std::string const& version, std::string const& id)
+{
+    w.bytes(CACHE_MAGIC_BUILD, 4);
+    w.u32(CACHE_FORMAT);
+    w.str(version);
+    w.str(id);
+    write_options(w, c);
+}
+
+static void write_pairs(
+    cache_writer_t& w, std::vector<std::pair<size_t, std::string>> const& v)
+{
+    w.u32((uint32_t)v.size());
+    for(auto const& [offset, label] : v)
+    {
+        w.u32((uint32_t)offset);
+        w.str(label);
+    }
+}
+
+static void read_pairs(
+    cache_reader_t& r, std::vector<std::pair<size_t, std::string>>& v)
+{
+    v.resize(r.count());
+    for(auto& [offset, label] : v)
+    {
+        offset = r.u32();
+        label = r.str();
+    }
+}
+
+bool compiler_t::cache_load_build(std::string const& fpath, std::string const& fname)
+{
+    std::string id = fpath + "/" + fname;
+    std::vector<char> d;
+    if(!cache_read(cache_file("build", id), d))
+        return false;
+
+    cache_writer_t header;
+    write_build_header(header, *this, cache_version, id);
+    cache_reader_t r(d);
+    if(r.view(header.d.size()) != std::string_view(header.d.data(), header.d.size()))
+        return false;
+
+    // the build is reusable only if every input it read is unchanged
+    size_t num_inputs = r.count();
+    for(size_t i = 0; i < num_inputs; ++i)
+    {
+        std::string filename = r.str();
+        uint64_t size = r.u64();
+        uint64_t hash = r.u64();
+        std::vector<char> input;
+        if(!r.ok || !file_loader || !file_loader(filename, input))
+            return false;
+        if(input.size() != size || cache_hash(input) != hash)
+            return false;
+    }
+
+    decltype(funcs) new_funcs;
+    decltype(globals) new_globals;
+    decltype(progdata) new_progdata;
+    decltype(warns) new_warns;
+    decltype(debug_filenames) new_debug_filenames;
+    decltype(arduboy_file_directives) new_directives;
+    std::vector<std::string> global_order;
+
+    int new_shades = (int)r.u32();
+
+    size_t num_directives = r.count();
+    for(size_t i = 0; i < num_directives; ++i)
+    {
+        std::string k = r.str();
+        new_directives[k] = r.str();
+    }
+    if(r.u8())
+        new_directives["date"] = today();
+
+    new_warns.resize(r.count());
+    for(auto& w : new_warns)
+    {
+        w.msg = r.str();
+        w.line_info.first = r.u32();
+        w.line_info.second = r.u32();
+    }
+
+    new_debug_filenames.resize(r.count());
+    for(auto& f : new_debug_filenames)
+        f = r.str();
+
+    global_order.resize(r.count());
+    for(auto& name : global_order)
+    {
+        name = r.str();
+        auto& g = new_globals[name];
+        g.name = name;
+        g.var.type.prim_size = r.u32();
+        g.saved = r.u8() != 0;
+    }
+
+    size_t num_progdata = r.count();
+    for(size_t i = 0; i < num_progdata && r.ok; ++i)
+    {
+        auto& pd = new_progdata[r.str()];
+        pd.offset = r.u32();
+        auto data = r.view(r.count());
+        pd.data.assign(data.begin(), data.end());
+        read_pairs(r, pd.relocs_prog);
+        read_pairs(r, pd.relocs_glob);
+        read_pairs(r, pd.inter_labels);
+    }
+
+    size_t num_funcs = r.count();
+    for(size_t i = 0; i < num_funcs && r.ok; ++i)
+    {
+        std::string name = r.str();
+        auto& f = new_funcs[name];
+        f.name = name;
+        f.filename = r.str();
+        f.instrs.resize(r.count());
+        for(auto& instr : f.instrs)
+        {
+            instr.instr = instr_t(r.u32());
+            instr.line = (uint16_t)r.u32();
+            instr.imm = r.u32();
+            instr.imm2 = r.u32();
+            instr.label = r.str();
+            instr.is_label = r.u8() != 0;
+            instr.file = (uint16_t)r.u32();
+        }
+    }
+
+    if(!r.done())
+        return false;
+
+    funcs = std::move(new_funcs);
+    globals = std::move(new_globals);
+    progdata = std::move(new_progdata);
+    warns = std::move(new_warns);
+    debug_filenames = std::move(new_debug_filenames);
+    arduboy_file_directives = std::move(new_directives);
+    shades = new_shades;
+
+    sorted_globals.clear();
+    for(auto const& name : global_order)
+        sorted_globals.push_back(&globals[name]);
+
+    cache_stat.build_hit = true;
+    return true;
+}
+
+void compiler_t::cache_store_build(std::string const& fpath, std::string const& fname)
+{
+    std::string id = fpath + "/" + fname;
+    cache_writer_t w;
+    write_build_header(w, *this, cache_version, id);
+
+    w.u32((uint32_t)cache_inputs.size());
+    for(auto const& [filename, input] : cache_inputs)
+    {
+        w.str(filename);
+        w.u64(input.first);
+        w.u64(input.second);
+    }
+
+    w.u32((uint32_t)shades);
+
+    // a default date is refreshed when the build is reused
+    std::string date = today();
+    bool default_date = false;
+    w.u32((uint32_t)arduboy_file_directives.size());
+    for(auto const& [k, v] : arduboy_file_directives)
+    {
+        w.str(k);
+        w.str(v);
+        if(k == "date" && v == date)
+            default_date = true;
+    }
+    w.u8(default_date);
+
+    w.u32((uint32_t)warns.size());
+    for(auto const& warn : warns)
+    {
+        w.str(warn.msg);
+        w.u32((uint32_t)warn.line_info.first);
+        w.u32((uint32_t)warn.line_info.second);
+    }
+
+    w.u32((uint32_t)debug_filenames.size());
+    for(auto const& f : debug_filenames)
+        w.str(f);
+
+    // only globals that are emitted, in emission order
+    std::vector<compiler_global_t const*> emitted;
+    for(auto const* g : sorted_globals)
+        if(!(g->is_constexpr_ref() || g->var.is_constexpr || g->var.type.is_prog))
+            emitted.push_back(g);
+    w.u32((uint32_t)emitted.size());
+    for(auto const* g : emitted)
+    {
+        w.str(g->name);
+        w.u32((uint32_t)g->var.type.prim_size);
+        w.u8(g->saved);
+    }
+
+    size_t num_progdata = 0;
+    for(auto const& [label, pd] : progdata)
+        if(!pd.merged)
+            ++num_progdata;
+    w.u32((uint32_t)num_progdata);
+    for(auto const& [label, pd] : progdata)
+    {
+        if(pd.merged)
+            continue;
+        w.str(label);
+        w.u32(pd.offset);
+        w.u32((uint32_t)pd.data.size());
+        w.bytes(pd.data.data(), pd.data.size());
+        write_pairs(w, pd.relocs_prog);
+        write_pairs(w, pd.relocs_glob);
+        write_pairs(w, pd.inter_labels);
+    }
+
+    w.u32((uint32_t)funcs.size());
+    for(auto const& [name, f] : funcs)
+    {
+        w.str(name);
+        w.str(f.filename);
+        w.u32((uint32_t)f.instrs.size());
+        for(auto const& instr : f.instrs)
+        {
+            w.u32(instr.instr);
+            w.u32(instr.line);
+            w.u32(instr.imm);
+            w.u32(instr.imm2);
+            w.str(instr.label.str());
+            w.u8(instr.is_label);
+            w.u32(instr.file);
+        }
+    }
+
+    cache_write(cache_file("build", id), std::move(w.d));
+}
+
+}
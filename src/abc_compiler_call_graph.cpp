@@ -0,0 +1,148 @@
+#include "abc_compiler.hpp"
+
+#include <algorithm>
+
+namespace abc
+{
+
+void compiler_t::unlink_callees(symbol_t name)
+{
+    auto& node = call_graph[name];
+    for(auto const& e : node.callees)
+    {
+        auto it = call_graph.find(e.func);
+        if(it == call_graph.end())
+            continue;
+        auto& callee = it->second;
+        callee.num_refs -= 1;
+        if(e.call)
+            callee.num_calls -= 1;
+        auto cit = callee.callers.find(name);
+        assert(cit != callee.callers.end());
+        if(--cit->second == 0)
+            callee.callers.erase(cit);
+    }
+    node.callees.clear();
+}
+
+void compiler_t::index_callees(symbol_t name, compiler_func_t const& f)
+{
+    unlink_callees(name);
+    auto& node = call_graph[name];
+    node.version = f.version;
+    for(auto const& i : f.instrs)
+    {
+        if(i.is_label || i.label.empty())
+            continue;
+        auto it = call_graph.find(i.label);
+        if(it == call_graph.end())
+            continue;
+        bool call = i.instr == I_CALL;
+        node.callees.push_back({ i.label, call });
+        auto& callee = it->second;
+        callee.num_refs += 1;
+        if(call)
+            callee.num_calls += 1;
+        callee.callers[name] += 1;
+    }
+}
+
+// Re-reads the references of every function changed since it was last
+// indexed. Functions are only removed through remove_function and
+// inline_function, which keep the graph up to date themselves.
+void compiler_t::update_call_graph()
+{
+    for(auto const& [n, f] : funcs)
+        call_graph.try_emplace(n);
+    for(auto const& [n, f] : funcs)
+    {
+        auto const& node = call_graph[n];
+        if(node.version != f.version)
+            index_callees(n, f);
+    }
+}
+
+// Strongly connected components of the call graph (Tarjan's algorithm),
+// returned in reverse topological order: callees before their callers.
+// Functions that can reach themselves are added to 'recursive'.
+std::vector<symbol_t> compiler_t::call_graph_order(
+    std::unordered_set<symbol_t>& recursive)
+{
+    struct visit_t
+    {
+        size_t index;
+        size_t low;
+        bool on_stack;
+    };
+    std::unordered_map<symbol_t, visit_t> visits;
+    std::vector<symbol_t> stack;
+    std::vector<symbol_t> order;
+    order.reserve(call_graph.size());
+
+    std::function<void(symbol_t)> connect = [&](symbol_t v) {
+        auto& vv = visits[v];
+        vv = { visits.size() - 1, visits.size() - 1, true };
+        stack.push_back(v);
+        for(auto const& e : call_graph[v].callees)
+        {
+            if(e.func == v)
+                recursive.insert(v);
+            auto it = visits.find(e.func);
+            if(it == visits.end())
+            {
+                connect(e.func);
+                vv.low = std::min(vv.low, visits[e.func].low);
+            }
+            else if(it->second.on_stack)
+                vv.low = std::min(vv.low, it->second.index);
+        }
+        if(vv.low != vv.index)
+            return;
+        auto begin = std::find(stack.rbegin(), stack.rend(), v).base() - 1;
+        bool cycle = stack.end() - begin > 1;
+        for(auto it = begin; it != stack.end(); ++it)
+        {
+            visits[*it].on_stack = false;
+            if(cycle)
+                recursive.insert(*it);
+            order.push_back(*it);
+        }
+        stack.erase(begin, stack.end());
+    };
+
+    for(auto const& [n, f] : funcs)
+        if(symbol_t s = n; !visits.count(s))
+            connect(s);
+    return order;
+}
+
+// Removes an unreferenced function, along with the functions that were
+// only referenced by it.
+void compiler_t::remove_function(symbol_t func)
+{
+    static symbol_t const main_sym = "main";
+    static symbol_t const globinit_sym = "$globinit";
+    std::vector<symbol_t> dead{ func };
+    while(!dead.empty())
+    {
+        symbol_t f = dead.back();
+        dead.pop_back();
+        auto callees = call_graph[f].callees;
+        unlink_callees(f);
+        call_graph.erase(f);
+        funcs.erase(f);
+        opt_changes += 1;
+        for(auto const& e : callees)
+        {
+            if(e.func == main_sym || e.func == globinit_sym)
+                continue;
+            auto it = call_graph.find(e.func);
+            if(it == call_graph.end() || it->second.num_refs != 0)
+                continue;
+            if(std::find(dead.begin(), dead.end(), e.func) == dead.end())
+                dead.push_back(e.func);
+        }
+    }
+}
+
+}
@@ -162,7 +162,12 @@ void compiler_t::codegen_function(compiler_func_t& f)
 
     frame.push();
 
+    analyze_ranges(f);
+    f.temp = temperature(profile_hits(f, f.block, true));
+    cold_instrs.clear();
     codegen(f, frame, f.block);
+    f.instrs.insert(f.instrs.end(), cold_instrs.begin(), cold_instrs.end());
+    cold_instrs.clear();
 
     // no need to call codegen_return here
     // all function blocks are guaranteed to end with a return statement
@@ -171,10 +176,8 @@ void compiler_t::codegen_function(compiler_func_t& f)
 
 std::string compiler_t::new_label(compiler_func_t& f)
 {
-    std::ostringstream ss;
-    ss << f.label_count;
+    std::string label = "$L_" + f.name + "_" + std::to_string(f.label_count);
     f.label_count += 1;
-    std::string label = "$L_" + f.name + "_" + ss.str();
     return label;
 }
 
@@ -220,10 +223,37 @@ void compiler_t::codegen(compiler_func_t& f, compiler_frame_t& frame, ast_node_t
         codegen_expr(f, frame, a.children[0], false);
         // TODO: unnecessary for a.children[0].comp_type.prim_size == 1
         codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
+        if(size_t cold = out_of_line_branch(f, a))
+        {
+            // the rarely taken branch moves to the end of the function
+            // and the hot path falls through
+            auto cold_label = new_label(f);
+            auto end_label = new_label(f);
+            f.instrs.push_back({ cold == 1 ? I_BNZ : I_BZ, a.line(), 0, 0, cold_label });
+            frame.size -= 1;
+            auto branch = [&](size_t i) {
+                size_t facts = i == 1 ?
+                    push_range_facts(a.children[0], a.children[1], nullptr) : 0;
+                codegen(f, frame, a.children[i]);
+                pop_range_facts(facts);
+            };
+            branch(3 - cold);
+            size_t cold_index = f.instrs.size();
+            codegen_label(f, cold_label);
+            branch(cold);
+            f.instrs.push_back({ I_JMP, a.line(), 0, 0, end_label });
+            cold_instrs.insert(cold_instrs.end(),
+                f.instrs.begin() + cold_index, f.instrs.end());
+            f.instrs.resize(cold_index);
+            codegen_label(f, end_label);
+            break;
+        }
         size_t cond_index = f.instrs.size();
         f.instrs.push_back({ I_BZ, a.line() });
         frame.size -= 1;
+        size_t facts = push_range_facts(a.children[0], a.children[1], nullptr);
         codegen(f, frame, a.children[1]);
+        pop_range_facts(facts);
         size_t jmp_index = f.instrs.size();
         if(a.children[2].type != AST::EMPTY_STMT)
             f.instrs.push_back({ I_JMP, a.line() });
@@ -252,99 +282,7 @@ void compiler_t::codegen(compiler_func_t& f, compiler_frame_t& frame, ast_node_t
         type_annotate(a.children[0], frame);
         if(!is_do_while && a.children[0].type == AST::INT_CONST && a.children[0].value == 0)
             break;
-        bool nocond = (a.children[0].type == AST::INT_CONST && a.children[0].value != 0);
-        std::string end = new_label(f);
-
-        if(!is_do_while && !nocond)
-        {
-            // duplicate codegen for condition
-            codegen_expr(f, frame, a.children[0], false);
-            codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
-            f.instrs.push_back({ I_BZ, a.children[0].line(), 0, 0, end });
-            frame.size -= 1;
-        }
-        std::string start = codegen_label(f);
-        std::string cont = is_for ? new_label(f) : start;
-
-        break_stack.push_back({ end, frame.size });
-        continue_stack.push_back({ cont, frame.size });
-        codegen(f, frame, a.children[1]);
-        if(is_for)
-        {
-            codegen_label(f, cont);
-            codegen(f, frame, a.children[2]);
-        }
-        break_stack.pop_back();
-        continue_stack.pop_back();
-
-        size_t body_instrs = f.instrs.size() - prev_instrs;
-        unroll_info_t u;
-        if(enable_sized_unrolling && is_for && can_unroll_for_loop_sized(a, u) &&
-            u.num * body_instrs <= unroll_sized_max_instrs &&
-            u.num <= unroll_sized_max_iters)
-        {
-            f.instrs.resize(prev_instrs);
-            if(is_for) { frame.pop(); frame.push(); }
-            unroll_loop_sized(a, u, f, frame);
-            break;
-        }
-
-        // TODO: unrolling can defeat/prevent inlining if body contains function call
-
-        // unsized loop unroll
-        if(enable_unsized_unrolling && unroll_unsized_max_iters > 1 &&
-            body_instrs <= unroll_unsized_max_add_instrs)
-        {
-            size_t extra_instrs = body_instrs;
-            for(size_t i = 1; i < unroll_unsized_max_iters; ++i)
-            {
-                if(!nocond)
-                {
-                    codegen_expr(f, frame, a.children[0], false);
-                    codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
-                    f.instrs.push_back({ I_BZ, a.children[0].line(), 0, 0, end });
-                    frame.size -= 1;
-                }
-
-                // TODO: continue defeats unrolling
-
-                break_stack.push_back({ end, frame.size });
-                continue_stack.push_back({ cont, frame.size });
-                codegen(f, frame, a.children[1]);
-                if(is_for)
-                    codegen(f, frame, a.children[2]);
-                break_stack.pop_back();
-                continue_stack.pop_back();
-
-                extra_instrs += body_instrs;
-                if(extra_instrs > unroll_unsized_max_add_instrs)
-                    break;
-            }
-            if(!nocond)
-            {
-                codegen_expr(f, frame, a.children[0], false);
-                codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
-                f.instrs.push_back({ I_BNZ, a.children[0].line(), 0, 0, start });
-                frame.size -= 1;
-            }
-            else
-                f.instrs.push_back({ I_JMP, a.children[0].line(), 0, 0, start });
-            codegen_label(f, end);
-            break;
-        }
-
-        if(!nocond)
-        {
-            codegen_expr(f, frame, a.children[0], false);
-            codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
-            f.instrs.push_back({ I_BNZ, a.children[0].line(), 0, 0, start });
-            frame.size -= 1;
-        }
-        else
-        {
-            f.instrs.push_back({ I_JMP, a.children[0].line(), 0, 0, start });
-        }
-        codegen_label(f, end);
+        codegen_loop_motion(f, frame, a, prev_instrs);
         break;
     }
     case AST::BREAK_STMT:
@@ -438,6 +376,51 @@ void compiler_t::codegen(compiler_func_t& f, compiler_frame_t& frame, ast_node_t
         assert(frame.size == prev_size);
 }
 
+// Whether an 8-bit switch over the given number of case items, some of
+// them ranges, is cheaper as a jump table than as a linear search. Each
+// item is assumed equally likely to match, and so is the default.
+bool compiler_t::switch_jump_table_cheaper(
+    size_t items, size_t ranges, opt_goal_t goal) const
+{
+    compiler_instr_t const single[] = {
+        { I_GETL, 0, 1 }, { I_PUSH, 0, 9 }, { I_SUB }, { I_BOOL } };
+    compiler_instr_t const range[] = {
+        { I_GETL, 0, 1 }, { I_PUSH, 0, 9 }, { I_CULT },
+        { I_PUSH, 0, 10 }, { I_GETL, 0, 2 }, { I_CULT } };
+    compiler_instr_t const table[] = {
+        { I_PUSH, 0, 0 }, { I_PUSH, 0, 3 }, { I_PUSH, 0, 0 }, { I_MUL2 },
+        { I_PUSH, 0, 0 }, { I_PUSHL }, { I_ADD3 }, { I_GETPN, 0, 3 },
+        { I_IJMP } };
+    compiler_instr_t const branch{ I_BZ }, jmp{ I_JMP }, popn{ I_POPN, 0, 1 };
+
+    auto sc = instrs_cost(std::begin(single), std::end(single));
+    auto rc = instrs_cost(std::begin(range), std::end(range));
+    auto rc_below = instrs_cost(std::begin(range), std::begin(range) + 3);
+    uint64_t taken = instr_time(I_BZ, 1);
+    uint64_t not_taken = instr_time(I_BZ, 0);
+    uint64_t fail_single = sc.time + not_taken;
+    uint64_t hit_single = sc.time + taken;
+    uint64_t fail_range = (rc_below.time + taken + rc.time + not_taken * 2) / 2;
+    uint64_t hit_range = rc.time + not_taken + taken;
+
+    // item i is reached after the i items before it fail
+    uint64_t n = items;
+    uint64_t fails = (n - ranges) * fail_single + ranges * fail_range;
+    uint64_t hits = (n - ranges) * hit_single + ranges * hit_range;
+    compiler_cost_t linear;
+    linear.time =
+        (fails * (n - 1) / 2 + hits + fails + instr_time(I_JMP)) / (n + 1) +
+        instr_time(I_POPN);
+    linear.bytes =
+        (n - ranges) * (sc.bytes + instr_bytes(branch)) +
+        ranges * (rc.bytes + instr_bytes(branch) * 2) +
+        instr_bytes(jmp) + instr_bytes(popn);
+
+    auto tc = instrs_cost(std::begin(table), std::end(table));
+    tc.bytes += 256 * 3;
+    return cheaper(tc, linear, goal);
+}
+
 void compiler_t::codegen_switch(
     compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a)
 {
@@ -546,6 +529,7 @@ void compiler_t::codegen_switch(
     std::vector<std::string> case_labels;
     int64_t rmin, rmax;
     bool is_jump_table = false;
+    opt_goal_t goal = goal_at(f, a);
 
     if(ranges.empty())
         goto pop_expr;
@@ -565,9 +549,13 @@ void compiler_t::codegen_switch(
         default_label = end_label;
 
     is_jump_table = expr_type.prim_size == 1 &&
-        ranges.size() >= switch_min_ranges_for_jump_table && (
+        (goal == OPT_GOAL_SIZE ||
+        ranges.size() >= switch_min_ranges_for_jump_table) && (
         !expr_type.is_signed && rmin >= 0 && rmax <= 255 ||
-        expr_type.is_signed && rmin >= -128 && rmax <= 127);
+        expr_type.is_signed && rmin >= -128 && rmax <= 127) &&
+        switch_jump_table_cheaper(ranges.size(), size_t(
+            std::count_if(ranges.begin(), ranges.end(),
+                [](range_t const& r) { return r.a != r.b; })), goal);
 
     // 8-bit jump table logic
     if(is_jump_table)
@@ -15,27 +15,6 @@ static bool is_constant(ast_node_t const& n)
         n.type == AST::FLOAT_CONST && n.fvalue == double(C);
 }
 
-static bool is_power_of_two(int64_t x)
-{
-    if(x <= 0) return false;
-    return ((uint32_t)x & (uint32_t)(x - 1)) == 0;
-}
-
-static bool is_power_of_two(ast_node_t const& n)
-{
-    return n.type == AST::INT_CONST && is_power_of_two(n.value);
-}
-
-static uint8_t get_pow2_shift(int64_t x)
-{
-    if(x == 0) return 0;
-    uint8_t n = 0;
-    uint32_t t = (uint32_t)x;
-    while(!(t & 1))
-        t >>= 1, ++n;
-    return n;
-}
-
 bool compiler_t::is_simple_lvalue(ast_node_t const& n, compiler_frame_t const& frame)
 {
     if(n.type == AST::IDENT)
@@ -240,6 +219,9 @@ void compiler_t::codegen_expr(
             a.line_info });
     }
     if(!errs.empty()) return;
+    if(!ref && a.type != AST::ARRAY_INDEX && !loop_motion.empty() &&
+        codegen_loop_value(f, frame, a, nullptr))
+        return;
     switch(a.type)
     {
 
@@ -955,38 +937,8 @@ no_memcpy_optimization:
             return;
         }
 
-        // convert division into right shift
-        if(a.data == "/" && !a.comp_type.is_float &&
-            a.comp_type.prim_size != 3 && !a.comp_type.is_signed &&
-            is_power_of_two(a.children[1]))
-        {
-            uint8_t shift = get_pow2_shift(a.children[1].value);
-            instr_t ti = I_LSR;
-            if(a.comp_type.prim_size == 2) ti = I_LSR2;
-            if(a.comp_type.prim_size == 4) ti = I_LSR4;
-            codegen_expr(f, frame, a.children[0], false);
-            codegen_convert(f, frame, a, a.comp_type, a.children[0].comp_type);
-            f.instrs.push_back({ I_PUSH, a.children[1].line(), shift });
-            f.instrs.push_back({ ti, a.line() });
+        if(codegen_const_multiplicative(f, frame, a))
             return;
-        }
-
-        // convert modulo into bitwise AND
-        if(a.data == "%" && !a.comp_type.is_float &&
-            a.comp_type.prim_size != 3 && !a.comp_type.is_signed &&
-            is_power_of_two(a.children[1]))
-        {
-            uint32_t mask = uint32_t(a.children[1].value - 1);
-            instr_t ti = I_AND;
-            if(a.comp_type.prim_size == 2) ti = I_AND2;
-            if(a.comp_type.prim_size == 4) ti = I_AND4;
-            codegen_expr(f, frame, a.children[0], false);
-            codegen_convert(f, frame, a, a.comp_type, a.children[0].comp_type);
-            for(size_t i = 0; i < a.comp_type.prim_size; ++i)
-                f.instrs.push_back({ I_PUSH, a.children[1].line(), uint8_t(mask >> (i * 8)) });
-            f.instrs.push_back({ ti, a.line() });
-            return;
-        }
 
         c0 = a.data == "*" && is_constant<1>(a.children[0]);
         c1 = is_constant<1>(a.children[1]);
@@ -1532,6 +1484,9 @@ void compiler_t::codegen_expr_array_index(
         return;
     }
 
+    if(!loop_motion.empty() && codegen_loop_value(f, frame, a, &offset))
+        return;
+
     auto const& t = a.children[0].comp_type.without_ref();
     bool prog = t.is_array_ref() ? t.children[0].is_prog : t.is_prog;
     size_t elem_size = t.children[0].prim_size;
@@ -1576,6 +1531,31 @@ void compiler_t::codegen_expr_array_index(
 
     // construct index
     codegen_expr(f, frame, a.children[1], false);
+
+    // skip the bounds check when range analysis proves the index valid
+    size_t num_elems = t.is_array_ref() ? 0 : t.prim_size / elem_size;
+    if(num_elems != 0 && index_in_bounds(a.children[1], num_elems))
+    {
+        if(elem_size == 1)
+        {
+            codegen_convert(
+                f, frame, a,
+                prog ? TYPE_U24 : TYPE_U16,
+                a.children[1].comp_type);
+            f.instrs.push_back({ prog ? I_ADD3 : I_ADD2, a.line() });
+            frame.size -= prog ? 3 : 2;
+            return;
+        }
+        if(num_elems <= 256 && elem_size < 256)
+        {
+            codegen_convert(f, frame, a, TYPE_U8, a.children[1].comp_type);
+            f.instrs.push_back({
+                prog ? I_PIXB : I_AIXB, a.line(), (uint16_t)elem_size });
+            frame.size -= 1;
+            return;
+        }
+    }
+
     codegen_convert(
         f, frame, a,
         prog ? TYPE_U24 : TYPE_U16,
@@ -1590,8 +1570,6 @@ void compiler_t::codegen_expr_array_index(
     }
     else
     {
-        size_t size = t.prim_size;
-        size_t num_elems = size / elem_size;
         f.instrs.push_back({
             prog ? I_PIDX : I_AIDX, a.line(),
             (uint16_t)elem_size, (uint32_t)num_elems });
@@ -0,0 +1,300 @@
+#include "abc_compiler.hpp"
+
+#include <algorithm>
+
+#include <assert.h>
+
+namespace abc
+{
+
+// Strength reduction of multiplication, division and modulo by constants.
+//
+// Division and modulo call into abc_div.S on the Arduboy VM and take
+// between 110 and 700 cycles. With a constant divisor they become:
+//
+//   - shifts and masks for powers of two, with a bias that rounds signed
+//     quotients toward zero;
+//   - for other divisors, a multiplication by a scaled reciprocal when
+//     the dividend is known to fit in 16 bits, so that the product fits
+//     in the 32 bits MUL4 keeps (the VM has no multiply-high).
+//
+// Multiplication by a power of two becomes a shift.
+//
+// A replacement is emitted only if the cost model rates it cheaper than
+// the instructions it replaces.
+
+static instr_t div_instr(int n, bool is_signed, bool mod)
+{
+    static_assert(I_UDIV4 == I_UDIV2 + 1);
+    static_assert(I_DIV2 == I_UDIV2 + 2);
+    static_assert(I_UMOD2 == I_UDIV2 + 4);
+    return instr_t(I_UDIV2 + (n == 4 ? 1 : 0) + (is_signed ? 2 : 0) + (mod ? 4 : 0));
+}
+
+static int bit_width(uint32_t x)
+{
+    int n = 0;
+    for(; x != 0; x >>= 1)
+        ++n;
+    return n;
+}
+
+static void push_const(
+    std::vector<compiler_instr_t>& seq, uint16_t line, uint32_t x, int n)
+{
+    for(int i = 0; i < n; ++i)
+        seq.push_back({ I_PUSH, line, uint8_t(x >> (i * 8)) });
+}
+
+static instr_t sized_instr(instr_t i, int n)
+{
+    static_assert(I_AND2 == I_AND + 1);
+    static_assert(I_AND4 == I_AND + 2);
+    static_assert(I_LSL2 == I_LSL + 1);
+    static_assert(I_LSL4 == I_LSL + 2);
+    static_assert(I_LSR2 == I_LSR + 1);
+    static_assert(I_LSR4 == I_LSR + 2);
+    static_assert(I_ASR2 == I_ASR + 1);
+    static_assert(I_ASR4 == I_ASR + 2);
+    return instr_t(i + (n == 1 ? 0 : n == 2 ? 1 : 2));
+}
+
+// x / 2^k and x % 2^k for signed x of n bytes on the stack:
+//     bias = (x >> (8n-1)) & (2^k-1)
+//     x / 2^k = (x + bias) >> k
+//     x % 2^k = x - ((x + bias) & ~(2^k-1))
+static void signed_pow2(
+    std::vector<compiler_instr_t>& seq, uint16_t line, int n, int k, bool mod)
+{
+    uint32_t mask = (uint32_t(1) << k) - 1;
+    if(mod)
+        seq.push_back(n == 2 ?
+            compiler_instr_t{ I_DUPW, line } :
+            compiler_instr_t{ I_GETL4, line, 4 });
+    seq.push_back({ I_DUP, line });
+    seq.push_back({ I_PUSH, line, 7 });
+    seq.push_back({ I_ASR, line });
+    if(k <= 8)
+    {
+        if(k < 8)
+        {
+            seq.push_back({ I_PUSH, line, mask });
+            seq.push_back({ I_AND, line });
+        }
+        if(n == 2)
+            seq.push_back({ I_ADD2B, line });
+        else
+        {
+            push_const(seq, line, 0, 3);
+            seq.push_back({ I_ADD4, line });
+        }
+    }
+    else
+    {
+        static_assert(I_SEXT3 == I_SEXT + 2);
+        seq.push_back({ instr_t(I_SEXT + n - 2), line });
+        push_const(seq, line, mask, n);
+        seq.push_back({ sized_instr(I_AND, n), line });
+        seq.push_back({ n == 2 ? I_ADD2 : I_ADD4, line });
+    }
+    if(mod)
+    {
+        push_const(seq, line, ~mask, n);
+        seq.push_back({ sized_instr(I_AND, n), line });
+        seq.push_back({ n == 2 ? I_SUB2 : I_SUB4, line });
+    }
+    else
+    {
+        seq.push_back({ I_PUSH, line, uint32_t(k) });
+        seq.push_back({ sized_instr(I_ASR, n), line });
+    }
+}
+
+// x / d for unsigned x < 2^bits held in w bytes, as (x * m) >> s in
+// 16- or 32-bit arithmetic. The quotient is exact when
+//     2^s <= m * d <= 2^s + 2^(s-bits)
+// (Granlund and Montgomery), and the product must not overflow.
+// Whole low bytes of the product are dropped by storing the high half
+// over them. Returns the width of the quotient, or 0 if no (m, s) fits.
+template<class F>
+static int reciprocal(
+    std::vector<compiler_instr_t>& seq, uint16_t line, uint32_t d, int bits, int w,
+    F const& cheaper)
+{
+    int best_w = 0;
+    std::vector<compiler_instr_t> t;
+    for(int pw = std::max(w, 2); pw <= 4; pw += 2)
+    {
+        for(int s = 0; s < pw * 8; ++s)
+        {
+            uint64_t p = uint64_t(1) << s;
+            uint64_t m = (p + d - 1) / d;
+            if(((m * d - p) << bits) > p)
+                continue;
+            if((((uint64_t(1) << bits) - 1) * m) >> (pw * 8) != 0)
+                break;
+            t.clear();
+            push_const(t, line, 0, pw - w);
+            push_const(t, line, uint32_t(m), pw);
+            t.push_back({ pw == 2 ? I_MUL2 : I_MUL4, line });
+            int tw = pw;
+            int ts = s;
+            if(tw == 4 && ts >= 16)
+            {
+                t.push_back({ I_SETL2, line, 2 });
+                tw = 2, ts -= 16;
+            }
+            if(tw == 2 && ts >= 8)
+            {
+                t.push_back({ I_SETL, line, 1 });
+                tw = 1, ts -= 8;
+            }
+            if(ts > 0)
+            {
+                t.push_back({ I_PUSH, line, uint32_t(ts) });
+                t.push_back({ sized_instr(I_LSR, tw), line });
+            }
+            if(best_w == 0 || cheaper(t, seq))
+            {
+                best_w = tw;
+                seq = t;
+            }
+        }
+    }
+    return best_w;
+}
+
+static compiler_type_t unsigned_type(int w)
+{
+    return w == 1 ? TYPE_U8 : w == 2 ? TYPE_U16 : TYPE_U32;
+}
+
+// the operand of a division (or the node beneath its widening casts)
+// when its value is known to be nonnegative, and its width
+static ast_node_t const* unsigned_operand(
+    ast_node_t const& x, compiler_type_t const& t, int& w)
+{
+    ast_node_t const* r = nullptr;
+    for(auto* y = &x; y->type == AST::OP_CAST; )
+    {
+        auto const& yt = y->comp_type.without_ref();
+        y = &y->children[1];
+        auto const& ct = y->comp_type.without_ref();
+        if(!ct.is_prim() || ct.is_float || ct.is_signed || ct.is_byte ||
+            ct.prim_size >= yt.prim_size)
+            break;
+        if(ct.prim_size != 3)
+        {
+            w = int(ct.prim_size);
+            r = y;
+        }
+    }
+    if(r || t.is_signed)
+        return r;
+    w = int(t.prim_size);
+    return &x;
+}
+
+bool compiler_t::codegen_const_multiplicative(
+    compiler_func_t& f, compiler_frame_t& frame, ast_node_t const& a)
+{
+    auto const& t = a.comp_type;
+    if(t.is_float || (t.prim_size != 2 && t.prim_size != 4))
+        return false;
+
+    int n = int(t.prim_size);
+    bool mul = a.data == "*";
+    int ci = mul && a.children[0].type == AST::INT_CONST ? 0 : 1;
+    auto const& c = a.children[ci];
+    if(c.type != AST::INT_CONST || c.value <= 1)
+        return false;
+    uint32_t d = uint32_t(c.value);
+    bool pow2 = (d & (d - 1)) == 0;
+    int k = bit_width(d) - 1;
+    auto line = a.line();
+
+    ast_node_t const* x = &a.children[1 - ci];
+    int w = n;      // width of x as generated
+    int rw = n;     // width of the result of seq
+    std::vector<compiler_instr_t> seq, alt;
+    auto goal = goal_at(f, a);
+
+    // alt followed by the division it feeds
+    auto div_cost = [&](std::vector<compiler_instr_t> const& alt,
+        instr_t instr, int nbits, int dbits) {
+        auto c = instrs_cost(alt);
+        c.time += div_time(instr, nbits, dbits);
+        c.bytes += 1;
+        return c;
+    };
+
+    if(mul)
+    {
+        if(!pow2)
+            return false;
+        seq.push_back({ I_PUSH, line, uint32_t(k) });
+        seq.push_back({ sized_instr(I_LSL, n), line });
+        push_const(alt, line, d, n);
+        alt.push_back({ n == 2 ? I_MUL2 : I_MUL4, line });
+        if(!cheaper(instrs_cost(seq), instrs_cost(alt), goal))
+            return false;
+    }
+    else if(auto* y = unsigned_operand(*x, t, w))
+    {
+        x = y;
+        rw = w;
+        if(pow2 && a.data == "/")
+        {
+            // shifting a narrower operand is cheaper and leaves the
+            // quotient at the same width
+            seq.push_back({ I_PUSH, line, uint32_t(k) });
+            seq.push_back({ sized_instr(I_LSR, w), line });
+        }
+        else if(pow2)
+        {
+            if(k < w * 8)
+            {
+                push_const(seq, line, d - 1, w);
+                seq.push_back({ sized_instr(I_AND, w), line });
+            }
+        }
+        else if(a.data == "/" && w <= 2)
+        {
+            // the remainder would need the quotient multiplied back and
+            // subtracted, which never beats UMOD2
+            rw = reciprocal(seq, line, d, w * 8, w,
+                [&](std::vector<compiler_instr_t> const& x,
+                    std::vector<compiler_instr_t> const& y) {
+                    return cheaper(instrs_cost(x), instrs_cost(y), goal); });
+            if(rw == 0)
+                return false;
+            push_const(alt, line, 0, n - w);
+            push_const(alt, line, d, n);
+            if(!cheaper(instrs_cost(seq), div_cost(alt,
+                div_instr(n, t.is_signed, false), w * 8, k + 1), goal))
+                return false;
+        }
+        else
+            return false;
+    }
+    else if(pow2 && k < n * 8 - 1)
+    {
+        signed_pow2(seq, line, n, k, a.data == "%");
+        push_const(alt, line, d, n);
+        if(!cheaper(instrs_cost(seq), div_cost(alt,
+            div_instr(n, true, a.data == "%"), n * 8 - 1, k + 1), goal))
+            return false;
+    }
+    else
+        return false;
+
+    codegen_expr(f, frame, *x, false);
+    codegen_convert(f, frame, a, w == n ? t : unsigned_type(w), x->comp_type);
+    for(auto const& i : seq)
+        f.instrs.push_back(i);
+    frame.size += rw - w;
+    codegen_convert(f, frame, a, t, rw == n ? t : unsigned_type(rw));
+    return true;
+}
+
+}
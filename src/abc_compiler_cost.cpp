@@ -0,0 +1,177 @@
+#include "abc_compiler.hpp"
+
+#include <algorithm>
+#include <array>
+
+#include <assert.h>
+
+namespace abc
+{
+
+// Cost model for optimizer decisions.
+//
+// Instruction times come from abc_instr_costs.hpp, which the benchmark
+// harness generates for each VM. Where an instruction's time depends on
+// its argument (shift count, byte count, quotient width or branch
+// direction) it is interpolated between the measured arguments, which
+// include both ends of every linear segment.
+
+struct instr_cost_t
+{
+    instr_t instr;
+    int arg;
+    uint32_t cost[NUM_COST_VMS];
+};
+
+#include "abc_instr_costs.hpp"
+
+static constexpr size_t NUM_COST_INSTRS = I_PUSH3 + 1;
+
+// rows of INSTR_COSTS for each instruction, ordered by argument
+using cost_rows_t = std::vector<instr_cost_t const*>;
+static std::array<cost_rows_t, NUM_COST_INSTRS> const& cost_rows()
+{
+    static auto const rows = []() {
+        std::array<cost_rows_t, NUM_COST_INSTRS> r;
+        for(auto const& c : INSTR_COSTS)
+            r[c.instr].push_back(&c);
+        for(auto& v : r)
+            std::stable_sort(v.begin(), v.end(),
+                [](instr_cost_t const* a, instr_cost_t const* b) {
+                    return a->arg < b->arg; });
+        return r;
+    }();
+    return rows;
+}
+
+// instructions the benchmarks do not measure separately
+static instr_t cost_alias(instr_t i)
+{
+    switch(i)
+    {
+    case I_PUSHG: return I_PUSH2;
+    case I_PUSHL: return I_PUSH3;
+    case I_IJMP:  return I_JMP;
+    default:      return i;
+    }
+}
+
+uint32_t compiler_t::instr_time(instr_t instr, int arg) const
+{
+    assert(size_t(instr) < NUM_COST_INSTRS);
+    auto const& all = cost_rows();
+    auto const* rows = &all[cost_alias(instr)];
+    if(rows->empty())
+        rows = &all[I_NOP];
+    auto const& r = *rows;
+    auto cost = [&](size_t i) { return int64_t(r[i]->cost[cost_vm]); };
+
+    if(arg < 0 || r.front()->arg < 0)
+    {
+        int64_t sum = 0;
+        for(size_t i = 0; i < r.size(); ++i)
+            sum += cost(i);
+        return uint32_t(sum / int64_t(r.size()));
+    }
+
+    if(arg <= r.front()->arg)
+        return uint32_t(cost(0));
+    for(size_t i = 1; i < r.size(); ++i)
+    {
+        int a0 = r[i - 1]->arg;
+        int a1 = r[i]->arg;
+        if(arg > a1)
+            continue;
+        int64_t c0 = cost(i - 1);
+        int64_t c1 = cost(i);
+        return uint32_t(c0 + (c1 - c0) * (arg - a0) / (a1 - a0));
+    }
+    return uint32_t(cost(r.size() - 1));
+}
+
+// __udivmodsi4 falls back to __udivmodhi4 when both operands fit in
+// 16 bits, which the 32-bit measurements do not cover
+uint32_t compiler_t::div_time(instr_t instr, int nbits, int dbits) const
+{
+    static_assert(I_UDIV4 == I_UDIV2 + 1);
+    static_assert(I_MOD4 == I_UDIV2 + 7);
+    assert(instr >= I_UDIV2 && instr <= I_MOD4);
+    int q = std::max(nbits - dbits + 1, 0);
+    bool wide = (instr - I_UDIV2) % 2 != 0;
+    if(cost_vm == COST_VM_ARDUBOY && wide && nbits <= 16 && dbits <= 16)
+        return instr_time(instr_t(instr - 1), q) + 30;
+    return instr_time(instr, q);
+}
+
+static int cost_arg(compiler_instr_t const& i, int pushed)
+{
+    switch(i.instr)
+    {
+    case I_LSL: case I_LSL2: case I_LSL4:
+    case I_LSR: case I_LSR2: case I_LSR4:
+    case I_ASR: case I_ASR2: case I_ASR4:
+        return pushed;
+    case I_GETLN:
+    case I_SETLN:
+    case I_GETGN:
+    case I_SETGN:
+    case I_GETPN:
+    case I_GETRN:
+    case I_SETRN:
+        return int(i.imm);
+    default:
+        return -1;
+    }
+}
+
+// Runs of PUSHs are costed as push_compression and the PUSH 0; MUL2
+// peephole will leave them.
+compiler_cost_t compiler_t::instrs_cost(
+    compiler_instr_t const* b, compiler_instr_t const* e) const
+{
+    compiler_cost_t c{};
+    std::vector<compiler_instr_t> pushes, pi;
+    auto add = [&](compiler_instr_t const& i, int arg) {
+        c.time += instr_time(i.instr, arg);
+        c.bytes += instr_bytes(i);
+    };
+    auto flush = [&]() {
+        pi.clear();
+        if(!pushes.empty())
+            push_compression(pi, pushes.data(), pushes.data(), pushes.size());
+        for(auto const& i : pi)
+            add(i, -1);
+        pushes.clear();
+    };
+    for(auto const* p = b; p != e; ++p)
+    {
+        auto i = *p;
+        if(i.is_label || i.instr == I_REMOVE)
+            continue;
+        if(i.instr == I_PUSH)
+        {
+            pushes.push_back(i);
+            continue;
+        }
+        int pushed = pushes.empty() ? -1 : int(uint8_t(pushes.back().imm));
+        if(i.instr == I_MUL2 && pushed == 0)
+        {
+            pushes.pop_back();
+            i.instr = I_MUL2B;
+        }
+        flush();
+        add(i, cost_arg(i, pushed));
+    }
+    flush();
+    return c;
+}
+
+bool compiler_t::cheaper(
+    compiler_cost_t const& a, compiler_cost_t const& b, opt_goal_t goal) const
+{
+    if(goal == OPT_GOAL_SIZE)
+        return a.bytes < b.bytes || (a.bytes == b.bytes && a.time < b.time);
+    return a.time < b.time || (a.time == b.time && a.bytes < b.bytes);
+}
+
+}
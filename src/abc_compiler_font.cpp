@@ -57,7 +57,14 @@ void compiler_t::encode_font(std::vector<uint8_t>& data, ast_node_t const& n)
         }
     }
 
+    std::string key = "font " + std::to_string(n.children[0].value);
+    if(cache_load_asset(key, d, data))
+        return;
+    size_t start = data.size();
+    size_t num_errs = errs.size();
     encode_font_ttf(data, n, (uint8_t const*)d.data(), d.size());
+    if(errs.size() == num_errs)
+        cache_store_asset(key, d, data, start);
 }
 
 void compiler_t::encode_font_ttf(
@@ -0,0 +1,104 @@
+#include "abc_compiler.hpp"
+
+#include <algorithm>
+
+namespace abc
+{
+
+// Global placement.
+//
+// The assembler shortens GETG/GETG2/GETG4 to GTGB/GTGB2/GTGB4, with a
+// 1-byte address, when the accessed byte lies in the first 256 bytes of
+// globals. Globals are therefore ordered by how often they are read per
+// byte of their size, so that the most read ones land there and large,
+// rarely read arrays are pushed to higher addresses. Reads are weighted
+// by the profile where it covers their line, and otherwise by the depth
+// of the loops around them.
+
+static constexpr size_t MAX_LOOP_WEIGHT_DEPTH = 4;
+static constexpr uint64_t LOOP_WEIGHT = 8;
+
+static auto tie_var(compiler_global_t const* v)
+{
+    return std::tie(v->var.type.prim_size, v->name);
+}
+
+static bool is_branch(instr_t i)
+{
+    return i == I_JMP || i == I_BZ || i == I_BNZ || i == I_BZP || i == I_BNZP;
+}
+
+void compiler_t::place_globals()
+{
+    sorted_globals.clear();
+    for(auto const& [name, global] : globals)
+        sorted_globals.push_back(&global);
+
+    std::unordered_map<std::string, uint64_t> reads;
+    if(enable_global_placement)
+    {
+        std::unordered_map<symbol_t, size_t> labels;
+        std::vector<int> depth;
+        for(auto const& [name, f] : funcs)
+        {
+            // every backward branch closes a loop over the code it jumps back over
+            auto const& instrs = f.instrs;
+            labels.clear();
+            depth.assign(instrs.size() + 1, 0);
+            for(size_t i = 0; i < instrs.size(); ++i)
+            {
+                auto const& instr = instrs[i];
+                if(instr.is_label)
+                {
+                    labels[instr.label] = i;
+                    continue;
+                }
+                if(!is_branch(instr.instr))
+                    continue;
+                auto it = labels.find(instr.label);
+                if(it == labels.end())
+                    continue;
+                depth[it->second] += 1;
+                depth[i + 1] -= 1;
+            }
+
+            int d = 0;
+            for(size_t i = 0; i < instrs.size(); ++i)
+            {
+                d += depth[i];
+                auto const& instr = instrs[i];
+                if(instr.is_label || instr.imm >= 256 || (
+                    instr.instr != I_GETG &&
+                    instr.instr != I_GETG2 &&
+                    instr.instr != I_GETG4))
+                    continue;
+                uint64_t w = 1;
+                for(int j = 0; j < d && j < (int)MAX_LOOP_WEIGHT_DEPTH; ++j)
+                    w *= LOOP_WEIGHT;
+                if(instr.file != 0 && instr.file <= debug_filenames.size())
+                {
+                    auto const* lines = profile_lines(debug_filenames[instr.file - 1]);
+                    if(lines && instr.line < lines->size() && (*lines)[instr.line] >= 0)
+                        w = uint64_t((*lines)[instr.line]);
+                }
+                reads[instr.label] += w;
+            }
+        }
+    }
+
+    // most reads per byte first, then ascending size
+    auto weight = [&](compiler_global_t const* g) {
+        auto it = reads.find(g->name);
+        return it == reads.end() ? 0 : it->second;
+    };
+    std::sort(sorted_globals.begin(), sorted_globals.end(),
+        [&](compiler_global_t const* a, compiler_global_t const* b) {
+            uint64_t wa = weight(a) * std::max<size_t>(b->var.type.prim_size, 1);
+            uint64_t wb = weight(b) * std::max<size_t>(a->var.type.prim_size, 1);
+            if(wa != wb)
+                return wa > wb;
+            return tie_var(a) < tie_var(b);
+    });
+}
+
+}
@@ -120,6 +120,7 @@ std::pair<bool, uint32_t> compiler_t::instr_accesses_stack(
     case I_GETPN:
     case I_AIXB1:
     case I_AIDXB:
+    case I_AIXB:
         return { off <= 3, 3 };
     case I_POP4:
     case I_ADD2:
@@ -142,6 +143,7 @@ std::pair<bool, uint32_t> compiler_t::instr_accesses_stack(
     case I_CULT2:
     case I_CSLT2:
     case I_AIDX:
+    case I_PIXB:
     case I_PIDXB:
     case I_SETG4:
         return { off <= 4, 4 };
@@ -418,6 +420,8 @@ int compiler_t::instr_stack_mod(compiler_instr_t const& i)
     case I_PDEC:
     case I_AIDXB:
     case I_AIXB1:
+    case I_AIXB:
+    case I_PIXB:
     case I_PIDXB:
     case I_SETL:
         return -1;
@@ -521,5 +525,72 @@ int compiler_t::instr_stack_mod(compiler_instr_t const& i)
         return 0;
     }
 }
-    
+
+uint32_t compiler_t::instr_bytes(compiler_instr_t const& i)
+{
+    if(i.is_label)
+        return 0;
+    switch(i.instr)
+    {
+    case I_REMOVE:
+        return 0;
+    case I_PUSH:
+    case I_GETL:
+    case I_GETL2:
+    case I_GETL4:
+    case I_SETL:
+    case I_SETL2:
+    case I_SETL4:
+    case I_GETPN:
+    case I_GETRN:
+    case I_SETRN:
+    case I_POPN:
+    case I_ALLOC:
+    case I_AIXB1:
+    case I_AIXB:
+    case I_PIXB:
+    case I_REFL:
+    case I_LINC:
+    case I_SYS:
+        return 2;
+    case I_PUSHG:
+        // REFGB when the global lies in the first 256 bytes, but globals
+        // are not placed yet
+    case I_GETG:
+    case I_GETG2:
+    case I_GETG4:
+    case I_SETG:
+    case I_SETG2:
+    case I_SETG4:
+    case I_UAIDX:
+    case I_UPIDX:
+    case I_ASLC:
+    case I_PSLC:
+    case I_PUSH2:
+    case I_GETLN:
+    case I_SETLN:
+    case I_AIDXB:
+    case I_PIDXB:
+        return 3;
+    case I_GETGN:
+    case I_SETGN:
+    case I_PUSHL:
+    case I_PUSH3:
+    case I_BZ:
+    case I_BNZ:
+    case I_BZP:
+    case I_BNZP:
+    case I_JMP:
+    case I_CALL:
+        return 4;
+    case I_PUSH4:
+    case I_AIDX:
+        return 5;
+    case I_PIDX:
+        return 6;
+    default:
+        return 1;
+    }
+}
+
 }
@@ -0,0 +1,1494 @@
+#include "abc_compiler.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+namespace abc
+{
+
+// Function-level IR for the first optimization loop (OPT_IR).
+//
+// A function is split into basic blocks, and each block is lifted to a
+// list of ops over byte values. The stack is tracked symbolically: each
+// slot holds a value id, so the copies and stores codegen emits for
+// locals (GETLN, SETLN, DUP, POPN, ...) move ids around instead of
+// becoming ops. That is the copy propagation. Pure ops whose operands
+// are all known are folded, and a pure op with the same operands as an
+// earlier one whose result is still on the stack reuses that result.
+//
+// Across blocks, a forward dataflow finds the slots that hold the same
+// constant on every path into a block, ignoring branches whose condition
+// is known. A backward liveness pass then marks the ops whose results
+// reach a live slot, a branch or an op with side effects; the rest are
+// dead.
+//
+// Each block is lowered back to stack code by a simple scheduler. Live
+// ops are emitted in their original order. Operands already on top of
+// the stack are consumed in place; others are copied up with GETLN or
+// pushed. Dead bytes are popped once they reach the top, and at the end
+// of the block the stack is reshaped into the layout its successors
+// read. A lowered block replaces the original only if the cost model
+// prefers it, and it never uses more stack than the original.
+//
+// In functions that take the address of a local, locals can be read and
+// written through references. There, every op that does so, or calls
+// out, is a barrier: the stack is reshaped to the exact symbolic layout
+// before it, and afterwards every slot holds a new unknown value if the
+// op may store. All slots are live at block boundaries.
+
+namespace
+{
+
+// undefined (ALLOC) byte, or a slot that nothing reads
+uint32_t const IR_ANY = UINT32_MAX;
+
+enum ir_kind_t : uint8_t
+{
+    IR_CONST,  // known byte
+    IR_SLOT,   // what a slot held on entry to the block or after a barrier
+    IR_RESULT, // byte of the result of an op
+};
+
+struct ir_value_t
+{
+    ir_kind_t kind;
+    bool known = false; // IR_CONST, or a slot with one constant on every path in
+    bool entry = false; // IR_SLOT on entry to the block
+    uint8_t c = 0;
+    uint32_t pos = 0;   // IR_SLOT
+    uint32_t op = 0;    // IR_RESULT
+};
+
+enum ir_class_t : uint8_t
+{
+    IR_NONE,   // not supported: the function is left alone
+    IR_PURE,   // may be folded, shared or removed
+    IR_LOAD,   // reads memory: may be removed, but is not shared
+    IR_EFFECT, // always kept
+};
+
+// stack bytes an instruction pops and pushes
+struct ir_shape_t
+{
+    uint32_t args;
+    uint32_t results;
+};
+
+struct ir_op_t
+{
+    compiler_instr_t instr; // for REFL, imm is the slot
+    ir_class_t cls;
+    bool barrier;
+    bool linc;   // INC of a slot, from LINC
+    bool live;
+    uint32_t depth; // stack size before the op
+    uint32_t floor; // least stack size from after the op to the block end
+    std::vector<uint32_t> args;    // bottom to top
+    std::vector<uint32_t> results; // bottom to top
+    std::vector<uint32_t> layout;  // barrier: the stack before the op
+    std::vector<uint32_t> fresh;   // barrier that may store: slots after it
+    std::vector<uint32_t> frame;   // REFL: the stack up to the slot
+};
+
+struct ir_edge_t
+{
+    size_t to;
+    bool keep_cond; // taken BZP/BNZP: the condition stays on the stack
+};
+
+// slot with different values on different paths into a block
+int const IR_NAC = -1;
+
+struct ir_block_t
+{
+    size_t begin; // first instruction, labels included
+    size_t body;  // first instruction after the labels
+    size_t end;
+    int depth = -1; // stack size on entry; -1 until reached
+    std::vector<int> in; // per slot: IR_NAC or a known byte
+    bool kept = false;   // original code stays: it may read any slot
+    std::vector<bool> live_in;
+    std::vector<bool> live_out;
+
+    // lifted with the final entry constants
+    std::vector<ir_value_t> vals;
+    std::vector<ir_op_t> ops;
+    std::vector<uint32_t> exit; // stack at the end, without a branch condition
+    uint32_t cond;
+    compiler_instr_t const* term; // nullptr if the block falls through
+    uint32_t max_depth;
+    std::vector<ir_edge_t> succs;
+};
+
+ir_class_t ir_class(instr_t instr)
+{
+    switch(instr)
+    {
+    case I_SEXT: case I_SEXT2: case I_SEXT3:
+    case I_INC: case I_DEC: case I_LINC:
+    case I_ADD: case I_ADD2: case I_ADD3: case I_ADD4:
+    case I_SUB: case I_SUB2: case I_SUB3: case I_SUB4:
+    case I_ADD2B: case I_ADD3B: case I_SUB2B: case I_MUL2B:
+    case I_MUL: case I_MUL2: case I_MUL3: case I_MUL4:
+    case I_LSL: case I_LSL2: case I_LSL4:
+    case I_LSR: case I_LSR2: case I_LSR4:
+    case I_ASR: case I_ASR2: case I_ASR4:
+    case I_AND: case I_AND2: case I_AND4:
+    case I_OR: case I_OR2: case I_OR4:
+    case I_XOR: case I_XOR2: case I_XOR4:
+    case I_COMP: case I_COMP2: case I_COMP4:
+    case I_BOOL: case I_BOOL2: case I_BOOL3: case I_BOOL4:
+    case I_CULT: case I_CULT2: case I_CULT3: case I_CULT4:
+    case I_CSLT: case I_CSLT2: case I_CSLT3: case I_CSLT4:
+    case I_CFEQ: case I_CFLT: case I_NOT:
+    case I_FADD: case I_FSUB: case I_FMUL: case I_FDIV:
+    case I_F2I: case I_F2U: case I_I2F: case I_U2F:
+    case I_REFL: case I_REFGB: case I_PUSHG: case I_PUSHL:
+        return IR_PURE;
+    case I_GETG: case I_GETG2: case I_GETG4: case I_GETGN:
+    case I_GTGB: case I_GTGB2: case I_GTGB4:
+    case I_GETP: case I_GETPN:
+        return IR_LOAD;
+    // division traps on a zero divisor
+    case I_UDIV2: case I_UDIV4: case I_DIV2: case I_DIV4:
+    case I_UMOD2: case I_UMOD4: case I_MOD2: case I_MOD4:
+    case I_SETG: case I_SETG2: case I_SETG4: case I_SETGN:
+    case I_GETR: case I_GETR2: case I_GETRN:
+    case I_SETR: case I_SETR2: case I_SETRN:
+    case I_PINC: case I_PINC2: case I_PINC3: case I_PINC4:
+    case I_PDEC: case I_PDEC2: case I_PDEC3: case I_PDEC4:
+    case I_PINCF: case I_PDECF:
+    // bounds checks trap
+    case I_AIXB1: case I_AIDXB: case I_AIDX: case I_PIDXB: case I_PIDX:
+    case I_UAIDX: case I_UPIDX: case I_ASLC: case I_PSLC:
+    case I_AIXB: case I_PIXB:
+    case I_SYS: case I_CALL:
+        return IR_EFFECT;
+    default:
+        return IR_NONE;
+    }
+}
+
+// whether an op reads or writes memory that may be a local (or calls
+// code that may), and whether it may write
+bool ir_barrier(compiler_instr_t const& i, bool& stores)
+{
+    stores = true;
+    switch(i.instr)
+    {
+    case I_GETR:
+    case I_GETR2:
+    case I_GETRN:
+        stores = false;
+        return true;
+    case I_SETR:
+    case I_SETR2:
+    case I_SETRN:
+    case I_PINC:
+    case I_PINC2:
+    case I_PINC3:
+    case I_PINC4:
+    case I_PDEC:
+    case I_PDEC2:
+    case I_PDEC3:
+    case I_PDEC4:
+    case I_PINCF:
+    case I_PDECF:
+    case I_CALL:
+        return true;
+    case I_SYS:
+    {
+        auto sys = (sysfunc_t)i.imm;
+        auto it = sysfunc_decls.find(sys);
+        if(sysfunc_is_format(sys) || it == sysfunc_decls.end())
+            return true;
+        auto const& args = it->second.decl.arg_types;
+        return std::any_of(args.begin(), args.end(),
+            [](compiler_type_t const& t) { return t.is_any_ref(); });
+    }
+    default:
+        return false;
+    }
+}
+
+bool ir_pushed_bytes(compiler_instr_t const& i, std::vector<uint8_t>& bytes)
+{
+    bytes.clear();
+    switch(i.instr)
+    {
+    case I_PUSH:  bytes.push_back(uint8_t(i.imm)); return true;
+    case I_P0:    bytes.push_back(0); return true;
+    case I_P1:    bytes.push_back(1); return true;
+    case I_P2:    bytes.push_back(2); return true;
+    case I_P3:    bytes.push_back(3); return true;
+    case I_P4:    bytes.push_back(4); return true;
+    case I_P5:    bytes.push_back(5); return true;
+    case I_P6:    bytes.push_back(6); return true;
+    case I_P7:    bytes.push_back(7); return true;
+    case I_P8:    bytes.push_back(8); return true;
+    case I_P16:   bytes.push_back(16); return true;
+    case I_P32:   bytes.push_back(32); return true;
+    case I_P64:   bytes.push_back(64); return true;
+    case I_P128:  bytes.push_back(128); return true;
+    case I_P00:   bytes.resize(2, 0); return true;
+    case I_P000:  bytes.resize(3, 0); return true;
+    case I_P0000: bytes.resize(4, 0); return true;
+    case I_PZ8:   bytes.resize(8, 0); return true;
+    case I_PZ16:  bytes.resize(16, 0); return true;
+    case I_PUSH2:
+    case I_PUSH3:
+    case I_PUSH4:
+    {
+        int n = i.instr == I_PUSH2 ? 2 : i.instr == I_PUSH3 ? 3 : 4;
+        for(int k = 0; k < n; ++k)
+            bytes.push_back(uint8_t(i.imm >> (k * 8)));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// GETL*, GETLN, DUP*: copy n bytes from offset off (1 = top)
+bool ir_local_copy(compiler_instr_t const& i, uint32_t& n, uint32_t& off)
+{
+    switch(i.instr)
+    {
+    case I_GETL:  n = 1; off = i.imm; return true;
+    case I_GETL2: n = 2; off = i.imm; return true;
+    case I_GETL4: n = 4; off = i.imm; return true;
+    case I_GETLN: n = i.imm; off = i.imm2; return true;
+    case I_DUP: case I_DUP2: case I_DUP3: case I_DUP4:
+    case I_DUP5: case I_DUP6: case I_DUP7: case I_DUP8:
+        n = 1;
+        off = uint32_t(i.instr - I_DUP + 1);
+        return true;
+    case I_DUPW: case I_DUPW2: case I_DUPW3: case I_DUPW4:
+    case I_DUPW5: case I_DUPW6: case I_DUPW7: case I_DUPW8:
+        n = 2;
+        off = uint32_t(i.instr - I_DUPW + 2);
+        return true;
+    default:
+        return false;
+    }
+}
+
+// SETL*, SETLN: pop n bytes and store them off bytes further down
+bool ir_local_store(compiler_instr_t const& i, uint32_t& n, uint32_t& off)
+{
+    switch(i.instr)
+    {
+    case I_SETL:  n = 1; off = i.imm; return true;
+    case I_SETL2: n = 2; off = i.imm; return true;
+    case I_SETL4: n = 4; off = i.imm; return true;
+    case I_SETLN: n = i.imm; off = i.imm2; return true;
+    default:
+        return false;
+    }
+}
+
+bool ir_pop(compiler_instr_t const& i, uint32_t& n)
+{
+    switch(i.instr)
+    {
+    case I_POP:  n = 1; return true;
+    case I_POP2: n = 2; return true;
+    case I_POP3: n = 3; return true;
+    case I_POP4: n = 4; return true;
+    case I_POPN: n = i.imm; return true;
+    default:
+        return false;
+    }
+}
+
+bool ir_branch(instr_t instr)
+{
+    return instr == I_BZ || instr == I_BNZ || instr == I_BZP || instr == I_BNZP;
+}
+
+bool ir_terminator(instr_t instr)
+{
+    return ir_branch(instr) || instr == I_JMP || instr == I_RET;
+}
+
+// evaluates a pure op on known operand bytes with the VM's semantics
+bool ir_fold(instr_t instr, std::vector<uint8_t> const& a, std::vector<uint8_t>& r)
+{
+    auto get = [&](size_t off, size_t n) {
+        uint32_t x = 0;
+        for(size_t k = 0; k < n; ++k)
+            x |= uint32_t(a[off + k]) << (k * 8);
+        return x;
+    };
+    auto sext = [](uint32_t x, size_t n) {
+        int s = int(32 - n * 8);
+        return int32_t(x << s) >> s;
+    };
+    auto put = [&](uint32_t x, size_t n) {
+        r.clear();
+        for(size_t k = 0; k < n; ++k)
+            r.push_back(uint8_t(x >> (k * 8)));
+        return true;
+    };
+    switch(instr)
+    {
+    case I_INC: return put(a[0] + 1u, 1);
+    case I_DEC: return put(a[0] - 1u, 1);
+    case I_ADD: case I_ADD2: case I_ADD3: case I_ADD4:
+    {
+        size_t n = instr - I_ADD + 1;
+        return put(get(0, n) + get(n, n), n);
+    }
+    case I_SUB: case I_SUB2: case I_SUB3: case I_SUB4:
+    {
+        size_t n = instr - I_SUB + 1;
+        return put(get(0, n) - get(n, n), n);
+    }
+    case I_MUL: case I_MUL2: case I_MUL3: case I_MUL4:
+    {
+        size_t n = instr - I_MUL + 1;
+        return put(get(0, n) * get(n, n), n);
+    }
+    case I_ADD2B: return put(get(0, 2) + a[2], 2);
+    case I_SUB2B: return put(get(0, 2) - a[2], 2);
+    case I_MUL2B: return put(get(0, 2) * a[2], 2);
+    case I_ADD3B: return put(get(0, 3) + a[3], 3);
+    case I_AND: case I_AND2: case I_AND4:
+    {
+        size_t n = size_t(1) << (instr - I_AND);
+        return put(get(0, n) & get(n, n), n);
+    }
+    case I_OR: case I_OR2: case I_OR4:
+    {
+        size_t n = size_t(1) << (instr - I_OR);
+        return put(get(0, n) | get(n, n), n);
+    }
+    case I_XOR: case I_XOR2: case I_XOR4:
+    {
+        size_t n = size_t(1) << (instr - I_XOR);
+        return put(get(0, n) ^ get(n, n), n);
+    }
+    case I_COMP: case I_COMP2: case I_COMP4:
+    {
+        size_t n = size_t(1) << (instr - I_COMP);
+        return put(~get(0, n), n);
+    }
+    case I_BOOL: case I_BOOL2: case I_BOOL3: case I_BOOL4:
+        return put(get(0, instr - I_BOOL + 1) != 0, 1);
+    case I_NOT:
+        return put(a[0] == 0, 1);
+    case I_CULT: case I_CULT2: case I_CULT3: case I_CULT4:
+    {
+        size_t n = instr - I_CULT + 1;
+        return put(get(0, n) < get(n, n), 1);
+    }
+    case I_CSLT: case I_CSLT2: case I_CSLT3: case I_CSLT4:
+    {
+        size_t n = instr - I_CSLT + 1;
+        return put(sext(get(0, n), n) < sext(get(n, n), n), 1);
+    }
+    // shifts by the operand width or more give zero (or the sign)
+    case I_LSL: case I_LSL2: case I_LSL4:
+    {
+        size_t n = size_t(1) << (instr - I_LSL);
+        uint32_t s = a[n];
+        return put(s >= 32 ? 0 : get(0, n) << s, n);
+    }
+    case I_LSR: case I_LSR2: case I_LSR4:
+    {
+        size_t n = size_t(1) << (instr - I_LSR);
+        uint32_t s = a[n];
+        return put(s >= 32 ? 0 : get(0, n) >> s, n);
+    }
+    case I_ASR: case I_ASR2: case I_ASR4:
+    {
+        size_t n = size_t(1) << (instr - I_ASR);
+        uint32_t s = a[n];
+        int32_t x = sext(get(0, n), n);
+        return put(s >= 32 ? (x < 0 ? 0xffffffffu : 0) : uint32_t(x >> s), n);
+    }
+    default:
+        return false;
+    }
+}
+
+class ir_func_t
+{
+public:
+    ir_func_t(
+        std::vector<compiler_instr_t> const& instrs,
+        std::vector<ir_shape_t> const& shapes,
+        uint32_t ret_size, uint32_t entry_size, bool refs)
+        : instrs(instrs)
+        , shapes(shapes)
+        , ret_size(ret_size)
+        , entry_size(entry_size)
+        , refs(refs)
+    {}
+
+    // false if the function cannot be lifted
+    bool analyze();
+    // which slots are read, given the blocks whose code is kept
+    void liveness();
+    // false if the block could not be lowered within its original stack
+    bool lower(ir_block_t const& b, std::vector<compiler_instr_t>& out) const;
+
+    std::vector<ir_block_t> blocks;
+
+private:
+    bool split();
+    bool lift(ir_block_t& b, std::vector<int> const& in) const;
+    bool edges(size_t bi, ir_block_t& b) const;
+    void dce(ir_block_t& b, std::vector<bool>& live_in) const;
+    void compute_live_out(ir_block_t& b) const;
+
+    std::vector<compiler_instr_t> const& instrs;
+    std::vector<ir_shape_t> const& shapes;
+    std::unordered_map<symbol_t, size_t> label_blocks;
+    uint32_t ret_size;
+    uint32_t entry_size;
+    bool refs;
+};
+
+bool ir_func_t::split()
+{
+    size_t begin = 0;
+    auto close = [&](size_t end) {
+        if(begin == end)
+            return;
+        ir_block_t b{};
+        b.begin = begin;
+        b.body = begin;
+        while(b.body < end && instrs[b.body].is_label)
+            ++b.body;
+        b.end = end;
+        blocks.push_back(std::move(b));
+        begin = end;
+    };
+    for(size_t k = 0; k < instrs.size(); ++k)
+    {
+        auto const& i = instrs[k];
+        if(i.is_label)
+        {
+            if(k > begin && !instrs[k - 1].is_label)
+                close(k);
+            if(!label_blocks.emplace(i.label, blocks.size()).second)
+                return false;
+        }
+        else if(ir_terminator(i.instr))
+            close(k + 1);
+    }
+    close(instrs.size());
+    return !blocks.empty();
+}
+
+bool ir_func_t::lift(ir_block_t& b, std::vector<int> const& in) const
+{
+    auto& vals = b.vals;
+    auto& ops = b.ops;
+    vals.clear();
+    ops.clear();
+    b.exit.clear();
+    b.cond = IR_ANY;
+    b.term = nullptr;
+
+    std::vector<uint32_t> s;
+    uint32_t consts[256];
+    std::fill(std::begin(consts), std::end(consts), IR_ANY);
+    auto konst = [&](uint8_t c) {
+        if(consts[c] == IR_ANY)
+        {
+            consts[c] = uint32_t(vals.size());
+            ir_value_t v{ IR_CONST };
+            v.known = true;
+            v.c = c;
+            vals.push_back(v);
+        }
+        return consts[c];
+    };
+    auto slot = [&](uint32_t p, bool entry, int k) {
+        ir_value_t v{ IR_SLOT };
+        v.known = k >= 0;
+        v.entry = entry;
+        v.c = uint8_t(k);
+        v.pos = p;
+        vals.push_back(v);
+        return uint32_t(vals.size() - 1);
+    };
+    auto known = [&](uint32_t v) { return v != IR_ANY && vals[v].known; };
+
+    // entry slots are values 0 to depth-1
+    for(uint32_t p = 0; p < uint32_t(b.depth); ++p)
+        s.push_back(slot(p, true, in[p]));
+
+    // stack size after each instruction, for the ops' floors
+    std::vector<uint32_t> trace;
+    std::vector<size_t> op_trace;
+    std::map<std::vector<uint32_t>, uint32_t> cse;
+    std::vector<uint8_t> bytes, folded;
+
+    auto add_op = [&](compiler_instr_t const& i, ir_class_t cls, uint32_t nargs,
+        uint32_t nresults) -> ir_op_t* {
+        ir_op_t op{};
+        op.instr = i;
+        op.cls = cls;
+        op.depth = uint32_t(s.size());
+        op.args.assign(s.end() - nargs, s.end());
+        s.resize(s.size() - nargs);
+        bool stores = false;
+        if(refs && ir_barrier(i, stores))
+        {
+            op.barrier = true;
+            op.layout = s;
+            op.layout.insert(op.layout.end(), op.args.begin(), op.args.end());
+        }
+
+        if(cls == IR_PURE && !op.args.empty() &&
+            std::all_of(op.args.begin(), op.args.end(), known))
+        {
+            bytes.clear();
+            for(auto v : op.args)
+                bytes.push_back(vals[v].c);
+            if(ir_fold(i.instr, bytes, folded) && folded.size() == nresults)
+            {
+                for(auto c : folded)
+                    s.push_back(konst(c));
+                return nullptr;
+            }
+        }
+
+        // reuse the result of an identical pure op that is still around
+        std::vector<uint32_t> key;
+        if(cls == IR_PURE && !op.args.empty() &&
+            std::find(op.args.begin(), op.args.end(), IR_ANY) == op.args.end())
+        {
+            key = { uint32_t(i.instr), i.imm, i.imm2 };
+            key.insert(key.end(), op.args.begin(), op.args.end());
+            auto it = cse.find(key);
+            if(it != cse.end())
+            {
+                auto const& prev = ops[it->second].results;
+                if(std::all_of(prev.begin(), prev.end(), [&](uint32_t v) {
+                    return std::find(s.begin(), s.end(), v) != s.end(); }))
+                {
+                    s.insert(s.end(), prev.begin(), prev.end());
+                    return nullptr;
+                }
+            }
+            cse[key] = uint32_t(ops.size());
+        }
+
+        uint32_t index = uint32_t(ops.size());
+        for(uint32_t k = 0; k < nresults; ++k)
+        {
+            ir_value_t v{ IR_RESULT };
+            v.op = index;
+            op.results.push_back(uint32_t(vals.size()));
+            vals.push_back(v);
+        }
+        if(op.barrier && stores)
+        {
+            for(uint32_t p = 0; p < uint32_t(s.size()); ++p)
+                s[p] = slot(p, false, IR_NAC);
+            op.fresh = s;
+        }
+        s.insert(s.end(), op.results.begin(), op.results.end());
+        op_trace.push_back(trace.size());
+        ops.push_back(std::move(op));
+        return &ops.back();
+    };
+
+    b.max_depth = uint32_t(s.size());
+    for(size_t k = b.body; k < b.end; ++k)
+    {
+        auto const& i = instrs[k];
+        uint32_t n, off;
+        if(i.is_label)
+            return false;
+        if(ir_pushed_bytes(i, bytes))
+        {
+            for(auto c : bytes)
+                s.push_back(konst(c));
+        }
+        else if(ir_local_copy(i, n, off))
+        {
+            // a copy may overlap the bytes it pushes
+            if(off == 0 || off > s.size())
+                return false;
+            for(uint32_t j = 0; j < n; ++j)
+                s.push_back(s[s.size() - off]);
+        }
+        else if(ir_local_store(i, n, off))
+        {
+            if(off < n || n + off > s.size())
+                return false;
+            for(uint32_t j = 0; j < n; ++j)
+            {
+                size_t p = s.size() - 1;
+                s[p - off] = s[p];
+                s.pop_back();
+            }
+        }
+        else if(ir_pop(i, n))
+        {
+            if(n > s.size())
+                return false;
+            s.resize(s.size() - n);
+        }
+        else switch(i.instr)
+        {
+        case I_NOP:
+            break;
+        case I_ALLOC:
+            s.insert(s.end(), i.imm, IR_ANY);
+            break;
+        case I_SEXT:
+        case I_SEXT2:
+        case I_SEXT3:
+        {
+            if(s.empty())
+                return false;
+            n = uint32_t(i.instr - I_SEXT + 1);
+            uint32_t x = s.back();
+            if(known(x))
+            {
+                s.insert(s.end(), n, konst(vals[x].c & 0x80 ? 0xff : 0x00));
+                break;
+            }
+            // the operand stays below its sign bytes
+            auto* op = add_op(i, IR_PURE, 1, 1);
+            s.insert(s.end() - 1, x);
+            op->results.insert(op->results.begin(), x);
+            s.insert(s.end(), n - 1, s.back());
+            op->results.insert(op->results.end(), n - 1, op->results.back());
+            break;
+        }
+        case I_LINC:
+        {
+            if(i.imm == 0 || i.imm > s.size())
+                return false;
+            size_t p = s.size() - i.imm;
+            auto inc = i;
+            inc.instr = I_INC;
+            inc.imm = 0;
+            s.push_back(s[p]);
+            if(auto* op = add_op(inc, IR_PURE, 1, 1))
+                op->linc = true;
+            s[p] = s.back();
+            s.pop_back();
+            break;
+        }
+        case I_REFL:
+        {
+            if(i.imm == 0 || i.imm > s.size())
+                return false;
+            auto refl = i;
+            refl.imm = uint32_t(s.size() - i.imm);
+            if(auto* op = add_op(refl, IR_PURE, 0, 2))
+                op->frame.assign(s.begin(), s.begin() + refl.imm + 1);
+            break;
+        }
+        case I_BZ:
+        case I_BNZ:
+        case I_BZP:
+        case I_BNZP:
+            if(s.empty())
+                return false;
+            b.cond = s.back();
+            s.pop_back();
+            b.term = &i;
+            break;
+        case I_JMP:
+        case I_RET:
+            b.term = &i;
+            break;
+        default:
+        {
+            auto cls = ir_class(i.instr);
+            auto const& shape = shapes[k];
+            if(cls == IR_NONE || shape.args > s.size())
+                return false;
+            add_op(i, cls, shape.args, shape.results);
+            break;
+        }
+        }
+        trace.push_back(uint32_t(s.size()));
+        b.max_depth = std::max(b.max_depth, uint32_t(s.size()));
+        if(b.term && k + 1 != b.end)
+            return false;
+    }
+    if(b.max_depth > 256)
+        return false;
+    b.exit = std::move(s);
+
+    std::vector<uint32_t> low(trace.size() + 1, uint32_t(b.exit.size()));
+    for(size_t k = trace.size(); k-- > 0;)
+        low[k] = std::min(low[k + 1], trace[k]);
+    for(size_t k = 0; k < ops.size(); ++k)
+        ops[k].floor = low[op_trace[k]];
+    return true;
+}
+
+bool ir_func_t::edges(size_t bi, ir_block_t& b) const
+{
+    b.succs.clear();
+    auto target = [&](bool keep) {
+        auto it = label_blocks.find(b.term->label);
+        if(it == label_blocks.end())
+            return false;
+        b.succs.push_back({ it->second, keep });
+        return true;
+    };
+    auto next = [&]() {
+        if(bi + 1 >= blocks.size())
+            return false;
+        b.succs.push_back({ bi + 1, false });
+        return true;
+    };
+    if(!b.term)
+        return next();
+    switch(b.term->instr)
+    {
+    case I_RET:
+        return b.exit.size() == ret_size;
+    case I_JMP:
+        return target(false);
+    default:
+        break;
+    }
+    bool keep = b.term->instr == I_BZP || b.term->instr == I_BNZP;
+    bool on_zero = b.term->instr == I_BZ || b.term->instr == I_BZP;
+    auto const& c = b.vals[b.cond];
+    if(b.cond != IR_ANY && c.known)
+        return (c.c == 0) == on_zero ? target(keep) : next();
+    return target(keep) && next();
+}
+
+void ir_func_t::dce(ir_block_t& b, std::vector<bool>& live_in) const
+{
+    std::vector<bool> needed(b.vals.size());
+    auto need = [&](uint32_t v) {
+        if(v != IR_ANY)
+            needed[v] = true;
+    };
+    for(size_t p = 0; p < b.exit.size(); ++p)
+        if(b.live_out[p])
+            need(b.exit[p]);
+    need(b.cond);
+    for(size_t k = b.ops.size(); k-- > 0;)
+    {
+        auto& op = b.ops[k];
+        op.live = op.cls == IR_EFFECT || std::any_of(
+            op.results.begin(), op.results.end(), [&](uint32_t v) {
+                return needed[v] && b.vals[v].kind == IR_RESULT && b.vals[v].op == k; });
+        if(!op.live)
+            continue;
+        for(auto v : op.args)
+            need(v);
+        for(auto v : op.layout)
+            need(v);
+    }
+
+    live_in.assign(b.depth, refs || b.kept);
+    for(size_t v = 0; v < b.vals.size(); ++v)
+        if(needed[v] && b.vals[v].kind == IR_SLOT && b.vals[v].entry)
+            live_in[b.vals[v].pos] = true;
+}
+
+void ir_func_t::compute_live_out(ir_block_t& b) const
+{
+    bool all = refs || (b.term && b.term->instr == I_RET);
+    b.live_out.assign(b.exit.size(), all);
+    if(all)
+        return;
+    for(auto const& e : b.succs)
+    {
+        auto const& s = blocks[e.to];
+        for(size_t p = 0; p < b.exit.size(); ++p)
+            if(s.live_in[p])
+                b.live_out[p] = true;
+    }
+}
+
+bool ir_func_t::analyze()
+{
+    if(!split())
+        return false;
+
+    // forward: which slots hold one constant on every feasible path
+    std::vector<size_t> work;
+    blocks[0].depth = int(entry_size);
+    blocks[0].in.assign(entry_size, IR_NAC);
+    work.push_back(0);
+    std::vector<int> state;
+    while(!work.empty())
+    {
+        size_t bi = work.back();
+        work.pop_back();
+        auto& b = blocks[bi];
+        if(!lift(b, b.in) || !edges(bi, b))
+            return false;
+        for(auto const& e : b.succs)
+        {
+            state.clear();
+            for(auto v : b.exit)
+                state.push_back(v != IR_ANY && b.vals[v].known ? b.vals[v].c : IR_NAC);
+            if(e.keep_cond)
+            {
+                // a taken BZP leaves a zero
+                auto const& c = b.vals[b.cond];
+                state.push_back(b.term->instr == I_BZP ? 0 : c.known ? c.c : IR_NAC);
+            }
+            auto& s = blocks[e.to];
+            bool changed = false;
+            if(s.depth < 0)
+            {
+                s.depth = int(state.size());
+                s.in = state;
+                changed = true;
+            }
+            else if(s.depth != int(state.size()))
+                return false;
+            else for(size_t p = 0; p < state.size(); ++p)
+            {
+                int x = s.in[p];
+                if(x == IR_NAC || x == state[p])
+                    continue;
+                s.in[p] = IR_NAC;
+                changed = true;
+            }
+            if(changed && std::find(work.begin(), work.end(), e.to) == work.end())
+                work.push_back(e.to);
+        }
+    }
+
+    // final lift
+    for(size_t bi = 0; bi < blocks.size(); ++bi)
+    {
+        auto& b = blocks[bi];
+        if(b.depth < 0)
+            continue;
+        if(!lift(b, b.in) || !edges(bi, b))
+            return false;
+    }
+    return true;
+}
+
+void ir_func_t::liveness()
+{
+    for(auto& b : blocks)
+        if(b.depth >= 0)
+            b.live_in.assign(b.depth, refs);
+    std::vector<bool> live_in;
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        for(size_t bi = blocks.size(); bi-- > 0;)
+        {
+            auto& b = blocks[bi];
+            if(b.depth < 0)
+                continue;
+            compute_live_out(b);
+            dce(b, live_in);
+            if(live_in != b.live_in)
+            {
+                b.live_in = live_in;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool ir_func_t::lower(ir_block_t const& b, std::vector<compiler_instr_t>& out) const
+{
+    auto const& vals = b.vals;
+    std::vector<uint32_t> p; // values on the physical stack, bottom to top
+    std::vector<uint32_t> rem(vals.size()); // uses not yet emitted
+    auto use = [&](uint32_t v) {
+        if(v != IR_ANY)
+            rem[v] += 1;
+    };
+    auto unuse = [&](uint32_t v) {
+        if(v != IR_ANY)
+            rem[v] -= 1;
+    };
+
+    std::vector<uint32_t> exit = b.exit;
+    for(size_t q = 0; q < exit.size(); ++q)
+        if(!b.live_out[q])
+            exit[q] = IR_ANY;
+    for(auto v : exit)
+        use(v);
+    use(b.cond);
+    for(auto const& op : b.ops)
+    {
+        if(!op.live)
+            continue;
+        for(auto v : op.args)
+            use(v);
+        for(auto v : op.layout)
+            use(v);
+    }
+    for(uint32_t q = 0; q < uint32_t(b.depth); ++q)
+    {
+        assert(vals[q].kind == IR_SLOT && vals[q].pos == q);
+        p.push_back(b.live_in[q] ? q : IR_ANY);
+    }
+
+    auto known = [&](uint32_t v) { return v != IR_ANY && vals[v].known; };
+    auto same = [&](uint32_t x, uint32_t y) {
+        return x == y || (known(x) && known(y) && vals[x].c == vals[y].c);
+    };
+    auto count = [&](uint32_t v) {
+        return size_t(std::count(p.begin(), p.end(), v));
+    };
+    // ops without operands are emitted where their results are needed
+    auto remat = [&](uint32_t v) -> ir_op_t const* {
+        if(v == IR_ANY || vals[v].kind != IR_RESULT)
+            return nullptr;
+        auto const& op = b.ops[vals[v].op];
+        return op.cls == IR_PURE && op.args.empty() ? &op : nullptr;
+    };
+    auto cheap = [&](uint32_t v) { return known(v) || remat(v); };
+
+    compiler_instr_t const* src = b.term ? b.term : &instrs[b.end - 1];
+    uint32_t max_depth = uint32_t(p.size());
+    auto emit = [&](instr_t instr, uint32_t imm = 0, uint32_t imm2 = 0) {
+        auto i = *src;
+        i.instr = instr;
+        i.imm = imm;
+        i.imm2 = imm2;
+        i.label = {};
+        i.is_label = false;
+        out.push_back(i);
+    };
+    auto grow = [&]() {
+        max_depth = std::max(max_depth, uint32_t(p.size()));
+    };
+    auto pop = [&]() {
+        p.pop_back();
+        if(!out.empty() && out.back().instr == I_POPN && out.back().imm < 255)
+            out.back().imm += 1;
+        else
+            emit(I_POPN, 1);
+    };
+    // bytes nothing reads any more, down to the given stack size
+    auto pop_dead = [&](size_t floor) {
+        while(p.size() > floor && (p.back() == IR_ANY || rem[p.back()] == 0))
+            pop();
+    };
+    // move the top byte to slot q, merging runs into one SETLN
+    auto store_top = [&](size_t q) {
+        uint32_t t = uint32_t(p.size() - 1 - q);
+        p[q] = p.back();
+        p.pop_back();
+        if(!out.empty() && out.back().instr == I_SETLN &&
+            out.back().imm2 == t && out.back().imm < t)
+            out.back().imm += 1;
+        else
+            emit(I_SETLN, 1, t);
+    };
+    auto emit_op = [&](ir_op_t const& op) {
+        auto i = op.instr;
+        if(i.instr == I_REFL)
+        {
+            // the slot is addressed from the current top
+            if(p.size() <= i.imm || p.size() - i.imm > 255)
+                return false;
+            i.imm = uint32_t(p.size() - i.imm);
+        }
+        out.push_back(i);
+        return true;
+    };
+    // push vs[from, to), copying runs of adjacent bytes with one GETLN
+    std::function<bool(std::vector<uint32_t> const&, size_t, size_t)> materialize;
+    materialize = [&](std::vector<uint32_t> const& vs, size_t from, size_t to) {
+        for(size_t k = from; k < to;)
+        {
+            uint32_t v = vs[k];
+            if(v == IR_ANY || known(v))
+            {
+                emit(I_PUSH, v == IR_ANY ? 0 : vals[v].c);
+                p.push_back(v);
+                grow();
+                ++k;
+                continue;
+            }
+            if(auto* op = remat(v))
+            {
+                // a reference needs its slot on the stack
+                auto const& frame = op->frame;
+                if(p.size() < frame.size() && !materialize(frame, p.size(), frame.size()))
+                    return false;
+                if(!emit_op(*op))
+                    return false;
+                auto const& rs = op->results;
+                size_t n = rs.size();
+                size_t j = size_t(std::find(rs.begin(), rs.end(), v) - rs.begin());
+                p.insert(p.end(), rs.begin(), rs.end());
+                grow();
+                if(j == 0 && k + n <= to && std::equal(rs.begin(), rs.end(), vs.begin() + k))
+                {
+                    k += n;
+                    continue;
+                }
+                // only one byte of the result is wanted here
+                for(size_t x = j + 1; x < n; ++x)
+                    pop();
+                if(j > 0)
+                {
+                    store_top(p.size() - 1 - j);
+                    while(p.back() != v)
+                        pop();
+                }
+                ++k;
+                continue;
+            }
+            size_t m = p.size();
+            size_t best = SIZE_MAX, best_n = 0;
+            for(size_t r = m; r-- > 0;)
+            {
+                if(p[r] != v)
+                    continue;
+                size_t n = 1;
+                while(k + n < to && r + n < m && p[r + n] == vs[k + n] && !cheap(vs[k + n]))
+                    ++n;
+                if(n > best_n)
+                    best = r, best_n = n;
+            }
+            if(best == SIZE_MAX || m - best > 255)
+                return false;
+            emit(I_GETLN, uint32_t(best_n), uint32_t(m - best));
+            for(size_t j = 0; j < best_n; ++j)
+                p.push_back(p[best + j]);
+            grow();
+            k += best_n;
+        }
+        return true;
+    };
+
+    // rearrange the stack into t, where IR_ANY is any byte
+    auto reshape = [&](std::vector<uint32_t> const& t) {
+        size_t n = t.size();
+        auto mismatch = [&](size_t q) {
+            return q < n && q < p.size() && t[q] != IR_ANY && !same(p[q], t[q]);
+        };
+        auto wanted = [&](uint32_t w) {
+            for(size_t q = 0; q < n; ++q)
+                if(t[q] != IR_ANY && same(t[q], w) && (q >= p.size() || !same(p[q], t[q])))
+                    return true;
+            return false;
+        };
+        auto spare = [&](size_t q) {
+            uint32_t w = p[q];
+            return w == IR_ANY || cheap(w) || count(w) >= 2 || !wanted(w);
+        };
+        // fills slot q, keeping a copy of the only byte it holds
+        auto save_and_fill = [&](size_t q) {
+            std::vector<uint32_t> v{ p[q], t[q] };
+            if(!materialize(v, 0, 2))
+                return false;
+            store_top(q);
+            return true;
+        };
+        // each step fixes a slot or shrinks the stack, except pushes
+        // that only happen once nothing below is wrong
+        for(;;)
+        {
+            size_t m = p.size();
+            if(m > n)
+            {
+                uint32_t w = p[m - 1];
+                size_t q = SIZE_MAX;
+                if(w != IR_ANY)
+                {
+                    for(size_t r = 0; r < n && r + 1 < m; ++r)
+                        if(mismatch(r) && same(t[r], w))
+                            q = r;
+                }
+                if(q == SIZE_MAX)
+                    pop();
+                else if(spare(q))
+                    store_top(q);
+                else if(!save_and_fill(q))
+                    return false;
+                continue;
+            }
+            size_t q = 0;
+            bool any = false;
+            for(; q < m; ++q)
+            {
+                if(!mismatch(q))
+                    continue;
+                any = true;
+                if(spare(q))
+                    break;
+            }
+            if(q < m)
+            {
+                // fill a run of slots with one copy and one store
+                size_t k = 1;
+                std::vector<uint32_t> saved;
+                saved.push_back(p[q]);
+                p[q] = t[q];
+                while(q + k < m && mismatch(q + k) && spare(q + k) && k < m - q - k)
+                {
+                    saved.push_back(p[q + k]);
+                    p[q + k] = t[q + k];
+                    ++k;
+                }
+                for(size_t j = 0; j < k; ++j)
+                    p[q + j] = saved[j];
+                if(!materialize(t, q, q + k))
+                    return false;
+                for(size_t j = k; j-- > 0;)
+                    store_top(q + j);
+                continue;
+            }
+            if(any)
+            {
+                // the wrong bytes are all needed elsewhere: a cycle
+                q = 0;
+                while(!mismatch(q))
+                    ++q;
+                if(!save_and_fill(q))
+                    return false;
+                continue;
+            }
+            if(m == n)
+                return true;
+            if(!materialize(t, m, n))
+                return false;
+        }
+    };
+
+    // operands left of a computed one are pushed before the first op
+    // that computes it, as the original code does. Copies of earlier
+    // values are only pushed that early if every op in between is part
+    // of the computation, so that they do not sit under unrelated work.
+    struct prefix_t { size_t op, from, to; };
+    std::vector<size_t> first(b.ops.size());
+    std::vector<std::vector<prefix_t>> prefixes(b.ops.size());
+    auto available = [&](uint32_t v, size_t f) {
+        if(v == IR_ANY || cheap(v))
+            return true;
+        if(vals[v].kind == IR_SLOT)
+            return vals[v].entry;
+        return vals[v].op < f;
+    };
+    std::vector<size_t> mark(b.ops.size(), SIZE_MAX);
+    std::vector<size_t> todo;
+    auto only_feeds = [&](size_t k, size_t f) {
+        todo.assign(1, k);
+        while(!todo.empty())
+        {
+            size_t x = todo.back();
+            todo.pop_back();
+            mark[x] = k;
+            for(auto v : b.ops[x].args)
+                if(v != IR_ANY && vals[v].kind == IR_RESULT && vals[v].op >= f &&
+                    mark[vals[v].op] != k)
+                    todo.push_back(vals[v].op);
+        }
+        for(size_t x = f; x < k; ++x)
+        {
+            auto const& o = b.ops[x];
+            if(o.live && !(o.cls == IR_PURE && o.args.empty()) && mark[x] != k)
+                return false;
+        }
+        return true;
+    };
+    for(size_t k = 0; k < b.ops.size(); ++k)
+    {
+        auto const& op = b.ops[k];
+        first[k] = k;
+        if(!op.live || op.barrier)
+            continue;
+        for(size_t a = 0; a < op.args.size(); ++a)
+        {
+            uint32_t v = op.args[a];
+            if(v == IR_ANY || vals[v].kind != IR_RESULT || remat(v))
+                continue;
+            size_t f = first[vals[v].op];
+            first[k] = std::min(first[k], f);
+            size_t j = a;
+            while(j > 0 && available(op.args[j - 1], f))
+                --j;
+            if(j > 0 || a == 0)
+                continue;
+            if(std::all_of(op.args.begin(), op.args.begin() + a, [&](uint32_t w) {
+                return w == IR_ANY || cheap(w); }) || only_feeds(k, f))
+                prefixes[f].push_back({ k, j, a });
+        }
+    }
+    // likewise, constants the successors read above the current stack
+    // go below a branch condition before it is computed
+    size_t cond_first = SIZE_MAX;
+    if(b.term && ir_branch(b.term->instr) && !known(b.cond) &&
+        vals[b.cond].kind == IR_RESULT && !remat(b.cond))
+        cond_first = first[vals[b.cond].op];
+
+    for(size_t k = 0; k < b.ops.size(); ++k)
+    {
+        auto const& op = b.ops[k];
+        if(k == cond_first && p.size() < exit.size() &&
+            std::all_of(exit.begin() + p.size(), exit.end(), [&](uint32_t v) {
+                return v != IR_ANY && cheap(v); }))
+        {
+            bool in_place = true;
+            for(size_t q = 0; q < p.size(); ++q)
+                if(exit[q] != IR_ANY && !same(p[q], exit[q]))
+                    in_place = false;
+            if(in_place && !materialize(exit, p.size(), exit.size()))
+                return false;
+        }
+        // outer consumers first
+        for(size_t x = prefixes[k].size(); x-- > 0;)
+        {
+            auto const& r = prefixes[k][x];
+            auto const& args = b.ops[r.op].args;
+            // bytes on top that are read there for the last time stay
+            size_t from = r.from;
+            for(size_t t = std::min(r.to - r.from, p.size()); t > 0; --t)
+            {
+                bool ok = true;
+                for(size_t a = 0; ok && a < t; ++a)
+                {
+                    size_t q = p.size() - t + a;
+                    uint32_t v = p[q];
+                    uint32_t w = args[r.from + a];
+                    if(w == IR_ANY)
+                        continue;
+                    if(q < exit.size() && exit[q] != IR_ANY && same(v, exit[q]))
+                        ok = false;
+                    else if(!same(v, w))
+                        ok = false;
+                    else if(!cheap(v))
+                        ok = rem[v] == size_t(std::count(args.begin(), args.end(), v));
+                }
+                if(ok)
+                {
+                    from += t;
+                    break;
+                }
+            }
+            if(!materialize(args, from, r.to))
+                return false;
+        }
+        if(!op.live || (op.cls == IR_PURE && op.args.empty()))
+            continue;
+        src = &op.instr;
+        size_t nargs = op.args.size();
+        pop_dead(std::min(op.depth, op.floor));
+        if(op.barrier)
+        {
+            if(!reshape(op.layout))
+                return false;
+            for(auto v : op.layout)
+                unuse(v);
+        }
+        else
+        {
+            // operands already on top are consumed where they are
+            size_t m = p.size();
+            size_t in_place = 0;
+            for(size_t j = std::min(nargs, m); j > 0 && in_place == 0; --j)
+            {
+                bool ok = true;
+                for(size_t a = 0; ok && a < j; ++a)
+                {
+                    uint32_t v = p[m - j + a];
+                    uint32_t x = op.args[a];
+                    size_t q = m - j + a;
+                    if(x != IR_ANY && !same(v, x))
+                        ok = false;
+                    else if(q < exit.size() && exit[q] != IR_ANY && same(v, exit[q]))
+                        ok = false; // already where the successors read it
+                    else if(v != IR_ANY && !cheap(v))
+                    {
+                        // the last use, or another copy stays
+                        size_t uses = std::count(op.args.begin(), op.args.end(), v);
+                        size_t taken = std::count(p.end() - j, p.end(), v);
+                        ok = rem[v] == uses || count(v) > taken;
+                    }
+                }
+                if(ok)
+                    in_place = j;
+            }
+
+            uint32_t x = nargs == 1 ? op.args[0] : IR_ANY;
+            size_t q = x == IR_ANY ? SIZE_MAX : size_t(
+                std::find(p.begin(), p.end(), x) - p.begin());
+            if(op.linc && in_place == 0 && q < m && m - q <= 255 &&
+                (rem[x] == 1 || count(x) >= 2))
+            {
+                // increment a slot in place
+                emit(I_LINC, uint32_t(m - q));
+                p[q] = op.results[0];
+                unuse(x);
+                continue;
+            }
+
+            if(!materialize(op.args, in_place, nargs))
+                return false;
+        }
+
+        // nothing extra below a call's frame
+        if(op.instr.instr == I_CALL && p.size() > op.depth)
+            return false;
+        if(!emit_op(op))
+            return false;
+        p.resize(p.size() - nargs);
+        for(auto v : op.args)
+            unuse(v);
+        if(!op.fresh.empty())
+        {
+            assert(op.fresh.size() == p.size());
+            p = op.fresh;
+        }
+        p.insert(p.end(), op.results.begin(), op.results.end());
+        grow();
+
+        pop_dead(op.floor);
+    }
+
+    src = b.term ? b.term : &instrs[b.end - 1];
+    if(!b.term || !ir_branch(b.term->instr))
+    {
+        if(!reshape(exit))
+            return false;
+        if(b.term)
+            out.push_back(*b.term);
+    }
+    else if(known(b.cond))
+    {
+        // the branch always goes the same way
+        bool on_zero = b.term->instr == I_BZ || b.term->instr == I_BZP;
+        bool keep = b.term->instr == I_BZP || b.term->instr == I_BNZP;
+        if((vals[b.cond].c == 0) == on_zero)
+        {
+            if(keep)
+                exit.push_back(b.cond);
+            if(!reshape(exit))
+                return false;
+            emit(I_JMP);
+            out.back().label = b.term->label;
+        }
+        else if(!reshape(exit))
+            return false;
+    }
+    else
+    {
+        exit.push_back(b.cond);
+        if(!reshape(exit))
+            return false;
+        out.push_back(*b.term);
+    }
+    return max_depth <= b.max_depth;
+}
+
+}
+
+bool compiler_t::optimize_ir(compiler_func_t& f)
+{
+    bool refs = false;
+    std::vector<ir_shape_t> shapes(f.instrs.size());
+    for(size_t k = 0; k < f.instrs.size(); ++k)
+    {
+        auto const& i = f.instrs[k];
+        if(i.is_label)
+            continue;
+        switch(i.instr)
+        {
+        case I_REFL:
+            refs = true;
+            break;
+        case I_CALL:
+        {
+            // the caller reserves the return value below the arguments,
+            // and the callee pops the arguments
+            auto it = funcs.find(i.label);
+            if(it == funcs.end())
+                return false;
+            auto const& decl = it->second.decl;
+            uint32_t n = 0;
+            for(auto const& t : decl.arg_types)
+                n += uint32_t(t.prim_size);
+            uint32_t r = uint32_t(decl.return_type.prim_size);
+            shapes[k] = { r + n, r };
+            break;
+        }
+        case I_GETR:  shapes[k] = { 2, 1 }; break;
+        case I_GETR2: shapes[k] = { 2, 2 }; break;
+        case I_GETRN: shapes[k] = { 2, i.imm }; break;
+        case I_SETR:  shapes[k] = { 3, 0 }; break;
+        case I_SETR2: shapes[k] = { 4, 0 }; break;
+        case I_SETRN: shapes[k] = { i.imm + 2, 0 }; break;
+        case I_GETP:  shapes[k] = { 3, 1 }; break;
+        default:
+            if(ir_class(i.instr) != IR_NONE)
+            {
+                uint32_t n = instr_accesses_stack(i, 1).second;
+                shapes[k] = { n, uint32_t(int(n) + instr_stack_mod(i)) };
+            }
+            break;
+        }
+    }
+
+    uint32_t ret_size = uint32_t(f.decl.return_type.prim_size);
+    uint32_t arg_size = 0;
+    for(auto const& t : f.decl.arg_types)
+        arg_size += uint32_t(t.prim_size);
+
+    ir_func_t ir(f.instrs, shapes, ret_size, ret_size + arg_size, refs);
+    if(!ir.analyze())
+        return false;
+
+    // a block that is not replaced reads its slots as they are, which
+    // may make a lowered predecessor more expensive: repeat until no
+    // more blocks are kept
+    auto g = goal(f.temp);
+    auto const* first = f.instrs.data();
+    std::vector<std::vector<compiler_instr_t>> lowered(ir.blocks.size());
+    for(bool changed = true; changed;)
+    {
+        changed = false;
+        ir.liveness();
+        for(size_t bi = 0; bi < ir.blocks.size(); ++bi)
+        {
+            auto& b = ir.blocks[bi];
+            if(b.depth < 0 || b.kept)
+                continue;
+            lowered[bi].clear();
+            if(!ir.lower(b, lowered[bi]) || !cheaper(instrs_cost(lowered[bi]),
+                instrs_cost(first + b.body, first + b.end), g))
+            {
+                b.kept = true;
+                changed = true;
+            }
+        }
+    }
+
+    bool t = false;
+    std::vector<compiler_instr_t> instrs;
+    instrs.reserve(f.instrs.size());
+    for(size_t bi = 0; bi < ir.blocks.size(); ++bi)
+    {
+        auto const& b = ir.blocks[bi];
+        instrs.insert(instrs.end(), first + b.begin, first + b.body);
+        if(b.depth < 0 || b.kept)
+        {
+            instrs.insert(instrs.end(), first + b.body, first + b.end);
+            continue;
+        }
+        instrs.insert(instrs.end(), lowered[bi].begin(), lowered[bi].end());
+        t = true;
+    }
+    if(t)
+        f.instrs = std::move(instrs);
+    return t;
+}
+
+}
@@ -0,0 +1,828 @@
+#include "abc_compiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace abc
+{
+
+// Loop-invariant code motion and induction variable strength reduction.
+//
+// A loop is first generated as usual while every pure expression in it
+// is classified: invariant when it reads only constants, locals the
+// loop does not write and, unless the loop calls functions or stores
+// through references, globals it does not assign; or an affine function
+// k*i+c of the induction variable i that a for loop's iteration
+// statement steps by a constant. Array elements indexed by i whose
+// bounds are proven become element pointers that advance by the
+// element size.
+//
+// If the instructions saved per iteration outweigh the stack bytes
+// needed, the loop is generated again: the chosen values are computed
+// once into a hidden scope before it, read with GETLN wherever the same
+// expression appears in it, and advanced after each iteration statement.
+
+static constexpr int64_t LOOP_MIN_SAVED = 2;
+// GETLN, PUSH, ADD, SETLN after peephole
+static constexpr int64_t LOOP_ADVANCE_INSTRS = 4;
+// room left for temporaries the classification does not see
+static constexpr size_t LOOP_MAX_FRAME = 240;
+
+static bool is_write(ast_node_t const& a)
+{
+    return
+        a.type == AST::OP_ASSIGN ||
+        a.type == AST::OP_ASSIGN_COMPOUND ||
+        a.type == AST::OP_INC_POST ||
+        a.type == AST::OP_DEC_POST;
+}
+
+static ast_node_t const& strip_casts(ast_node_t const& a)
+{
+    return a.type == AST::OP_CAST ? strip_casts(a.children[1]) : a;
+}
+
+static bool is_candidate(AST type)
+{
+    switch(type)
+    {
+    case AST::OP_CAST:
+    case AST::OP_ADDITIVE:
+    case AST::OP_MULTIPLICATIVE:
+    case AST::OP_SHIFT:
+    case AST::OP_UNARY:
+    case AST::OP_BITWISE_AND:
+    case AST::OP_BITWISE_OR:
+    case AST::OP_BITWISE_XOR:
+    case AST::OP_RELATIONAL:
+    case AST::OP_EQUALITY:
+    case AST::ARRAY_INDEX:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// instructions left after peephole: a variable's address followed by a
+// load becomes a single read
+static int64_t instr_weight(
+    std::vector<compiler_instr_t> const& instrs, size_t begin)
+{
+    int64_t n = 0;
+    for(size_t i = begin; i < instrs.size(); ++i)
+    {
+        auto const& t = instrs[i];
+        if(t.is_label)
+            continue;
+        if(i > begin && (t.instr == I_GETRN || t.instr == I_GETPN))
+        {
+            auto p = instrs[i - 1].instr;
+            if(p == I_REFL || p == I_PUSHG || p == I_PUSHL)
+                continue;
+        }
+        ++n;
+    }
+    return n;
+}
+
+// constant expressions are left to folding
+static bool reads_variable(ast_node_t const& a)
+{
+    if(a.type == AST::IDENT)
+        return true;
+    for(auto const& child : a.children)
+        if(reads_variable(child))
+            return true;
+    return false;
+}
+
+static void set_parents(ast_node_t& a)
+{
+    for(auto& child : a.children)
+    {
+        child.parent = &a;
+        set_parents(child);
+    }
+}
+
+void compiler_t::loop_scan(loop_motion_t& lm, ast_node_t const& a) const
+{
+    auto const& c = a.children;
+    if(a.type == AST::DECL_STMT)
+    {
+        int id = range_ident(c[1]);
+        if(id >= 0)
+        {
+            lm.written.insert(id);
+            lm.declared.insert(id);
+        }
+    }
+    else if(is_write(a))
+    {
+        // the variable assigned, or one of whose elements or members is
+        auto const* t = &strip_casts(c[0]);
+        while(t->type == AST::ARRAY_INDEX || t->type == AST::STRUCT_MEMBER)
+            t = &strip_casts(t->children[0]);
+        if(t->type == AST::IDENT)
+        {
+            int id = range_ident(*t);
+            if(id >= 0)
+                lm.written.insert(id);
+            else
+                lm.written_globals.insert(std::string(t->data));
+        }
+    }
+    for(auto const& child : c)
+        loop_scan(lm, child);
+}
+
+// whether a may write globals without naming them: through references,
+// or in functions it calls
+bool compiler_t::loop_opaque(ast_node_t const& a) const
+{
+    auto const& c = a.children;
+    if(a.type == AST::FUNC_CALL)
+    {
+        if(c.size() != 2 || c[1].type != AST::FUNC_ARGS ||
+            c[0].type != AST::IDENT || range_ident(c[0]) != RANGE_GLOBAL ||
+            c[0].data.empty() || c[0].data[0] != '$')
+            return true;
+        std::string name(c[0].data.substr(1));
+        if(name == "load")
+            return true;
+        for(size_t i = 0; i < c[1].children.size(); ++i)
+            if(sys_arg_is_ref(name, i))
+                return true;
+    }
+    else if(is_write(a))
+    {
+        for(auto const* t = &c[0]; ; )
+        {
+            if(t->comp_type.is_ref() && t->comp_type.children[0].is_any_ref())
+                return true;
+            if(t->type == AST::IDENT)
+            {
+                int id = range_ident(*t);
+                if(id >= 0 && range_locals[id].ref)
+                    return true;
+                break;
+            }
+            if(t->type == AST::OP_CAST)
+                t = &t->children[1];
+            else if(t->type == AST::ARRAY_INDEX || t->type == AST::STRUCT_MEMBER)
+                t = &t->children[0];
+            else
+                return true;
+        }
+    }
+    for(auto const& child : c)
+        if(loop_opaque(child))
+            return true;
+    return false;
+}
+
+// find the induction variable of a for loop whose body and condition
+// (already scanned into lm) leave it alone
+void compiler_t::loop_induction(loop_motion_t& lm, ast_node_t const& a)
+{
+    auto const& s = a.children[2];
+    if(s.type != AST::EXPR_STMT || s.children.size() != 1)
+        return;
+    auto const& e = strip_casts(s.children[0]);
+    if(e.children.empty() || e.children[0].type != AST::IDENT)
+        return;
+    int id = range_ident(e.children[0]);
+    int64_t step = 0;
+    if(e.type == AST::OP_INC_POST)
+        step = 1;
+    else if(e.type == AST::OP_DEC_POST)
+        step = -1;
+    else if(e.type == AST::OP_ASSIGN)
+    {
+        auto const& x = strip_casts(e.children[1]);
+        if(x.type != AST::OP_ADDITIVE || x.children.size() != 2)
+            return;
+        auto const& v = strip_casts(x.children[0]);
+        auto const& k = strip_casts(x.children[1]);
+        if(v.type != AST::IDENT || range_ident(v) != id || k.type != AST::INT_CONST)
+            return;
+        step = x.data == "-" ? -k.value : k.value;
+    }
+    if(id < 0 || step == 0 || lm.written.count(id) != 0)
+        return;
+    auto const& v = range_locals[id];
+    auto const& t = v.type.without_ref();
+    if(!v.tracked || v.ref || t.is_bool)
+        return;
+    // the variable must not wrap, so that derived values which are wider
+    // or index arrays step with it
+    if(truncate_value(t, v.range.lo + step) != v.range.lo + step ||
+        truncate_value(t, v.range.hi + step) != v.range.hi + step)
+        return;
+    lm.iv = id;
+    lm.step = step;
+}
+
+// whether a is the induction variable, possibly converted to a type
+// that holds all of its values
+bool compiler_t::loop_is_iv(loop_motion_t const& lm, ast_node_t const& a)
+{
+    if(lm.iv < 0)
+        return false;
+    if(a.type == AST::IDENT)
+        return range_ident(a) == lm.iv;
+    if(a.type != AST::OP_CAST || !loop_is_iv(lm, a.children[1]))
+        return false;
+    auto const& t = a.comp_type;
+    if(!t.is_prim() || t.is_float || t.is_bool || t.prim_size < 1 || t.prim_size > 4)
+        return false;
+    auto const& r = range_locals[lm.iv].range;
+    return truncate_value(t, r.lo) == r.lo && truncate_value(t, r.hi) == r.hi;
+}
+
+// whether a, in its own type, is coef times the induction variable plus
+// a loop-invariant value; sets reads_globals if it reads any
+bool compiler_t::loop_affine(
+    loop_motion_t const& lm, ast_node_t const& a, int64_t& coef, bool& reads_globals)
+{
+    auto const& c = a.children;
+    auto const& t = a.comp_type.without_ref();
+    if(!t.is_prim() || t.prim_size < 1 || t.prim_size > 4)
+        return false;
+
+    // the value of child, converted to the type of a
+    int64_t k[2] = {};
+    auto operand = [&](size_t i, int64_t& x) {
+        if(!loop_affine(lm, c[i], x, reads_globals))
+            return false;
+        auto const& ct = c[i].comp_type.without_ref();
+        return x == 0 || ct.prim_size >= t.prim_size || loop_is_iv(lm, c[i]);
+    };
+    auto invariant = [&](size_t first) {
+        for(size_t i = first; i < c.size(); ++i)
+        {
+            int64_t x;
+            if(!loop_affine(lm, c[i], x, reads_globals) || x != 0)
+                return false;
+        }
+        return true;
+    };
+
+    coef = 0;
+    switch(a.type)
+    {
+    case AST::INT_CONST:
+    case AST::FLOAT_CONST:
+        return true;
+    case AST::IDENT:
+    {
+        int id = range_ident(a);
+        if(id >= 0 && id == lm.iv)
+        {
+            coef = 1;
+            return true;
+        }
+        if(id >= 0)
+        {
+            auto const& v = range_locals[id];
+            return !v.addressed && !v.ref && lm.written.count(id) == 0;
+        }
+        if(id != RANGE_GLOBAL)
+            return false;
+        std::string name(a.data);
+        auto it = globals.find(name);
+        if(it == globals.end() || it->second.var.type.is_any_ref() ||
+            lm.written_globals.count(name) != 0)
+            return false;
+        reads_globals = true;
+        return true;
+    }
+    case AST::OP_CAST:
+        if(!operand(1, coef))
+            return false;
+        break;
+    case AST::OP_ADDITIVE:
+        if(c.size() != 2 || !operand(0, k[0]) || !operand(1, k[1]))
+            return false;
+        coef = a.data == "-" ? k[0] - k[1] : k[0] + k[1];
+        break;
+    case AST::OP_MULTIPLICATIVE:
+        if(c.size() != 2 || !operand(0, k[0]) || !operand(1, k[1]))
+            return false;
+        if(a.data == "*")
+        {
+            if(k[0] != 0 && k[1] != 0)
+                return false;
+            if(k[0] != 0 || k[1] != 0)
+            {
+                auto const& m = c[k[0] != 0 ? 1 : 0];
+                if(m.type != AST::INT_CONST)
+                    return false;
+                coef = (k[0] + k[1]) * m.value;
+            }
+        }
+        else
+        {
+            // division by zero must not move ahead of the loop
+            if(k[0] != 0 || k[1] != 0)
+                return false;
+            if(!t.is_float && (c[1].type != AST::INT_CONST || c[1].value == 0))
+                return false;
+        }
+        break;
+    case AST::OP_SHIFT:
+    {
+        if(c.size() != 2 || !operand(0, k[0]) || !invariant(1))
+            return false;
+        if(k[0] == 0)
+            break;
+        auto const& n = strip_casts(c[1]);
+        if(a.data != "<<" || n.type != AST::INT_CONST || n.value < 0 || n.value >= 32)
+            return false;
+        coef = k[0] * (int64_t(1) << n.value);
+        break;
+    }
+    case AST::OP_UNARY:
+        if(c[0].data == "-")
+        {
+            if(!operand(1, k[1]))
+                return false;
+            coef = -k[1];
+        }
+        else if(!invariant(1))
+            return false;
+        break;
+    case AST::OP_BITWISE_AND:
+    case AST::OP_BITWISE_OR:
+    case AST::OP_BITWISE_XOR:
+    case AST::OP_RELATIONAL:
+    case AST::OP_EQUALITY:
+        if(!invariant(0))
+            return false;
+        break;
+    default:
+        return false;
+    }
+
+    if(coef == 0)
+        return true;
+    if(t.is_float || t.is_bool || coef < -0xffffffffll || coef > 0xffffffffll)
+        return false;
+    return true;
+}
+
+// structural key of an annotated expression: locals by stack slot,
+// globals by name
+void compiler_t::loop_key(
+    std::string& key, compiler_frame_t const& frame, ast_node_t const& a)
+{
+    auto const& t = a.comp_type;
+    key += std::to_string(int(a.type));
+    key += ':';
+    key += std::to_string(int(t.type));
+    key += std::to_string(t.prim_size);
+    key += t.is_signed ? 's' : 'u';
+    if(t.is_float) key += 'f';
+    if(t.is_bool) key += 'b';
+    if(t.is_prog) key += 'p';
+    switch(a.type)
+    {
+    case AST::IDENT:
+        if(auto const* local = resolve_local(frame, a))
+            key += '@' + std::to_string(local->frame_offset);
+        else
+            key += '$' + std::string(a.data);
+        break;
+    case AST::INT_CONST:
+        key += '#' + std::to_string(a.value);
+        break;
+    case AST::FLOAT_CONST:
+    {
+        uint64_t x;
+        memcpy(&x, &a.fvalue, sizeof(x));
+        key += '#' + std::to_string(x);
+        break;
+    }
+    case AST::OP_ADDITIVE:
+    case AST::OP_MULTIPLICATIVE:
+    case AST::OP_SHIFT:
+    case AST::OP_RELATIONAL:
+    case AST::OP_EQUALITY:
+    case AST::TOKEN:
+        // the operator
+        key += '\'';
+        key += a.data;
+        break;
+    default:
+        break;
+    }
+    key += '(';
+    for(auto const& child : a.children)
+    {
+        loop_key(key, frame, child);
+        key += ',';
+    }
+    key += ')';
+}
+
+// Reads a value computed before an enclosing loop in place of generating
+// a, or generates a and records it as a candidate for the loop being
+// classified. offset is the member offset passed to an array index.
+bool compiler_t::codegen_loop_value(
+    compiler_func_t& f, compiler_frame_t& frame, ast_node_t const& a, size_t* offset)
+{
+    if(&a == loop_value_skip)
+    {
+        loop_value_skip = nullptr;
+        return false;
+    }
+    if(!is_candidate(a.type))
+        return false;
+
+    bool index = offset != nullptr;
+    size_t num_elems = 0;
+    size_t elem_size = 0;
+    if(index)
+    {
+        auto const& t = a.children[0].comp_type.without_ref();
+        if(!t.is_array())
+            return false;
+        elem_size = t.children[0].prim_size;
+        if(elem_size == 0)
+            return false;
+        num_elems = t.prim_size / elem_size;
+    }
+
+    std::string key;
+    for(size_t i = loop_motion.size(); i-- > 0;)
+    {
+        auto const& lm = loop_motion[i];
+        if(!lm.active || lm.values.empty())
+            continue;
+        if(key.empty())
+            loop_key(key, frame, a);
+        auto it = lm.value_index.find(key);
+        if(it == lm.value_index.end())
+            continue;
+        if(index && !index_in_bounds(a.children[1], num_elems))
+            continue;
+        auto const& v = lm.values[it->second];
+        f.instrs.push_back({
+            I_GETLN, a.line(), v.size, uint32_t(frame.size - v.frame_offset) });
+        frame.size += v.size;
+        return true;
+    }
+
+    // classify for the innermost loop being generated
+    size_t n = loop_motion.size();
+    while(n > 0 && !loop_motion[n - 1].active)
+        --n;
+    if(n == 0 || !loop_motion[n - 1].discover || loop_value_depth != 0)
+        return false;
+    auto& lm = loop_motion[n - 1];
+    lm.max_frame = std::max(lm.max_frame, frame.size);
+
+    loop_value_t v{};
+    if(index)
+    {
+        auto const& c = a.children;
+        auto const& t = c[0].comp_type.without_ref();
+        if(c[0].type != AST::IDENT || !c[0].comp_type.is_ref() ||
+            c[0].comp_type.children[0].is_ref() || !loop_is_iv(lm, c[1]))
+            return false;
+        int id = range_ident(c[0]);
+        if(id == RANGE_UNSEEN || (id >= 0 && lm.declared.count(id) != 0))
+            return false;
+        if(!index_in_bounds(c[1], num_elems))
+            return false;
+        v.size = t.is_prog ? 3 : 2;
+        v.delta = int64_t(elem_size) * lm.step;
+    }
+    else
+    {
+        auto const& t = a.comp_type;
+        int64_t coef = 0;
+        if(!t.is_prim() || !reads_variable(a) || !loop_affine(lm, a, coef, v.globals))
+            return false;
+        v.size = uint8_t(t.prim_size);
+        v.delta = coef * lm.step;
+    }
+    v.index = index;
+
+    if(key.empty())
+        loop_key(key, frame, a);
+    size_t instrs = f.instrs.size();
+    size_t size = frame.size;
+    bool folded = index && *offset != 0;
+    loop_value_skip = &a;
+    ++loop_value_depth;
+    if(index)
+        codegen_expr_array_index(f, frame, a, *offset);
+    else
+        codegen_expr(f, frame, a, false);
+    --loop_value_depth;
+    loop_value_skip = nullptr;
+    if(!errs.empty() || frame.size != size + v.size)
+        return true;
+    // a member offset folded into the address is added after the read
+    if(folded && *offset != 0)
+        folded = false;
+
+    // lm may have moved while generating a
+    auto& candidates = loop_motion[n - 1].candidates;
+    auto [it, inserted] = candidates.try_emplace(key);
+    if(inserted)
+    {
+        v.expr = a;
+        v.expr.parent = nullptr;
+        set_parents(v.expr);
+        v.order = candidates.size();
+        it->second = std::move(v);
+    }
+    it->second.saved += instr_weight(f.instrs, instrs) - 1 - (folded ? 2 : 0);
+    return true;
+}
+
+void compiler_t::codegen_loop_iter(
+    compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a, size_t lm)
+{
+    codegen(f, frame, a.children[2]);
+    if(lm == SIZE_MAX)
+        return;
+    auto line = a.children[2].line();
+    for(auto const& v : loop_motion[lm].values)
+    {
+        if(v.delta == 0)
+            continue;
+        f.instrs.push_back({
+            I_GETLN, line, v.size, uint32_t(frame.size - v.frame_offset) });
+        frame.size += v.size;
+        for(size_t i = 0; i < v.size; ++i)
+            f.instrs.push_back({ I_PUSH, line, uint8_t(uint64_t(v.delta) >> (i * 8)) });
+        f.instrs.push_back({ instr_t(I_ADD + v.size - 1), line });
+        f.instrs.push_back({
+            I_SETLN, line, v.size, uint32_t(frame.size - v.frame_offset - v.size) });
+        frame.size -= v.size;
+    }
+}
+
+void compiler_t::codegen_loop_motion(
+    compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a, size_t prev_instrs)
+{
+    if(!enable_loop_motion)
+    {
+        codegen_loop(f, frame, a, prev_instrs, SIZE_MAX);
+        return;
+    }
+
+    bool is_for = a.type == AST::FOR_STMT;
+    loop_motion_t lm{};
+    lm.iv = -1;
+    lm.active = true;
+    lm.discover = true;
+    lm.max_frame = frame.size;
+    loop_scan(lm, a.children[0]);
+    loop_scan(lm, a.children[1]);
+    if(is_for)
+    {
+        loop_induction(lm, a);
+        loop_scan(lm, a.children[2]);
+    }
+
+    size_t start = f.instrs.size();
+    size_t start_cold = cold_instrs.size();
+    size_t num_warns = warns.size();
+    size_t index = loop_motion.size();
+    loop_motion.push_back(std::move(lm));
+    codegen_loop(f, frame, a, prev_instrs, index);
+    lm = std::move(loop_motion.back());
+    loop_motion.pop_back();
+    if(!errs.empty() || !lm.active || lm.candidates.empty())
+        return;
+
+    // most instructions saved per stack byte first
+    int opaque = -1;
+    std::vector<std::pair<std::string const*, loop_value_t*>> chosen;
+    for(auto& [key, v] : lm.candidates)
+    {
+        if(v.delta != 0)
+            v.saved -= LOOP_ADVANCE_INSTRS;
+        if(v.saved < LOOP_MIN_SAVED)
+            continue;
+        if(v.globals)
+        {
+            if(opaque < 0)
+                opaque = loop_opaque(a.children[0]) || loop_opaque(a.children[1]) ||
+                    (is_for && loop_opaque(a.children[2]));
+            if(opaque)
+                continue;
+        }
+        chosen.push_back({ &key, &v });
+    }
+    std::sort(chosen.begin(), chosen.end(), [](auto const& x, auto const& y) {
+        auto const& p = *x.second;
+        auto const& q = *y.second;
+        if(p.saved * q.size != q.saved * p.size)
+            return p.saved * q.size > q.saved * p.size;
+        return p.order < q.order;
+    });
+    size_t bytes = 0;
+    auto kept = chosen.begin();
+    for(auto const& c : chosen)
+    {
+        size_t size = c.second->size;
+        if(bytes + size > loop_motion_max_bytes ||
+            lm.max_frame + bytes + size > LOOP_MAX_FRAME)
+            continue;
+        bytes += size;
+        *kept++ = c;
+    }
+    chosen.erase(kept, chosen.end());
+    if(chosen.empty())
+        return;
+    std::sort(chosen.begin(), chosen.end(), [](auto const& x, auto const& y) {
+        return x.second->order < y.second->order;
+    });
+    for(auto const& [key, v] : chosen)
+    {
+        lm.value_index[*key] = lm.values.size();
+        lm.values.push_back(std::move(*v));
+    }
+    lm.candidates.clear();
+
+    f.instrs.resize(start);
+    cold_instrs.resize(start_cold);
+    warns.erase(warns.begin() + num_warns, warns.end());
+    frame.push();
+    for(auto& v : lm.values)
+    {
+        v.frame_offset = frame.size;
+        auto const& e = v.expr;
+        if(!v.index)
+            codegen_expr(f, frame, e, false);
+        else
+        {
+            // address of the element indexed by the first value
+            auto const& t = e.children[0].comp_type.without_ref();
+            uint32_t elem_size = uint32_t(t.children[0].prim_size);
+            auto line = e.line();
+            codegen_expr_ident(f, frame, e.children[0], 0);
+            codegen_expr(f, frame, e.children[1], false);
+            codegen_convert(
+                f, frame, e,
+                v.size == 3 ? TYPE_U24 : TYPE_U16,
+                e.children[1].comp_type);
+            if(elem_size != 1)
+            {
+                for(size_t i = 0; i < v.size; ++i)
+                    f.instrs.push_back({ I_PUSH, line, uint8_t(elem_size >> (i * 8)) });
+                f.instrs.push_back({ instr_t(I_MUL + v.size - 1), line });
+            }
+            f.instrs.push_back({ instr_t(I_ADD + v.size - 1), line });
+            frame.size -= v.size;
+        }
+        frame.scopes.back().size += v.size;
+    }
+    lm.discover = false;
+    loop_motion.push_back(std::move(lm));
+    codegen_loop(f, frame, a, prev_instrs, index);
+    loop_motion.pop_back();
+    f.instrs.push_back({ I_POPN, a.line(), uint8_t(bytes) });
+    frame.pop();
+}
+
+// Whether num copies of a loop body are smaller than the loop. The
+// loop's init and entry condition, from prev_instrs to body_start, also
+// stand in for the condition it repeats at the bottom.
+bool compiler_t::unrolled_smaller(
+    compiler_func_t const& f, size_t prev_instrs, size_t body_start, size_t num) const
+{
+    auto const* p = f.instrs.data();
+    auto head = instrs_cost(p + prev_instrs, p + body_start).bytes;
+    auto body = instrs_cost(p + body_start, p + f.instrs.size()).bytes;
+    return num * body <= head * 2 + body;
+}
+
+void compiler_t::codegen_loop(
+    compiler_func_t& f, compiler_frame_t& frame, ast_node_t& a,
+    size_t prev_instrs, size_t lm)
+{
+    bool is_for = (a.type == AST::FOR_STMT);
+    bool is_do_while = (a.type == AST::DO_WHILE_STMT);
+    bool nocond = (a.children[0].type == AST::INT_CONST && a.children[0].value != 0);
+    std::string end = new_label(f);
+    size_t prev_cold = cold_instrs.size();
+
+    // hot loops unroll further, and cold loops only to save space
+    auto temp = temperature(profile_hits(f, a, true));
+    auto loop_goal = goal(temp);
+    size_t scale = temp == TEMP_HOT ? profile_hot_scale : 1;
+
+    if(!is_do_while && !nocond)
+    {
+        // duplicate codegen for condition
+        codegen_expr(f, frame, a.children[0], false);
+        codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
+        f.instrs.push_back({ I_BZ, a.children[0].line(), 0, 0, end });
+        frame.size -= 1;
+    }
+    size_t body_start = f.instrs.size();
+    std::string start = codegen_label(f);
+    std::string cont = is_for ? new_label(f) : start;
+
+    // the condition holds throughout the body, which is entered
+    // only after it is checked
+    size_t facts = is_do_while ? 0 :
+        push_range_facts(a.children[0], a.children[1], nullptr);
+    break_stack.push_back({ end, frame.size });
+    continue_stack.push_back({ cont, frame.size });
+    codegen(f, frame, a.children[1]);
+    pop_range_facts(facts);
+    if(is_for)
+    {
+        codegen_label(f, cont);
+        codegen_loop_iter(f, frame, a, lm);
+    }
+    break_stack.pop_back();
+    continue_stack.pop_back();
+    if(lm != SIZE_MAX)
+        loop_motion[lm].discover = false;
+
+    size_t body_instrs = f.instrs.size() - prev_instrs;
+    unroll_info_t u;
+    bool hoisted = lm != SIZE_MAX && !loop_motion[lm].values.empty();
+    if(enable_sized_unrolling && is_for && !hoisted && can_unroll_for_loop_sized(a, u) &&
+        u.num * body_instrs <= unroll_sized_max_instrs * scale &&
+        u.num <= unroll_sized_max_iters * scale && (
+        loop_goal != OPT_GOAL_SIZE || unrolled_smaller(f, prev_instrs, body_start, u.num)))
+    {
+        if(lm != SIZE_MAX)
+            loop_motion[lm].active = false;
+        f.instrs.resize(prev_instrs);
+        cold_instrs.resize(prev_cold);
+        if(is_for) { frame.pop(); frame.push(); }
+        unroll_loop_sized(a, u, f, frame);
+        return;
+    }
+
+    // TODO: unrolling can defeat/prevent inlining if body contains function call
+
+    // unsized loop unroll (always adds code)
+    if(enable_unsized_unrolling && loop_goal != OPT_GOAL_SIZE && unroll_unsized_max_iters > 1 &&
+        body_instrs <= unroll_unsized_max_add_instrs * scale)
+    {
+        size_t extra_instrs = body_instrs;
+        for(size_t i = 1; i < unroll_unsized_max_iters * scale; ++i)
+        {
+            if(!nocond)
+            {
+                codegen_expr(f, frame, a.children[0], false);
+                codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
+                f.instrs.push_back({ I_BZ, a.children[0].line(), 0, 0, end });
+                frame.size -= 1;
+            }
+
+            // TODO: continue defeats unrolling
+
+            break_stack.push_back({ end, frame.size });
+            continue_stack.push_back({ cont, frame.size });
+            facts = push_range_facts(a.children[0], a.children[1], nullptr);
+            codegen(f, frame, a.children[1]);
+            pop_range_facts(facts);
+            if(is_for)
+                codegen_loop_iter(f, frame, a, lm);
+            break_stack.pop_back();
+            continue_stack.pop_back();
+
+            extra_instrs += body_instrs;
+            if(extra_instrs > unroll_unsized_max_add_instrs * scale)
+                break;
+        }
+        if(!nocond)
+        {
+            codegen_expr(f, frame, a.children[0], false);
+            codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
+            f.instrs.push_back({ I_BNZ, a.children[0].line(), 0, 0, start });
+            frame.size -= 1;
+        }
+        else
+            f.instrs.push_back({ I_JMP, a.children[0].line(), 0, 0, start });
+        codegen_label(f, end);
+        return;
+    }
+
+    if(!nocond)
+    {
+        codegen_expr(f, frame, a.children[0], false);
+        codegen_convert(f, frame, a, TYPE_BOOL, a.children[0].comp_type);
+        f.instrs.push_back({ I_BNZ, a.children[0].line(), 0, 0, start });
+        frame.size -= 1;
+    }
+    else
+    {
+        f.instrs.push_back({ I_JMP, a.children[0].line(), 0, 0, start });
+    }
+    codegen_label(f, end);
+}
+
+}
@@ -1,10 +1,24 @@
 #include "abc_compiler.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iterator>
 
 namespace abc
 {
 
+static char const* const OPT_PASS_NAMES[NUM_OPT_PASSES] =
+{
+    "inline",
+    "reduce",
+    "ir",
+    "peephole",
+    "remove labels",
+    "merge labels",
+    "stack",
+};
+
 void compiler_t::optimize()
 {
 #ifndef NDEBUG
@@ -15,11 +29,24 @@ void compiler_t::optimize()
     }
 #endif
 
+    opt_stat = {};
+    call_graph.clear();
+    for(int p = 0; p < NUM_OPT_PASSES; ++p)
+        opt_stat.passes[p].name = OPT_PASS_NAMES[p];
+    for(auto& [n, f] : funcs)
+    {
+        f.version = 1;
+        std::fill(std::begin(f.clean_version), std::end(f.clean_version), 0);
+    }
+
     for(bool repeat = true; repeat;)
     {
         repeat = false;
+        ++opt_stat.rounds[0];
         if(enable_inlining)
-            repeat |= inline_or_remove_functions();
+            repeat |= optimize_global(OPT_INLINE, [this] {
+                return inline_or_remove_functions();
+            });
 
         // compute progdata offsets
         {
@@ -42,43 +69,139 @@ void compiler_t::optimize()
             }
         }
 
-        for(auto& [n, f] : funcs)
-        {
-            if(!errs.empty())
-                return;
+        if(!errs.empty())
+            return;
+        optimize_funcs(OPT_REDUCE, [this](compiler_func_t& f) {
+            bool t = false;
             while(peephole_reduce(f))
-                ;
+                t = true;
             while(peephole_reduce_bake_pushl(f))
-                ;
-        }
-        repeat |= remove_unreferenced_labels();
-        repeat |= merge_adjacent_labels();
+                t = true;
+            return t;
+        });
+        repeat |= optimize_funcs(OPT_IR, [this](compiler_func_t& f) {
+            return optimize_ir(f);
+        });
+        repeat |= optimize_global(OPT_REMOVE_LABELS, [this] {
+            return remove_unreferenced_labels();
+        });
+        repeat |= optimize_global(OPT_MERGE_LABELS, [this] {
+            return merge_adjacent_labels();
+        });
         repeat |= optimize_stack();
     }
 
     for(bool repeat = true; repeat;)
     {
         repeat = false;
-        for(auto& [n, f] : funcs)
-        {
-            if(!errs.empty())
-                return;
+        ++opt_stat.rounds[1];
+        if(!errs.empty())
+            return;
+        optimize_funcs(OPT_PEEPHOLE, [this](compiler_func_t& f) {
+            // catch tail calls exposed by the whole-program passes
+            bool t = tail_call_optimization(f);
             while(peephole_reduce(f))
-                ;
+                t = true;
             while(peephole(f))
-                ;
+                t = true;
             while(peephole_reduce(f))
-                ;
+                t = true;
             while(peephole(f))
-                ;
-        }
-        repeat |= remove_unreferenced_labels();
-        repeat |= merge_adjacent_labels();
+                t = true;
+            return t;
+        });
+        repeat |= optimize_global(OPT_REMOVE_LABELS, [this] {
+            return remove_unreferenced_labels();
+        });
+        repeat |= optimize_global(OPT_MERGE_LABELS, [this] {
+            return merge_adjacent_labels();
+        });
         repeat |= optimize_stack();
     }
 
 }
 
+static double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+bool compiler_t::optimize_global(opt_pass_t pass, std::function<bool()> const& fn)
+{
+    auto& s = opt_stat.passes[pass];
+    phase_timer_t timer(time_rep, s.name, [this] { return instr_count(); });
+    auto t0 = std::chrono::steady_clock::now();
+    opt_changes = 0;
+    s.visited += funcs.size();
+    bool t = fn();
+    s.changed += opt_changes;
+    s.runs += 1;
+    s.seconds += seconds_since(t0);
+    return t;
+}
+
+// Runs a per-function pass on every function it has not already left
+// unchanged at its current version. The result is the same as running
+// the pass on all functions: the pass is deterministic, and only reads
+// the function itself and progdata, which is fixed during optimization.
+// A pass returns true if and only if it changed the function.
+bool compiler_t::optimize_funcs(
+    opt_pass_t pass, std::function<bool(compiler_func_t&)> const& fn)
+{
+    auto& s = opt_stat.passes[pass];
+    phase_timer_t timer(time_rep, s.name, [this] { return instr_count(); });
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<compiler_func_t*> work;
+    for(auto& [n, f] : funcs)
+    {
+        if(f.clean_version[pass] == f.version)
+            s.skipped += 1;
+        else
+            work.push_back(&f);
+    }
+
+    std::atomic<bool> t{ false };
+    std::atomic<size_t> changed{ 0 };
+    for_each_func(work, [&](compiler_func_t& f) {
+#ifndef NDEBUG
+        auto instrs = f.instrs;
+        auto label_count = f.label_count;
+#endif
+        if(fn(f))
+        {
+            t = true;
+            f.version += 1;
+            changed += 1;
+        }
+        else
+        {
+            // a pass must report every change it makes
+            assert(f.instrs == instrs && f.label_count == label_count);
+            f.clean_version[pass] = f.version;
+        }
+    });
+
+    s.visited += work.size();
+    s.changed += changed;
+    s.runs += 1;
+    s.seconds += seconds_since(t0);
+    return t;
+}
+
+size_t compiler_t::instr_count() const
+{
+    size_t n = 0;
+    for(auto const& [name, f] : funcs)
+        n += f.instrs.size();
+    return n;
+}
+
+void compiler_t::func_changed(compiler_func_t& f)
+{
+    f.version += 1;
+    opt_changes += 1;
+}
+
 bool compiler_t::peephole(compiler_func_t& f)
 {
     bool t = false;
@@ -111,7 +234,7 @@ bool compiler_t::peephole(compiler_func_t& f)
         while(peephole_jmp_to_ret(f))
             t = true;
 
-    if(t) tail_call_optimization();
+    if(t) tail_call_optimization(f);
 
     return t;
 }
@@ -125,41 +248,44 @@ void compiler_t::clear_removed_instrs(std::vector<compiler_instr_t>& instrs)
     instrs.erase(end, instrs.end());
 }
 
-void compiler_t::tail_call_optimization()
+bool compiler_t::tail_call_optimization(compiler_func_t& f)
 {
-    for(auto& [n, f] : funcs)
+    bool t = false;
+    for(size_t i = 0; i + 1 < f.instrs.size(); ++i)
     {
-        for(size_t i = 0; i + 1 < f.instrs.size(); ++i)
+        auto& i0 = f.instrs[i + 0];
+        auto& i1 = f.instrs[i + 1];
+        if(i0.instr == I_CALL && i1.instr == I_RET)
         {
-            auto& i0 = f.instrs[i + 0];
-            auto& i1 = f.instrs[i + 1];
-            if(i0.instr == I_CALL && i1.instr == I_RET)
-            {
-                i0.instr = I_JMP;
-                i1.instr = I_REMOVE;
-                clear_removed_instrs(f.instrs);
-            }
+            i0.instr = I_JMP;
+            i1.instr = I_REMOVE;
+            clear_removed_instrs(f.instrs);
+            t = true;
         }
     }
+    return t;
 }
 
 bool compiler_t::remove_unreferenced_labels()
 {
-    std::unordered_map<std::string, int> label_counts;
+    std::unordered_set<symbol_t> referenced;
     for(auto const& [n, f] : funcs)
         for(auto const& i : f.instrs)
             if(!i.is_label && !i.label.empty())
-                label_counts[i.label] += 1;
+                referenced.insert(i.label);
     for(auto const& [k, d] : progdata)
         for(auto const& p : d.relocs_prog)
-            label_counts[p.second] += 1;
+            referenced.insert(p.second);
     bool t = false;
     for(auto& [n, f] : funcs)
     {
+        size_t size = f.instrs.size();
         for(auto& i : f.instrs)
-            if(i.is_label && label_counts[i.label] == 0)
+            if(i.is_label && referenced.count(i.label) == 0)
                 i.instr = I_REMOVE, t = true;
         clear_removed_instrs(f.instrs);
+        if(f.instrs.size() != size)
+            func_changed(f);
     }
     return t;
 }
@@ -167,79 +293,77 @@ bool compiler_t::remove_unreferenced_labels()
 bool compiler_t::merge_adjacent_labels()
 {
     bool t = false;
+    std::unordered_map<symbol_t, symbol_t> merged;
     for(auto& [n, f] : funcs)
     {
+        // each run of labels is replaced by its first label
+        merged.clear();
         for(size_t i = 0; i < f.instrs.size(); ++i)
         {
             if(!f.instrs[i].is_label) continue;
-            for(size_t j = i + 1; j < f.instrs.size(); ++j)
+            size_t j = i + 1;
+            for(; j < f.instrs.size() && f.instrs[j].is_label; ++j)
             {
-                auto& j0 = f.instrs[j];
-                if(!j0.is_label)
-                    break;
-
-                for(auto& ti : f.instrs)
-                    if(!ti.is_label && ti.label == j0.label)
-                        ti.label = f.instrs[i].label;
-
-                j0.instr = I_REMOVE;
+                merged[f.instrs[j].label] = f.instrs[i].label;
+                f.instrs[j].instr = I_REMOVE;
                 t = true;
             }
+            i = j - 1;
         }
+        if(merged.empty()) continue;
+        for(auto& ti : f.instrs)
+            if(!ti.is_label)
+                if(auto it = merged.find(ti.label); it != merged.end())
+                    ti.label = it->second;
         clear_removed_instrs(f.instrs);
+        func_changed(f);
     }
     return t;
 }
 
-bool compiler_t::is_inlinable(
-    std::string const& func, std::unordered_set<std::string>& refs)
+bool compiler_t::should_inline(std::string const& func, size_t ref_count)
 {
-    if(refs.count(func)) return false;
-    auto it = funcs.find(func);
-    if(it == funcs.end())
-        return true;
-    auto const& f = it->second;
-    refs.insert(func);
-    for(auto const& i : f.instrs)
-    {
-        if(!i.is_label && !i.label.empty() && !is_inlinable(i.label, refs))
-            return false;
-    }
-    return true;
-}
-
-bool compiler_t::is_inlinable(std::string const& func)
-{
-    std::unordered_set<std::string> refs;
-    return is_inlinable(func, refs);
-}
-
-bool compiler_t::should_inline(std::string const& func, int ref_count)
-{
-    if(!is_inlinable(func)) return false;
     if(!funcs.count(func)) return false;
     if(ref_count == 1) return true;
 #if 0
     return false;
 #else
-    auto const& instrs = funcs[func].instrs;
+    auto const& callee = funcs[func];
+    auto const& instrs = callee.instrs;
+    if(goal(callee.temp) == OPT_GOAL_SIZE)
+    {
+        // each call site gets a copy of the body without its RET, and the
+        // function and its calls go away
+        uint64_t bytes = instrs_cost(instrs).bytes;
+        compiler_instr_t call{ I_CALL };
+        return ref_count * (bytes - 1) <= bytes + ref_count * instr_bytes(call);
+    }
     if(instrs.size() <= 8) return true;
-    if((size_t)(ref_count - 1) * instrs.size() <= inlining_max_add_instrs)
+    size_t max_add = inlining_max_add_instrs;
+    if(callee.temp == TEMP_HOT)
+        max_add *= profile_hot_scale;
+    if((ref_count - 1) * instrs.size() <= max_add)
         return true;
     return false;
 #endif
 }
 
-bool compiler_t::inline_function(std::string const& func)
+bool compiler_t::inline_function(symbol_t func)
 {
     auto it = funcs.find(func);
     assert(it != funcs.end());
     if(it == funcs.end()) return false;
     auto const& f = it->second;
     bool t = false;
-    for(auto& [tn, tf] : funcs)
+    std::vector<symbol_t> callers;
+    for(auto const& [cn, count] : call_graph[func].callers)
+        if(cn != func)
+            callers.push_back(cn);
+    std::unordered_map<symbol_t, symbol_t> renamed;
+    for(symbol_t cn : callers)
     {
-        if(tn == func) continue;
+        auto& tf = funcs[cn];
+        bool ft = false;
         for(size_t i = 0; i < tf.instrs.size(); ++i)
         {
             auto& ti = tf.instrs[i];
@@ -257,67 +381,89 @@ bool compiler_t::inline_function(std::string const& func)
             auto func_instrs = f.instrs;
             auto ret_label = new_label(tf);
             func_instrs.push_back({ I_NOP, 0, 0, 0, ret_label, true });
+
+            // need to rename labels in case of multiple inlining
+            renamed.clear();
             for(auto& fi : func_instrs)
             {
                 if(fi.is_label)
                 {
-                    // need to rename label in case of multiple inlining
-                    auto replacement_label = new_label(tf);
-                    for(auto& tfi : func_instrs)
-                    {
-                        if(!tfi.is_label && tfi.label == fi.label)
-                            tfi.label = replacement_label;
-                    }
+                    symbol_t replacement_label = new_label(tf);
+                    renamed.emplace(fi.label, replacement_label);
                     fi.label = replacement_label;
-                    continue;
                 }
+            }
+            for(auto& fi : func_instrs)
+            {
+                if(fi.is_label)
+                    continue;
                 if(fi.instr == I_RET)
                 {
                     fi.instr = I_JMP;
                     fi.label = ret_label;
                 }
+                if(auto rit = renamed.find(fi.label); rit != renamed.end())
+                    fi.label = rit->second;
             }
 
             tf.instrs.erase(tf.instrs.begin() + i);
             tf.instrs.insert(tf.instrs.begin() + i, func_instrs.begin(), func_instrs.end());
-            t = true;
+            ft = true;
         }
+        if(!ft) continue;
+        func_changed(tf);
+        index_callees(cn, tf);
+        t = true;
     }
     if(t)
+    {
+        unlink_callees(func);
+        call_graph.erase(func);
         funcs.erase(func);
+    }
     return t;
 }
 
+// Functions are visited bottom-up, so a function is inlined into its
+// callers after its own callees have been inlined into it.
 bool compiler_t::inline_or_remove_functions()
 {
-    std::unordered_map<std::string, std::pair<int, int> > func_refs;
-    for(auto const& [n, f] : funcs)
-    {
-        func_refs[n] = {};
-        for(auto const& [tn, tf] : funcs)
-        {
-            for(auto const& i : tf.instrs)
-                if(!i.is_label && i.label == n)
-                {
-                    auto& p = func_refs[n];
-                    p.first += 1;
-                    if(i.instr == I_CALL)
-                        p.second += 1;
-                }
-        }
-    }
+    static symbol_t const main_sym = "main";
+    static symbol_t const globinit_sym = "$globinit";
+
+    update_call_graph();
+    std::unordered_set<symbol_t> recursive;
+    auto order = call_graph_order(recursive);
+
+    // inlining renames labels, so functions whose labels are referenced
+    // from progdata (e.g., switch jump tables) stay where they are
+    std::unordered_set<symbol_t> data_labels;
+    for(auto const& [k, d] : progdata)
+        for(auto const& p : d.relocs_prog)
+            data_labels.insert(p.second);
+    auto has_data_labels = [&](symbol_t n) {
+        for(auto const& i : funcs[n].instrs)
+            if(i.is_label && data_labels.count(i.label))
+                return true;
+        return false;
+    };
 
     bool t = false;
-    for(auto const& [n, p] : func_refs)
+    for(symbol_t n : order)
     {
-        if(n == "main") continue;
-        if(n == "$globinit") continue;
-        if(p.first == 0)
+        if(n == main_sym) continue;
+        if(n == globinit_sym) continue;
+        auto it = call_graph.find(n);
+        if(it == call_graph.end()) continue; // already removed
+        auto const& node = it->second;
+        if(node.num_refs == 0)
         {
-            funcs.erase(n);
+            remove_function(n);
             t = true;
         }
-        else if(p.first == p.second && should_inline(n, p.first))
+        else if(node.num_refs == node.num_calls &&
+            !recursive.count(n) && !has_data_labels(n) &&
+            should_inline(n, node.num_refs))
         {
             inline_function(n);
             t = true;
@@ -326,7 +472,6 @@ bool compiler_t::inline_or_remove_functions()
     return t;
 }
 
-
 bool compiler_t::peephole_reduce_bake_pushl(compiler_func_t& f)
 {
     bool t = false;
@@ -344,8 +489,7 @@ bool compiler_t::peephole_reduce_bake_pushl(compiler_func_t& f)
                 auto offset = it->second.offset + i0.imm;
                 i0.instr = I_PUSH;
                 i0.imm = uint8_t(offset >> 0);
-                std::string empty;
-                i0.label.swap(empty);
+                i0.label = {};
                 f.instrs.insert(f.instrs.begin() + i, 2, i0);
                 f.instrs[i + 1].imm = uint8_t(offset >> 8);
                 f.instrs[i + 2].imm = uint8_t(offset >> 16);
@@ -358,6 +502,23 @@ bool compiler_t::peephole_reduce_bake_pushl(compiler_func_t& f)
     return t;
 }
 
+// constant shifts with the VM's semantics for counts of the operand
+// width or more
+static uint32_t shift_lsl(uint32_t x, uint32_t n)
+{
+    return n >= 32 ? 0 : x << n;
+}
+
+static uint32_t shift_lsr(uint32_t x, uint32_t n)
+{
+    return n >= 32 ? 0 : x >> n;
+}
+
+static uint32_t shift_asr(int32_t x, uint32_t n)
+{
+    return n >= 32 ? (x < 0 ? 0xffffffffu : 0) : uint32_t(x >> n);
+}
+
 bool compiler_t::peephole_reduce(compiler_func_t& f)
 {
     bool t = false;
@@ -582,7 +743,7 @@ bool compiler_t::peephole_reduce(compiler_func_t& f)
         }
 
         // replace PUSHL <LABEL>; GETPN <N> with a bunch of pushes
-        if(i0.instr == I_PUSHL && i1.instr == I_GETPN && i1.imm <= 16)
+        if(i0.instr == I_PUSHL && i1.instr == I_GETPN && i1.imm <= max_getpn_bake)
         {
             // locate label
             auto offset = i0.imm;
@@ -613,6 +774,12 @@ bool compiler_t::peephole_reduce(compiler_func_t& f)
             }
             if(!d) continue;
 
+            std::vector<compiler_instr_t> baked(n, { I_PUSH, i0.line });
+            for(size_t j = 0; j < n; ++j)
+                baked[j].imm = d[j];
+            if(!cheaper(instrs_cost(baked), instrs_cost(&i0, &i1 + 1), goal(f.temp)))
+                continue;
+
             i0.instr = I_REMOVE;
             i1.instr = I_REMOVE;
 
@@ -653,8 +820,9 @@ bool compiler_t::peephole_reduce(compiler_func_t& f)
         }
 
         // replace PUSH N; LSL; with PUSH (1<<N); MUL; (N <= 7)
-        // just cause it's faster
-        if(i0.instr == I_PUSH && i0.imm <= 7 && i1.instr == I_LSL)
+        // where the multiply is faster
+        if(i0.instr == I_PUSH && i0.imm <= 7 && i1.instr == I_LSL &&
+            instr_time(I_MUL) < instr_time(I_LSL, int(i0.imm)))
         {
             i0.imm = 1u << i0.imm;
             i1.instr = I_MUL;
@@ -850,9 +1018,9 @@ bool compiler_t::peephole_reduce(compiler_func_t& f)
         if(i0.instr == I_PUSH && i1.instr == I_PUSH && (
             i2.instr == I_LSL || i2.instr == I_LSR || i2.instr == I_ASR))
         {
-            if(i2.instr == I_LSL) i0.imm = uint8_t(i0.imm << i1.imm);
-            if(i2.instr == I_LSR) i0.imm = uint8_t(i0.imm >> i1.imm);
-            if(i2.instr == I_ASR) i0.imm = uint8_t((int8_t)i0.imm >> i1.imm);
+            if(i2.instr == I_LSL) i0.imm = uint8_t(shift_lsl(i0.imm, i1.imm));
+            if(i2.instr == I_LSR) i0.imm = uint8_t(shift_lsr(i0.imm, i1.imm));
+            if(i2.instr == I_ASR) i0.imm = uint8_t(shift_asr((int8_t)i0.imm, i1.imm));
             i1.instr = I_REMOVE;
             i2.instr = I_REMOVE;
             t = true;
@@ -950,8 +1118,8 @@ bool compiler_t::peephole_reduce(compiler_func_t& f)
             case I_AND: i0.imm = uint8_t(i0.imm & i1.imm); break;
             case I_OR: i0.imm = uint8_t(i0.imm | i1.imm); break;
             case I_XOR: i0.imm = uint8_t(i0.imm ^ i1.imm); break;
-            case I_LSL: i0.imm = uint8_t(i0.imm << i1.imm); break;
-            case I_LSR: i0.imm = uint8_t(i0.imm >> i1.imm); break;
+            case I_LSL: i0.imm = uint8_t(shift_lsl(i0.imm, i1.imm)); break;
+            case I_LSR: i0.imm = uint8_t(shift_lsr(i0.imm, i1.imm)); break;
             case I_CULT: i0.imm = i0.imm < i1.imm ? 1 : 0; break;
             case I_CSLT: i0.imm = (int8_t)i0.imm < (int8_t)i1.imm ? 1 : 0; break;
             case I_BOOL2: i0.imm = i0.imm != 0 || i1.imm != 0 ? 1 : 0; break;
@@ -1032,9 +1200,9 @@ bool compiler_t::peephole_reduce(compiler_func_t& f)
             i3.instr == I_LSL2 || i3.instr == I_LSR2 || i3.instr == I_ASR2))
         {
             uint32_t imm = uint16_t(i0.imm + (i1.imm << 8));
-            if(i3.instr == I_LSL2) imm = uint16_t(imm << i2.imm);
-            if(i3.instr == I_LSR2) imm = uint16_t(imm >> i2.imm);
-            if(i3.instr == I_ASR2) imm = uint16_t((int16_t)imm >> i2.imm);
+            if(i3.instr == I_LSL2) imm = uint16_t(shift_lsl(imm, i2.imm));
+            if(i3.instr == I_LSR2) imm = uint16_t(shift_lsr(imm, i2.imm));
+            if(i3.instr == I_ASR2) imm = uint16_t(shift_asr((int16_t)imm, i2.imm));
             i0.imm = uint8_t(imm >> 0);
             i1.imm = uint8_t(imm >> 8);
             i2.instr = I_REMOVE;
@@ -1074,6 +1242,12 @@ bool compiler_t::peephole_reduce(compiler_func_t& f)
             }
             if(!d) continue;
 
+            std::vector<compiler_instr_t> baked(n, { I_PUSH, i0.line });
+            for(size_t j = 0; j < n; ++j)
+                baked[j].imm = d[j];
+            if(!cheaper(instrs_cost(baked), instrs_cost(&i0, &i3 + 1), goal(f.temp)))
+                continue;
+
             i0.instr = I_REMOVE;
             i1.instr = I_REMOVE;
             i2.instr = I_REMOVE;
@@ -1361,9 +1535,9 @@ bool compiler_t::peephole_reduce(compiler_func_t& f)
             i5.instr == I_LSL4 || i5.instr == I_LSR4 || i5.instr == I_ASR4))
         {
             uint32_t imm = i0.imm + (i1.imm << 8) + (i2.imm << 16) + (i3.imm << 24);
-            if(i5.instr == I_LSL4) imm = uint32_t(imm << i4.imm);
-            if(i5.instr == I_LSR4) imm = uint32_t(imm >> i4.imm);
-            if(i5.instr == I_ASR4) imm = uint32_t((int32_t)imm >> i4.imm);
+            if(i5.instr == I_LSL4) imm = shift_lsl(imm, i4.imm);
+            if(i5.instr == I_LSR4) imm = shift_lsr(imm, i4.imm);
+            if(i5.instr == I_ASR4) imm = shift_asr((int32_t)imm, i4.imm);
             i0.imm = uint8_t(imm >> 0);
             i1.imm = uint8_t(imm >> 8);
             i2.imm = uint8_t(imm >> 16);
@@ -2091,8 +2265,14 @@ bool compiler_t::peephole_compress_push_sequence(compiler_func_t& f)
                 {});
         }
 
+        if(pi.size() != n)
+            t = true;
         for(size_t j = 0; j < pi.size(); ++j)
+        {
+            if(pi[j].instr != I_PUSH)
+                t = true;
             f.instrs[i + j] = pi[j];
+        }
         i += std::max(n, pi.size());
     }
     clear_removed_instrs(f.instrs);
@@ -113,6 +113,14 @@ bool compiler_t::optimize_stack_func(std::vector<compiler_instr_t>& instrs)
 {
     bool t = false;
     std::unordered_set<std::string> found_labels;
+
+    // branches to each label: a PUSH ... POP pair may only span a label
+    // when every branch to it is also inside the pair
+    std::unordered_map<std::string, int> label_refs, region_refs;
+    for(auto const& i : instrs)
+        if(!i.is_label && i.instr != I_CALL && is_branch_jmp_call(i))
+            label_refs[i.label] += 1;
+
     for(size_t i = 0; i < instrs.size(); ++i)
     {
         auto& i0 = instrs[i];
@@ -177,6 +185,7 @@ bool compiler_t::optimize_stack_func(std::vector<compiler_instr_t>& instrs)
         int size = n;
         size_t j;
         found_labels.clear();
+        region_refs.clear();
         for(j = i + 1; j < instrs.size(); ++j)
         {
             auto const& ij = instrs[j];
@@ -208,8 +217,12 @@ bool compiler_t::optimize_stack_func(std::vector<compiler_instr_t>& instrs)
             }
             if(ij.instr == I_RET)
                 break;
-            if(is_branch_jmp_call(ij) && !found_labels.count(ij.label))
-                break;
+            if(is_branch_jmp_call(ij))
+            {
+                if(!found_labels.count(ij.label))
+                    break;
+                region_refs[ij.label] += 1;
+            }
             bool accessed = false;
             for(int k = 0; k < size; ++k)
             {
@@ -224,6 +237,9 @@ bool compiler_t::optimize_stack_func(std::vector<compiler_instr_t>& instrs)
             n += instr_stack_mod(ij);
         }
 
+        for(auto const& label : found_labels)
+            if(region_refs[label] != label_refs[label])
+                elim = false;
         if(!elim)
             continue;
 
@@ -330,15 +346,12 @@ bool compiler_t::optimize_stack_func(std::vector<compiler_instr_t>& instrs)
 
 bool compiler_t::optimize_stack()
 {
-    bool t = false;
-
-    for(auto& [n, f] : funcs)
-    {
+    return optimize_funcs(OPT_STACK, [this](compiler_func_t& f) {
+        bool t = false;
         while(optimize_stack_func(f.instrs))
             t = true;
-    }
-
-    return t;
+        return t;
+    });
 }
 
 }
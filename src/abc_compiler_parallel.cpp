@@ -0,0 +1,332 @@
+#include "abc_compiler.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include <cassert>
+
+namespace abc
+{
+
+// Functions generated in parallel allocate progdata under provisional
+// labels. Their allocations are replayed in function order on the main
+// compiler, which assigns the real labels exactly as a serial compile
+// would.
+static char const PROVISIONAL_PREFIX[] = "$PDW_";
+
+static bool is_provisional(std::string const& label)
+{
+    return label.compare(0, sizeof(PROVISIONAL_PREFIX) - 1, PROVISIONAL_PREFIX) == 0;
+}
+
+template<class F>
+static void parallel_for(size_t threads, size_t n, F const& f)
+{
+    std::atomic<size_t> next{ 0 };
+    auto run = [&](size_t w) {
+        for(size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+            f(w, i);
+    };
+    std::vector<std::thread> pool;
+    for(size_t w = 1; w < threads; ++w)
+        pool.emplace_back(run, w);
+    run(0);
+    for(auto& t : pool)
+        t.join();
+}
+
+size_t compiler_t::thread_count(size_t items) const
+{
+#ifdef __EMSCRIPTEN__
+    (void)items;
+    return 1;
+#else
+    size_t n = num_threads;
+    if(n == 0)
+        n = std::thread::hardware_concurrency();
+    if(n > items)
+        n = items;
+    return n == 0 ? 1 : n;
+#endif
+}
+
+void compiler_t::for_each_func(std::function<void(compiler_func_t&)> const& fn)
+{
+    std::vector<compiler_func_t*> work;
+    work.reserve(funcs.size());
+    for(auto& [n, f] : funcs)
+        work.push_back(&f);
+    for_each_func(work, fn);
+}
+
+void compiler_t::for_each_func(
+    std::vector<compiler_func_t*> const& work,
+    std::function<void(compiler_func_t&)> const& fn)
+{
+    parallel_for(thread_count(work.size()), work.size(),
+        [&](size_t, size_t i) { fn(*work[i]); });
+}
+
+// Loads every module reachable through imports from fname and parses
+// them in parallel, one level of the import graph at a time, for
+// compile_recurse to take in its usual order. Errors are kept with their
+// module and reported when compile_recurse reaches it, as in a serial
+// compile. Loading and the cache are only used from this thread.
+void compiler_t::parse_modules(std::string const& fpath, std::string const& fname)
+{
+    struct item_t
+    {
+        std::string filename;
+        std::string path;
+        parsed_module_t* m;
+    };
+
+    phase_timer_t timer(time_rep, "parse");
+    parsed_modules.clear();
+    std::vector<std::pair<std::string, std::string>> level{ { fpath, fname } };
+    while(!level.empty())
+    {
+        std::vector<item_t> items;
+        std::vector<item_t*> work;
+        for(auto const& [path, file] : level)
+        {
+            std::string filename = module_filename(path, file);
+            auto [it, added] = parsed_modules.try_emplace(filename);
+            if(!added)
+                continue;
+            auto& m = it->second;
+            m.loaded = file_loader && file_loader(filename, m.source);
+            if(m.loaded)
+                items.push_back({ filename, path, &m });
+        }
+        for(auto& i : items)
+            if(!cache_load_ast(i.filename, i.m->source, i.m->ast))
+                work.push_back(&i);
+
+        parallel_for(thread_count(work.size()), work.size(), [&](size_t, size_t i) {
+            auto& m = *work[i]->m;
+            parse(m.source, m.ast, m.errs);
+        });
+
+        level.clear();
+        for(auto const* i : work)
+            if(i->m->errs.empty())
+                cache_store_ast(i->filename, i->m->source, i->m->ast);
+        for(auto const& i : items)
+        {
+            if(!i.m->errs.empty())
+                continue;
+            for(auto const& n : i.m->ast.children)
+            {
+                if(n.type != AST::IMPORT_STMT)
+                    continue;
+                level.emplace_back();
+                import_module(n, i.path, level.back().first, level.back().second);
+            }
+        }
+    }
+}
+
+void compiler_t::codegen_functions()
+{
+    std::vector<compiler_func_t*> work;
+    for(auto& [n, f] : funcs)
+        if(f.block.type != AST::NONE)
+            work.push_back(&f);
+
+    size_t threads = thread_count(work.size());
+    if(threads <= 1)
+    {
+        for(auto& [n, f] : funcs)
+        {
+            if(!errs.empty()) return;
+            current_file = f.filename;
+            if(f.block.type == AST::NONE) continue;
+            codegen_function(f);
+        }
+        return;
+    }
+    if(!errs.empty()) return;
+
+    // each worker sees the state left by parsing: functions without their
+    // bodies, globals, types, and the progdata of global initializers
+    std::mutex loader_mutex;
+    std::vector<compiler_t> workers(threads);
+    for(auto& w : workers)
+    {
+        static_cast<compiler_options_t&>(w) = *this;
+        w.profile = profile;
+        for(auto const& [n, f] : funcs)
+        {
+            auto& wf = w.funcs[n];
+            wf.ref_type = f.ref_type;
+            wf.decl = f.decl;
+            wf.name = f.name;
+            wf.filename = f.filename;
+            wf.arg_names = f.arg_names;
+            wf.line_info = f.line_info;
+            wf.label_count = f.label_count;
+            wf.sys = f.sys;
+            wf.is_sys = f.is_sys;
+        }
+        w.globals = globals;
+        w.structs = structs;
+        w.enums = enums;
+        w.font_label_cache = font_label_cache;
+        w.progdata = progdata;
+        w.base_path = base_path;
+        w.current_path = current_path;
+        w.shades = shades;
+        w.cache_dir = cache_dir;
+        w.cache_version = cache_version;
+        w.cache_memory = cache_memory;
+        w.cache_stat = {};
+        w.file_loader = [&](std::string const& fname, std::vector<char>& d) {
+            std::lock_guard<std::mutex> lock(loader_mutex);
+            return file_loader && file_loader(fname, d);
+        };
+        w.codegen_worker = true;
+    }
+
+    std::vector<codegen_result_t> results(work.size());
+    parallel_for(threads, work.size(), [&](size_t w, size_t i) {
+        workers[w].codegen_worker_function(*work[i], *this, results[i]);
+    });
+    for(auto const& w : workers)
+    {
+        type_annotate_seconds += w.type_annotate_seconds;
+        type_annotate_runs += w.type_annotate_runs;
+        cache_stat.asset_hits += w.cache_stat.asset_hits;
+        cache_stat.asset_misses += w.cache_stat.asset_misses;
+    }
+
+    size_t i = 0;
+    for(auto& [n, f] : funcs)
+    {
+        current_file = f.filename;
+        if(f.block.type == AST::NONE) continue;
+        assert(work[i] == &f);
+        if(!merge_codegen_result(f, results[i++]))
+            return;
+    }
+}
+
+void compiler_t::codegen_worker_function(
+    compiler_func_t& f, compiler_t const& main, codegen_result_t& r)
+{
+    current_file = f.filename;
+    progdata_label_index = 0;
+    codegen_function(f);
+
+    r.errs = std::move(errs);
+    r.warns = std::move(warns);
+    r.events = std::move(codegen_events);
+    errs.clear();
+    warns.clear();
+    codegen_events.clear();
+    break_stack.clear();
+    continue_stack.clear();
+
+    // hand over the provisional progdata and undo changes to shared state
+    for(auto const& e : r.events)
+    {
+        auto node = progdata.extract(e.label);
+        if(!node.empty())
+            r.progdata.insert(std::move(node));
+        if(e.type == codegen_event_t::FONT)
+            font_label_cache.erase(e.font);
+        else if(e.type == codegen_event_t::BUILTIN_FONT)
+        {
+            auto const& mg = main.globals.at(e.global);
+            auto& g = globals[e.global];
+            g.constexpr_ref = mg.constexpr_ref;
+            g.var.label_ref = mg.var.label_ref;
+        }
+    }
+}
+
+bool compiler_t::merge_codegen_result(compiler_func_t& f, codegen_result_t& r)
+{
+    warns.insert(warns.end(), r.warns.begin(), r.warns.end());
+    if(!r.errs.empty())
+    {
+        errs.insert(errs.end(), r.errs.begin(), r.errs.end());
+        return false;
+    }
+
+    std::unordered_map<std::string, std::string> rename;
+    auto rename_label = [&](std::string& label) {
+        if(!is_provisional(label)) return;
+        auto it = rename.find(label);
+        assert(it != rename.end());
+        if(it != rename.end())
+            label = it->second;
+    };
+    auto rename_progdata = [&](compiler_progdata_t& pd) {
+        for(auto& [offset, label] : pd.relocs_prog)
+            rename_label(label);
+        for(auto& [offset, label] : pd.inter_labels)
+            rename_label(label);
+    };
+
+    // data the serial compile would have found already cached is dropped
+    std::unordered_set<std::string> dropped;
+    for(auto& e : r.events)
+    {
+        switch(e.type)
+        {
+        case codegen_event_t::LABEL:
+            rename[e.label] = progdata_label();
+            break;
+        case codegen_event_t::FONT:
+            if(auto it = font_label_cache.find(e.font); it != font_label_cache.end())
+            {
+                rename[e.label] = it->second;
+                dropped.insert(e.label);
+            }
+            else
+                rename[e.label] = font_label_cache[e.font] = progdata_label();
+            break;
+        case codegen_event_t::BUILTIN_FONT:
+        {
+            auto& g = globals[e.global];
+            if(!g.constexpr_ref.empty())
+                dropped.insert(e.label);
+            else
+            {
+                g.constexpr_ref = progdata_label();
+                g.var.label_ref = g.constexpr_ref;
+            }
+            rename[e.label] = g.constexpr_ref;
+            break;
+        }
+        default:
+            assert(false);
+            break;
+        }
+    }
+
+    for(auto& [label, pd] : r.progdata)
+    {
+        if(dropped.count(label))
+            continue;
+        auto& dst = progdata[rename[label]];
+        dst = std::move(pd);
+        rename_progdata(dst);
+    }
+
+    for(auto& i : f.instrs)
+    {
+        if(i.is_label || !is_provisional(i.label))
+            continue;
+        auto it = rename.find(i.label);
+        assert(it != rename.end());
+        if(it != rename.end())
+            i.label = it->second;
+    }
+    return true;
+}
+
+}
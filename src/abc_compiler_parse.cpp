@@ -16,14 +16,24 @@
 namespace abc
 {
 
-static peg::parser parser;
-static bool parser_initialized = false;
+// Child nodes are moved out of the semantic values, which the parser drops
+// once an action has run. Taking them by any_cast would copy the whole
+// subtree of every child at every level of the tree.
+static ast_node_t take(std::any const& a)
+{
+    return std::move(*const_cast<ast_node_t*>(std::any_cast<ast_node_t>(&a)));
+}
+
+static ast_node_t const& peek(std::any const& a)
+{
+    return *std::any_cast<ast_node_t>(&a);
+}
 
 template<AST T> ast_node_t basic(peg::SemanticValues const& v)
 {
     ast_node_t a = { v.line_info(), T, v.token() };
     for(auto& child : v)
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(child)));
+        a.children.emplace_back(take(child));
     return a;
 }
 
@@ -31,25 +41,46 @@ template<AST T> ast_node_t infix(peg::SemanticValues const& v)
 {
     size_t num_ops = v.size() / 2;
     if(num_ops == 0)
-        return std::any_cast<ast_node_t>(v[0]);
+        return take(v[0]);
     ast_node_t a{ v.line_info(), T, v.token() };
     for(auto& child : v)
-        a.children.push_back(std::any_cast<ast_node_t>(child));
+        a.children.push_back(take(child));
     return a;
 };
 
-void compiler_t::parse(std::vector<char> const& input, ast_node_t& ast)
+// The grammar and its actions are built once and shared: parsing only
+// reads them, so any number of modules may be parsed at the same time.
+struct shared_parser_t
+{
+    peg::parser parser;
+    std::vector<error_t> errs; // errors building the grammar
+};
+
+void compiler_t::parse(
+    std::vector<char> const& input, ast_node_t& ast, std::vector<error_t>& errs)
 {
-    if(!parser_initialized)
-        init_parser();
+    static shared_parser_t const shared = [] {
+        shared_parser_t s;
+        init_parser(s.parser, s.errs);
+        s.parser.set_logger(peg::Log{});
+        return s;
+    }();
+    if(!shared.errs.empty())
+    {
+        errs.insert(errs.end(), shared.errs.begin(), shared.errs.end());
+        return;
+    }
+    // copies share the grammar but each has its own logger
+    peg::parser parser = shared.parser;
+    parser.set_logger([&](size_t line, size_t column, std::string const& msg) {
+        errs.push_back({ msg, { line, column } });
+    });
     if(!parser.parse({ input.data(), input.size() }, ast) && errs.empty())
         errs.push_back({ "An unknown parse error occurred." });
 }
 
-void compiler_t::init_parser()
+void compiler_t::init_parser(peg::parser& p, std::vector<error_t>& errs)
 {
-    peg::parser& p = parser;
-
     p.set_logger([&](size_t line, size_t column, std::string const& msg) {
         errs.push_back({ msg, { line, column } });
     });
@@ -235,10 +266,10 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
     p["for_stmt"] = [](peg::SemanticValues const& v) {
         ast_node_t a{ v.line_info(), AST::BLOCK, v.token() };
         ast_node_t b{ v.line_info(), AST::FOR_STMT, v.token() };
-        auto A = std::any_cast<ast_node_t>(v[0]);
-        auto B = std::any_cast<ast_node_t>(v[1]);
-        auto C = std::any_cast<ast_node_t>(v[2]);
-        auto D = std::any_cast<ast_node_t>(v[3]);
+        auto A = take(v[0]);
+        auto B = take(v[1]);
+        auto C = take(v[2]);
+        auto D = take(v[3]);
         b.children.emplace_back(std::move(B));
         b.children.push_back({ D.line_info, AST::BLOCK, D.data, { D } });
         b.children.push_back({ C.line_info, AST::EXPR_STMT, C.data, { C } });
@@ -247,7 +278,7 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         return a;
     };
     p["for_init_stmt"] = [](peg::SemanticValues const& v) {
-        return std::any_cast<ast_node_t>(v[0]);
+        return take(v[0]);
     };
 
     p["decimal_literal"] = [](peg::SemanticValues const& v) {
@@ -306,13 +337,13 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         return { v.line_info(), AST::IDENT, v.token() };
     };
     p["type_name"] = [](peg::SemanticValues const& v) -> ast_node_t {
-        auto ident = std::any_cast<ast_node_t>(v[0]);
+        auto ident = take(v[0]);
         ast_node_t a{ v.line_info(), AST::TYPE, ident.data };
         if(ident.type == AST::TYPE_FUNC_REF)
             a = std::move(ident);
         for(size_t i = 1; i < v.size(); ++i)
         {
-            ast_node_t b = std::any_cast<ast_node_t>(v[i]);
+            ast_node_t b = take(v[i]);
             b.children.emplace_back(std::move(a));
             a = std::move(b);
         }
@@ -320,11 +351,11 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
     };
     p["type_name_base"] = [](peg::SemanticValues const& v) -> ast_node_t {
         if(v.choice() == 0)
-            return std::any_cast<ast_node_t>(v[0]);
+            return take(v[0]);
         ast_node_t a{ v.line_info(), AST::TYPE_FUNC_REF, v.token()};
         assert(v.size() == 2);
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[0])));
-        auto args = std::any_cast<ast_node_t>(v[1]);
+        a.children.emplace_back(take(v[0]));
+        auto args = take(v[1]);
         for(auto& arg : args.children)
         {
             if(arg.type == AST::TYPE)
@@ -339,7 +370,7 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
             // sized array
             return {
                 v.line_info(), AST::TYPE_ARRAY, v.token(),
-                { std::any_cast<ast_node_t>(v[0]) }
+                { take(v[0]) }
             };
         case 1:
             // reference
@@ -372,7 +403,7 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         {
             // pre-increment, pre-decrement
             // transform into child0 +=/-= 1
-            auto child0 = std::any_cast<ast_node_t>(v[0]);
+            auto child0 = take(v[0]);
             bool simple = (child0.type == AST::IDENT);
             ast_node_t a{
                 v.line_info(),
@@ -394,10 +425,10 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         case 2:
             return {
                 v.line_info(), AST::OP_UNARY, v.token(),
-                { std::any_cast<ast_node_t>(v[0]), std::any_cast<ast_node_t>(v[1]) }
+                { take(v[0]), take(v[1]) }
             };
         case 3:
-            return std::any_cast<ast_node_t>(v[0]);
+            return take(v[0]);
         default:
             assert(false);
             return {};
@@ -406,11 +437,11 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
 
     // form a left-associative binary tree
     p["postfix_expr"] = [](peg::SemanticValues const& v) -> ast_node_t {
-        ast_node_t a = std::any_cast<ast_node_t>(v[0]);
+        ast_node_t a = take(v[0]);
         if(v.size() == 1) return a;
         for(size_t i = 1; i < v.size(); ++i)
         {
-            ast_node_t b = std::any_cast<ast_node_t>(v[i]);
+            ast_node_t b = take(v[i]);
             ast_node_t pair{ v.line_info(), AST::NONE, v.token() };
             auto type = b.type;
             if(type == AST::FUNC_ARGS)
@@ -449,7 +480,7 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
             ast_node_t a = { v.line_info(), AST::FUNC_ARGS, v.token() };
             if(v.size() == 1)
             {
-                auto child = std::any_cast<ast_node_t>(v[0]);
+                auto child = take(v[0]);
                 a.children = std::move(child.children);
             }
             return a;
@@ -458,24 +489,24 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         {
             // array indexing
             ast_node_t a = { v.line_info(), AST::ARRAY_INDEX, v.token() };
-            a.children.push_back(std::any_cast<ast_node_t>(v[0]));
+            a.children.push_back(take(v[0]));
             return a;
         }
         else if(v.choice() == 1 && v.size() == 3)
         {
             // array slice
-            auto type = std::any_cast<ast_node_t>(v[1]).type;
+            auto type = peek(v[1]).type;
             assert(type == AST::ARRAY_SLICE || type == AST::ARRAY_SLICE_LEN);
             ast_node_t a = { v.line_info(), type, v.token() };
-            a.children.push_back(std::any_cast<ast_node_t>(v[0]));
-            a.children.push_back(std::any_cast<ast_node_t>(v[2]));
+            a.children.push_back(take(v[0]));
+            a.children.push_back(take(v[2]));
             return a;
         }
         else if(v.choice() == 2)
         {
             // struct member
             ast_node_t a = { v.line_info(), AST::STRUCT_MEMBER, v.token() };
-            a.children.push_back(std::any_cast<ast_node_t>(v[0]));
+            a.children.push_back(take(v[0]));
             return a;
         }
         else if(v.choice() == 3)
@@ -504,7 +535,7 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
     p["arg_expr_list"] = basic<AST::LIST>;
 
     p["primary_expr"] = [](peg::SemanticValues const& v) {
-        return std::any_cast<ast_node_t>(v[0]);
+        return take(v[0]);
     };
 
     const auto token = [](peg::SemanticValues const& v) {
@@ -535,10 +566,10 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
 
     p["conditional_expr"] = [](peg::SemanticValues const& v) -> ast_node_t {
         if(v.size() == 1)
-            return std::move(std::any_cast<ast_node_t>(v[0]));
+            return take(v[0]);
         ast_node_t a{ v.line_info(), AST::OP_TERNARY, v.token() };
         for(auto& child : v)
-            a.children.emplace_back(std::move(std::any_cast<ast_node_t>(child)));
+            a.children.emplace_back(take(child));
         return a;
     };
 
@@ -557,7 +588,7 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
             v.token()
         };
         for(auto& child : v)
-            a.children.emplace_back(std::move(std::any_cast<ast_node_t>(child)));
+            a.children.emplace_back(take(child));
         return a;
     };
 
@@ -569,20 +600,20 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
             a.children.push_back({ v.line_info(), AST::INT_CONST, "0", {}, 0 });
         }
         for(auto& child : v)
-            a.children.emplace_back(std::move(std::any_cast<ast_node_t>(child)));
+            a.children.emplace_back(take(child));
         return a;
     };
 
     p["sprite_data"] = [](peg::SemanticValues const& v) -> ast_node_t {
         if(v.choice() == 0)
         {
-            return std::any_cast<ast_node_t>(v[0]);
+            return take(v[0]);
         }
         else if(v.choice() == 1)
         {
             ast_node_t a{ v.line_info(), AST::TOKEN, v.token() };
             for(auto& child : v)
-                a.children.emplace_back(std::move(std::any_cast<ast_node_t>(child)));
+                a.children.emplace_back(take(child));
             return a;
         }
         return {};
@@ -593,15 +624,15 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         {
             ast_node_t a{ v.line_info(), AST::COMPOUND_LITERAL, v.token() };
             for(auto& child : v)
-                a.children.push_back(std::move(std::any_cast<ast_node_t>(child)));
+                a.children.push_back(take(child));
             return a;
         }
-        auto child0 = std::any_cast<ast_node_t>(v[0]);
+        auto child0 = take(v[0]);
         if(v.choice() == 4) return child0;
 
         // normal assignment
-        auto child1 = std::any_cast<ast_node_t>(v[1]);
-        auto child2 = std::any_cast<ast_node_t>(v[2]);
+        auto child1 = take(v[1]);
+        auto child2 = take(v[2]);
         assert(child1.type == AST::TOKEN);
         if(child1.data == "=")
             return { v.line_info(), AST::OP_ASSIGN, v.token(), { std::move(child0), std::move(child2) } };
@@ -636,21 +667,21 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         return a;
     };
     p["if_stmt"] = [](peg::SemanticValues const& v) -> ast_node_t {
-        auto B = std::any_cast<ast_node_t>(v[1]);
+        auto B = take(v[1]);
         ast_node_t BB{ B.line_info, AST::BLOCK, B.data };
         BB.children.emplace_back(std::move(B));
         ast_node_t a{
             v.line_info(), AST::IF_STMT, v.token(),
             //{ std::any_cast<ast_node_t>(v[0]), std::any_cast<ast_node_t>(v[1]) }
         };
-        a.children.push_back(std::any_cast<ast_node_t>(v[0]));
+        a.children.push_back(take(v[0]));
         a.children.emplace_back(std::move(BB));
         //a.children.emplace_back(std::move(B));
         // always include else clause, even if only an empty statement
         ast_node_t else_stmt{};
         if(v.size() >= 3)
         {
-            auto E = std::any_cast<ast_node_t>(v[2]);
+            auto E = take(v[2]);
             ast_node_t EB{ E.line_info, AST::BLOCK, E.data };
             EB.children.emplace_back(std::move(E));
             a.children.emplace_back(std::move(EB));
@@ -662,22 +693,22 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
     p["expr_stmt"] = [](peg::SemanticValues const& v) -> ast_node_t {
         if(v.empty()) return { v.line_info(), AST::EMPTY_STMT, v.token() };
         ast_node_t a{ v.line_info(), AST::EXPR_STMT, v.token() };
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[0])));
+        a.children.emplace_back(take(v[0]));
         return a;
     };
     p["compound_stmt"] = basic<AST::BLOCK>;
     p["func_stmt"] = [](peg::SemanticValues const& v) -> ast_node_t {
         ast_node_t a{ v.line_info(), AST::FUNC_STMT, v.token() };
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[0])));
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[1])));
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v.back())));
+        a.children.emplace_back(take(v[0]));
+        a.children.emplace_back(take(v[1]));
+        a.children.emplace_back(take(v.back()));
         auto& block = a.children.back();
         if(block.children.empty() || block.children.back().type != AST::RETURN_STMT)
             block.children.push_back({ v.line_info(), AST::RETURN_STMT, ""});
         if(v.size() == 4)
         {
             // arg decls
-            a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[2])));
+            a.children.emplace_back(take(v[2]));
         }
         else
         {
@@ -692,12 +723,12 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         if(v.size() == 1)
         {
             a.children.push_back(ast_node_t{ v.line_info(), AST::IDENT, "" });
-            a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[0])));
+            a.children.emplace_back(take(v[0]));
         }
         else
         {
-            a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[0])));
-            a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[1])));
+            a.children.emplace_back(take(v[0]));
+            a.children.emplace_back(take(v[1]));
         }
         return a;
     };
@@ -706,12 +737,12 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
 
     p["decl_stmt"] = [](peg::SemanticValues const& v) -> ast_node_t {
         ast_node_t a{ v.line_info(), AST::DECL_STMT, v.token() };
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[0])));
+        a.children.emplace_back(take(v[0]));
         if(v.choice() == 0) // constexpr
             a.children[0].comp_type.is_constexpr = true;
         if(v.choice() == 1) // saved
             a.children[0].comp_type.is_saved = true;
-        auto list = std::move(std::any_cast<ast_node_t>(v[1]));
+        auto list = take(v[1]);
         for(auto& t : list.children)
             a.children.emplace_back(std::move(t));
         return a;
@@ -719,19 +750,19 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
     p["decl_stmt_item"] = basic<AST::DECL_ITEM>;
     p["decl_stmt_item_list"] = basic<AST::LIST>;
     p["decl_expr"] = [](peg::SemanticValues const& v) -> ast_node_t {
-        return std::any_cast<ast_node_t>(v[0]);
+        return take(v[0]);
     };
     p["global_stmt"] = [](peg::SemanticValues const& v) -> ast_node_t {
-        return std::any_cast<ast_node_t>(v[0]);
+        return take(v[0]);
     };
     p["import_stmt"] = [](peg::SemanticValues const& v) -> ast_node_t {
-        return std::any_cast<ast_node_t>(v[0]);
+        return take(v[0]);
     };
     p["import_path"] = basic<AST::IMPORT_STMT>;
     p["while_stmt"] = [](peg::SemanticValues const& v) -> ast_node_t {
         ast_node_t a{ v.line_info(), AST::WHILE_STMT, v.token() };
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[0])));
-        auto B = std::any_cast<ast_node_t>(v[1]);
+        a.children.emplace_back(take(v[0]));
+        auto B = take(v[1]);
         ast_node_t block{ B.line_info, AST::BLOCK, B.data };
         block.children.emplace_back(std::move(B));
         a.children.emplace_back(std::move(block));
@@ -739,8 +770,8 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
         };
     p["do_while_stmt"] = [](peg::SemanticValues const& v) -> ast_node_t {
         ast_node_t a{ v.line_info(), AST::DO_WHILE_STMT, v.token() };
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[1])));
-        auto B = std::any_cast<ast_node_t>(v[0]);
+        a.children.emplace_back(take(v[1]));
+        auto B = take(v[0]);
         ast_node_t block{ B.line_info, AST::BLOCK, B.data };
         block.children.emplace_back(std::move(B));
         a.children.emplace_back(std::move(block));
@@ -754,17 +785,15 @@ multiline_comment   <- '/*' (! '*/' .)* '*/'
     p["switch_case"] = [](peg::SemanticValues const& v) -> ast_node_t {
         ast_node_t a{ v.line_info(), AST::SWITCH_CASE, v.token() };
         // statement first
-        a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v.back())));
+        a.children.emplace_back(take(v.back()));
         // then case items
         for(size_t i = 0; i + 1 < v.size(); ++i)
-            a.children.emplace_back(std::move(std::any_cast<ast_node_t>(v[i])));
+            a.children.emplace_back(take(v[i]));
         return a;
     };
     p["switch_case_item"] = basic<AST::SWITCH_CASE_ITEM>;
 
     p["program"] = basic<AST::PROGRAM>;
-
-    parser_initialized = true;
 }
 
 }
@@ -0,0 +1,221 @@
+#include "abc_compiler.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#include <cstring>
+
+namespace abc
+{
+
+// Profile-guided optimization.
+//
+// A profile counts how often each PC of a previous build was executed.
+// The line table of that build maps every PC to a file and source line,
+// so the profile is kept as hits per line and applies to the current
+// sources as long as they have not moved too far from the profiled ones.
+
+static bool has_dev_trailer(std::vector<uint8_t> const& b, size_t end)
+{
+    return end >= 32 &&
+        b[end - 4] == 0xAB && b[end - 3] == 0xCE &&
+        b[end - 2] == 0xEA && b[end - 1] == 0xBC;
+}
+
+static uint32_t read24(std::vector<uint8_t> const& b, size_t i)
+{
+    return (uint32_t(b[i + 0]) << 16) | (uint32_t(b[i + 1]) << 8) | b[i + 2];
+}
+
+error_t compiler_t::load_profile(std::vector<uint8_t> const& binary, std::istream& in)
+{
+    profile.reset();
+
+    // the dev trailer ends the binary, or precedes the 4 KB save area
+    size_t end = binary.size();
+    if(!has_dev_trailer(binary, end))
+        end = end >= 4096 ? end - 4096 : 0;
+    if(!has_dev_trailer(binary, end))
+        return { "Profile binary is not an ABC dev binary" };
+    end -= 6;
+
+    size_t num_files = binary[12];
+    size_t file_table = read24(binary, 13);
+    size_t line_table = read24(binary, 16);
+    if(file_table + num_files * FILE_TABLE_STRING_LENGTH > line_table ||
+        line_table > end)
+        return { "Profile binary has no valid line table" };
+
+    std::vector<std::string> files(num_files);
+    for(size_t i = 0; i < num_files; ++i)
+    {
+        char const* s = (char const*)&binary[file_table + i * FILE_TABLE_STRING_LENGTH];
+        files[i] = std::string(s, strnlen(s, FILE_TABLE_STRING_LENGTH));
+    }
+
+    // first PC of each run of code from one line
+    struct pc_line_t
+    {
+        uint32_t pc;
+        uint8_t file;
+        uint16_t line;
+    };
+    std::vector<pc_line_t> pc_lines;
+    {
+        uint32_t pc = 0;
+        uint8_t file = 0;
+        uint16_t line = 0;
+        size_t i = line_table;
+        auto advance = [&](uint32_t npc) {
+            if(npc != pc)
+                pc_lines.push_back({ pc, file, line });
+            pc = npc;
+        };
+        while(i < end)
+        {
+            uint8_t t = binary[i++];
+            if(t < 128)
+                advance(pc + t + 1);
+            else if(t <= 252)
+                line = uint16_t(line + t - 127);
+            else if(t == 253 && i + 1 <= end)
+                file = binary[i++];
+            else if(t == 254 && i + 2 <= end)
+                line = uint16_t((binary[i] << 8) | binary[i + 1]), i += 2;
+            else if(t == 255 && i + 3 <= end)
+                advance(read24(binary, i)), i += 3;
+            else
+                break;
+        }
+        // the page padding after the table only extends the last line
+        pc_lines.push_back({ pc, file, line });
+    }
+
+    auto p = std::make_shared<compiler_profile_t>();
+    p->max_hits = 0;
+    for(auto const& e : pc_lines)
+    {
+        if(e.file >= files.size() || e.line == 0)
+            continue;
+        auto& lines = p->lines[files[e.file]];
+        if(lines.size() <= e.line)
+            lines.resize(e.line + 1, -1);
+        lines[e.line] = 0;
+    }
+    std::string text;
+    size_t line_num = 0;
+    while(std::getline(in, text))
+    {
+        ++line_num;
+        auto c = text.find('#');
+        if(c != std::string::npos)
+            text.resize(c);
+        std::istringstream ss(text);
+        uint32_t pc;
+        uint64_t count;
+        if(!(ss >> std::hex >> pc))
+        {
+            if(text.find_first_not_of(" \t\r") == std::string::npos)
+                continue;
+            return { "Invalid profile entry", { line_num, 0 } };
+        }
+        if(!(ss >> std::dec >> count))
+            return { "Invalid profile entry", { line_num, 0 } };
+        auto it = std::upper_bound(pc_lines.begin(), pc_lines.end(), pc,
+            [](uint32_t pc, pc_line_t const& e) { return pc < e.pc; });
+        if(it == pc_lines.begin())
+            continue;
+        --it;
+        if(it->file >= files.size() || it->line == 0)
+            continue;
+        auto& hits = p->lines[files[it->file]][it->line];
+        hits += int64_t(count);
+        p->max_hits = std::max(p->max_hits, hits);
+    }
+
+    profile = std::move(p);
+    return {};
+}
+
+std::vector<int64_t> const* compiler_t::profile_lines(std::string const& filename) const
+{
+    if(!profile)
+        return nullptr;
+    std::string name = filename + ".abc";
+    if(name.size() >= FILE_TABLE_STRING_LENGTH)
+        name.resize(FILE_TABLE_STRING_LENGTH - 1);
+    auto it = profile->lines.find(name);
+    return it == profile->lines.end() ? nullptr : &it->second;
+}
+
+int64_t compiler_t::profile_hits(
+    compiler_func_t const& f, ast_node_t const& a, bool subtree) const
+{
+    auto const* pl = profile_lines(f.filename);
+    if(!pl)
+        return -1;
+    auto const& lines = *pl;
+
+    auto hits = [&](ast_node_t const& n) -> int64_t {
+        size_t line = n.line();
+        return line < lines.size() ? lines[line] : -1;
+    };
+    if(!subtree)
+        return hits(a);
+
+    // blocks run no code of their own: their line is usually that of the
+    // statement which owns them, e.g. "if(x) {"
+    int64_t r = -1;
+    std::function<void(ast_node_t const&)> visit = [&](ast_node_t const& n) {
+        if(n.type != AST::BLOCK)
+            r = std::max(r, hits(n));
+        for(auto const& child : n.children)
+            visit(child);
+    };
+    visit(a);
+    return r;
+}
+
+profile_temp_t compiler_t::temperature(int64_t hits) const
+{
+    if(hits < 0 || !profile || profile->max_hits == 0)
+        return TEMP_WARM;
+    uint64_t h = uint64_t(hits);
+    uint64_t max = uint64_t(profile->max_hits);
+    if(h * profile_hot_ratio >= max)
+        return TEMP_HOT;
+    if(h * profile_cold_ratio < max)
+        return TEMP_COLD;
+    return TEMP_WARM;
+}
+
+opt_goal_t compiler_t::goal(profile_temp_t temp) const
+{
+    if(temp == TEMP_HOT) return OPT_GOAL_SPEED;
+    if(temp == TEMP_COLD) return OPT_GOAL_SIZE;
+    return opt_goal;
+}
+
+// Which branch of an if statement (1: then, 2: else) to move out of line:
+// one that is rarely taken, in a statement that is not itself cold, so
+// that the common case falls through.
+size_t compiler_t::out_of_line_branch(compiler_func_t const& f, ast_node_t const& a) const
+{
+    int64_t hits = profile_hits(f, a, false);
+    if(hits <= 0 || temperature(hits) == TEMP_COLD)
+        return 0;
+    auto rare = [&](ast_node_t const& b) {
+        int64_t h = profile_hits(f, b, true);
+        return h >= 0 && uint64_t(h) * profile_branch_ratio < uint64_t(hits);
+    };
+    bool has_else = a.children[2].type != AST::EMPTY_STMT;
+    bool rare_then = rare(a.children[1]);
+    bool rare_else = has_else && rare(a.children[2]);
+    if(rare_then && !rare_else)
+        return 1;
+    if(rare_else && !rare_then)
+        return 2;
+    return 0;
+}
+
+}
@@ -1,7 +1,10 @@
 #include "abc_compiler.hpp"
 
 #include <algorithm>
+#include <functional>
 #include <sstream>
+#include <string_view>
+#include <tuple>
 
 #include <cassert>
 
@@ -13,8 +16,10 @@ namespace abc
 std::string compiler_t::progdata_label()
 {
     std::ostringstream ss;
-    ss << "$PD_" << progdata_label_index;
+    ss << (codegen_worker ? "$PDW_" : "$PD_") << progdata_label_index;
     ++progdata_label_index;
+    if(codegen_worker)
+        codegen_events.push_back({ codegen_event_t::LABEL, ss.str() });
     return ss.str();
 }
 
@@ -23,7 +28,6 @@ void compiler_t::add_custom_progdata(std::string const& label, std::vector<uint8
     auto& pdata = progdata[label];
     assert(pdata.data.empty());
     pdata.data = std::move(data);
-    try_merge_progdata(label, pdata);
 }
 
 void compiler_t::add_progdata(
@@ -32,52 +36,262 @@ void compiler_t::add_progdata(
     auto& pdata = progdata[label];
     assert(pdata.data.empty());
     progdata_expr(n, t, pdata);
-    try_merge_progdata(label, pdata);
 }
 
-void compiler_t::try_merge_progdata(
-    std::string const& label, compiler_progdata_t& pdata)
+// Suffix array of a string of symbols below 'alphabet', each separator
+// symbol occurring once (prefix doubling with counting sorts). Unique
+// separators make the order of cyclic shifts that of the suffixes.
+static std::vector<uint32_t> suffix_array(
+    std::vector<uint32_t> const& s, uint32_t alphabet)
 {
-#if 0
-    (void)label;
-    (void)pdata;
-#else
-    if(!enable_merging_progdata) return;
-    auto const& data = pdata.data;
-    if(data.empty()) return;
-    if(!pdata.relocs_glob.empty()) return;
-    if(!pdata.relocs_prog.empty()) return;
-    for(auto& [k, pd] : progdata)
+    size_t n = s.size();
+    std::vector<uint32_t> sa(n), cls(n), tsa(n), tcls(n);
+    std::vector<uint32_t> cnt(std::max<size_t>(alphabet, n), 0);
+    for(auto c : s)
+        ++cnt[c];
+    for(size_t i = 1; i < alphabet; ++i)
+        cnt[i] += cnt[i - 1];
+    for(size_t i = n; i-- > 0;)
+        sa[--cnt[s[i]]] = (uint32_t)i;
+    uint32_t classes = 1;
+    cls[sa[0]] = 0;
+    for(size_t i = 1; i < n; ++i)
     {
-        if(!pd.relocs_glob.empty() || !pd.relocs_prog.empty() || !pd.inter_labels.empty())
-            continue;
+        if(s[sa[i]] != s[sa[i - 1]])
+            ++classes;
+        cls[sa[i]] = classes - 1;
+    }
+    for(size_t k = 1; classes < n; k <<= 1)
+    {
+        // sort by the class of the second half, then stably by the first
+        for(size_t i = 0; i < n; ++i)
+            tsa[i] = uint32_t((sa[i] + n - k % n) % n);
+        std::fill(cnt.begin(), cnt.begin() + classes, 0);
+        for(size_t i = 0; i < n; ++i)
+            ++cnt[cls[tsa[i]]];
+        for(size_t i = 1; i < classes; ++i)
+            cnt[i] += cnt[i - 1];
+        for(size_t i = n; i-- > 0;)
+            sa[--cnt[cls[tsa[i]]]] = tsa[i];
+        tcls[sa[0]] = 0;
+        classes = 1;
+        for(size_t i = 1; i < n; ++i)
+        {
+            size_t a = sa[i], b = sa[i - 1];
+            if(cls[a] != cls[b] || cls[(a + k) % n] != cls[(b + k) % n])
+                ++classes;
+            tcls[a] = classes - 1;
+        }
+        cls.swap(tcls);
+    }
+    return sa;
+}
 
-        if(data.size() > pd.data.size())
+// lcp[i] is the length of the common prefix of suffixes sa[i - 1] and sa[i]
+static std::vector<uint32_t> lcp_array(
+    std::vector<uint32_t> const& s, std::vector<uint32_t> const& sa,
+    std::vector<uint32_t>& rank)
+{
+    size_t n = s.size();
+    std::vector<uint32_t> lcp(n);
+    rank.resize(n);
+    for(size_t i = 0; i < n; ++i)
+        rank[sa[i]] = (uint32_t)i;
+    size_t h = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        if(rank[i] == 0)
+        {
+            h = 0;
             continue;
+        }
+        size_t j = sa[rank[i] - 1];
+        while(i + h < n && j + h < n && s[i + h] == s[j + h])
+            ++h;
+        lcp[rank[i]] = (uint32_t)h;
+        if(h > 0)
+            --h;
+    }
+    return lcp;
+}
 
-        if(data.size() >= 32 && data.size() != pd.data.size())
-            continue;
+// Shares storage between progdata entries without relocations:
+//   1. exact duplicates are merged into the first of them
+//   2. entries contained in a larger entry become labels inside it
+//   3. remaining entries are chained where the end of one matches the
+//      start of another, greedily by longest overlap (tail merging)
+// Steps 2 and 3 use a suffix array over all distinct entries.
+void compiler_t::merge_progdata()
+{
+    if(!enable_merging_progdata) return;
 
-        if(k == label)
-            continue;
+    struct blob_t
+    {
+        std::string const* label;
+        compiler_progdata_t* pd;
+        size_t rep;    // index of the exact duplicate kept
+        size_t host;   // index of the containing entry (or itself)
+        size_t offset; // offset in host
+        size_t start;  // position in the suffix array text (reps only)
+        size_t next;   // successor in the overlap chain
+        size_t prev;
+        size_t overlap; // bytes shared with the successor
+    };
+    size_t const NONE = SIZE_MAX;
+    std::vector<blob_t> blobs;
+    for(auto& [label, pd] : progdata)
+    {
+        if(pd.merged || pd.data.empty()) continue;
+        if(!pd.relocs_glob.empty() || !pd.relocs_prog.empty()) continue;
+        if(!pd.inter_labels.empty()) continue;
+        blobs.push_back({ &label, &pd, NONE, NONE, 0, 0, NONE, NONE, 0 });
+    }
+    if(blobs.size() < 2) return;
+
+    std::vector<size_t> reps;
+    {
+        std::unordered_map<std::string_view, size_t> seen;
+        for(size_t i = 0; i < blobs.size(); ++i)
+        {
+            auto const& d = blobs[i].pd->data;
+            std::string_view key((char const*)d.data(), d.size());
+            auto [it, inserted] = seen.emplace(key, i);
+            blobs[i].rep = it->second;
+            if(inserted)
+                reps.push_back(i);
+        }
+    }
 
-        auto it = std::search(
-            pd.data.begin(),
-            pd.data.end(),
-            data.begin(),
-            data.end());
+    // text: each distinct entry followed by its own separator symbol
+    std::vector<uint32_t> text;
+    std::vector<size_t> owner; // rep index of each text position
+    uint32_t const nsep = (uint32_t)reps.size();
+    for(size_t r = 0; r < reps.size(); ++r)
+    {
+        auto& b = blobs[reps[r]];
+        b.start = text.size();
+        for(uint8_t x : b.pd->data)
+            text.push_back(nsep + x);
+        text.push_back((uint32_t)r);
+        owner.resize(text.size(), reps[r]);
+    }
+    auto sa = suffix_array(text, nsep + 256);
+    std::vector<uint32_t> rank;
+    auto lcp = lcp_array(text, sa, rank);
+    auto size_of = [&](size_t i) { return blobs[i].pd->data.size(); };
 
-        if(it == pd.data.end())
-            continue;
+    // containment: with duplicates gone, any other suffix sharing a whole
+    // entry as prefix lies in a larger entry, and one is adjacent to it
+    for(size_t i : reps)
+    {
+        auto& b = blobs[i];
+        size_t r = rank[b.start];
+        size_t n = size_of(i);
+        size_t other = NONE;
+        if(r > 0 && lcp[r] >= n)
+            other = sa[r - 1];
+        else if(r + 1 < sa.size() && lcp[r + 1] >= n)
+            other = sa[r + 1];
+        if(other == NONE) continue;
+        b.host = owner[other];
+        b.offset = other - blobs[b.host].start;
+    }
+    // hosts are strictly larger, so following them terminates
+    std::vector<bool> resolved(blobs.size());
+    std::function<void(size_t)> resolve = [&](size_t i) {
+        auto& b = blobs[i];
+        if(resolved[i]) return;
+        resolved[i] = true;
+        if(b.host == NONE)
+        {
+            b.host = i;
+            return;
+        }
+        resolve(b.host);
+        b.offset += blobs[b.host].offset;
+        b.host = blobs[b.host].host;
+    };
+    for(size_t i : reps)
+        resolve(i);
 
-        size_t index = size_t(it - pd.data.begin());
-        pd.inter_labels.push_back({ index, label });
-        std::sort(pd.inter_labels.begin(), pd.inter_labels.end());
-        pdata.data.clear();
-        pdata.merged = true;
-        return;
+    // overlaps: a suffix of entry A that is a prefix of entry B sorts
+    // just before B, and every suffix between them shares its prefix
+    struct edge_t { size_t overlap, a, b; };
+    std::vector<edge_t> edges;
+    size_t const MAX_STEPS = 64;
+    size_t const MAX_EDGES = 4;
+    for(size_t i : reps)
+    {
+        auto const& b = blobs[i];
+        if(b.host != i) continue;
+        size_t m = SIZE_MAX;
+        size_t found = 0;
+        for(size_t r = rank[b.start], steps = 0;
+            r-- > 0 && steps < MAX_STEPS && found < MAX_EDGES; ++steps)
+        {
+            m = std::min<size_t>(m, lcp[r + 1]);
+            if(m == 0) break;
+            size_t a = owner[sa[r]];
+            if(a == i || blobs[a].host != a) continue;
+            if(blobs[a].start + size_of(a) - sa[r] != m) continue;
+            edges.push_back({ m, a, i });
+            ++found;
+        }
+    }
+    std::sort(edges.begin(), edges.end(), [](edge_t const& x, edge_t const& y) {
+        return std::tie(y.overlap, x.a, x.b) < std::tie(x.overlap, y.a, y.b);
+    });
+    std::vector<size_t> chain(blobs.size());
+    for(size_t i = 0; i < chain.size(); ++i)
+        chain[i] = i;
+    std::function<size_t(size_t)> find = [&](size_t i) {
+        return chain[i] == i ? i : chain[i] = find(chain[i]);
+    };
+    for(auto const& e : edges)
+    {
+        auto& a = blobs[e.a];
+        auto& b = blobs[e.b];
+        if(a.next != NONE || b.prev != NONE) continue;
+        if(find(e.a) == find(e.b)) continue;
+        chain[find(e.a)] = find(e.b);
+        a.next = e.b;
+        a.overlap = e.overlap;
+        b.prev = e.a;
+    }
+
+    // build each chain into its first entry
+    std::vector<size_t> head(blobs.size(), NONE);
+    std::vector<size_t> head_offset(blobs.size(), 0);
+    for(size_t i : reps)
+    {
+        auto& b = blobs[i];
+        if(b.host != i || b.prev != NONE) continue;
+        head[i] = i;
+        auto& data = b.pd->data;
+        for(size_t j = i; blobs[j].next != NONE;)
+        {
+            size_t k = blobs[j].overlap;
+            j = blobs[j].next;
+            auto const& d = blobs[j].pd->data;
+            head[j] = i;
+            head_offset[j] = data.size() - k;
+            data.insert(data.end(), d.begin() + k, d.end());
+        }
+    }
+
+    for(size_t i = 0; i < blobs.size(); ++i)
+    {
+        auto const& r = blobs[blobs[i].rep];
+        size_t h = head[r.host];
+        if(h == i) continue;
+        size_t offset = head_offset[r.host] + r.offset;
+        auto& pd = *blobs[i].pd;
+        blobs[h].pd->inter_labels.push_back({ offset, *blobs[i].label });
+        pd.data.clear();
+        pd.merged = true;
     }
-#endif
+    for(size_t i = 0; i < blobs.size(); ++i)
+        std::sort(blobs[i].pd->inter_labels.begin(), blobs[i].pd->inter_labels.end());
 }
 
 void compiler_t::progdata_zero(
@@ -0,0 +1,792 @@
+#include "abc_compiler.hpp"
+
+#include <algorithm>
+
+namespace abc
+{
+
+// Value ranges of integer locals, used to elide array bounds checks.
+//
+// Before a function is generated, every integer local whose address is
+// never taken gets an interval that contains every value it can hold:
+// the join of its initializer and of every value assigned to it,
+// computed as a fixpoint over the whole function. Conditions guarding an
+// if-branch or a loop body add facts like "i < n" for locals the guarded
+// code does not write, which narrow the ranges both while solving and
+// when an index is generated inside that code.
+
+static constexpr int64_t RANGE_MAX = int64_t(1) << 48;
+static constexpr compiler_range_t RANGE_FULL = { -RANGE_MAX, RANGE_MAX };
+static constexpr compiler_range_t RANGE_EMPTY = { 1, 0 };
+
+// how far fact bounds are followed through other facts
+static constexpr int RANGE_MAX_DEPTH = 4;
+
+// rounds of plain joins before bounds jump to the next threshold, and
+// the rounds after which all ranges are given up on
+static constexpr int RANGE_WIDEN_ROUND = 3;
+static constexpr int RANGE_MAX_ROUNDS = 256;
+
+// results of un-annotated operations are only trusted in [0, max]: the
+// widening additive and multiplicative operators hold at least 16 bits,
+// and any integer type holds [0, 127]
+static constexpr int64_t RANGE_EXACT_WIDE = 0x7fff;
+static constexpr int64_t RANGE_EXACT_ANY = 0x7f;
+
+static bool is_integer(compiler_type_t const& t)
+{
+    auto const& tr = t.without_ref();
+    return tr.is_prim() && !tr.is_float && tr.prim_size >= 1 && tr.prim_size <= 4;
+}
+
+static compiler_range_t type_range(compiler_type_t const& t)
+{
+    if(!is_integer(t))
+        return RANGE_FULL;
+    auto const& tr = t.without_ref();
+    if(tr.is_bool)
+        return { 0, 1 };
+    int bits = int(tr.prim_size * 8);
+    if(tr.is_signed)
+        return { -(int64_t(1) << (bits - 1)), (int64_t(1) << (bits - 1)) - 1 };
+    return { 0, (int64_t(1) << bits) - 1 };
+}
+
+static bool contains(compiler_range_t const& a, compiler_range_t const& b)
+{
+    return b.empty() || (a.lo <= b.lo && b.hi <= a.hi);
+}
+
+static compiler_range_t hull(compiler_range_t const& a, compiler_range_t const& b)
+{
+    if(a.empty()) return b;
+    if(b.empty()) return a;
+    return { std::min(a.lo, b.lo), std::max(a.hi, b.hi) };
+}
+
+// the values r becomes after conversion to t
+static compiler_range_t fit(compiler_range_t const& r, compiler_type_t const& t)
+{
+    if(r.empty())
+        return r;
+    if(!is_integer(t))
+        return RANGE_FULL;
+    auto tr = type_range(t);
+    return contains(tr, r) ? r : tr;
+}
+
+// the values r becomes as the result of node a, which is computed in
+// a's type once annotated
+static compiler_range_t fit_node(
+    compiler_range_t const& r, ast_node_t const& a, int64_t exact)
+{
+    if(r.empty())
+        return r;
+    if(a.comp_type.prim_size != 0)
+        return fit(r, a.comp_type);
+    return r.lo >= 0 && r.hi <= exact ? r : RANGE_FULL;
+}
+
+static ast_node_t const* len_arg(ast_node_t const& a)
+{
+    if(a.type != AST::FUNC_CALL || a.children.size() != 2 ||
+        a.children[0].type != AST::IDENT || a.children[0].data != "len")
+        return nullptr;
+    auto const& args = a.children[1];
+    if(args.type != AST::FUNC_ARGS || args.children.size() != 1 ||
+        args.children[0].type != AST::IDENT)
+        return nullptr;
+    return &args.children[0];
+}
+
+static bool is_write(ast_node_t const& a)
+{
+    return
+        a.type == AST::OP_ASSIGN ||
+        a.type == AST::OP_ASSIGN_COMPOUND ||
+        a.type == AST::OP_INC_POST ||
+        a.type == AST::OP_DEC_POST;
+}
+
+static ast_node_t const& strip_casts(ast_node_t const& a)
+{
+    return a.type == AST::OP_CAST ? strip_casts(a.children[1]) : a;
+}
+
+// whether argument i of a call to system function name may be bound
+// to a reference
+bool compiler_t::sys_arg_is_ref(std::string const& name, size_t i)
+{
+    std::vector<std::string> names{ name };
+    if(auto it = sys_overloads.find(name); it != sys_overloads.end())
+        names.insert(names.end(), it->second.begin(), it->second.end());
+    for(auto const& n : names)
+    {
+        auto it = sys_names.find(n);
+        if(it == sys_names.end())
+            return true;
+        auto jt = sysfunc_decls.find(it->second);
+        if(jt == sysfunc_decls.end() || sysfunc_is_format(it->second))
+            return true;
+        auto const& args = jt->second.decl.arg_types;
+        if(i >= args.size() || args[i].is_any_ref())
+            return true;
+    }
+    return false;
+}
+
+int compiler_t::range_ident(ast_node_t const& a) const
+{
+    auto it = range_idents.find({ a.line_info, a.data });
+    return it == range_idents.end() ? RANGE_UNSEEN : it->second;
+}
+
+void compiler_t::range_scan_stmt(compiler_func_t const& f, ast_node_t const& a)
+{
+    switch(a.type)
+    {
+    case AST::BLOCK:
+        range_scopes.emplace_back();
+        for(auto const& child : a.children)
+            range_scan_stmt(f, child);
+        range_scopes.pop_back();
+        return;
+    case AST::DECL_STMT:
+    {
+        auto const& ta = a.children[0];
+        auto const& ident = a.children[1];
+        compiler_type_t t = TYPE_NONE;
+        if(ta.type == AST::TYPE && ta.children.empty())
+        {
+            std::string name(ta.data);
+            if(auto it = primitive_types.find(name); it != primitive_types.end())
+                t = it->second;
+            else if(auto jt = enums.find(name); jt != enums.end())
+                t = jt->second;
+        }
+        int id = int(range_locals.size());
+        bool ref =
+            ta.type == AST::TYPE_REF ||
+            ta.type == AST::TYPE_AREF ||
+            ta.type == AST::TYPE_AREF_PROG;
+        range_locals.push_back({ t, is_integer(t), false, ref, RANGE_EMPTY });
+        range_scopes.back()[ident.data] = id;
+        range_idents[{ ident.line_info, ident.data }] = id;
+        if(a.children.size() >= 3)
+            range_scan_expr(a.children[2], ref);
+        return;
+    }
+    case AST::FOR_STMT:
+        for(size_t i = 3; i < a.children.size(); ++i)
+            range_scan_stmt(f, a.children[i]);
+        range_scan_expr(a.children[0], false);
+        range_scan_stmt(f, a.children[1]);
+        range_scan_stmt(f, a.children[2]);
+        return;
+    case AST::RETURN_STMT:
+        if(!a.children.empty())
+            range_scan_expr(a.children[0], f.decl.return_type.is_any_ref());
+        return;
+    default:
+        for(auto const& child : a.children)
+        {
+            if(child.type > AST::EXPR_BEGIN)
+                range_scan_expr(child, false);
+            else
+                range_scan_stmt(f, child);
+        }
+        return;
+    }
+}
+
+// ref: the value of a may be bound to a reference, so a local named
+// there can be written through it
+void compiler_t::range_scan_expr(ast_node_t const& a, bool ref)
+{
+    auto const& c = a.children;
+    switch(a.type)
+    {
+    case AST::IDENT:
+    {
+        int id = RANGE_GLOBAL;
+        for(auto it = range_scopes.rbegin(); it != range_scopes.rend(); ++it)
+        {
+            if(auto jt = it->find(a.data); jt != it->end())
+            {
+                id = jt->second;
+                break;
+            }
+        }
+        range_idents[{ a.line_info, a.data }] = id;
+        if(ref && id >= 0)
+        {
+            range_locals[id].tracked = false;
+            range_locals[id].addressed = true;
+        }
+        return;
+    }
+    case AST::INT_CONST:
+    case AST::FLOAT_CONST:
+    case AST::STRING_LITERAL:
+        return;
+    case AST::OP_EQUALITY:
+    case AST::OP_LOGICAL_AND:
+    case AST::OP_LOGICAL_OR:
+    case AST::OP_BITWISE_AND:
+    case AST::OP_BITWISE_OR:
+    case AST::OP_BITWISE_XOR:
+    case AST::OP_RELATIONAL:
+    case AST::OP_SHIFT:
+    case AST::OP_ADDITIVE:
+    case AST::OP_MULTIPLICATIVE:
+        for(auto const& child : c)
+            range_scan_expr(child, false);
+        return;
+    case AST::OP_UNARY:
+        range_scan_expr(c[1], false);
+        return;
+    case AST::OP_CAST:
+        range_scan_expr(c[1], ref);
+        return;
+    case AST::OP_TERNARY:
+        range_scan_expr(c[0], false);
+        range_scan_expr(c[1], ref);
+        range_scan_expr(c[2], ref);
+        return;
+    case AST::OP_ASSIGN:
+    {
+        range_scan_expr(c[0], ref);
+        bool value = false;
+        if(c[0].type == AST::IDENT)
+        {
+            int id = range_ident(c[0]);
+            if(id >= 0)
+                value = is_integer(range_locals[id].type);
+            else if(auto it = globals.find(std::string(c[0].data)); it != globals.end())
+                value = is_integer(it->second.var.type) && !it->second.var.type.is_ref();
+        }
+        range_scan_expr(c[1], !value);
+        return;
+    }
+    case AST::OP_INC_POST:
+    case AST::OP_DEC_POST:
+        range_scan_expr(c[0], false);
+        return;
+    case AST::ARRAY_INDEX:
+    case AST::ARRAY_SLICE:
+    case AST::ARRAY_SLICE_LEN:
+        range_scan_expr(c[0], true);
+        for(size_t i = 1; i < c.size(); ++i)
+            range_scan_expr(c[i], false);
+        return;
+    case AST::STRUCT_MEMBER:
+        // the member name is not a variable
+        range_scan_expr(c[0], true);
+        return;
+    case AST::FUNC_CALL:
+    {
+        if(c.size() != 2 || c[1].type != AST::FUNC_ARGS)
+            break;
+        auto const& args = c[1].children;
+        range_scan_expr(c[0], false);
+        compiler_func_decl_t const* decl = nullptr;
+        std::string name;
+        if(c[0].type == AST::IDENT && range_ident(c[0]) == RANGE_GLOBAL)
+        {
+            name = std::string(c[0].data);
+            if(auto it = funcs.find(name); it != funcs.end())
+                decl = &it->second.decl;
+        }
+        for(size_t i = 0; i < args.size(); ++i)
+        {
+            bool arg_ref = true;
+            if(decl)
+                arg_ref = i >= decl->arg_types.size() || decl->arg_types[i].is_any_ref();
+            else if(!name.empty() && name[0] == '$')
+                arg_ref = sys_arg_is_ref(name.substr(1), i);
+            range_scan_expr(args[i], arg_ref);
+        }
+        return;
+    }
+    default:
+        break;
+    }
+    // anything else may take the address of the locals it names
+    for(auto const& child : c)
+    {
+        if(child.type > AST::EXPR_BEGIN)
+            range_scan_expr(child, true);
+    }
+}
+
+bool compiler_t::range_writes(ast_node_t const& a, int local) const
+{
+    if(is_write(a))
+    {
+        auto const& t = strip_casts(a.children[0]);
+        if(local < 0 || (t.type == AST::IDENT && range_ident(t) == local))
+            return true;
+    }
+    for(auto const& child : a.children)
+        if(range_writes(child, local))
+            return true;
+    return false;
+}
+
+size_t compiler_t::push_range_facts(
+    ast_node_t const& cond, ast_node_t const& body, ast_node_t const* iter)
+{
+    if(range_locals.empty() || range_writes(cond, -1))
+        return 0;
+
+    size_t n = range_facts.size();
+
+    // returns the local compared by a, if its value reaches the comparison
+    // unchanged
+    std::function<int(ast_node_t const&, compiler_type_t&)> local_of =
+        [&](ast_node_t const& a, compiler_type_t& t) -> int {
+        if(a.type == AST::IDENT)
+        {
+            int id = range_ident(a);
+            if(id < 0 || !range_locals[id].tracked)
+                return -1;
+            t = range_locals[id].type;
+            return id;
+        }
+        if(a.type != AST::OP_CAST)
+            return -1;
+        compiler_type_t ct;
+        int id = local_of(a.children[1], ct);
+        t = a.children[0].comp_type;
+        if(id < 0 || !is_integer(t) || !contains(type_range(t), type_range(ct)))
+            return -1;
+        return id;
+    };
+
+    std::function<void(ast_node_t const&)> add = [&](ast_node_t const& a) {
+        if(a.type == AST::OP_LOGICAL_AND && a.children.size() == 2)
+        {
+            add(a.children[0]);
+            add(a.children[1]);
+            return;
+        }
+        bool rel = a.type == AST::OP_RELATIONAL;
+        if(!(rel || (a.type == AST::OP_EQUALITY && a.data == "==")) ||
+            a.children.size() != 2)
+            return;
+        for(int side = 0; side < 2; ++side)
+        {
+            compiler_type_t t;
+            int id = local_of(a.children[side], t);
+            if(id < 0)
+                continue;
+            auto const* bound = &a.children[1 - side];
+            bool annotated = a.comp_type.prim_size != 0;
+            std::string_view op = a.data;
+            if(side == 1)
+            {
+                if(op == "<") op = ">";
+                else if(op == ">") op = "<";
+                else if(op == "<=") op = ">=";
+                else if(op == ">=") op = "<=";
+            }
+            if(op == "<")
+                range_facts.push_back({ id, true, annotated, -1, bound });
+            else if(op == "<=")
+                range_facts.push_back({ id, true, annotated, 0, bound });
+            else if(op == ">")
+                range_facts.push_back({ id, false, annotated, 1, bound });
+            else if(op == ">=")
+                range_facts.push_back({ id, false, annotated, 0, bound });
+            else if(op == "==")
+            {
+                range_facts.push_back({ id, true, annotated, 0, bound });
+                range_facts.push_back({ id, false, annotated, 0, bound });
+            }
+        }
+    };
+    add(cond);
+
+    // drop facts about locals the guarded code changes; the loop iteration
+    // statement may change the local last, as in "++i"
+    auto iter_keeps = [&](int id) {
+        if(!iter || !range_writes(*iter, id))
+            return true;
+        if(iter->type != AST::EXPR_STMT || iter->children.size() != 1)
+            return false;
+        auto const& e = iter->children[0];
+        if(e.children.empty() || e.children[0].type != AST::IDENT ||
+            range_ident(e.children[0]) != id)
+            return false;
+        if(e.type == AST::OP_INC_POST || e.type == AST::OP_DEC_POST)
+            return true;
+        return e.type == AST::OP_ASSIGN && !range_writes(e.children[1], -1);
+    };
+    auto it = std::remove_if(range_facts.begin() + n, range_facts.end(),
+        [&](compiler_range_fact_t const& fact) {
+            return range_writes(body, fact.local) || !iter_keeps(fact.local);
+        });
+    range_facts.erase(it, range_facts.end());
+    return range_facts.size() - n;
+}
+
+void compiler_t::pop_range_facts(size_t n)
+{
+    range_facts.resize(range_facts.size() - n);
+}
+
+compiler_range_t compiler_t::eval_range(
+    ast_node_t const& a, compiler_range_fact_t const* facts,
+    size_t num_facts, int depth) const
+{
+    auto const& c = a.children;
+    auto eval = [&](ast_node_t const& n) {
+        return eval_range(n, facts, num_facts, depth);
+    };
+    // operands of operators that are not computed modulo the result size
+    // are first converted to the result type
+    auto operand = [&](ast_node_t const& n) {
+        return fit_node(eval(n), a, RANGE_EXACT_ANY);
+    };
+
+    switch(a.type)
+    {
+    case AST::INT_CONST:
+        return { a.value, a.value };
+
+    case AST::IDENT:
+    {
+        int id = range_ident(a);
+        if(id >= 0 && range_locals[id].tracked)
+        {
+            auto r = range_locals[id].range;
+            if(r.empty() || depth >= RANGE_MAX_DEPTH)
+                return r;
+            for(size_t i = 0; i < num_facts; ++i)
+            {
+                auto const& fact = facts[i];
+                if(fact.local != id)
+                    continue;
+                // a bound may only rely on the facts established before it
+                auto b = eval_range(*fact.bound, facts, i, depth + 1);
+                if(b.empty())
+                    return b;
+                // annotation makes a comparison between signed and
+                // unsigned values explicit, and the local is only seen
+                // through casts that keep its value; without it the
+                // comparison may be unsigned, which agrees with the
+                // facts only when both sides are nonnegative
+                if(fact.upper && (fact.annotated || b.lo >= 0))
+                    r.hi = std::min(r.hi, b.hi + fact.offset);
+                else if(!fact.upper && (fact.annotated || r.lo >= 0))
+                    r.lo = std::max(r.lo, b.lo + fact.offset);
+            }
+            return r.empty() ? RANGE_EMPTY : r;
+        }
+        if(id == RANGE_GLOBAL)
+        {
+            auto it = globals.find(std::string(a.data));
+            if(it != globals.end())
+            {
+                auto const& var = it->second.var;
+                if(var.is_constexpr && var.label_ref.empty() && is_integer(var.type))
+                    return { var.value, var.value };
+                if(is_integer(var.type))
+                    return type_range(var.type);
+            }
+        }
+        return fit_node(RANGE_FULL, a, RANGE_EXACT_ANY);
+    }
+
+    case AST::OP_CAST:
+        return fit(eval(c[1]), c[0].comp_type);
+
+    case AST::OP_ADDITIVE:
+    {
+        auto x = eval(c[0]);
+        auto y = eval(c[1]);
+        if(x.empty() || y.empty())
+            return RANGE_EMPTY;
+        compiler_range_t r = a.data == "-" ?
+            compiler_range_t{ x.lo - y.hi, x.hi - y.lo } :
+            compiler_range_t{ x.lo + y.lo, x.hi + y.hi };
+        return fit_node(r, a, RANGE_EXACT_WIDE);
+    }
+
+    case AST::OP_MULTIPLICATIVE:
+    {
+        if(a.data == "*")
+        {
+            auto x = eval(c[0]);
+            auto y = eval(c[1]);
+            if(x.empty() || y.empty())
+                return RANGE_EMPTY;
+            int64_t const m = int64_t(1) << 24;
+            if(std::max({ -x.lo, x.hi, -y.lo, y.hi }) > m)
+                return fit_node(RANGE_FULL, a, RANGE_EXACT_WIDE);
+            int64_t p[] = { x.lo * y.lo, x.lo * y.hi, x.hi * y.lo, x.hi * y.hi };
+            return fit_node(
+                { *std::min_element(p, p + 4), *std::max_element(p, p + 4) },
+                a, RANGE_EXACT_WIDE);
+        }
+        auto x = operand(c[0]);
+        auto y = operand(c[1]);
+        if(x.empty() || y.empty())
+            return RANGE_EMPTY;
+        if(x.lo < 0 || y.lo <= 0)
+            return fit_node(RANGE_FULL, a, RANGE_EXACT_ANY);
+        if(a.data == "/")
+            return fit_node({ x.lo / y.hi, x.hi / y.lo }, a, RANGE_EXACT_ANY);
+        return fit_node({ 0, std::min(x.hi, y.hi - 1) }, a, RANGE_EXACT_ANY);
+    }
+
+    case AST::OP_BITWISE_AND:
+    {
+        auto x = operand(c[0]);
+        auto y = operand(c[1]);
+        if(x.empty() || y.empty())
+            return RANGE_EMPTY;
+        int64_t hi = RANGE_MAX;
+        if(x.lo >= 0) hi = std::min(hi, x.hi);
+        if(y.lo >= 0) hi = std::min(hi, y.hi);
+        if(hi == RANGE_MAX)
+            return fit_node(RANGE_FULL, a, RANGE_EXACT_ANY);
+        return fit_node({ 0, hi }, a, RANGE_EXACT_ANY);
+    }
+
+    case AST::OP_SHIFT:
+    {
+        if(a.data != ">>" || c[1].type != AST::INT_CONST)
+            break;
+        auto x = operand(c[0]);
+        int64_t s = c[1].value;
+        if(x.empty())
+            return RANGE_EMPTY;
+        if(x.lo < 0 || s < 0 || s >= 32)
+            break;
+        return fit_node({ x.lo >> s, x.hi >> s }, a, RANGE_EXACT_ANY);
+    }
+
+    case AST::OP_TERNARY:
+        return fit_node(hull(operand(c[1]), operand(c[2])), a, RANGE_EXACT_ANY);
+
+    case AST::OP_UNARY:
+    {
+        auto x = operand(c[1]);
+        if(x.empty())
+            return RANGE_EMPTY;
+        if(c[0].data == "!")
+            return { 0, 1 };
+        if(c[0].data == "-")
+            return fit_node({ -x.hi, -x.lo }, a, RANGE_EXACT_ANY);
+        if(c[0].data == "~")
+            return fit_node({ -x.hi - 1, -x.lo - 1 }, a, RANGE_EXACT_ANY);
+        break;
+    }
+
+    case AST::OP_EQUALITY:
+    case AST::OP_RELATIONAL:
+    case AST::OP_LOGICAL_AND:
+    case AST::OP_LOGICAL_OR:
+        return { 0, 1 };
+
+    case AST::FUNC_CALL:
+    {
+        auto const* arr = len_arg(a);
+        if(!arr || range_ident(*arr) != RANGE_GLOBAL)
+            break;
+        auto it = globals.find(std::string(arr->data));
+        if(it == globals.end())
+            break;
+        int64_t n = int64_t(it->second.var.type.array_size());
+        if(n == 0)
+            break;
+        return { n, n };
+    }
+
+    default:
+        break;
+    }
+    return fit_node(RANGE_FULL, a, RANGE_EXACT_ANY);
+}
+
+void compiler_t::range_collect(ast_node_t const& a)
+{
+    auto const& c = a.children;
+    switch(a.type)
+    {
+    case AST::DECL_STMT:
+    {
+        int id = range_ident(c[1]);
+        if(c.size() < 3)
+        {
+            range_assigns.push_back({ id, nullptr, 0, {} });
+            return;
+        }
+        range_collect(c[2]);
+        range_assigns.push_back({ id, &c[2], 0, range_facts });
+        return;
+    }
+    case AST::IF_STMT:
+    {
+        range_collect(c[0]);
+        size_t n = push_range_facts(c[0], c[1], nullptr);
+        range_collect(c[1]);
+        pop_range_facts(n);
+        range_collect(c[2]);
+        return;
+    }
+    case AST::WHILE_STMT:
+    case AST::FOR_STMT:
+    {
+        bool is_for = a.type == AST::FOR_STMT;
+        for(size_t i = 3; i < c.size(); ++i)
+            range_collect(c[i]);
+        range_collect(c[0]);
+        size_t n = push_range_facts(c[0], c[1], is_for ? &c[2] : nullptr);
+        range_collect(c[1]);
+        if(is_for)
+            range_collect(c[2]);
+        pop_range_facts(n);
+        return;
+    }
+    case AST::OP_ASSIGN:
+    case AST::OP_ASSIGN_COMPOUND:
+    case AST::OP_INC_POST:
+    case AST::OP_DEC_POST:
+    {
+        for(auto const& child : c)
+            range_collect(child);
+        if(c[0].type != AST::IDENT)
+            return;
+        int id = range_ident(c[0]);
+        if(id < 0)
+            return;
+        if(a.type == AST::OP_ASSIGN)
+            range_assigns.push_back({ id, &c[1], 0, range_facts });
+        else if(a.type == AST::OP_ASSIGN_COMPOUND)
+            range_assigns.push_back({ id, nullptr, 0, {} });
+        else
+            range_assigns.push_back({
+                id, &c[0], a.type == AST::OP_INC_POST ? 1 : -1, range_facts });
+        return;
+    }
+    default:
+        for(auto const& child : c)
+            range_collect(child);
+        return;
+    }
+}
+
+void compiler_t::analyze_ranges(compiler_func_t const& f)
+{
+    range_idents.clear();
+    range_scopes.clear();
+    range_locals.clear();
+    range_assigns.clear();
+    range_facts.clear();
+
+    range_scopes.emplace_back();
+    for(size_t i = 0; i < f.arg_names.size(); ++i)
+    {
+        auto const& t = f.decl.arg_types[i];
+        int id = int(range_locals.size());
+        range_locals.push_back({
+            t, is_integer(t) && !t.is_ref(), false, t.is_any_ref(), RANGE_EMPTY });
+        range_scopes.back()[f.arg_names[i]] = id;
+        range_assigns.push_back({ id, nullptr, 0, {} });
+    }
+    range_scan_stmt(f, f.block);
+    range_scopes.clear();
+    range_collect(f.block);
+
+    // constants of the function are the points ranges are widened to
+    std::vector<int64_t> thresholds;
+    std::function<void(ast_node_t const&)> add_thresholds = [&](ast_node_t const& a) {
+        if(a.type == AST::INT_CONST || a.type == AST::IDENT || a.type == AST::FUNC_CALL)
+        {
+            auto r = eval_range(a, nullptr, 0, 0);
+            if(!r.empty() && r.lo == r.hi)
+                for(int64_t d = -1; d <= 1; ++d)
+                    thresholds.push_back(r.lo + d);
+        }
+        for(auto const& child : a.children)
+            add_thresholds(child);
+    };
+    add_thresholds(f.block);
+    std::sort(thresholds.begin(), thresholds.end());
+    thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+
+    for(int round = 0; ; ++round)
+    {
+        if(round == RANGE_MAX_ROUNDS)
+        {
+            for(auto& v : range_locals)
+                v.range = type_range(v.type);
+            break;
+        }
+        bool changed = false;
+        for(auto const& s : range_assigns)
+        {
+            auto& v = range_locals[s.local];
+            if(!v.tracked)
+                continue;
+            auto t = type_range(v.type);
+            auto r = t;
+            if(s.expr)
+            {
+                r = eval_range(*s.expr, s.facts.data(), s.facts.size(), 0);
+                if(r.empty())
+                    continue;
+                r = fit({ r.lo + s.delta, r.hi + s.delta }, v.type);
+            }
+            if(v.range.empty())
+            {
+                v.range = r;
+                changed = true;
+                continue;
+            }
+            auto n = v.range;
+            if(r.lo < n.lo)
+            {
+                n.lo = r.lo;
+                if(round >= RANGE_WIDEN_ROUND)
+                {
+                    auto it = std::upper_bound(thresholds.begin(), thresholds.end(), r.lo);
+                    n.lo = it == thresholds.begin() ? t.lo : std::max(*--it, t.lo);
+                }
+            }
+            if(r.hi > n.hi)
+            {
+                n.hi = r.hi;
+                if(round >= RANGE_WIDEN_ROUND)
+                {
+                    auto it = std::lower_bound(thresholds.begin(), thresholds.end(), r.hi);
+                    n.hi = it == thresholds.end() ? t.hi : std::min(*it, t.hi);
+                }
+            }
+            if(n.lo != v.range.lo || n.hi != v.range.hi)
+            {
+                v.range = n;
+                changed = true;
+            }
+        }
+        if(!changed)
+            break;
+    }
+
+    // locals no value reaches
+    for(auto& v : range_locals)
+        if(v.range.empty())
+            v.range = type_range(v.type);
+
+    range_assigns.clear();
+}
+
+bool compiler_t::index_in_bounds(ast_node_t const& index, size_t num_elems) const
+{
+    auto r = eval_range(index, range_facts.data(), range_facts.size(), 0);
+    return !r.empty() && r.lo >= 0 && uint64_t(r.hi) < num_elems;
+}
+
+}
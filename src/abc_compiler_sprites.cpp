@@ -40,9 +40,14 @@ void compiler_t::encode_sprites(std::vector<uint8_t>& data, ast_node_t const& n)
     size_t ih = 0;
     bool masked = false;
 
+    // image files are decoded and encoded once per contents and format
+    std::vector<char> d;
+    std::string key;
+    size_t start = data.size();
+    size_t num_errs = errs.size();
+
     if(n.children[2].type == AST::STRING_LITERAL)
     {
-        std::vector<char> d;
         std::string image_path = current_path + "/";
         image_path += n.children[2].string_literal();
         if(!file_loader || !file_loader(image_path, d))
@@ -52,6 +57,10 @@ void compiler_t::encode_sprites(std::vector<uint8_t>& data, ast_node_t const& n)
                 n.children[2].line_info });
             return;
         }
+        key = "sprites " + std::to_string(w) + " " + std::to_string(h) +
+            " " + std::to_string(shades);
+        if(cache_load_asset(key, d, data))
+            return;
         int tx = 0, ty = 0, tc = 0;
         stbi_uc* loaded_data = stbi_load_from_memory(
             (stbi_uc*)d.data(), (int)d.size(), &tx, &ty, &tc, 2);
@@ -122,6 +131,8 @@ void compiler_t::encode_sprites(std::vector<uint8_t>& data, ast_node_t const& n)
     }
 
     encode_sprites_image(data, n, iw, ih, w, h, masked, idata);
+    if(!key.empty() && errs.size() == num_errs)
+        cache_store_asset(key, d, data, start);
 }
 
 void compiler_t::encode_sprites_image(
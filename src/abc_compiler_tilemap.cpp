@@ -75,6 +75,11 @@ std::string compiler_t::encode_tilemap_tmx(
     if(!file_loader || !file_loader(path, d))
         return "Unable to open \"" + filename + "\"";
 
+    std::string key = "tilemap " + layer_name;
+    if(cache_load_asset(key, d, data))
+        return "";
+    size_t start = data.size();
+
     if(!map.loadFromString(std::string(d.begin(), d.end()), current_path + "/"))
         return "Unable to load tilemap: \"" + filename + "\"";
 
@@ -122,6 +127,7 @@ std::string compiler_t::encode_tilemap_tmx(
                 data.push_back(uint8_t(t.ID >> 8));
         }
 
+        cache_store_asset(key, d, data, start);
         return "";
     }
     
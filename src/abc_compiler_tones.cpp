@@ -52,6 +52,19 @@ std::string compiler_t::encode_tones_midi(
     if(!file_loader || !file_loader(path, d))
         return "Unable to open \"" + filename + "\"";
 
+    // music is appended to the data while tones replace it
+    std::string key = music ? "music" : "tones";
+    size_t start = music ? data.size() : 0;
+    {
+        std::vector<uint8_t> cached;
+        if(cache_load_asset(key, d, cached))
+        {
+            data.resize(start);
+            data.insert(data.end(), cached.begin(), cached.end());
+            return "";
+        }
+    }
+
     smf::MidiFile f;
     {
         std::istrstream ss(d.data(), (int)d.size());
@@ -153,6 +166,7 @@ std::string compiler_t::encode_tones_midi(
         data = std::move(cdata[0]);
     }
 
+    cache_store_asset(key, d, data, start);
     return "";
 }
 
@@ -1,6 +1,7 @@
 #include "abc_compiler.hpp"
 
 #include <algorithm>
+#include <chrono>
 #include <assert.h>
 
 namespace abc
@@ -840,6 +841,8 @@ void compiler_t::type_reduce_recurse(ast_node_t& a, size_t size)
 
 void compiler_t::type_annotate(ast_node_t& a, compiler_frame_t const& frame, size_t size)
 {
+    auto t0 = std::chrono::steady_clock::now();
+
     a.recurse([](ast_node_t& n) {
         for(auto& child : n.children)
             child.parent = &n;
@@ -853,6 +856,10 @@ void compiler_t::type_annotate(ast_node_t& a, compiler_frame_t const& frame, siz
         for(auto& child : n.children)
             child.parent = &n;
     });
+
+    type_annotate_seconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+    type_annotate_runs += 1;
 }
 
 }
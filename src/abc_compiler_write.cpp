@@ -113,7 +113,9 @@ void compiler_t::write_instr(
     case I_AIXB1: f << "aixb1 " << instr.imm; break;
     case I_AIDXB: f << "aidxb " << instr.imm << " " << instr.imm2; break;
     case I_AIDX:  f << "aidx  " << instr.imm << " " << instr.imm2; break;
+    case I_AIXB:  f << "aixb  " << instr.imm; break;
 
+    case I_PIXB:  f << "pixb  " << instr.imm; break;
     case I_PIDXB: f << "pidxb " << instr.imm << " " << instr.imm2; break;
     case I_PIDX:  f << "pidx  " << instr.imm << " " << instr.imm2; break;
 
@@ -247,6 +249,8 @@ void compiler_t::write_instr(
 
 void compiler_t::write(std::ostream& f)
 {
+    phase_timer_t timer(time_rep, "write");
+
     if(!do_suppress_githash && !githash.empty())
         f << ".githash " << githash << "\n";
 
@@ -0,0 +1,322 @@
+#pragma once
+
+// Generated by abc_integration from benchmarks/instructions.asm.
+// Do not edit: rerun the benchmarks after changing either VM.
+//
+// Cost of each instruction on the Arduboy VM in cycles and on the
+// generic interpreter in host picoseconds. The argument is the shift
+// count, byte count, quotient bit width or whether a branch is taken,
+// and -1 where the measured variants were averaged.
+//
+// Rows marked "arduboy cycles estimated" were not measured on the
+// Arduboy: their cycles were counted from the VM source (AIXB, PIXB) or
+// derived from the neighbouring measured points of the division and
+// shift loops. Rerunning the benchmarks replaces them with measurements.
+
+static instr_cost_t const INSTR_COSTS[] =
+{
+    //  instr        arg   arduboy  generic
+    { I_NOP,       -1, {      17,    3654 } },
+    { I_P0,        -1, {      18,    4207 } },
+    { I_P1,        -1, {      18,    4381 } },
+    { I_P2,        -1, {      18,    4134 } },
+    { I_P3,        -1, {      18,    4160 } },
+    { I_P4,        -1, {      18,    3846 } },
+    { I_P5,        -1, {      18,    3975 } },
+    { I_P6,        -1, {      18,    4143 } },
+    { I_P7,        -1, {      18,    4325 } },
+    { I_P8,        -1, {      18,    4063 } },
+    { I_P16,       -1, {      18,    3974 } },
+    { I_P32,       -1, {      18,    4117 } },
+    { I_P64,       -1, {      18,    3965 } },
+    { I_P128,      -1, {      18,    4600 } },
+    { I_P00,       -1, {      18,    6229 } },
+    { I_P000,      -1, {      20,    6572 } },
+    { I_P0000,     -1, {      22,    6098 } },
+    { I_PZ8,       -1, {      30,    8110 } },
+    { I_PZ16,      -1, {      46,   14457 } },
+    { I_PUSH,      -1, {      34,    5995 } },
+    { I_PUSH2,     -1, {      51,    9121 } },
+    { I_PUSH3,     -1, {      68,    9990 } },
+    { I_PUSH4,     -1, {      85,   12605 } },
+    { I_SEXT,      -1, {      18,    4471 } },
+    { I_SEXT2,     -1, {      19,    4826 } },
+    { I_SEXT3,     -1, {      21,    8193 } },
+    { I_DUP,       -1, {      17,    4620 } },
+    { I_DUP2,      -1, {      19,    4435 } },
+    { I_DUP3,      -1, {      19,    4430 } },
+    { I_DUP4,      -1, {      19,    4731 } },
+    { I_DUP5,      -1, {      19,    4349 } },
+    { I_DUP6,      -1, {      19,    4068 } },
+    { I_DUP7,      -1, {      19,    4403 } },
+    { I_DUP8,      -1, {      19,    4607 } },
+    { I_DUPW,      -1, {      23,    5730 } },
+    { I_DUPW2,     -1, {      23,    5209 } },
+    { I_DUPW3,     -1, {      23,    4939 } },
+    { I_DUPW4,     -1, {      23,    5027 } },
+    { I_DUPW5,     -1, {      23,    4816 } },
+    { I_DUPW6,     -1, {      23,    4652 } },
+    { I_DUPW7,     -1, {      23,    4859 } },
+    { I_DUPW8,     -1, {      23,    5193 } },
+    { I_GETL,      -1, {      34,    6226 } },
+    { I_GETL2,     -1, {      34,    8077 } },
+    { I_GETL4,     -1, {      37,    8970 } },
+    { I_GETLN,      3, {      55,    9391 } },
+    { I_GETLN,      5, {      66,   11788 } },
+    { I_GETLN,      8, {      85,   14339 } },
+    { I_GETLN,     16, {     129,   24385 } },
+    { I_GETLN,     32, {     217,   40255 } },
+    { I_SETL,      -1, {      34,    5341 } },
+    { I_SETL2,     -1, {      35,    7005 } },
+    { I_SETL4,     -1, {      36,    8996 } },
+    { I_SETLN,      3, {      55,   10793 } },
+    { I_SETLN,      5, {      66,   11930 } },
+    { I_SETLN,      8, {      85,   12888 } },
+    { I_SETLN,     16, {     129,   18802 } },
+    { I_SETLN,     32, {     217,   31958 } },
+    { I_GETG,      -1, {      51,    9976 } },
+    { I_GETG2,     -1, {      51,    9286 } },
+    { I_GETG4,     -1, {      54,   12160 } },
+    { I_GETGN,      3, {      73,   11651 } },
+    { I_GETGN,      5, {      84,   14259 } },
+    { I_GETGN,      8, {     103,   13763 } },
+    { I_GETGN,     16, {     147,   19574 } },
+    { I_GETGN,     32, {     235,   31467 } },
+    { I_GTGB,      -1, {      34,    6498 } },
+    { I_GTGB2,     -1, {      34,    7132 } },
+    { I_GTGB4,     -1, {      36,    8241 } },
+    { I_SETG,      -1, {      51,    8594 } },
+    { I_SETG2,     -1, {      51,    8247 } },
+    { I_SETG4,     -1, {      51,   13115 } },
+    { I_SETGN,      3, {      75,   15304 } },
+    { I_SETGN,      5, {      86,   13829 } },
+    { I_SETGN,      8, {     105,   13918 } },
+    { I_SETGN,     16, {     149,   18956 } },
+    { I_SETGN,     32, {     237,   32008 } },
+    { I_GETP,      -1, {     202,    6806 } },
+    { I_GETPN,      2, {     224,   10991 } },
+    { I_GETPN,      3, {     241,   12537 } },
+    { I_GETPN,      4, {     258,   18541 } },
+    { I_GETPN,      8, {     326,   22903 } },
+    { I_GETPN,     16, {     462,   39124 } },
+    { I_GETPN,     32, {     734,   65417 } },
+    { I_POP,       -1, {      17,    3685 } },
+    { I_POP2,      -1, {      17,    3889 } },
+    { I_POP3,      -1, {      17,    4072 } },
+    { I_POP4,      -1, {      17,    3837 } },
+    { I_POPN,      -1, {      34,    4582 } },
+    { I_REFL,      -1, {      35,    5821 } },
+    { I_REFGB,     -1, {      34,    5157 } },
+    { I_GETR,      -1, {      18,    6033 } },
+    { I_GETR2,     -1, {      20,    6444 } },
+    { I_GETRN,      3, {      39,    8841 } },
+    { I_GETRN,      4, {      47,    9232 } },
+    { I_GETRN,      8, {      69,   11862 } },
+    { I_GETRN,     16, {     113,   17321 } },
+    { I_GETRN,     32, {     201,   29480 } },
+    { I_SETR,      -1, {      20,    6962 } },
+    { I_SETR2,     -1, {      24,    6265 } },
+    { I_SETRN,      3, {      40,    7949 } },
+    { I_SETRN,      4, {      48,    8536 } },
+    { I_SETRN,      8, {      70,   10777 } },
+    { I_SETRN,     16, {     114,   16200 } },
+    { I_SETRN,     32, {     202,   28090 } },
+    { I_AIXB1,     -1, {      34,    6091 } },
+    { I_AIDXB,     -1, {      52,    7400 } },
+    { I_AIDX,      -1, {      95,   12559 } },
+    { I_AIXB,      -1, {      34,    5952 } }, // arduboy cycles estimated
+    { I_PIXB,      -1, {      38,    7118 } }, // arduboy cycles estimated
+    { I_PIDXB,     -1, {      52,    8631 } },
+    { I_PIDX,      -1, {     123,   18256 } },
+    { I_UAIDX,     -1, {      52,    9422 } },
+    { I_UPIDX,     -1, {      83,   15472 } },
+    { I_ASLC,      -1, {      62,   12796 } },
+    { I_PSLC,      -1, {      86,   21377 } },
+    { I_INC,       -1, {      17,    4264 } },
+    { I_DEC,       -1, {      17,    4224 } },
+    { I_LINC,      -1, {      34,    4869 } },
+    { I_PINC,      -1, {      20,    6746 } },
+    { I_PINC2,     -1, {      27,    6107 } },
+    { I_PINC3,     -1, {      37,    6946 } },
+    { I_PINC4,     -1, {      44,    6581 } },
+    { I_PDEC,      -1, {      20,    6573 } },
+    { I_PDEC2,     -1, {      27,    5984 } },
+    { I_PDEC3,     -1, {      37,    6665 } },
+    { I_PDEC4,     -1, {      44,    6540 } },
+    { I_PINCF,     -1, {     149,    6591 } },
+    { I_PDECF,     -1, {     145,    6565 } },
+    { I_ADD,       -1, {      17,    4371 } },
+    { I_ADD2,      -1, {      21,    6713 } },
+    { I_ADD3,      -1, {      28,    8197 } },
+    { I_ADD4,      -1, {      35,    8039 } },
+    { I_SUB,       -1, {      17,    4426 } },
+    { I_SUB2,      -1, {      22,    7108 } },
+    { I_SUB3,      -1, {      29,    8184 } },
+    { I_SUB4,      -1, {      36,    8136 } },
+    { I_ADD2B,     -1, {      20,    5971 } },
+    { I_SUB2B,     -1, {      20,    5343 } },
+    { I_MUL2B,     -1, {      24,    5316 } },
+    { I_ADD3B,     -1, {      25,    5856 } },
+    { I_MUL,       -1, {      18,    4433 } },
+    { I_MUL2,      -1, {      29,    6845 } },
+    { I_MUL3,      -1, {      45,    8180 } },
+    { I_MUL4,      -1, {      70,    8188 } },
+    { I_UDIV2,     13, {     209,    5832 } },
+    { I_UDIV2,      3, {     113,    5740 } },
+    { I_UDIV2,      9, {     209,    5708 } }, // arduboy cycles estimated
+    { I_UDIV4,     26, {     676,    8533 } },
+    { I_UDIV4,      3, {     185,    8480 } },
+    { I_UDIV4,     17, {     676,    8523 } }, // arduboy cycles estimated
+    { I_DIV2,      13, {     226,    5746 } },
+    { I_DIV2,       3, {     130,    5670 } },
+    { I_DIV2,       9, {     226,    5614 } }, // arduboy cycles estimated
+    { I_DIV4,      26, {     693,    8689 } },
+    { I_DIV4,       3, {     202,    8475 } },
+    { I_DIV4,      17, {     693,    8652 } }, // arduboy cycles estimated
+    { I_UMOD2,     13, {     209,    5758 } },
+    { I_UMOD2,      3, {     113,    5571 } },
+    { I_UMOD2,      9, {     209,    5696 } }, // arduboy cycles estimated
+    { I_UMOD4,     26, {     676,    8317 } },
+    { I_UMOD4,      3, {     185,    8425 } },
+    { I_UMOD4,     17, {     676,    8352 } }, // arduboy cycles estimated
+    { I_MOD2,      13, {     226,    5836 } },
+    { I_MOD2,       3, {     130,    5666 } },
+    { I_MOD2,       9, {     226,    5829 } }, // arduboy cycles estimated
+    { I_MOD4,      26, {     693,    8499 } },
+    { I_MOD4,       3, {     202,    8317 } },
+    { I_MOD4,      17, {     693,    8460 } }, // arduboy cycles estimated
+    { I_LSL,        0, {      27,    4802 } },
+    { I_LSL,        1, {      27,    4803 } },
+    { I_LSL,        4, {      27,    4776 } },
+    { I_LSL,        7, {      27,    4951 } },
+    { I_LSL,        8, {      20,    4840 } },
+    { I_LSL,       64, {      20,    4959 } },
+    { I_LSL2,       0, {      24,    6923 } },
+    { I_LSL2,       1, {      31,    6637 } },
+    { I_LSL2,       4, {      46,    6618 } },
+    { I_LSL2,       7, {      61,    6468 } }, // arduboy cycles estimated
+    { I_LSL2,       8, {      30,    6530 } },
+    { I_LSL2,      15, {      63,    6870 } },
+    { I_LSL2,      16, {      26,    5685 } },
+    { I_LSL2,      64, {      26,    5364 } },
+    { I_LSL4,       0, {      34,    6958 } },
+    { I_LSL4,       1, {      41,    7073 } },
+    { I_LSL4,       4, {      62,    6934 } },
+    { I_LSL4,       8, {      90,    6885 } },
+    { I_LSL4,      15, {     139,    6874 } }, // arduboy cycles estimated
+    { I_LSL4,      16, {      39,    6954 } },
+    { I_LSL4,      24, {      93,    6865 } },
+    { I_LSL4,      31, {     142,    6893 } },
+    { I_LSL4,      32, {      34,    6892 } },
+    { I_LSL4,      64, {      34,    7117 } },
+    { I_LSR,        0, {      27,    4683 } },
+    { I_LSR,        1, {      27,    4746 } },
+    { I_LSR,        4, {      27,    5231 } },
+    { I_LSR,        7, {      27,    5052 } },
+    { I_LSR,        8, {      20,    4590 } },
+    { I_LSR,       64, {      20,    4844 } },
+    { I_LSR2,       0, {      24,    6642 } },
+    { I_LSR2,       1, {      31,    5401 } },
+    { I_LSR2,       4, {      46,    5965 } },
+    { I_LSR2,       7, {      61,    6608 } }, // arduboy cycles estimated
+    { I_LSR2,       8, {      30,    7104 } },
+    { I_LSR2,      15, {      63,    6625 } },
+    { I_LSR2,      16, {      26,    5493 } },
+    { I_LSR2,      64, {      26,    5748 } },
+    { I_LSR4,       0, {      34,    7213 } },
+    { I_LSR4,       1, {      41,    7782 } },
+    { I_LSR4,       4, {      62,    7119 } },
+    { I_LSR4,       8, {      90,    7129 } },
+    { I_LSR4,      15, {     139,    7105 } }, // arduboy cycles estimated
+    { I_LSR4,      16, {      39,    7124 } },
+    { I_LSR4,      24, {      93,    7122 } },
+    { I_LSR4,      31, {     142,    7144 } },
+    { I_LSR4,      32, {      34,    7130 } },
+    { I_LSR4,      64, {      34,    7084 } },
+    { I_ASR,        0, {      20,    4812 } },
+    { I_ASR,        1, {      24,    5034 } },
+    { I_ASR,        4, {      36,    5106 } },
+    { I_ASR,        6, {      44,    5143 } }, // arduboy cycles estimated
+    { I_ASR,        7, {      22,    5161 } },
+    { I_ASR,        8, {      22,    4669 } },
+    { I_ASR,       64, {      22,    4580 } },
+    { I_ASR2,       0, {      24,    6263 } },
+    { I_ASR2,       1, {      29,    6798 } },
+    { I_ASR2,       4, {      44,    7040 } },
+    { I_ASR2,       8, {      64,    6884 } },
+    { I_ASR2,      15, {      99,    6952 } },
+    { I_ASR2,      16, {      26,    6697 } },
+    { I_ASR2,      64, {      26,    6306 } },
+    { I_ASR4,       0, {      34,    6923 } },
+    { I_ASR4,       1, {      41,    6957 } },
+    { I_ASR4,       4, {      62,    7093 } },
+    { I_ASR4,       8, {      90,    6911 } },
+    { I_ASR4,      16, {     146,    6990 } },
+    { I_ASR4,      24, {     202,    6925 } },
+    { I_ASR4,      31, {     251,    6937 } },
+    { I_ASR4,      32, {      34,    6816 } },
+    { I_ASR4,      64, {      34,    6818 } },
+    { I_AND,       -1, {      17,    4311 } },
+    { I_AND2,      -1, {      21,    6522 } },
+    { I_AND4,      -1, {      35,    8643 } },
+    { I_OR,        -1, {      17,    4313 } },
+    { I_OR2,       -1, {      21,    6888 } },
+    { I_OR4,       -1, {      35,    8430 } },
+    { I_XOR,       -1, {      17,    4519 } },
+    { I_XOR2,      -1, {      21,    6848 } },
+    { I_XOR4,      -1, {      35,    8268 } },
+    { I_COMP,      -1, {      17,    4672 } },
+    { I_COMP2,     -1, {      18,    5338 } },
+    { I_COMP4,     -1, {      27,    6324 } },
+    { I_BOOL,      -1, {      17,    4606 } },
+    { I_BOOL2,     -1, {      18,    4606 } },
+    { I_BOOL3,     -1, {      20,    6626 } },
+    { I_BOOL4,     -1, {      23,    6085 } },
+    { I_CULT,      -1, {      18,    4702 } },
+    { I_CULT2,     -1, {      22,    5342 } },
+    { I_CULT3,     -1, {      27,    7396 } },
+    { I_CULT4,     -1, {      32,    7853 } },
+    { I_CSLT,      -1, {      18,    4675 } },
+    { I_CSLT2,     -1, {      22,    5732 } },
+    { I_CSLT3,     -1, {      27,    7652 } },
+    { I_CSLT4,     -1, {      32,    7377 } },
+    { I_CFEQ,      -1, {      76,    7795 } },
+    { I_CFLT,      -1, {      77,    7560 } },
+    { I_NOT,       -1, {      17,    4702 } },
+    { I_FADD,      -1, {     154,    8311 } },
+    { I_FSUB,      -1, {     155,    8513 } },
+    { I_FMUL,      -1, {     158,    8406 } },
+    { I_FDIV,      -1, {     500,    8542 } },
+    { I_F2I,       -1, {     115,    6514 } },
+    { I_F2U,       -1, {     105,    6622 } },
+    { I_I2F,       -1, {      92,    6595 } },
+    { I_U2F,       -1, {      92,    6675 } },
+    { I_BZ,         0, {      68,    8545 } },
+    { I_BZ,         1, {     144,    8959 } },
+    { I_BZ1,        0, {      34,    4801 } },
+    { I_BZ1,        1, {     112,    8281 } },
+    { I_BZ2,        0, {      51,    7166 } },
+    { I_BZ2,        1, {     127,    7257 } },
+    { I_BNZ,        0, {      68,    8818 } },
+    { I_BNZ,        1, {     144,    9569 } },
+    { I_BNZ1,       0, {      34,    4692 } },
+    { I_BNZ1,       1, {     112,    5207 } },
+    { I_BNZ2,       0, {      51,    7776 } },
+    { I_BNZ2,       1, {     127,    7409 } },
+    { I_BZP,        0, {      68,    9452 } },
+    { I_BZP,        1, {     144,    9646 } },
+    { I_BZP1,       0, {      34,    5061 } },
+    { I_BZP1,       1, {     110,    5358 } },
+    { I_BNZP,       0, {      68,   10109 } },
+    { I_BNZP,       1, {     144,    9320 } },
+    { I_BNZP1,      0, {      34,    5224 } },
+    { I_BNZP1,      1, {     110,    5352 } },
+    { I_JMP,       -1, {     144,    9200 } },
+    { I_JMP1,      -1, {     110,    5423 } },
+    { I_JMP2,      -1, {     127,    7255 } },
+    { I_CALL,      -1, {     144,    9307 } },
+    { I_CALL1,     -1, {     121,    5861 } },
+    { I_CALL2,     -1, {     128,    8047 } },
+    { I_ICALL,     -1, {     118,    5177 } },
+    { I_RET,       -1, {     109,    3871 } },
+};
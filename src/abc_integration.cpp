@@ -1,6 +1,7 @@
 int abc_benchmarks();
 int abc_docs();
 int abc_tests();
+int abc_host_tests();
 
 int main(int argc, char** argv)
 {
@@ -8,6 +9,7 @@ int main(int argc, char** argv)
     (void)argv;
 
     if(0 != abc_tests()) return 1;
+    if(0 != abc_host_tests()) return 1;
     if(0 != abc_benchmarks()) return 1;
     if(0 != abc_docs()) return 1;
     
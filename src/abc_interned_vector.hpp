@@ -0,0 +1,122 @@
+#pragma once
+
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <cassert>
+#include <stddef.h>
+
+namespace abc
+{
+
+// Immutable vector whose contents are hash-consed: equal contents are
+// stored once, so copies are pointer copies and vectors with the same
+// pointer are known to be equal. Element equality for interning is given
+// by Same, which must be exact (not merely equivalent), and Hash must
+// agree with it. Like the symbol table, the tables are shared by all
+// compilers in the process, may be used from several threads, and never
+// free their entries.
+template<class T, class Hash, class Same>
+class interned_vector_t
+{
+public:
+    using value_type = T;
+    using vector_type = std::vector<T>;
+    using const_iterator = typename vector_type::const_iterator;
+
+    interned_vector_t() : v(&empty_vector()) {}
+    interned_vector_t(vector_type const& t) : v(intern(t)) {}
+    interned_vector_t(std::initializer_list<T> t) : v(intern(vector_type(t))) {}
+
+    size_t size() const { return v->size(); }
+    bool empty() const { return v->empty(); }
+    T const& operator[](size_t i) const { assert(i < v->size()); return (*v)[i]; }
+    T const& front() const { return v->front(); }
+    T const& back() const { return v->back(); }
+    const_iterator begin() const { return v->begin(); }
+    const_iterator end() const { return v->end(); }
+    T const* data() const { return v->data(); }
+    vector_type const& vec() const { return *v; }
+
+    // modifications intern a changed copy
+    void push_back(T const& t)
+    {
+        vector_type c = *v;
+        c.push_back(t);
+        v = intern(c);
+    }
+    void set(size_t i, T const& t)
+    {
+        assert(i < v->size());
+        vector_type c = *v;
+        c[i] = t;
+        v = intern(c);
+    }
+    void clear() { v = &empty_vector(); }
+
+    // same contents
+    bool same(interned_vector_t const& o) const { return v == o.v; }
+    size_t hash() const { return std::hash<void const*>{}(v); }
+
+    // equal under T's operator==, which may be coarser than Same
+    friend bool operator==(interned_vector_t const& a, interned_vector_t const& b)
+    {
+        return a.v == b.v || *a.v == *b.v;
+    }
+    friend bool operator!=(interned_vector_t const& a, interned_vector_t const& b)
+    {
+        return !(a == b);
+    }
+
+private:
+    struct vector_hash
+    {
+        size_t operator()(vector_type const& t) const
+        {
+            size_t h = t.size();
+            for(auto const& x : t)
+                h = h * 0x9e3779b97f4a7c15ull + Hash{}(x);
+            return h;
+        }
+    };
+    struct vector_same
+    {
+        bool operator()(vector_type const& a, vector_type const& b) const
+        {
+            if(a.size() != b.size())
+                return false;
+            for(size_t i = 0; i < a.size(); ++i)
+                if(!Same{}(a[i], b[i]))
+                    return false;
+            return true;
+        }
+    };
+    struct table_t
+    {
+        std::mutex mutex;
+        std::unordered_set<vector_type, vector_hash, vector_same> set;
+    };
+
+    static vector_type const& empty_vector()
+    {
+        static vector_type const e;
+        return e;
+    }
+
+    static vector_type const* intern(vector_type const& t)
+    {
+        if(t.empty())
+            return &empty_vector();
+        static table_t table;
+        std::lock_guard<std::mutex> lock(table.mutex);
+        return &*table.set.insert(t).first;
+    }
+
+    vector_type const* v;
+};
+
+}
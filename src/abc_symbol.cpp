@@ -0,0 +1,66 @@
+#include "abc_symbol.hpp"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include <cassert>
+
+namespace abc
+{
+
+// Names are stored in fixed-size chunks that never move, so a name can
+// be read without locking once its id is known.
+static constexpr uint32_t CHUNK_BITS = 12;
+static constexpr uint32_t CHUNK_SIZE = 1u << CHUNK_BITS;
+static constexpr uint32_t MAX_CHUNKS = 1u << 16;
+
+namespace
+{
+struct symbol_table_t
+{
+    std::mutex mutex;
+    std::unordered_map<std::string_view, uint32_t> ids;
+    std::unique_ptr<std::string[]> chunks[MAX_CHUNKS];
+    uint32_t count;
+
+    symbol_table_t()
+        : count(1) // id 0 is the empty name
+    {
+        chunks[0].reset(new std::string[CHUNK_SIZE]);
+        ids[chunks[0][0]] = 0;
+    }
+};
+}
+
+static symbol_table_t& table()
+{
+    static symbol_table_t* t = new symbol_table_t;
+    return *t;
+}
+
+uint32_t symbol_t::intern(std::string_view s)
+{
+    if(s.empty())
+        return 0;
+    auto& t = table();
+    std::lock_guard<std::mutex> lock(t.mutex);
+    if(auto it = t.ids.find(s); it != t.ids.end())
+        return it->second;
+    uint32_t id = t.count++;
+    assert((id >> CHUNK_BITS) < MAX_CHUNKS);
+    auto& chunk = t.chunks[id >> CHUNK_BITS];
+    if(!chunk)
+        chunk.reset(new std::string[CHUNK_SIZE]);
+    auto& name = chunk[id & (CHUNK_SIZE - 1)];
+    name = s;
+    t.ids[name] = id;
+    return id;
+}
+
+std::string const& symbol_t::name(uint32_t id)
+{
+    return table().chunks[id >> CHUNK_BITS][id & (CHUNK_SIZE - 1)];
+}
+
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include <stdint.h>
+
+namespace abc
+{
+
+// Interned name of a label, function or global. Equal names share one
+// integer id, so symbols are cheap to copy, compare and hash. The symbol
+// table is shared by all compilers and assemblers in the process and may
+// be used from several threads.
+//
+// Symbols are never released: ids stay valid for the life of the process,
+// because cached syntax trees (abcc --watch) and the IDE's last build keep
+// them across compiles. The table therefore grows by every distinct name
+// seen, e.g. each renamed function or global. That is a few dozen bytes
+// per name, which a long editing session does not come close to making
+// significant, so there is no per-session table to clear.
+struct symbol_t
+{
+    symbol_t() : id(0) {}
+    symbol_t(std::string const& s) : id(intern(s)) {}
+    symbol_t(std::string_view s) : id(intern(s)) {}
+    symbol_t(char const* s) : id(intern(s)) {}
+
+    std::string const& str() const { return name(id); }
+    operator std::string const&() const { return name(id); }
+    bool empty() const { return id == 0; }
+    uint32_t index() const { return id; }
+
+    friend bool operator==(symbol_t a, symbol_t b) { return a.id == b.id; }
+    friend bool operator!=(symbol_t a, symbol_t b) { return a.id != b.id; }
+    friend bool operator==(symbol_t a, std::string const& b) { return a.str() == b; }
+    friend bool operator!=(symbol_t a, std::string const& b) { return a.str() != b; }
+    friend bool operator==(symbol_t a, char const* b) { return a.str() == b; }
+    friend bool operator!=(symbol_t a, char const* b) { return a.str() != b; }
+    friend bool operator==(std::string const& a, symbol_t b) { return a == b.str(); }
+    friend bool operator!=(std::string const& a, symbol_t b) { return a != b.str(); }
+
+    // orders by name, not by id, so sorted output does not depend on
+    // the order in which symbols were created
+    friend bool operator<(symbol_t a, symbol_t b)
+    {
+        return a.id != b.id && a.str() < b.str();
+    }
+
+private:
+    static uint32_t intern(std::string_view s);
+    static std::string const& name(uint32_t id);
+    uint32_t id;
+};
+
+inline std::ostream& operator<<(std::ostream& f, symbol_t s)
+{
+    return f << s.str();
+}
+
+inline std::string operator+(std::string const& a, symbol_t b) { return a + b.str(); }
+inline std::string operator+(char const* a, symbol_t b) { return a + b.str(); }
+inline std::string operator+(symbol_t a, std::string const& b) { return a.str() + b; }
+inline std::string operator+(symbol_t a, char const* b) { return a.str() + b; }
+
+}
+
+namespace std
+{
+template<> struct hash<abc::symbol_t>
+{
+    size_t operator()(abc::symbol_t s) const noexcept { return s.index(); }
+};
+}
@@ -0,0 +1,92 @@
+#include "abc_time_report.hpp"
+
+#include <algorithm>
+
+namespace abc
+{
+
+std::atomic<size_t> alloc_current_bytes{ 0 };
+std::atomic<size_t> alloc_peak_bytes{ 0 };
+bool alloc_tracking_enabled = false;
+
+static void raise_peak(size_t n)
+{
+    size_t peak = alloc_peak_bytes.load(std::memory_order_relaxed);
+    while(n > peak && !alloc_peak_bytes.compare_exchange_weak(
+        peak, n, std::memory_order_relaxed))
+        ;
+}
+
+void track_alloc(size_t n)
+{
+    raise_peak(alloc_current_bytes.fetch_add(n, std::memory_order_relaxed) + n);
+}
+
+void track_free(size_t n)
+{
+    alloc_current_bytes.fetch_sub(n, std::memory_order_relaxed);
+}
+
+time_report_t::phase_t& time_report_t::phase(std::string const& name)
+{
+    for(auto& p : phases)
+        if(p.name == name)
+            return p;
+    auto& p = phases.emplace_back();
+    p.name = name;
+    p.depth = open;
+    return p;
+}
+
+void time_report_t::add_seconds(std::string const& name, double seconds, size_t runs)
+{
+    auto& p = phase(name);
+    p.seconds += seconds;
+    p.runs += runs;
+}
+
+phase_timer_t::phase_timer_t(
+    time_report_t& r, std::string const& name, std::function<size_t()> count)
+    : report(r)
+    , count(std::move(count))
+    , instrs(0)
+    , running(true)
+{
+    auto& p = r.phase(name);
+    index = size_t(&p - r.phases.data());
+    r.open += 1;
+    if(this->count)
+        instrs = this->count();
+    base_bytes = alloc_current_bytes.load(std::memory_order_relaxed);
+    outer_peak = alloc_peak_bytes.exchange(base_bytes, std::memory_order_relaxed);
+    t0 = std::chrono::steady_clock::now();
+}
+
+void phase_timer_t::stop()
+{
+    if(!running)
+        return;
+    running = false;
+    auto t1 = std::chrono::steady_clock::now();
+    size_t peak = alloc_peak_bytes.load(std::memory_order_relaxed);
+    raise_peak(outer_peak);
+
+    auto& p = report.phases[index];
+    p.seconds += std::chrono::duration<double>(t1 - t0).count();
+    p.has_peak = true;
+    if(peak > base_bytes)
+        p.peak_bytes = std::max(p.peak_bytes, peak - base_bytes);
+    if(count)
+    {
+        if(p.runs == 0)
+        {
+            p.has_instrs = true;
+            p.instrs_before = p.instrs_after = instrs;
+        }
+        p.instrs_after += count() - instrs;
+    }
+    p.runs += 1;
+    report.open -= 1;
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace abc
+{
+
+// Bytes currently allocated through the global operator new, and the
+// most allocated at once since the last reset. These are only counted in
+// programs that link abc_alloc_tracking.cpp, which replaces the global
+// allocation functions and sets alloc_tracking_enabled.
+extern std::atomic<size_t> alloc_current_bytes;
+extern std::atomic<size_t> alloc_peak_bytes;
+extern bool alloc_tracking_enabled;
+
+void track_alloc(size_t n);
+void track_free(size_t n);
+
+// Wall time, peak allocation and instruction counts of the phases of a
+// compile or link. Phases are identified by name: running a phase again
+// adds to its totals.
+struct time_report_t
+{
+    struct phase_t
+    {
+        std::string name;
+        int depth;            // number of phases the first run was nested in
+        size_t runs;
+        double seconds;
+        bool has_peak;        // false for time added without a timer
+        size_t peak_bytes;    // most bytes allocated above the start of a run
+        bool has_instrs;
+        size_t instrs_before; // instructions before the first run
+        size_t instrs_after;  // instrs_before plus the net change of all runs
+    };
+    std::vector<phase_t> phases;
+
+    void clear() { phases.clear(); open = 0; }
+    phase_t& phase(std::string const& name);
+
+    // adds time measured outside a timer (e.g. summed over threads)
+    void add_seconds(std::string const& name, double seconds, size_t runs);
+
+    int open = 0;
+};
+
+// Times one run of a phase, from construction to stop() or destruction.
+// Timers must nest and, since allocation peaks are process-wide, only one
+// thread should run timers at a time. The optional count function gives
+// the current number of instructions.
+class phase_timer_t
+{
+public:
+    phase_timer_t(time_report_t& r, std::string const& name,
+        std::function<size_t()> count = {});
+    ~phase_timer_t() { stop(); }
+    void stop();
+    phase_timer_t(phase_timer_t const&) = delete;
+    phase_timer_t& operator=(phase_timer_t const&) = delete;
+
+private:
+    time_report_t& report;
+    size_t index;
+    std::function<size_t()> count;
+    size_t instrs;
+    size_t base_bytes;
+    size_t outer_peak;
+    std::chrono::steady_clock::time_point t0;
+    bool running;
+};
+
+}
@@ -1,26 +1,31 @@
 #include <abc_compiler.hpp>
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <set>
 #include <sstream>
 #include <filesystem>
+#include <thread>
 
 #include <cstring>
 
-#include <argparse/argparse.hpp>
-
-#define PROFILE_COUNT 1
-
-#ifndef NDEBUG
-#undef PROFILE_COUNT
-#define PROFILE_COUNT 1
+#ifdef __linux__
+#include <sys/inotify.h>
 #endif
-
-#define PROFILING (PROFILE_COUNT > 1)
-#if PROFILING
-#include <ctime>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 #endif
 
+#include <argparse/argparse.hpp>
+
 void export_arduboy(
     std::string const& filename,
     std::vector<uint8_t> const& binary, bool has_save, bool universal, int shades,
@@ -33,26 +38,43 @@ static void usage(char const* argv0)
     std::cout << "Usage: " << argv0 << " <main.abc> [fxdata.bin] [-a game.arduboy]" << std::endl;
 }
 
-#include <cmath>
+static void print_opt_stats(abc::compiler_t::opt_stats_t const& s)
+{
+    double total = 0;
+    printf("Optimizer: %d + %d rounds\n", (int)s.rounds[0], (int)s.rounds[1]);
+    printf("Pass            Runs   Visited   Skipped   Changed   Time (ms)\n");
+    for(auto const& p : s.passes)
+    {
+        printf("%-14s %5d %9d %9d %9d %11.2f\n",
+            p.name, (int)p.runs, (int)p.visited, (int)p.skipped, (int)p.changed,
+            p.seconds * 1000);
+        total += p.seconds;
+    }
+    printf("Total %57.2f\n", total * 1000);
+    printf("======================\n");
+}
 
-int main(int argc, char** argv)
+static void print_time_report(abc::time_report_t const& r)
 {
-#if 0
-    for(int i = 0; i < 129; ++i)
+    for(auto const& p : r.phases)
     {
-        double f = 440.0 * std::pow(2.0, 1.0 / 12 * (i - 69));
-        double pre = ceil(log2(16e6 / (1023 * f))) + 1.0;
-        pre = std::clamp(pre, 1.0, 15.0);
-        double top = round(16e6 / pow(2.0, pre - 1.0) / f) - 1.0;
-        uint16_t ipre = (uint16_t)pre;
-        uint16_t itop = (uint16_t)top;
-        if(i == 0)
-            ipre = itop = 0;
-        uint16_t t = (ipre << 12) | (itop & 0x0fff);
-        printf("0x%04x,%c", t, i % 8 == 7 ? '\n' : ' ');
+        int indent = p.depth * 2;
+        printf("%*s%-*s %5d %11.2f", indent, "", 18 - indent, p.name.c_str(),
+            (int)p.runs, p.seconds * 1000);
+        if(abc::alloc_tracking_enabled && p.has_peak)
+            printf(" %11.1f", (double)p.peak_bytes / 1024);
+        else
+            printf(" %11s", "-");
+        if(p.has_instrs)
+            printf(" %11d %11d", (int)p.instrs_before, (int)p.instrs_after);
+        printf("\n");
     }
-#endif
+}
+
+#include <cmath>
 
+struct options_t
+{
     std::filesystem::path psrc;
     std::filesystem::path pbin;
     std::filesystem::path pdata;
@@ -60,110 +82,117 @@ int main(int argc, char** argv)
     std::filesystem::path parduboy;
     std::filesystem::path pasm;
     std::filesystem::path pinterp;
+    std::filesystem::path pcache;
+    std::filesystem::path psocket;
+    std::filesystem::path pprofile;
+    std::filesystem::path pprofile_bin;
+    bool universal = false;
+    bool show_asm = false;
+    bool opt_stats = false;
+    bool time_report = false;
+    bool summary = true;
+    abc::opt_goal_t opt_goal = abc::OPT_GOAL_SPEED;
+    abc::cost_vm_t cost_vm = abc::COST_VM_ARDUBOY;
+};
+
+static bool load_file(std::string const& fname, std::vector<char>& t)
+{
+    std::ifstream f(fname, std::ios::in | std::ios::binary);
+    if(f.fail()) return false;
+    t = std::vector<char>(
+        (std::istreambuf_iterator<char>(f)),
+        (std::istreambuf_iterator<char>()));
+    return true;
+}
 
-    argparse::ArgumentParser args("abcc", ABC_VERSION);
-    args.add_argument("<main.abc>")
-        .help("path to top-level ABC source file")
-        .action([&](std::string const& v) { psrc = v; });
-    args.add_argument("-i", "--interp")
-        .help("path to interpreter .hex output file")
-        .metavar("PATH")
-        .action([&](std::string const& v) { pinterp = v; });
-    args.add_argument("-b", "--bin")
-        .help("path to development FX data output file")
-        .metavar("PATH")
-        .action([&](std::string const& v) { pbin = v; });
-    args.add_argument("-d", "--data")
-        .help("path to FX data output file")
-        .metavar("PATH")
-        .action([&](std::string const& v) { pdata = v; });
-    args.add_argument("-s", "--save")
-        .help("path to FX save output file (if there are no saved variables, no file is written)")
-        .metavar("PATH")
-        .action([&](std::string const& v) { psave = v; });
-    args.add_argument("-u", "--universal")
-        .help("universal .arduboy file (include binaries for Arduboy Mini and homemade variants)")
-        .flag();
-    args.add_argument("-a", "--arduboy")
-        .help("path to .arduboy output file")
-        .metavar("PATH")
-        .action([&](std::string const& v) { parduboy = v; });
-    args.add_argument("-S", "--asm")
-        .help("path to .asm output file")
-        .metavar("PATH")
-        .action([&](std::string const& v) { pasm = v; });
-
-    try {
-        args.parse_args(argc, argv);
+// Loads the profile given by --profile-use. Its PCs refer to the binary
+// given by --profile-bin, or else to the --bin output of the previous
+// build, which is read before this build replaces it.
+static bool load_profile(abc::compiler_t& c, options_t const& o)
+{
+    if(o.pprofile.empty())
+        return true;
+    auto pbin = o.pprofile_bin.empty() ? o.pbin : o.pprofile_bin;
+    if(pbin.empty())
+    {
+        std::cerr << "--profile-use needs --profile-bin or --bin" << std::endl;
+        return false;
     }
-    catch(const std::exception& err) {
-        std::cerr << err.what() << std::endl;
-        std::cerr << args;
-#ifdef NDEBUG
-        std::exit(1);
-#endif
+    std::vector<char> binary;
+    if(!load_file(pbin.generic_string(), binary))
+    {
+        std::cerr << "Unable to open file: \"" << pbin.generic_string() << "\"" << std::endl;
+        return false;
     }
-
-    if(!psrc.empty() &&
-        pbin.empty() &&
-        pdata.empty() &&
-        psave.empty() &&
-        parduboy.empty() &&
-        pasm.empty() &&
-        pinterp.empty())
-        parduboy = psrc.parent_path() / "game.arduboy";
-
-    bool show_asm = false;
-#ifndef NDEBUG
-    show_asm = true;
-#endif
-
-#if PROFILING
-    psrc = "C:/Users/Brown/Documents/GitHub/abc/examples/platformer/main.abc";
-#endif
-
-#ifndef NDEBUG
-    //psrc = "C:/Users/Brown/Documents/GitHub/summer_camp/src/main.abc";
-    //psrc = "C:/Users/Brown/Documents/GitHub/abc/examples/test/main.abc";
-    //psrc = "C:/Users/Brown/Documents/GitHub/abc/examples/platformer/main.abc";
-    //psrc = "C:/Users/Brown/Documents/GitHub/abc/benchmarks/fibonacci/fibonacci.abc";
-    psrc = "C:/Users/Brown/Documents/GitHub/abc/tests/tests/func_ref.abc";
-    //pbin = "C:/Users/Brown/Documents/GitHub/abc/examples/test/blah.bin";
-    //parduboy = "C:/Users/Brown/Documents/GitHub/abc/examples/test/test.arduboy";
-#endif
-
-    if(psrc.empty())
+    std::ifstream f(o.pprofile, std::ios::in);
+    if(f.fail())
     {
-        usage(argv[0]);
-        return 1;
+        std::cerr << "Unable to open file: \"" << o.pprofile.generic_string() << "\"" << std::endl;
+        return false;
     }
-    if(pbin.empty() && parduboy.empty())
-        show_asm = true;
-
-    psrc = std::filesystem::current_path() / psrc;
-
-    abc::compiler_t c;
-    abc::assembler_t a;
-
-#if PROFILING
-    auto ta = clock();
-
-    for(int prof = 0; prof < PROFILE_COUNT; ++prof)
+    auto e = c.load_profile(std::vector<uint8_t>(binary.begin(), binary.end()), f);
+    if(!e.msg.empty())
     {
-#endif
+        std::cerr << o.pprofile.generic_string();
+        if(e.line_info.first != 0)
+            std::cerr << ":" << e.line_info.first;
+        std::cerr << ": error: " << e.msg << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    c = {};
-    a = {};
+// Outputs are written to a temporary file that is renamed into place, so
+// that an emulator or uploader watching them never reads a partial file.
+static bool replace_file(
+    std::filesystem::path const& path,
+    std::function<void(std::string const&)> const& write)
+{
+    auto tmp = path;
+    tmp += ".tmp";
+    write(tmp.generic_string());
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if(ec)
+        std::filesystem::remove(tmp, ec);
+    return !ec;
+}
 
-    std::stringstream fasm;
+static bool replace_file(std::filesystem::path const& path, void const* data, size_t size)
+{
+    return replace_file(path, [&](std::string const& fname) {
+        std::ofstream f(fname, std::ios::out | std::ios::binary);
+        if(f)
+            f.write((char const*)data, size);
+    });
+}
 
-    c.compile(psrc.parent_path().generic_string(), psrc.stem().generic_string(), fasm);
+// Compiles o.psrc and writes the requested outputs. Diagnostics go to err.
+// When inputs is given, it receives the name of every file the compiler
+// tried to read.
+static bool build(
+    abc::compiler_t& c, abc::assembler_t& a, options_t const& o,
+    std::ostream& err, std::set<std::string>* inputs = nullptr)
+{
+    auto unable_to_open = [&](std::filesystem::path const& p) {
+        err << "Unable to open file: \"" << p.generic_string() << "\"" << std::endl;
+        return false;
+    };
+
+    c.opt_goal = o.opt_goal;
+    c.cost_vm = o.cost_vm;
+    c.compile(o.psrc.parent_path().generic_string(), o.psrc.stem().generic_string(),
+        [inputs](std::string const& fname, std::vector<char>& t) {
+            if(inputs)
+                inputs->insert(fname);
+            return load_file(fname, t);
+        });
     for(auto const& e : c.errors())
     {
         //std::cerr << "Compiler Error" << std::endl;
         //std::cerr << /* argv[2] << ":" << */ e.line_info.first << ":" << e.line_info.second << std::endl;
         //std::cerr << e.msg << std::endl;
-        std::cerr
+        err
             << c.error_file()
             << ":"
             << e.line_info.first
@@ -174,31 +203,32 @@ int main(int argc, char** argv)
             << std::endl;
     }
     if(!c.errors().empty())
-        return 1;
+        return false;
 
-#if !PROFILING
-    if(show_asm)
-        std::cout << fasm.str() << std::endl;
-#endif
+    // assembly text is only produced when requested; the assembler
+    // reads the compiler output directly
+    if(o.show_asm)
+    {
+        c.write(std::cout);
+        std::cout << std::endl;
+    }
 
-    if(!pasm.empty())
+    if(!o.pasm.empty())
     {
-        std::ofstream f(pasm);
-        if(!f)
-        {
-            std::cerr << "Unable to open file: \"" << pasm.generic_string() << "\"" << std::endl;
-            return 1;
-        }
-        f << fasm.str();
+        std::ostringstream f;
+        c.write(f);
+        std::string t = f.str();
+        if(!replace_file(o.pasm, t.data(), t.size()))
+            return unable_to_open(o.pasm);
     }
 
     {
-        auto e = a.assemble(fasm);
+        auto e = a.assemble(c);
         if(!e.msg.empty())
         {
-            std::cerr << "Assembler Error" << std::endl;
-            std::cerr << e.msg << std::endl;
-            return 1;
+            err << "Assembler Error" << std::endl;
+            err << e.msg << std::endl;
+            return false;
         }
     }
 
@@ -206,78 +236,542 @@ int main(int argc, char** argv)
         auto e = a.link();
         if(!e.msg.empty())
         {
-            std::cerr << "Linker Error" << std::endl;
-            std::cerr << e.msg << std::endl;
-            return 1;
+            err << "Linker Error" << std::endl;
+            err << e.msg << std::endl;
+            return false;
         }
     }
 
-#if PROFILING
+    if(o.summary)
+    {
+        printf("Compilation Succeeded!\n");
+        printf("======================\n");
+        printf("Dev Bin: %7d bytes  %6.1f KB\n", (int)a.data().size(), (double)a.data().size() / 1024);
+        printf("======================\n");
+        printf("Data:    %7d bytes  %6.1f KB\n", (int)a.data_size(), (double)a.data_size() / 1024);
+        printf("Code:    %7d bytes  %6.1f KB\n", (int)a.code_size(), (double)a.code_size() / 1024);
+        printf("Debug:   %7d bytes  %6.1f KB\n", (int)a.debug_size(), (double)a.debug_size() / 1024);
+        printf("======================\n");
+        printf("Globals: %7d bytes\n", (int)a.globals_size());
+        printf("Save:    %7d bytes\n", (int)a.save_size());
+        printf("======================\n");
+    }
+
+    if(o.opt_stats)
+        print_opt_stats(c.opt_stats());
+
+    if(o.time_report)
+    {
+        printf("%-18s %5s %11s %11s %11s %11s\n", "Phase", "Runs",
+            "Time (ms)", "Peak (KB)", "Instrs in", "Instrs out");
+        print_time_report(c.time_report());
+        print_time_report(a.time_report());
+        printf("======================\n");
+    }
+
+    if(!o.pbin.empty())
+    {
+        if(!replace_file(o.pbin, a.data().data(), a.data().size()))
+            return unable_to_open(o.pbin);
+    }
+
+    if(!o.pdata.empty())
+    {
+        size_t save_bytes = a.has_save() ? 4096 : 0;
+        if(!replace_file(o.pdata, a.data().data(), a.data().size() - save_bytes))
+            return unable_to_open(o.pdata);
+    }
+
+    if(!o.psave.empty() && a.has_save())
+    {
+        if(!replace_file(o.psave, a.data().data() + a.data().size() - 4096, 4096))
+            return unable_to_open(o.psave);
+    }
+
+    if(!o.pinterp.empty())
+    {
+        replace_file(o.pinterp, [&](std::string const& fname) {
+            export_interpreter_hex(fname, a.num_shades());
+        });
+    }
+
+    if(!o.parduboy.empty())
+    {
+        replace_file(o.parduboy, [&](std::string const& fname) {
+            export_arduboy(
+                fname,
+                a.data(), a.has_save(), o.universal, a.num_shades(),
+                c.arduboy_directives());
+        });
     }
 
-    auto tb = clock();
+    return true;
+}
+
+// Reports changes to a set of files: through inotify on the directories
+// that hold them on Linux, and by polling modification times elsewhere.
+class file_watcher_t
+{
+public:
+    file_watcher_t()
+    {
+#ifdef __linux__
+        ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+    }
+    ~file_watcher_t()
+    {
+#ifdef __linux__
+        if(ifd >= 0)
+            close(ifd);
+#endif
+    }
 
-    printf("Time: %f\n", double(tb - ta) / CLOCKS_PER_SEC);
+    // descriptor that becomes readable on changes, or -1 if polling
+    int fd() const
+    {
+#ifdef __linux__
+        return ifd;
+#else
+        return -1;
 #endif
+    }
 
-    printf("Compilation Succeeded!\n");
-    printf("======================\n");
-    printf("Dev Bin: %7d bytes  %6.1f KB\n", (int)a.data().size(), (double)a.data().size() / 1024);
-    printf("======================\n");
-    printf("Data:    %7d bytes  %6.1f KB\n", (int)a.data_size(), (double)a.data_size() / 1024);
-    printf("Code:    %7d bytes  %6.1f KB\n", (int)a.code_size(), (double)a.code_size() / 1024);
-    printf("Debug:   %7d bytes  %6.1f KB\n", (int)a.debug_size(), (double)a.debug_size() / 1024);
-    printf("======================\n");
-    printf("Globals: %7d bytes\n", (int)a.globals_size());
-    printf("Save:    %7d bytes\n", (int)a.save_size());
-    printf("======================\n");
+    void set_files(std::set<std::string> const& fnames)
+    {
+        files.clear();
+        times.clear();
+        for(auto const& f : fnames)
+        {
+            auto p = normal(f);
+            files.insert(p);
+            times[p] = write_time(p);
+        }
+#ifdef __linux__
+        if(ifd < 0)
+            return;
+        std::set<std::string> want;
+        for(auto const& f : files)
+            want.insert(std::filesystem::path(f).parent_path().generic_string());
+        for(auto it = dirs.begin(); it != dirs.end();)
+        {
+            if(want.count(it->second))
+            {
+                want.erase(it->second);
+                ++it;
+            }
+            else
+            {
+                inotify_rm_watch(ifd, it->first);
+                it = dirs.erase(it);
+            }
+        }
+        for(auto const& d : want)
+        {
+            int wd = inotify_add_watch(ifd, d.c_str(),
+                IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM);
+            if(wd >= 0)
+                dirs[wd] = d;
+        }
+#endif
+    }
 
-    if(!pbin.empty())
+    // whether any of the files changed since the last call
+    bool changed()
     {
-        std::ofstream fbin(pbin.generic_string(), std::ios::out | std::ios::binary);
-        if(!fbin)
+        bool r = false;
+#ifdef __linux__
+        if(ifd >= 0)
         {
-            std::cerr << "Unable to open file: \"" << pbin.generic_string() << "\"" << std::endl;
-            return 1;
+            alignas(inotify_event) char buf[4096];
+            ssize_t n;
+            while((n = read(ifd, buf, sizeof(buf))) > 0)
+            {
+                for(char* p = buf; p < buf + n;)
+                {
+                    auto const* e = (inotify_event const*)p;
+                    p += sizeof(inotify_event) + e->len;
+                    auto it = dirs.find(e->wd);
+                    if(it == dirs.end() || e->len == 0)
+                        continue;
+                    if(files.count(normal(it->second + "/" + e->name)))
+                        r = true;
+                }
+            }
+            return r;
         }
-        fbin.write((char const*)a.data().data(), a.data().size());
+#endif
+        for(auto& [f, t] : times)
+        {
+            auto nt = write_time(f);
+            if(nt != t)
+                r = true;
+            t = nt;
+        }
+        return r;
+    }
+
+private:
+    static std::string normal(std::string const& f)
+    {
+        return std::filesystem::path(f).lexically_normal().generic_string();
+    }
+    static std::filesystem::file_time_type write_time(std::string const& f)
+    {
+        std::error_code ec;
+        auto t = std::filesystem::last_write_time(f, ec);
+        return ec ? std::filesystem::file_time_type::min() : t;
+    }
+
+    std::set<std::string> files;
+    std::map<std::string, std::filesystem::file_time_type> times;
+#ifdef __linux__
+    int ifd = -1;
+    std::map<int, std::string> dirs;
+#endif
+};
+
+// Rebuilds whenever an input of the last build changes, keeping the
+// compiler and its parsed modules in memory between builds. Clients of
+// the optional local socket send one request per line:
+//     build        rebuild now
+//     diagnostics  report the last build
+// and receive the diagnostics of the build followed by a status line,
+// "succeeded <ms>" or "failed <ms>".
+static int watch(options_t o)
+{
+    abc::compiler_t c;
+    if(!o.pcache.empty())
+        c.set_cache_dir(o.pcache.generic_string(), ABC_VERSION);
+    c.set_memory_cache(true);
+    if(!load_profile(c, o))
+        return 1;
+    o.summary = false;
+    o.show_asm = false;
+
+    file_watcher_t watcher;
+    std::string diagnostics;
+    std::string status;
+    int builds = 0;
+
+    auto rebuild = [&] {
+        std::set<std::string> inputs{ o.psrc.generic_string() };
+        std::ostringstream err;
+        abc::assembler_t a;
+        auto t0 = std::chrono::steady_clock::now();
+        bool ok = build(c, a, o, err, &inputs);
+        auto t1 = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(t1 - t0).count();
+        watcher.set_files(inputs);
+
+        diagnostics = err.str();
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%s %.1f\n", ok ? "succeeded" : "failed", ms);
+        status = buf;
+
+        auto const& cs = c.cache_stats();
+        std::cerr << diagnostics;
+        if(cs.build_hit)
+            printf("Build %d: %s in %.1f ms (unchanged)\n",
+                ++builds, ok ? "succeeded" : "failed", ms);
+        else
+            printf("Build %d: %s in %.1f ms (%d of %d modules parsed, %d of %d assets encoded)\n",
+                ++builds, ok ? "succeeded" : "failed", ms,
+                (int)cs.module_misses, (int)(cs.module_hits + cs.module_misses),
+                (int)cs.asset_misses, (int)(cs.asset_hits + cs.asset_misses));
+        fflush(stdout);
+    };
+
+    printf("Watching %s\n", o.psrc.generic_string().c_str());
+    rebuild();
+
+#ifdef _WIN32
+    if(!o.psocket.empty())
+        std::cerr << "Local socket is not supported on this platform" << std::endl;
+    for(;;)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if(watcher.changed())
+            rebuild();
     }
+#else
+    signal(SIGPIPE, SIG_IGN);
 
-    if(!pdata.empty())
+    int lfd = -1;
+    if(!o.psocket.empty())
     {
-        std::ofstream f(pdata.generic_string(), std::ios::out | std::ios::binary);
-        if(!f)
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        std::string sp = o.psocket.string();
+        if(sp.size() >= sizeof(addr.sun_path))
         {
-            std::cerr << "Unable to open file: \"" << pdata.generic_string() << "\"" << std::endl;
+            std::cerr << "Socket path too long: \"" << sp << "\"" << std::endl;
+            return 1;
+        }
+        memcpy(addr.sun_path, sp.c_str(), sp.size() + 1);
+        // only replace a socket left behind by an earlier run
+        struct stat st;
+        if(lstat(sp.c_str(), &st) == 0)
+        {
+            if(!S_ISSOCK(st.st_mode))
+            {
+                std::cerr << "Not a socket: \"" << sp << "\"" << std::endl;
+                return 1;
+            }
+            unlink(sp.c_str());
+        }
+        lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(lfd < 0 ||
+            bind(lfd, (sockaddr const*)&addr, sizeof(addr)) != 0 ||
+            listen(lfd, 8) != 0)
+        {
+            std::cerr << "Unable to listen on socket: \"" << sp << "\"" << std::endl;
             return 1;
         }
-        size_t save_bytes = a.has_save() ? 4096 : 0;
-        f.write((char const*)a.data().data(), a.data().size() - save_bytes);
     }
 
-    if(!psave.empty() && a.has_save())
+    // client descriptor and its partial request line
+    std::vector<std::pair<int, std::string>> clients;
+    // client descriptors are non-blocking: a client that does not read
+    // its replies is dropped rather than stalling the watcher
+    auto reply = [](int fd, std::string const& t) {
+        for(size_t i = 0; i < t.size();)
+        {
+            ssize_t n = write(fd, t.data() + i, t.size() - i);
+            if(n <= 0) return false;
+            i += size_t(n);
+        }
+        return true;
+    };
+
+    for(;;)
     {
-        std::ofstream f(psave.generic_string(), std::ios::out | std::ios::binary);
-        if(!f)
+        std::vector<pollfd> fds;
+        for(auto const& [fd, line] : clients)
+            fds.push_back({ fd, POLLIN, 0 });
+        if(lfd >= 0)
+            fds.push_back({ lfd, POLLIN, 0 });
+        if(watcher.fd() >= 0)
+            fds.push_back({ watcher.fd(), POLLIN, 0 });
+        if(poll(fds.data(), (nfds_t)fds.size(), watcher.fd() >= 0 ? -1 : 100) < 0)
+            continue;
+
+        if(watcher.changed())
         {
-            std::cerr << "Unable to open file: \"" << psave.generic_string() << "\"" << std::endl;
-            return 1;
+            // editors often save in several steps: let them finish
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            watcher.changed();
+            rebuild();
+        }
+
+        bool connecting = lfd >= 0 && (fds[clients.size()].revents & POLLIN);
+
+        for(size_t i = 0, j = 0; i < clients.size(); ++j)
+        {
+            auto& [fd, line] = clients[i];
+            if(!(fds[j].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                ++i;
+                continue;
+            }
+            char buf[256];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            if(n <= 0)
+            {
+                close(fd);
+                clients.erase(clients.begin() + i);
+                continue;
+            }
+            line.append(buf, size_t(n));
+            bool ok = true;
+            for(size_t nl; ok && (nl = line.find('\n')) != std::string::npos;)
+            {
+                std::string req = line.substr(0, nl);
+                line.erase(0, nl + 1);
+                if(!req.empty() && req.back() == '\r')
+                    req.pop_back();
+                if(req == "build")
+                    rebuild();
+                else if(req != "diagnostics")
+                {
+                    ok = reply(fd, "unknown request: " + req + "\n");
+                    continue;
+                }
+                ok = reply(fd, diagnostics + status);
+            }
+            if(!ok)
+            {
+                close(fd);
+                clients.erase(clients.begin() + i);
+                continue;
+            }
+            ++i;
+        }
+
+        if(connecting)
+        {
+            int cfd = accept(lfd, nullptr, nullptr);
+            if(cfd >= 0)
+            {
+                fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK);
+                clients.push_back({ cfd, {} });
+            }
         }
-        f.write((char const*)a.data().data() + a.data().size() - 4096, 4096);
     }
+#endif
+}
 
-    if(!pinterp.empty())
+int main(int argc, char** argv)
+{
+#if 0
+    for(int i = 0; i < 129; ++i)
     {
-        export_interpreter_hex(pinterp.generic_string(), a.num_shades());
+        double f = 440.0 * std::pow(2.0, 1.0 / 12 * (i - 69));
+        double pre = ceil(log2(16e6 / (1023 * f))) + 1.0;
+        pre = std::clamp(pre, 1.0, 15.0);
+        double top = round(16e6 / pow(2.0, pre - 1.0) / f) - 1.0;
+        uint16_t ipre = (uint16_t)pre;
+        uint16_t itop = (uint16_t)top;
+        if(i == 0)
+            ipre = itop = 0;
+        uint16_t t = (ipre << 12) | (itop & 0x0fff);
+        printf("0x%04x,%c", t, i % 8 == 7 ? '\n' : ' ');
     }
+#endif
+
+    options_t o;
 
-    if(!parduboy.empty())
+    argparse::ArgumentParser args("abcc", ABC_VERSION);
+    args.add_argument("<main.abc>")
+        .help("path to top-level ABC source file")
+        .action([&](std::string const& v) { o.psrc = v; });
+    args.add_argument("-i", "--interp")
+        .help("path to interpreter .hex output file")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.pinterp = v; });
+    args.add_argument("-b", "--bin")
+        .help("path to development FX data output file")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.pbin = v; });
+    args.add_argument("-d", "--data")
+        .help("path to FX data output file")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.pdata = v; });
+    args.add_argument("-s", "--save")
+        .help("path to FX save output file (if there are no saved variables, no file is written)")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.psave = v; });
+    args.add_argument("-u", "--universal")
+        .help("universal .arduboy file (include binaries for Arduboy Mini and homemade variants)")
+        .flag();
+    args.add_argument("-a", "--arduboy")
+        .help("path to .arduboy output file")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.parduboy = v; });
+    args.add_argument("-S", "--asm")
+        .help("path to .asm output file")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.pasm = v; });
+    args.add_argument("-c", "--cache")
+        .help("path to incremental compilation cache directory (reuses unchanged work between runs)")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.pcache = v; });
+    args.add_argument("-w", "--watch")
+        .help("keep running and rebuild whenever a source or asset file changes")
+        .flag();
+    args.add_argument("--socket")
+        .help("with --watch: path of a local socket on which to accept build and diagnostics requests")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.psocket = v; });
+    args.add_argument("-O", "--optimize")
+        .help("what the optimizer minimizes: speed (default) or size")
+        .metavar("GOAL")
+        .action([&](std::string const& v) {
+            if(v == "speed") o.opt_goal = abc::OPT_GOAL_SPEED;
+            else if(v == "size") o.opt_goal = abc::OPT_GOAL_SIZE;
+            else throw std::runtime_error("Unknown optimization goal: " + v);
+        });
+    args.add_argument("--cost-model")
+        .help("VM whose instruction costs guide the optimizer: arduboy (default) or generic")
+        .metavar("VM")
+        .action([&](std::string const& v) {
+            if(v == "arduboy") o.cost_vm = abc::COST_VM_ARDUBOY;
+            else if(v == "generic") o.cost_vm = abc::COST_VM_GENERIC;
+            else throw std::runtime_error("Unknown cost model: " + v);
+        });
+    args.add_argument("--profile-use")
+        .help("path to a PC-hit profile (\"<hex pc> <count>\" per line) that guides hot/cold optimization")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.pprofile = v; });
+    args.add_argument("--profile-bin")
+        .help("with --profile-use: path to the development FX data file the profile was recorded with (default: the --bin file)")
+        .metavar("PATH")
+        .action([&](std::string const& v) { o.pprofile_bin = v; });
+    args.add_argument("--opt-stats")
+        .help("print iterations and time of each optimizer pass")
+        .flag();
+    args.add_argument("--time-report")
+        .help("print time, peak allocation and instruction counts of each compiler phase")
+        .flag();
+
+    try {
+        args.parse_args(argc, argv);
+    }
+    catch(const std::exception& err) {
+        std::cerr << err.what() << std::endl;
+        std::cerr << args;
+#ifdef NDEBUG
+        std::exit(1);
+#endif
+    }
+
+    if(!o.psrc.empty() &&
+        o.pbin.empty() &&
+        o.pdata.empty() &&
+        o.psave.empty() &&
+        o.parduboy.empty() &&
+        o.pasm.empty() &&
+        o.pinterp.empty())
+        o.parduboy = o.psrc.parent_path() / "game.arduboy";
+
+#ifndef NDEBUG
+    o.show_asm = true;
+#endif
+
+#ifndef NDEBUG
+    //o.psrc = "C:/Users/Brown/Documents/GitHub/summer_camp/src/main.abc";
+    //o.psrc = "C:/Users/Brown/Documents/GitHub/abc/examples/test/main.abc";
+    //o.psrc = "C:/Users/Brown/Documents/GitHub/abc/examples/platformer/main.abc";
+    //o.psrc = "C:/Users/Brown/Documents/GitHub/abc/benchmarks/fibonacci/fibonacci.abc";
+    o.psrc = "C:/Users/Brown/Documents/GitHub/abc/tests/tests/func_ref.abc";
+    //o.pbin = "C:/Users/Brown/Documents/GitHub/abc/examples/test/blah.bin";
+    //o.parduboy = "C:/Users/Brown/Documents/GitHub/abc/examples/test/test.arduboy";
+#endif
+
+    if(o.psrc.empty())
     {
-        export_arduboy(
-            parduboy.generic_string(),
-            a.data(), a.has_save(), args["--universal"] == true, a.num_shades(),
-            c.arduboy_directives());
+        usage(argv[0]);
+        return 1;
     }
+    if(o.pbin.empty() && o.parduboy.empty())
+        o.show_asm = true;
+
+    o.psrc = std::filesystem::current_path() / o.psrc;
+
+    o.universal = args["--universal"] == true;
+    o.opt_stats = args["--opt-stats"] == true;
+    o.time_report = args["--time-report"] == true;
+
+    if(args["--watch"] == true)
+        return watch(o);
+
+    abc::compiler_t c;
+    abc::assembler_t a;
+
+    if(!o.pcache.empty())
+        c.set_cache_dir(o.pcache.generic_string(), ABC_VERSION);
+    if(!load_profile(c, o))
+        return 1;
 
-    return 0;
+    return build(c, a, o, std::cerr) ? 0 : 1;
 }
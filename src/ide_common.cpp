@@ -271,6 +271,7 @@ void imgui_content()
         dock_next_window_to_welcome();
         if(Begin("Disassembly", &show_asm))
         {
+            update_asm_view();
             asm_editor.Render("###asm");
         }
         End();
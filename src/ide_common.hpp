@@ -10,6 +10,7 @@
 #include <absim.hpp>
 #include <TextEditor.h>
 #include <abc_error.hpp>
+#include <abc_time_report.hpp>
 
 constexpr float DEFAULT_FONT_SIZE = 16.f;
 
@@ -69,6 +70,7 @@ struct project_t
     size_t globals_size;
     size_t save_size;
     int shades;
+    abc::time_report_t time_report;
     bool has_save() const { return save_size != 0; };
 
     void update_cached_files();
@@ -114,6 +116,7 @@ void dock_next_window_to_welcome();
 
 // ide_compile.cpp
 bool compile_all();
+void update_asm_view();
 
 // ide_export.cpp
 extern const unsigned char INTERP_BUILDS_ZIP[];
@@ -29,12 +29,34 @@ static std::filesystem::path find_main(std::filesystem::path const& dir)
     return {};
 }
 
+// compiler of the last build: the disassembly view is written from it
+// only when that view is shown
+static std::unique_ptr<abc::compiler_t> asm_compiler;
+static bool asm_stale;
+
+void update_asm_view()
+{
+    if(!asm_stale || !asm_compiler)
+        return;
+    std::ostringstream ss;
+    asm_compiler->write(ss);
+    asm_editor.SetText(ss.str());
+    asm_stale = false;
+}
+
 bool compile_all()
 {
-    abc::compiler_t c{};
+    auto cp = std::make_unique<abc::compiler_t>();
+    auto& c = *cp;
     abc::assembler_t a{};
 
-    std::vector<std::string> asms;
+    // reuse unchanged work from previous compiles in this and earlier sessions
+    {
+        std::error_code ec;
+        auto tmp = std::filesystem::temp_directory_path(ec);
+        if(!ec)
+            c.set_cache_dir((tmp / "abc-cache").generic_string(), abc_version);
+    }
 
     project.errors.clear();
 
@@ -50,11 +72,9 @@ bool compile_all()
             project.errors["<Project>"].push_back({ "No main.abc found" });
             break;
         };
-        std::stringstream sout;
-        c.compile(fpath.parent_path().generic_string(), "main", sout);
-        std::string t = sout.str();
-        asm_editor.SetText(t);
-        asms.push_back(t);
+        c.compile(fpath.parent_path().generic_string(), "main");
+        asm_compiler = std::move(cp);
+        asm_stale = true;
         std::string ef;
         if(!c.errors().empty())
         {
@@ -68,10 +88,8 @@ bool compile_all()
     if(!project.errors.empty())
         return false;
 
-    for(auto const& s : asms)
     {
-        std::stringstream ss(s);
-        auto e = a.assemble(ss);
+        auto e = a.assemble(c);
         if(!e.msg.empty())
         {
             project.errors["<Assembler>"].push_back(e);
@@ -97,6 +115,10 @@ bool compile_all()
     project.save_size = a.save_size();
     project.shades = a.num_shades();
 
+    project.time_report = c.time_report();
+    for(auto const& p : a.time_report().phases)
+        project.time_report.phases.push_back(p);
+
     project.arduboy_directives = c.arduboy_directives();
     return true;
 }
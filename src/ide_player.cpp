@@ -89,6 +89,47 @@ void player_run()
         toggle_gif();
 }
 
+static void time_report_table(abc::time_report_t const& r)
+{
+    using namespace ImGui;
+    constexpr auto flags =
+        ImGuiTableFlags_SizingFixedFit |
+        ImGuiTableFlags_BordersInner |
+        0;
+    if(!BeginTable("##timereport", 6, flags))
+        return;
+    TableSetupColumn("Phase");
+    TableSetupColumn("Runs");
+    TableSetupColumn("Time (ms)");
+    TableSetupColumn("Peak (KB)");
+    TableSetupColumn("Instrs in");
+    TableSetupColumn("Instrs out");
+    TableHeadersRow();
+    for(auto const& p : r.phases)
+    {
+        TableNextRow();
+        TableSetColumnIndex(0);
+        Indent(p.depth * GetFontSize());
+        TextUnformatted(p.name.c_str());
+        Unindent(p.depth * GetFontSize());
+        TableSetColumnIndex(1);
+        Text("%d", (int)p.runs);
+        TableSetColumnIndex(2);
+        Text("%.2f", p.seconds * 1000);
+        TableSetColumnIndex(3);
+        if(abc::alloc_tracking_enabled && p.has_peak)
+            Text("%.1f", (double)p.peak_bytes / 1024);
+        if(p.has_instrs)
+        {
+            TableSetColumnIndex(4);
+            Text("%d", (int)p.instrs_before);
+            TableSetColumnIndex(5);
+            Text("%d", (int)p.instrs_after);
+        }
+    }
+    EndTable();
+}
+
 void player_window_contents(uint64_t dt)
 {
     using namespace ImGui;
@@ -301,6 +342,8 @@ void player_window_contents(uint64_t dt)
         Text("Globals: %7d bytes", (int)project.globals_size);
         Text("Save:    %7d bytes", (int)project.save_size);
         TextUnformatted("======================");
+        if(CollapsingHeader("Time Report"))
+            time_report_table(project.time_report);
     }
 
     if(!project.errors.empty())
@@ -0,0 +1,745 @@
+#include <abc_assembler.hpp>
+#include <abc_compiler.hpp>
+
+#include <abc_display_pipe.h>
+#include <abc_game_loader.h>
+#include <abc_input_log.h>
+#include <abc_interp.h>
+#include <abc_pool.h>
+#include <abc_prog_cache.h>
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+// simulated slow byte source: counts every access
+struct slow_source_t
+{
+    std::vector<uint8_t> const* binary;
+    uint64_t reads;
+};
+
+static uint8_t slow_source_prog(void* user, uint32_t addr)
+{
+    auto& s = *(slow_source_t*)user;
+    ++s.reads;
+    if(addr < s.binary->size())
+        return (*s.binary)[addr];
+    return 0;
+}
+
+static void slow_source_fill_line(void* user, uint32_t addr, uint8_t* dst, uint32_t n)
+{
+    for(uint32_t i = 0; i < n; ++i)
+        dst[i] = slow_source_prog(user, addr + i);
+}
+
+static bool compile_test(std::string const& name, std::vector<uint8_t>& binary)
+{
+    abc::compiler_t c{};
+    c.suppress_githash();
+    c.compile(TESTS_DIR, name);
+    if(!c.errors().empty())
+        return false;
+    abc::assembler_t a{};
+    auto e = a.assemble(c);
+    if(!e.msg.empty())
+        return false;
+    e = a.link();
+    if(!e.msg.empty())
+        return false;
+    binary = a.data();
+    return true;
+}
+
+// run until the second debug break (end of test) or an error
+static bool run_test(abc_interp_t& interp, abc_host_t const& host)
+{
+    memset(&interp, 0, sizeof(interp));
+    int breaks = 0;
+    for(;;)
+    {
+        auto r = abc_run(&interp, &host);
+        if(r == ABC_RESULT_BREAK && ++breaks >= 2)
+            return true;
+        if(r == ABC_RESULT_ERROR)
+            return false;
+    }
+}
+
+static bool test_prog_cache(std::string const& name, bool use_fill_line)
+{
+    std::vector<uint8_t> binary;
+    if(!compile_test(name, binary))
+        return false;
+
+    auto ref = std::make_unique<abc_interp_t>();
+    auto cached = std::make_unique<abc_interp_t>();
+
+    slow_source_t direct_source{ &binary, 0 };
+    {
+        abc_host_t host{};
+        host.prog = slow_source_prog;
+        host.user = &direct_source;
+        if(!run_test(*ref, host))
+            return false;
+    }
+
+    slow_source_t cached_source{ &binary, 0 };
+    abc_prog_cache_line_t lines[16];
+    abc_prog_cache_t cache{};
+    if(use_fill_line)
+        cache.fill_line = slow_source_fill_line;
+    else
+        cache.source = slow_source_prog;
+    cache.user = &cached_source;
+    abc_prog_cache_init(&cache, lines, 16);
+    {
+        abc_host_t host{};
+        host.prog = abc_prog_cache_prog;
+        host.user = &cache;
+        if(!run_test(*cached, host))
+            return false;
+    }
+
+    // cached execution must be indistinguishable from direct execution
+    if(ref->pc != cached->pc || ref->sp != cached->sp)
+        return false;
+    if(memcmp(ref->globals, cached->globals, sizeof(ref->globals)) != 0)
+        return false;
+    if(memcmp(ref->stack, cached->stack, sizeof(ref->stack)) != 0)
+        return false;
+    if(memcmp(ref->display, cached->display, sizeof(ref->display)) != 0)
+        return false;
+
+    // every access goes through the cache, misses fetch a full line
+    if(uint64_t(cache.hits) + cache.misses != direct_source.reads)
+        return false;
+    if(cached_source.reads != uint64_t(cache.misses) * ABC_PROG_CACHE_LINE_SIZE)
+        return false;
+    if(cache.hits <= cache.misses)
+        return false;
+
+    if(use_fill_line)
+        printf("%-23s %10llu reads %8u hits %6u misses\n",
+            name.c_str(),
+            (unsigned long long)direct_source.reads,
+            (unsigned)cache.hits, (unsigned)cache.misses);
+    return true;
+}
+
+static bool test_prog_cache_lines()
+{
+    std::vector<uint8_t> binary(4096);
+    for(size_t i = 0; i < binary.size(); ++i)
+        binary[i] = uint8_t(i * 7 + (i >> 8));
+    slow_source_t s{ &binary, 0 };
+    abc_prog_cache_line_t lines[4];
+    abc_prog_cache_t cache{};
+    cache.source = slow_source_prog;
+    cache.user = &s;
+    abc_prog_cache_init(&cache, lines, 4);
+
+    // sequential reads miss once per line
+    for(uint32_t i = 0; i < 256; ++i)
+        if(abc_prog_cache_read(&cache, i) != binary[i])
+            return false;
+    if(cache.misses != 256 / ABC_PROG_CACHE_LINE_SIZE)
+        return false;
+
+    // two addresses mapping to the same line evict each other
+    abc_prog_cache_reset_stats(&cache);
+    uint32_t stride = 4 * ABC_PROG_CACHE_LINE_SIZE;
+    for(int i = 0; i < 4; ++i)
+    {
+        if(abc_prog_cache_read(&cache, 1000) != binary[1000])
+            return false;
+        if(abc_prog_cache_read(&cache, 1000 + stride) != binary[1000 + stride])
+            return false;
+    }
+    if(cache.hits != 0 || cache.misses != 8)
+        return false;
+
+    // invalidation forces a refetch
+    abc_prog_cache_reset_stats(&cache);
+    (void)abc_prog_cache_read(&cache, 1000 + stride);
+    abc_prog_cache_invalidate(&cache);
+    (void)abc_prog_cache_read(&cache, 1000 + stride);
+    return cache.hits == 1 && cache.misses == 1;
+}
+
+// mock non-blocking SPI: stays busy for a number of polls after each write
+// and streams into a 128x128 panel that wraps around like the TFT window
+struct mock_spi_t
+{
+    std::vector<uint16_t> panel;
+    size_t panel_pos;
+    uint32_t transfer_polls;
+    uint32_t busy_polls;
+    uint32_t writes;
+};
+
+static uint8_t mock_spi_busy(void* user)
+{
+    auto& spi = *(mock_spi_t*)user;
+    if(spi.busy_polls == 0)
+        return 0;
+    --spi.busy_polls;
+    return 1;
+}
+
+static void mock_spi_write(void* user, uint8_t const* data, uint32_t size)
+{
+    auto& spi = *(mock_spi_t*)user;
+    assert(spi.busy_polls == 0);
+    uint16_t const* p = (uint16_t const*)data;
+    for(uint32_t i = 0; i < size / 2; ++i)
+    {
+        spi.panel[spi.panel_pos] = p[i];
+        spi.panel_pos = (spi.panel_pos + 1) % spi.panel.size();
+    }
+    spi.busy_polls = spi.transfer_polls;
+    ++spi.writes;
+}
+
+static bool test_display_pipe(uint32_t transfer_polls, uint32_t vm_polls, bool expect_waits)
+{
+    constexpr int W = ABC_DISPLAY_PIPE_WIDTH;
+    constexpr int H = ABC_DISPLAY_PIPE_HEIGHT;
+    mock_spi_t spi{};
+    spi.panel.resize(W * H * 2);
+    spi.transfer_polls = transfer_polls;
+
+    std::vector<uint16_t> buffer0(ABC_DISPLAY_PIPE_HALF_PIXELS);
+    std::vector<uint16_t> buffer1(ABC_DISPLAY_PIPE_HALF_PIXELS);
+    uint16_t palette[256];
+    for(int i = 0; i < 256; ++i)
+        palette[i] = uint16_t(i * 0x0101 ^ 0x5a00);
+
+    abc_display_pipe_t pipe{};
+    pipe.busy = mock_spi_busy;
+    pipe.write = mock_spi_write;
+    pipe.palette = palette;
+    pipe.user = &spi;
+    abc_display_pipe_init(&pipe, buffer0.data(), buffer1.data());
+
+    std::vector<uint8_t> display(W * H);
+    int const num_frames = 10;
+    for(int f = 0; f < num_frames; ++f)
+    {
+        for(int i = 0; i < W * H; ++i)
+            display[i] = uint8_t(i * 3 + f * 17);
+        abc_display_pipe_frame(&pipe, display.data());
+        // the VM overwrites the display right away
+        std::fill(display.begin(), display.end(), uint8_t(0xee));
+        // the VM keeps running while the transfer is in progress
+        for(uint32_t i = 0; i < vm_polls; ++i)
+            abc_display_pipe_poll(&pipe);
+    }
+    while(!abc_display_pipe_idle(&pipe))
+        ;
+
+    if(spi.writes != num_frames * 2 || pipe.frames != num_frames)
+        return false;
+    if((pipe.waits != 0) != expect_waits)
+        return false;
+    for(int y = 0; y < H * 2; ++y)
+    {
+        for(int x = 0; x < W; ++x)
+        {
+            uint8_t p = uint8_t((y / 2 * W + x) * 3 + (num_frames - 1) * 17);
+            if(spi.panel[y * W + x] != palette[p])
+                return false;
+        }
+    }
+    return true;
+}
+
+// directory-backed filesystem for the game loader
+struct dir_fs_t
+{
+    std::string dir;
+    std::vector<std::filesystem::path> entries;
+};
+
+static uint8_t dir_fs_entry(
+    void* user, uint32_t index, char* name, uint32_t name_size, uint32_t* size)
+{
+    auto& fs = *(dir_fs_t*)user;
+    if(index >= fs.entries.size())
+        return 0;
+    auto const& p = fs.entries[index];
+    snprintf(name, name_size, "%s", p.filename().generic_string().c_str());
+    *size = (uint32_t)std::filesystem::file_size(p);
+    return 1;
+}
+
+static void* dir_fs_open(void* user, char const* name, uint32_t* size)
+{
+    auto& fs = *(dir_fs_t*)user;
+    std::string path = fs.dir + "/" + name;
+    FILE* f = fopen(path.c_str(), "rb");
+    if(!f)
+        return nullptr;
+    fseek(f, 0, SEEK_END);
+    *size = (uint32_t)ftell(f);
+    return f;
+}
+
+static uint32_t dir_fs_read(
+    void* user, void* file, uint32_t offset, uint8_t* dst, uint32_t n)
+{
+    (void)user;
+    FILE* f = (FILE*)file;
+    if(0 != fseek(f, (long)offset, SEEK_SET))
+        return 0;
+    return (uint32_t)fread(dst, 1, n, f);
+}
+
+static void dir_fs_close(void* user, void* file)
+{
+    (void)user;
+    fclose((FILE*)file);
+}
+
+static abc_game_fs_t make_dir_fs(dir_fs_t& d, std::string const& dir)
+{
+    d.dir = dir;
+    d.entries.clear();
+    for(auto const& entry : std::filesystem::directory_iterator(dir))
+        if(entry.is_regular_file())
+            d.entries.push_back(entry.path());
+    abc_game_fs_t fs{};
+    fs.entry = dir_fs_entry;
+    fs.open = dir_fs_open;
+    fs.read = dir_fs_read;
+    fs.close = dir_fs_close;
+    fs.user = &d;
+    return fs;
+}
+
+static uint32_t fixed_millis(void* user)
+{
+    (void)user;
+    return 0;
+}
+
+// run a game for a fixed number of instructions
+static bool run_steps(abc_interp_t& interp, abc_host_t const& host, int steps)
+{
+    memset(&interp, 0, sizeof(interp));
+    for(int i = 0; i < steps; ++i)
+        if(abc_run(&interp, &host) == ABC_RESULT_ERROR)
+            return false;
+    return true;
+}
+
+static bool test_game_loader()
+{
+
+    // build a game directory from the examples
+    std::string dir = (std::filesystem::temp_directory_path() / "abc_host_tests_games").generic_string();
+    std::filesystem::remove_all(dir);
+    std::filesystem::create_directories(dir);
+    for(auto name : { "basic", "pong", "snake", "platformer" })
+    {
+        abc::compiler_t c{};
+        c.suppress_githash();
+        c.compile(std::string(EXAMPLES_DIR) + "/" + name, "main");
+        if(!c.errors().empty())
+            return false;
+        abc::assembler_t a{};
+        if(!a.assemble(c).msg.empty() || !a.link().msg.empty())
+            return false;
+        std::ofstream f(dir + "/" + name + ".bin", std::ios::binary);
+        f.write((char const*)a.data().data(), a.data().size());
+    }
+    {
+        std::ofstream f(dir + "/readme.txt");
+        f << "not a game\n";
+        std::ofstream g(dir + "/invalid.bin", std::ios::binary);
+        g << std::string(ABC_GAME_HEADER_SIZE, 'x');
+    }
+
+    dir_fs_t d;
+    abc_game_fs_t fs = make_dir_fs(d, dir);
+
+    auto list = std::make_unique<abc_game_list_t>();
+    abc_game_list_scan(list.get(), &fs);
+    if(list->count != 5)
+        return false;
+    for(uint8_t i = 1; i < list->count; ++i)
+        if(strcmp(list->names[i - 1], list->names[i]) >= 0)
+            return false;
+
+    // menu navigation: edge-triggered, wraps around, scrolls
+    if(abc_game_list_update(list.get(), ABC_BUTTON_U, 4) != 0)
+        return false;
+    if(list->selected != list->count - 1)
+        return false;
+    if(list->scroll + 4 != list->count)
+        return false;
+    (void)abc_game_list_update(list.get(), ABC_BUTTON_U, 4);
+    if(list->selected != list->count - 1)
+        return false;
+    (void)abc_game_list_update(list.get(), 0, 4);
+    (void)abc_game_list_update(list.get(), ABC_BUTTON_D, 4);
+    if(list->selected != 0 || list->scroll != 0)
+        return false;
+    if(abc_game_list_update(list.get(), ABC_BUTTON_A, 4) != 1)
+        return false;
+
+    auto ref = std::make_unique<abc_interp_t>();
+    auto streamed = std::make_unique<abc_interp_t>();
+
+    for(uint8_t i = 0; i < list->count; ++i)
+    {
+        char const* name = list->names[i];
+        if(!strcmp(name, "invalid.bin"))
+            continue;
+
+        std::vector<uint8_t> binary;
+        {
+            std::ifstream f(dir + "/" + name, std::ios::binary);
+            binary.assign(std::istreambuf_iterator<char>(f), {});
+        }
+        slow_source_t direct_source{ &binary, 0 };
+        abc_host_t host{};
+        host.prog = slow_source_prog;
+        host.millis = fixed_millis;
+        host.user = &direct_source;
+        if(!run_steps(*ref, host, 200000))
+            return false;
+
+        abc_game_t game;
+        if(abc_game_open(&game, &fs, name) != ABC_GAME_OK)
+            return false;
+        if(game.size != binary.size() || game.shades != binary[0x13])
+            return false;
+        abc_prog_cache_line_t lines[64];
+        abc_prog_cache_t cache{};
+        cache.fill_line = abc_game_fill_line;
+        cache.user = &game;
+        abc_prog_cache_init(&cache, lines, 64);
+        host.prog = abc_prog_cache_prog;
+        host.user = &cache;
+        bool ok = run_steps(*streamed, host, 200000);
+        abc_game_close(&game);
+        if(!ok)
+            return false;
+
+        if(ref->pc != streamed->pc)
+            return false;
+        if(memcmp(ref->globals, streamed->globals, sizeof(ref->globals)) != 0)
+            return false;
+        if(memcmp(ref->display, streamed->display, sizeof(ref->display)) != 0)
+            return false;
+    }
+
+    // files without a valid header are rejected
+    {
+        abc_game_t game;
+        if(abc_game_open(&game, &fs, "invalid.bin") != ABC_GAME_ERROR_FORMAT)
+            return false;
+        if(abc_game_open(&game, &fs, "missing.bin") != ABC_GAME_ERROR_OPEN)
+            return false;
+    }
+
+    std::filesystem::remove_all(dir);
+    return true;
+}
+
+struct pool_record_t
+{
+    uint32_t frames;
+    std::vector<uint32_t> hashes; // [instance * frames + frame]
+    std::vector<uint32_t> counts; // frames completed per instance
+};
+
+static uint8_t pool_buttons(void* user, uint32_t instance, uint32_t frame)
+{
+    (void)user;
+    uint32_t h = (instance + 1) * 0x9e3779b9u ^ (frame / 4) * 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    return uint8_t(h >> 24);
+}
+
+static uint32_t hash_display(abc_interp_t const* interp)
+{
+    uint32_t h = 2166136261u;
+    for(uint8_t b : interp->display)
+        h = (h ^ b) * 16777619u;
+    return h;
+}
+
+static void pool_frame_done(void* user, uint32_t instance, abc_interp_t const* interp)
+{
+    auto& rec = *(pool_record_t*)user;
+    uint32_t frame = rec.counts[instance]++;
+    if(frame < rec.frames)
+        rec.hashes[instance * rec.frames + frame] = hash_display(interp);
+}
+
+static bool run_pool(
+    std::vector<uint8_t> const& binary,
+    uint32_t num_instances, uint32_t num_threads, uint32_t frames,
+    pool_record_t& rec)
+{
+    rec.frames = frames;
+    rec.hashes.assign(num_instances * frames, 0);
+    rec.counts.assign(num_instances, 0);
+
+    abc_pool_config_t config{};
+    config.prog = binary.data();
+    config.prog_size = (uint32_t)binary.size();
+    config.num_instances = num_instances;
+    config.num_threads = num_threads;
+    config.buttons = pool_buttons;
+    config.frame_done = pool_frame_done;
+    config.user = &rec;
+    abc_pool_t* pool = abc_pool_create(&config);
+    if(!pool)
+        return false;
+    bool ok = abc_pool_num_threads(pool) == num_threads;
+    ok = ok && abc_pool_step(pool, frames) == num_instances;
+
+    // a reset instance replays the same frames
+    if(ok)
+    {
+        std::vector<uint32_t> first(rec.hashes.begin(), rec.hashes.begin() + frames);
+        abc_pool_reset(pool, 0);
+        rec.counts[0] = 0;
+        ok = abc_pool_step(pool, 1) == num_instances;
+        ok = ok && abc_pool_frames(pool, 0) == 1 && rec.hashes[0] == first[0];
+        ok = ok && abc_pool_frames(pool, 1) == frames + 1;
+    }
+    abc_pool_destroy(pool);
+    return ok;
+}
+
+static bool test_pool()
+{
+    std::vector<uint8_t> binary;
+    {
+        abc::compiler_t c{};
+        c.suppress_githash();
+        c.compile(std::string(EXAMPLES_DIR) + "/platformer", "main");
+        if(!c.errors().empty())
+            return false;
+        abc::assembler_t a{};
+        if(!a.assemble(c).msg.empty() || !a.link().msg.empty())
+            return false;
+        binary = a.data();
+    }
+
+    uint32_t const N = 16;
+    uint32_t const F = 60;
+    pool_record_t single, multi;
+    if(!run_pool(binary, N, 1, F, single) || !run_pool(binary, N, 4, F, multi))
+        return false;
+    if(single.hashes != multi.hashes)
+        return false;
+
+    // different inputs and seeds should lead to different games
+    bool differ = false;
+    for(uint32_t f = 0; f < F; ++f)
+        differ = differ || single.hashes[f] != single.hashes[F + f];
+    if(!differ)
+        return false;
+
+    // instance 0 matches a plain interpreter driven by a virtual clock
+    struct ref_host_t { uint32_t millis, frame; std::vector<uint8_t> const* binary; };
+    ref_host_t rh{ 0, 0, &binary };
+    abc_host_t host{};
+    host.prog = [](void* user, uint32_t addr) -> uint8_t {
+        auto const& b = *((ref_host_t*)user)->binary;
+        return addr < b.size() ? b[addr] : 0; };
+    host.millis = [](void* user) { return ((ref_host_t*)user)->millis; };
+    host.buttons = [](void* user) { return pool_buttons(nullptr, 0, ((ref_host_t*)user)->frame); };
+    host.rand_seed = [](void* user) { (void)user; return uint32_t(1); };
+    host.user = &rh;
+    auto interp = std::make_unique<abc_interp_t>();
+    while(rh.frame < F)
+    {
+        abc_result_t r = abc_run(interp.get(), &host);
+        if(r == ABC_RESULT_ERROR)
+            return false;
+        if(r == ABC_RESULT_IDLE && interp->waiting_for_frame)
+        {
+            rh.millis = interp->frame_start + interp->frame_dur;
+            if(hash_display(interp.get()) != single.hashes[rh.frame++])
+                return false;
+        }
+    }
+
+    return true;
+}
+
+struct live_host_t
+{
+    std::vector<uint8_t> const* binary;
+    uint32_t clock;
+    uint32_t calls;
+    uint8_t buttons;
+};
+
+static bool test_input_log(std::string const& example)
+{
+    std::vector<uint8_t> binary;
+    {
+        abc::compiler_t c{};
+        c.suppress_githash();
+        c.compile(std::string(EXAMPLES_DIR) + "/" + example, "main");
+        if(!c.errors().empty())
+            return false;
+        abc::assembler_t a{};
+        if(!a.assemble(c).msg.empty() || !a.link().msg.empty())
+            return false;
+        binary = a.data();
+    }
+    uint32_t prog_hash = abc_input_prog_hash(binary.data(), (uint32_t)binary.size());
+
+    // a "live" host with an irregular clock, changing input and entropy
+    live_host_t live{ &binary, 12345, 0, 0 };
+    abc_host_t host{};
+    host.prog = [](void* user, uint32_t addr) -> uint8_t {
+        auto const& b = *((live_host_t*)user)->binary;
+        return addr < b.size() ? b[addr] : 0; };
+    host.millis = [](void* user) {
+        auto& h = *(live_host_t*)user;
+        h.clock += 1 + (++h.calls * 7919) % 13;
+        return h.clock; };
+    host.buttons = [](void* user) {
+        auto& h = *(live_host_t*)user;
+        if(++h.calls % 37 == 0)
+            h.buttons = uint8_t(h.calls * 0x9e3779b9u >> 24);
+        return h.buttons; };
+    host.rand_seed = [](void* user) {
+        return ((live_host_t*)user)->calls * 2654435761u; };
+    host.user = &live;
+
+    std::vector<uint8_t> log;
+    abc_input_recorder_t rec{};
+    rec.host = &host;
+    rec.write = [](void* user, uint8_t const* data, uint32_t n) {
+        auto& v = *(std::vector<uint8_t>*)user;
+        v.insert(v.end(), data, data + n); };
+    rec.user = &log;
+
+    uint32_t const FRAMES = 300;
+    auto interp = std::make_unique<abc_interp_t>();
+    interp->has_save = 1;
+    interp->saved[0] = 42;
+    abc_input_record_begin(&rec, interp.get(), prog_hash);
+    std::vector<uint32_t> hashes;
+    while(hashes.size() < FRAMES)
+    {
+        bool was_waiting = interp->waiting_for_frame != 0;
+        abc_result_t r = abc_input_record_run(&rec, interp.get());
+        if(r == ABC_RESULT_ERROR)
+            return false;
+        if(!was_waiting && interp->waiting_for_frame)
+            hashes.push_back(hash_display(interp.get()));
+    }
+    abc_input_record_end(&rec);
+    std::vector<uint8_t> globals(interp->globals, interp->globals + sizeof(interp->globals));
+
+    // replay without a clock: frames run back to back
+    abc_host_t replay_host{};
+    replay_host.prog = host.prog;
+    replay_host.user = &live;
+    abc_input_player_t player{};
+    player.host = &replay_host;
+    player.data = log.data();
+    player.size = (uint32_t)log.size();
+    interp = std::make_unique<abc_interp_t>();
+    if(abc_input_replay_begin(&player, interp.get(), prog_hash) != ABC_INPUT_OK)
+        return false;
+    if(!interp->has_save || interp->saved[0] != 42)
+        return false;
+    size_t frame = 0;
+    while(player.state == ABC_INPUT_PLAYING)
+    {
+        bool was_waiting = interp->waiting_for_frame != 0;
+        abc_result_t r = abc_input_replay_run(&player, interp.get());
+        if(r == ABC_RESULT_ERROR)
+            return false;
+        if(!was_waiting && interp->waiting_for_frame)
+        {
+            if(frame >= hashes.size() || hash_display(interp.get()) != hashes[frame])
+                return false;
+            ++frame;
+        }
+    }
+    if(player.state != ABC_INPUT_DONE || frame != FRAMES)
+        return false;
+    if(memcmp(globals.data(), interp->globals, globals.size()) != 0)
+        return false;
+
+    // logs are rejected for other programs or when malformed
+    interp = std::make_unique<abc_interp_t>();
+    if(abc_input_replay_begin(&player, interp.get(), prog_hash + 1) != ABC_INPUT_ERROR_PROGRAM)
+        return false;
+    log[0] = 'X';
+    if(abc_input_replay_begin(&player, interp.get(), prog_hash) != ABC_INPUT_ERROR_FORMAT)
+        return false;
+
+    return true;
+}
+
+int abc_host_tests()
+{
+    int r = 0;
+    namespace fs = std::filesystem;
+
+    printf("\nRunning host tests...\n\n");
+
+    if(!test_prog_cache_lines())
+    {
+        printf("prog cache lines        fail !!!\n");
+        r = 1;
+    }
+
+    if(!test_display_pipe(4, 16, false) || !test_display_pipe(64, 4, true))
+    {
+        printf("display pipe            fail !!!\n");
+        r = 1;
+    }
+
+    if(!test_game_loader())
+    {
+        printf("game loader             fail !!!\n");
+        r = 1;
+    }
+
+    if(!test_pool())
+    {
+        printf("pool                    fail !!!\n");
+        r = 1;
+    }
+
+    if(!test_input_log("snake") || !test_input_log("platformer"))
+    {
+        printf("input log               fail !!!\n");
+        r = 1;
+    }
+
+    for(auto const& entry : fs::directory_iterator(TESTS_DIR))
+    {
+        if(entry.path().extension() != ".abc") continue;
+        std::string name = entry.path().stem().generic_string();
+        if(!test_prog_cache(name, false) || !test_prog_cache(name, true))
+        {
+            printf("%-23s fail !!!\n", name.c_str());
+            r = 1;
+        }
+    }
+
+    return r;
+}
@@ -7,13 +7,17 @@
 
 #include <abc_interp.h>
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <strstream>
+#include <thread>
 
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 
 static std::unique_ptr<absim::arduboy_t> arduboy;
 
@@ -118,6 +122,407 @@ static bool test(std::string const& fpath, std::string const& fname)
     return true;
 }
 
+using test_files_t = std::map<std::string, std::string>;
+
+static std::string compile_cached(
+    test_files_t const& files, std::string const& cache_dir,
+    abc::compiler_t::cache_stats_t& stats)
+{
+    abc::compiler_t c{};
+    c.suppress_githash();
+    if(!cache_dir.empty())
+        c.set_cache_dir(cache_dir, "test");
+    std::ostringstream fo;
+    c.compile("proj", "main", [&](std::string const& fname, std::vector<char>& t) {
+        auto it = files.find(fname);
+        if(it == files.end())
+            return false;
+        t.assign(it->second.begin(), it->second.end());
+        return true;
+    }, fo);
+    if(!c.errors().empty())
+        return {};
+    stats = c.cache_stats();
+    return fo.str();
+}
+
+static test_files_t cache_test_files()
+{
+    test_files_t files;
+    files["proj/main.abc"] = R"(
+#title "Cache Test"
+import util;
+saved u16 best;
+u8[4] prog TABLE = { 1, 2, 3, 4 };
+void main()
+{
+    $debug_break();
+    pos p = { 3, -4 };
+    best = dist(p) + TABLE[2];
+    $assert(best == 10);
+    $assert(len(GREETING) == 5);
+    $debug_break();
+}
+)";
+    files["proj/util.abc"] = R"(
+struct pos { i8 x, y; };
+enum { SCALE = 1 };
+char[6] GREETING = "hello";
+float f = 1.5;
+u16 dist(pos p)
+{
+    i8 x = p.x < 0 ? -p.x : p.x;
+    i8 y = p.y < 0 ? -p.y : p.y;
+    return u16(x + y) * SCALE;
+}
+)";
+    return files;
+}
+
+static bool test_cache()
+{
+    namespace fs = std::filesystem;
+    auto dir = (fs::temp_directory_path() / "abc_tests_cache").generic_string();
+    fs::remove_all(dir);
+
+    test_files_t files = cache_test_files();
+    abc::compiler_t::cache_stats_t stats{};
+    auto ref = compile_cached(files, {}, stats);
+    if(ref.empty())
+        return false;
+
+    // cold cache: everything is compiled and stored
+    if(compile_cached(files, dir, stats) != ref)
+        return false;
+    if(stats.build_hit || stats.module_hits != 0 || stats.module_misses != 2)
+        return false;
+
+    // warm cache: the whole build is reused
+    if(compile_cached(files, dir, stats) != ref || !stats.build_hit)
+        return false;
+
+    // one module changed: only that module is parsed again
+    files["proj/util.abc"] += "u8 extra;\n";
+    auto ref2 = compile_cached(files, {}, stats);
+    if(ref2.empty() || ref2 == ref)
+        return false;
+    if(compile_cached(files, dir, stats) != ref2)
+        return false;
+    if(stats.build_hit || stats.module_hits != 1 || stats.module_misses != 1)
+        return false;
+
+    // damaged entries are ignored
+    for(auto const& entry : fs::directory_iterator(dir))
+        fs::resize_file(entry.path(), fs::file_size(entry.path()) / 2);
+    if(compile_cached(files, dir, stats) != ref2)
+        return false;
+    if(stats.build_hit || stats.module_hits != 0)
+        return false;
+
+    fs::remove_all(dir);
+    return true;
+}
+
+// a compiler kept for many compiles, as in abcc --watch, must give the
+// same output as a fresh one while reparsing only changed modules
+static bool test_memory_cache()
+{
+    test_files_t files = cache_test_files();
+    abc::compiler_t::cache_stats_t stats{};
+    auto ref = compile_cached(files, {}, stats);
+    if(ref.empty())
+        return false;
+
+    abc::compiler_t c{};
+    c.suppress_githash();
+    c.set_memory_cache(true);
+    auto compile = [&]() -> std::string {
+        std::ostringstream fo;
+        c.compile("proj", "main", [&](std::string const& fname, std::vector<char>& t) {
+            auto it = files.find(fname);
+            if(it == files.end())
+                return false;
+            t.assign(it->second.begin(), it->second.end());
+            return true;
+        }, fo);
+        stats = c.cache_stats();
+        return c.errors().empty() ? fo.str() : std::string();
+    };
+
+    if(compile() != ref || stats.module_misses != 2)
+        return false;
+    if(compile() != ref || !stats.build_hit)
+        return false;
+
+    auto util = files["proj/util.abc"];
+    files["proj/util.abc"] += "u8 extra;\n";
+    auto ref2 = compile_cached(files, {}, stats);
+    if(compile() != ref2)
+        return false;
+    if(stats.build_hit || stats.module_hits != 1 || stats.module_misses != 1)
+        return false;
+
+    files["proj/util.abc"] += "u8 broken = ;\n";
+    if(!compile().empty() || c.errors().empty())
+        return false;
+
+    files["proj/util.abc"] = util;
+    if(compile() != ref || stats.module_hits != 1)
+        return false;
+
+    return true;
+}
+
+// encoded sprites and tilemaps are reused when only the code changes,
+// including by parallel code generation
+static bool test_asset_cache()
+{
+    namespace fs = std::filesystem;
+    auto dir = (fs::temp_directory_path() / "abc_tests_asset_cache").generic_string();
+    fs::remove_all(dir);
+
+    auto path = std::string(EXAMPLES_DIR) + "/platformer";
+    auto compile = [&](std::string const& cache_dir, char const* suffix,
+        abc::compiler_t::cache_stats_t& stats) -> std::string {
+        abc::compiler_t c{};
+        c.suppress_githash();
+        if(!cache_dir.empty())
+            c.set_cache_dir(cache_dir, "test");
+        std::ostringstream fo;
+        c.compile(path, "main", [&](std::string const& fname, std::vector<char>& t) {
+            std::ifstream f(fname, std::ios::in | std::ios::binary);
+            if(f.fail()) return false;
+            t = std::vector<char>(
+                (std::istreambuf_iterator<char>(f)),
+                (std::istreambuf_iterator<char>()));
+            if(fname == path + "/main.abc")
+                t.insert(t.end(), suffix, suffix + strlen(suffix));
+            return true;
+        }, fo);
+        stats = c.cache_stats();
+        return c.errors().empty() ? fo.str() : std::string();
+    };
+
+    abc::compiler_t::cache_stats_t stats{};
+    auto ref = compile({}, "", stats);
+    if(ref.empty())
+        return false;
+
+    if(compile(dir, "", stats) != ref)
+        return false;
+    size_t assets = stats.asset_misses;
+    if(assets == 0 || stats.asset_hits != 0)
+        return false;
+
+    if(compile(dir, "\n", stats) != ref)
+        return false;
+    if(stats.build_hit || stats.asset_hits != assets || stats.asset_misses != 0)
+        return false;
+
+    fs::remove_all(dir);
+    return true;
+}
+
+static std::string compile_threads(
+    std::string const& fpath, std::string const& fname, size_t threads)
+{
+    abc::compiler_t c{};
+    c.suppress_githash();
+    c.num_threads = threads;
+    std::ostringstream fo;
+    c.compile(fpath, fname, fo);
+    if(!c.errors().empty())
+        return {};
+    return fo.str();
+}
+
+// parallel code generation must produce the same program as a serial compile
+static bool test_threads()
+{
+    namespace fs = std::filesystem;
+    std::vector<std::pair<std::string, std::string>> programs;
+    for(auto const& entry : fs::directory_iterator(TESTS_DIR))
+        if(entry.path().extension() == ".abc")
+            programs.push_back({ TESTS_DIR, entry.path().stem().generic_string() });
+    for(char const* example : { "font", "platformer", "snake", "tilemap" })
+        programs.push_back({ std::string(EXAMPLES_DIR) + "/" + example, "main" });
+
+    for(auto const& [fpath, fname] : programs)
+    {
+        auto serial = compile_threads(fpath, fname, 1);
+        if(serial.empty())
+            return false;
+        for(size_t threads : { 2, 5 })
+        {
+            if(compile_threads(fpath, fname, threads) != serial)
+            {
+                printf("%s: %d threads differ from serial\n", fname.c_str(), (int)threads);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// compilers running at the same time, each parsing its imports in
+// parallel, must produce the same programs as one compiler at a time
+static bool test_concurrent_compile()
+{
+    std::vector<std::string> examples = { "font", "lasertank", "platformer", "snake", "tilemap" };
+    std::vector<std::string> serial, concurrent(examples.size());
+    for(auto const& example : examples)
+        serial.push_back(compile_threads(std::string(EXAMPLES_DIR) + "/" + example, "main", 1));
+
+    std::vector<std::thread> pool;
+    for(size_t i = 0; i < examples.size(); ++i)
+        pool.emplace_back([&, i] {
+            concurrent[i] = compile_threads(std::string(EXAMPLES_DIR) + "/" + examples[i], "main", 0);
+        });
+    for(auto& t : pool)
+        t.join();
+
+    for(size_t i = 0; i < examples.size(); ++i)
+    {
+        if(serial[i].empty() || concurrent[i] != serial[i])
+        {
+            printf("%s: concurrent compile differs\n", examples[i].c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool assemble_text_and_direct(std::string const& fpath, std::string const& fname)
+{
+    abc::compiler_t c{};
+    c.suppress_githash();
+    c.compile(fpath, fname);
+    if(!c.errors().empty())
+        return false;
+
+    std::stringstream fasm;
+    c.write(fasm);
+    abc::assembler_t a0{};
+    if(!a0.assemble(fasm).msg.empty() || !a0.link().msg.empty())
+        return false;
+    abc::assembler_t a1{};
+    if(!a1.assemble(c).msg.empty() || !a1.link().msg.empty())
+        return false;
+
+    // ignore the build date at header offset 32
+    auto d0 = a0.data();
+    auto d1 = a1.data();
+    if(d0.size() < 48 || d1.size() < 48)
+        return false;
+    std::fill(d0.begin() + 32, d0.begin() + 48, uint8_t(0));
+    std::fill(d1.begin() + 32, d1.begin() + 48, uint8_t(0));
+    return d0 == d1;
+}
+
+// assembling the compiler output directly must match the asm text path
+static bool test_assemble_direct()
+{
+    namespace fs = std::filesystem;
+    for(auto const& entry : fs::directory_iterator(TESTS_DIR))
+    {
+        if(entry.path().extension() != ".abc") continue;
+        if(!assemble_text_and_direct(TESTS_DIR, entry.path().stem().generic_string()))
+        {
+            printf("%s: direct assembly differs\n", entry.path().filename().generic_string().c_str());
+            return false;
+        }
+    }
+    for(char const* example : { "font", "platformer", "snake", "tilemap" })
+    {
+        if(!assemble_text_and_direct(std::string(EXAMPLES_DIR) + "/" + example, "main"))
+        {
+            printf("%s: direct assembly differs\n", example);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool build_profiled(
+    std::string const& fpath, std::string const& fname,
+    std::vector<uint8_t> const* prev, std::string const& profile,
+    std::vector<uint8_t>& binary)
+{
+    abc::compiler_t c{};
+    c.suppress_githash();
+    if(prev)
+    {
+        std::istringstream ss(profile);
+        if(!c.load_profile(*prev, ss).msg.empty())
+            return false;
+    }
+    c.compile(fpath, fname);
+    if(!c.errors().empty())
+        return false;
+    abc::assembler_t a{};
+    if(!a.assemble(c).msg.empty() || !a.link().msg.empty())
+        return false;
+    binary = a.data();
+    return true;
+}
+
+// run on the general interpreter until the end of the test, counting
+// the executions of each PC when hits is given
+static bool run_profiled(std::vector<uint8_t> const& binary, std::vector<uint64_t>* hits)
+{
+    abc_host_t host{};
+    host.user = (void*)&binary;
+    host.prog = [](void* user, uint32_t addr) -> uint8_t {
+        auto const& binary = *(std::vector<uint8_t> const*)user;
+        return addr < binary.size() ? binary[addr] : 0;
+    };
+    if(hits)
+        hits->assign(binary.size(), 0);
+    interp = {};
+    int breaks = 0;
+    for(;;)
+    {
+        if(hits && interp.pc < hits->size())
+            ++(*hits)[interp.pc];
+        auto r = abc_run(&interp, &host);
+        if(r == ABC_RESULT_BREAK && ++breaks >= 2)
+            return true;
+        if(r == ABC_RESULT_ERROR)
+            return false;
+    }
+}
+
+// programs rebuilt with a profile of their own run must still pass
+static bool test_profile()
+{
+    namespace fs = std::filesystem;
+    for(auto const& entry : fs::directory_iterator(TESTS_DIR))
+    {
+        if(entry.path().extension() != ".abc") continue;
+        std::string name = entry.path().stem().generic_string();
+        std::vector<uint8_t> binary, profiled;
+        std::vector<uint64_t> hits;
+        if(!build_profiled(TESTS_DIR, name, nullptr, {}, binary) ||
+            !run_profiled(binary, &hits))
+            return false;
+        std::ostringstream profile;
+        for(size_t pc = 0; pc < hits.size(); ++pc)
+            if(hits[pc] != 0)
+                profile << std::hex << pc << " " << std::dec << hits[pc] << "\n";
+        if(!build_profiled(TESTS_DIR, name, &binary, profile.str(), profiled) ||
+            !run_profiled(profiled, nullptr))
+        {
+            printf("%s: profiled build fails\n", name.c_str());
+            return false;
+        }
+    }
+
+    // profiles only apply to dev binaries
+    abc::compiler_t c{};
+    std::istringstream ss("0 1\n");
+    return !c.load_profile(std::vector<uint8_t>(1024), ss).msg.empty();
+}
+
 int abc_tests()
 {
     int r = 0;
@@ -136,5 +541,54 @@ int abc_tests()
         printf("%-23s %s\n", entry.path().filename().generic_string().c_str(), status);
     }
 
+    {
+        char const* status = "Pass";
+        if(!test_cache())
+            status = "fail !!!", r = 1;
+        printf("%-23s %s\n", "compile cache", status);
+    }
+
+    {
+        char const* status = "Pass";
+        if(!test_memory_cache())
+            status = "fail !!!", r = 1;
+        printf("%-23s %s\n", "memory cache", status);
+    }
+
+    {
+        char const* status = "Pass";
+        if(!test_asset_cache())
+            status = "fail !!!", r = 1;
+        printf("%-23s %s\n", "asset cache", status);
+    }
+
+    {
+        char const* status = "Pass";
+        if(!test_threads())
+            status = "fail !!!", r = 1;
+        printf("%-23s %s\n", "parallel codegen", status);
+    }
+
+    {
+        char const* status = "Pass";
+        if(!test_concurrent_compile())
+            status = "fail !!!", r = 1;
+        printf("%-23s %s\n", "concurrent compile", status);
+    }
+
+    {
+        char const* status = "Pass";
+        if(!test_assemble_direct())
+            status = "fail !!!", r = 1;
+        printf("%-23s %s\n", "direct assembly", status);
+    }
+
+    {
+        char const* status = "Pass";
+        if(!test_profile())
+            status = "fail !!!", r = 1;
+        printf("%-23s %s\n", "profile-guided", status);
+    }
+
     return r;
 }
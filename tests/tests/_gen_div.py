@@ -2,15 +2,15 @@ import random
 
 random.seed(1234);
 
-def test(f, a, b):
+def test(f, t, a, b):
     neg = (1 if a < 0 else 0) ^ (1 if b < 0 else 0)
     q = int(abs(a) / abs(b))
     if neg != 0: q = -q
     f.write(
-        '    a = 0x%08x; b = 0x%08x; $assert(a / b == 0x%08x);\n' %
-        (a & 0xffffffff, b & 0xffffffff, q & 0xffffffff))
+        '    a_%s = 0x%08x; b_%s = 0x%08x; $assert(a_%s / b_%s == 0x%08x);\n' %
+        (t, a & 0xffffffff, t, b & 0xffffffff, t, t, q & 0xffffffff))
 
-def test_range(f, signed, astop, bstop = None):
+def test_range(f, t, signed, astop, bstop = None):
     for n in range(20):
         a = random.randrange(-astop if signed else 2, astop);
         stop = int(abs(a) if bstop is None else bstop)
@@ -19,52 +19,53 @@ def test_range(f, signed, astop, bstop = None):
         b = random.randrange(-stop if signed else 1, stop);
         if b == 0:
             b = 1
-        test(f, a, b);
+        test(f, t, a, b);
 
 with open('div.abc', 'w') as f:
+    f.write('// operands are globals, so that the optimizer cannot fold the\n')
+    f.write('// divisions under test into constants\n')
+    for t in ['u32', 'i32', 'u16', 'i16']:
+        f.write('%s a_%s, b_%s;\n' % (t, t, t))
+    f.write('\n')
     f.write('void main()\n{\n');
     f.write('    $debug_break();\n');
     
     f.write('    {\n');
-    f.write('    u32 a, b;\n');
-    test_range(f, False, 1 << 8)
-    test_range(f, False, 1 << 16)
-    test_range(f, False, 1 << 24)
-    test_range(f, False, 1 << 32)
-    test_range(f, False, 1 << 16, 1 << 8)
-    test_range(f, False, 1 << 24, 1 << 16)
-    test_range(f, False, 1 << 24, 1 << 8)
-    test_range(f, False, 1 << 32, 1 << 24)
-    test_range(f, False, 1 << 32, 1 << 16)
-    test_range(f, False, 1 << 32, 1 << 8)
+    test_range(f, 'u32', False, 1 << 8)
+    test_range(f, 'u32', False, 1 << 16)
+    test_range(f, 'u32', False, 1 << 24)
+    test_range(f, 'u32', False, 1 << 32)
+    test_range(f, 'u32', False, 1 << 16, 1 << 8)
+    test_range(f, 'u32', False, 1 << 24, 1 << 16)
+    test_range(f, 'u32', False, 1 << 24, 1 << 8)
+    test_range(f, 'u32', False, 1 << 32, 1 << 24)
+    test_range(f, 'u32', False, 1 << 32, 1 << 16)
+    test_range(f, 'u32', False, 1 << 32, 1 << 8)
     f.write('    }\n');
     
     f.write('    {\n');
-    f.write('    i32 a, b;\n');
-    test_range(f, True, 1 << 8)
-    test_range(f, True, 1 << 16)
-    test_range(f, True, 1 << 24)
-    test_range(f, True, 1 << 31)
-    test_range(f, True, 1 << 16, 1 << 8)
-    test_range(f, True, 1 << 24, 1 << 16)
-    test_range(f, True, 1 << 24, 1 << 8)
-    test_range(f, True, 1 << 31, 1 << 24)
-    test_range(f, True, 1 << 31, 1 << 16)
-    test_range(f, True, 1 << 31, 1 << 8)
+    test_range(f, 'i32', True, 1 << 8)
+    test_range(f, 'i32', True, 1 << 16)
+    test_range(f, 'i32', True, 1 << 24)
+    test_range(f, 'i32', True, 1 << 31)
+    test_range(f, 'i32', True, 1 << 16, 1 << 8)
+    test_range(f, 'i32', True, 1 << 24, 1 << 16)
+    test_range(f, 'i32', True, 1 << 24, 1 << 8)
+    test_range(f, 'i32', True, 1 << 31, 1 << 24)
+    test_range(f, 'i32', True, 1 << 31, 1 << 16)
+    test_range(f, 'i32', True, 1 << 31, 1 << 8)
     f.write('    }\n');
     
     f.write('    {\n');
-    f.write('    u16 a, b;\n');
-    test_range(f, False, 1 << 8)
-    test_range(f, False, 1 << 16)
-    test_range(f, False, 1 << 16, 1 << 8)
+    test_range(f, 'u16', False, 1 << 8)
+    test_range(f, 'u16', False, 1 << 16)
+    test_range(f, 'u16', False, 1 << 16, 1 << 8)
     f.write('    }\n');
     
     f.write('    {\n');
-    f.write('    i16 a, b;\n');
-    test_range(f, True, 1 << 8)
-    test_range(f, True, 1 << 15)
-    test_range(f, True, 1 << 15, 1 << 8)
+    test_range(f, 'i16', True, 1 << 8)
+    test_range(f, 'i16', True, 1 << 15)
+    test_range(f, 'i16', True, 1 << 15, 1 << 8)
     f.write('    }\n');
     
     f.write('    $debug_break();\n');